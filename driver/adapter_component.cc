@@ -13,32 +13,21 @@ namespace innovusion {
 
 using json = nlohmann::json;
 
-// sine cosine acceleration
-// comparison: fastest implementation vs look up table(lut, 100 values per
-// radian) vs std max error : 0.002% vs 0.001% vs 0% time consumption: 0.13 vs
-// 0.25 vs 0.35
-
-// double abs fast implementation
-double absd(double a) {
-  *((unsigned long *)&a) &= ~(1UL << 63);
-  return a;
-}
-
-// input limit: -pi ~ pi
-double fast_sine(double x) {
-  double y = x * (1.273239545 + -0.405284735 * absd(x));
-  return y * (absd(y) * (0.0192 * absd(y) + 0.1951) + 0.7857);
-}
-
-// input limit: -pi-M_PI_2 ~ pi-M_PI_2
-double fast_cosine(double x) { return fast_sine(x + M_PI_2); }
-
 int InnovusionComponent::data_callback_(void *cframe) {
   inno_cframe_header *frame = (inno_cframe_header *)cframe;
+  if (!placement_reported_) {
+    // every thread has been placed once frames flow
+    placement_reported_ = true;
+    AINFO << "thread placement:\n" << driver_->thread_placement_report();
+  }
   // process full frame
-  if (frame && (scan_writer_ || pointcloud_writer_)) {
+  if (frame && (scan_writer_ || pointcloud_writer_ || range_image_writer_)) {
     // only use INNO_CFRAME_CPOINT
     if (frame->type == INNO_CFRAME_CPOINT) {
+      // ns offsets of the points, if the driver keeps them
+      uint32_t *point_offset_ns = driver_->get_point_ts_ns(frame);
+      // filter the points in place
+      if (filter_chain_) filter_chain_->process(frame, point_offset_ns);
       // check time shifting
       if (driver_->time_fix_err_ms != 0) {
         uint64_t local_ts_ns =
@@ -56,6 +45,10 @@ int InnovusionComponent::data_callback_(void *cframe) {
           frame->ts_us_start = (local_ts_ns + 100 * 1e6) / 1e9;
         }
       }
+      // completeness, if the driver tracks it
+      bool is_complete = true;
+      uint32_t lost_packets = 0;
+      driver_->get_frame_completeness(frame, &is_complete, &lost_packets);
       if (scan_writer_) {
         // reset data
         scan_cloud_ptr_.reset(new ScanCloud);
@@ -76,6 +69,8 @@ int InnovusionComponent::data_callback_(void *cframe) {
         scan_cloud_ptr_->set_source_id(conf_.lidar_id());
         scan_cloud_ptr_->set_height(1);
         scan_cloud_ptr_->set_width(frame->item_number);
+        scan_cloud_ptr_->set_is_complete(is_complete);
+        scan_cloud_ptr_->set_lost_packets(lost_packets);
       }
       if (pointcloud_writer_) {
         // reset data
@@ -97,6 +92,19 @@ int InnovusionComponent::data_callback_(void *cframe) {
         point_cloud_ptr_->set_source_id(conf_.lidar_id());
         point_cloud_ptr_->set_height(1);
         point_cloud_ptr_->set_width(frame->item_number);
+        point_cloud_ptr_->set_is_complete(is_complete);
+        point_cloud_ptr_->set_lost_packets(lost_packets);
+      }
+      fill_point_ts_ns_(frame, point_offset_ns);
+      if (pointcloud_writer_) {
+        fill_point_xyz_(frame);
+        // to the lidar pose at the end of the frame
+        if (deskew_)
+          deskew_->process((uint64_t)(frame->ts_us_start * 1000),
+                           (uint64_t)(frame->ts_us_end * 1000),
+                           point_ts_ns_.data(), point_x_.data(),
+                           point_y_.data(), point_z_.data(),
+                           frame->item_number);
       }
       // get every point from frame
       for (unsigned int i = 0; i < frame->item_number; i++) {
@@ -111,8 +119,7 @@ int InnovusionComponent::data_callback_(void *cframe) {
             point->set_h_angle(p->h_angle);
             point->set_v_angle(p->v_angle);
             point->set_radius(p->radius);  // in cm uint
-            point->set_timestamp((uint64_t)(p->ts_100us * 1e5) +
-                                 (uint64_t)(frame->ts_us_start) * 1000);
+            point->set_timestamp(point_ts_ns_[i]);
             point->set_intensity(static_cast<uint>(p->ref & 0xFF));
             point->set_elongation(static_cast<uint>((p->ref & 0xFF00) >> 8));
             point->set_flags(p->flags);
@@ -122,24 +129,10 @@ int InnovusionComponent::data_callback_(void *cframe) {
           // fill pointcloud
           if (pointcloud_writer_) {
             PointXYZIT *point = point_cloud_ptr_->add_point();
-            double radius = p->radius / 100.0;
-            double x = 0.0, y = 0.0, t = 0.0, z = 0.0;
-            if (enable_fast_sin_cos == 0) {
-              x = radius * sin(p->v_angle * cpoint_angle_unit_c);
-              t = radius * cos(p->v_angle * cpoint_angle_unit_c);
-              y = t * sin(p->h_angle * cpoint_angle_unit_c);
-              z = t * cos(p->h_angle * cpoint_angle_unit_c);
-            } else if (enable_fast_sin_cos == 1) {
-              x = radius * fast_sine(p->v_angle * cpoint_angle_unit_c);
-              t = radius * fast_cosine(p->v_angle * cpoint_angle_unit_c);
-              y = t * fast_sine(p->h_angle * cpoint_angle_unit_c);
-              z = t * fast_cosine(p->h_angle * cpoint_angle_unit_c);
-            }
-            point->set_x(x);
-            point->set_y(y);
-            point->set_z(z);
-            point->set_timestamp((uint64_t)(p->ts_100us * 1e5) +
-                                 (uint64_t)(frame->ts_us_start) * 1000);
+            point->set_x(point_x_[i]);
+            point->set_y(point_y_[i]);
+            point->set_z(point_z_[i]);
+            point->set_timestamp(point_ts_ns_[i]);
             point->set_intensity(static_cast<uint>(p->ref & 0xFF));
             point->set_elongation(static_cast<uint>((p->ref & 0xFF00) >> 8));
             point->set_flags(p->flags);
@@ -150,6 +143,7 @@ int InnovusionComponent::data_callback_(void *cframe) {
       }
 
       // write channel
+      if (range_image_writer_) write_range_image_(frame);
       if (scan_writer_ && scan_cloud_ptr_) {
         scan_cloud_ptr_->mutable_header()->set_timestamp_sec(
             std::chrono::duration_cast<std::chrono::nanoseconds>(
@@ -171,6 +165,101 @@ int InnovusionComponent::data_callback_(void *cframe) {
   return frame->item_number;
 }
 
+void InnovusionComponent::fill_point_ts_ns_(
+    const inno_cframe_header *frame, const uint32_t *point_offset_ns) {
+  uint32_t n = frame->item_number;
+  if (point_ts_ns_.size() < n) point_ts_ns_.resize(n);
+  uint64_t *ts = point_ts_ns_.data();
+  uint64_t start_us = (uint64_t)(frame->ts_us_start);
+  // plain loops over arrays, vectorized by the compiler
+  if (point_offset_ns) {
+    // keep the sub-us part of ts_us_start, the offsets are in ns
+    uint64_t start_ns =
+        start_us * 1000 +
+        (uint64_t)((frame->ts_us_start - (double)start_us) * 1000);
+    for (uint32_t i = 0; i < n; i++) ts[i] = start_ns + point_offset_ns[i];
+  } else {
+    uint64_t start_ns = start_us * 1000;
+    for (uint32_t i = 0; i < n; i++)
+      ts[i] = start_ns + frame->cpoints[i].ts_100us * 100000ull;
+  }
+}
+
+void InnovusionComponent::fill_point_xyz_(const inno_cframe_header *frame) {
+  uint32_t n = frame->item_number;
+  if (point_x_.size() < n) {
+    point_x_.resize(n);
+    point_y_.resize(n);
+    point_z_.resize(n);
+  }
+  cpoints_to_xyz(frame->cpoints, n, enable_fast_sin_cos, point_x_.data(),
+                 point_y_.data(), point_z_.data());
+}
+
+void InnovusionComponent::localization_callback_(
+    const std::shared_ptr<apollo::localization::LocalizationEstimate> &msg) {
+  const apollo::localization::Pose &p = msg->pose();
+  MotionPose pose;
+  double ts = msg->has_measurement_time() ? msg->measurement_time()
+                                          : msg->header().timestamp_sec();
+  pose.ts_ns = (uint64_t)(ts * 1e9);
+  pose.position[0] = p.position().x();
+  pose.position[1] = p.position().y();
+  pose.position[2] = p.position().z();
+  pose.rotation[0] = p.orientation().qw();
+  pose.rotation[1] = p.orientation().qx();
+  pose.rotation[2] = p.orientation().qy();
+  pose.rotation[3] = p.orientation().qz();
+  if (p.has_linear_velocity() && p.has_angular_velocity_vrf()) {
+    pose.has_velocity = true;
+    pose.linear_velocity[0] = p.linear_velocity().x();
+    pose.linear_velocity[1] = p.linear_velocity().y();
+    pose.linear_velocity[2] = p.linear_velocity().z();
+    pose.angular_velocity[0] = p.angular_velocity_vrf().x();
+    pose.angular_velocity[1] = p.angular_velocity_vrf().y();
+    pose.angular_velocity[2] = p.angular_velocity_vrf().z();
+  }
+  deskew_->add_pose(pose);
+}
+
+void InnovusionComponent::write_range_image_(
+    const inno_cframe_header *frame) {
+  range_image_->start();
+  range_image_->add_cpoints(frame->cpoints, frame->item_number);
+
+  range_image_ptr_.reset(new RangeImage);
+  range_image_ptr_->mutable_header()->set_frame_id(conf_.frame_id());
+  range_image_ptr_->mutable_header()->set_sequence_num(frame->idx % UINT_MAX);
+  range_image_ptr_->mutable_header()->set_lidar_timestamp(
+      (uint64_t)(frame->ts_us_start) * 1000);
+  range_image_ptr_->set_frame_id(conf_.frame_id());
+  range_image_ptr_->set_idx(frame->idx);
+  range_image_ptr_->set_measurement_time(frame->ts_us_start * 1e-6);
+  range_image_ptr_->set_frame_ns_start((uint64_t)(frame->ts_us_start) * 1000);
+  range_image_ptr_->set_frame_ns_end((uint64_t)(frame->ts_us_end) * 1000);
+  range_image_ptr_->set_model(conf_.lidar_model());
+  range_image_ptr_->set_source_id(conf_.lidar_id());
+  range_image_ptr_->set_width(range_image_->get_width());
+  range_image_ptr_->set_height(range_image_->get_height());
+  range_image_ptr_->set_h_angle_min(range_image_->get_h_angle_min());
+  range_image_ptr_->set_v_angle_max(range_image_->get_v_angle_max());
+  range_image_ptr_->set_h_resolution(range_image_->get_resolution_h());
+  range_image_ptr_->set_v_resolution(range_image_->get_resolution_v());
+  const std::vector<float> &range = range_image_->get_range();
+  const std::vector<uint8_t> &intensity = range_image_->get_intensity();
+  const std::vector<uint32_t> &timestamp = range_image_->get_timestamp_us();
+  range_image_ptr_->set_range(range.data(), range.size() * sizeof(range[0]));
+  range_image_ptr_->set_intensity(intensity.data(), intensity.size());
+  range_image_ptr_->set_timestamp_offset(
+      timestamp.data(), timestamp.size() * sizeof(timestamp[0]));
+  range_image_ptr_->mutable_header()->set_timestamp_sec(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::high_resolution_clock::now().time_since_epoch())
+          .count() /
+      1e9);
+  range_image_writer_->Write(range_image_ptr_);
+}
+
 int InnovusionComponent::status_callback_(std::string status) {
   try {
     auto j = json::parse(status);
@@ -215,7 +304,54 @@ int InnovusionComponent::status_callback_(std::string status) {
   return 0;
 };
 
-InnovusionComponent::~InnovusionComponent(){};
+int InnovusionComponent::queue_callback_(void *cframe) {
+  {
+    std::unique_lock<std::mutex> lk(convert_mtx_);
+    if (!convert_exit_) {
+      // the pool bounds the queue, the sdk gets no unit while all are here
+      convert_queue_.push_back(cframe);
+      convert_cv_.notify_one();
+      return 1;
+    }
+  }
+  data_callback_(cframe);
+  return 0;
+}
+
+void InnovusionComponent::convert_thread_() {
+  bool placed = false;
+  while (true) {
+    void *cframe = nullptr;
+    {
+      std::unique_lock<std::mutex> lk(convert_mtx_);
+      convert_cv_.wait(
+          lk, [this]() { return convert_exit_ || !convert_queue_.empty(); });
+      if (convert_queue_.empty()) break;
+      cframe = convert_queue_.front();
+      convert_queue_.pop_front();
+    }
+    // the driver is configured once the first frame comes
+    if (!placed) {
+      driver_->place_thread("convert");
+      placed = true;
+    }
+    data_callback_(cframe);
+    driver_->release_cframe(cframe);
+  }
+}
+
+InnovusionComponent::~InnovusionComponent() {
+  if (convert_thread_handle_.joinable()) {
+    // stop() waits for the queued frames to be converted and given back
+    driver_->stop();
+    {
+      std::unique_lock<std::mutex> lk(convert_mtx_);
+      convert_exit_ = true;
+      convert_cv_.notify_all();
+    }
+    convert_thread_handle_.join();
+  }
+};
 
 bool InnovusionComponent::Init() {
   if (!GetProtoConfig(&conf_)) {
@@ -245,6 +381,15 @@ bool InnovusionComponent::Init() {
     ADEBUG << "create scan_channel " << conf_.scan_channel();
     scan_writer_ = node_->CreateWriter<ScanCloud>(conf_.scan_channel());
   }
+  if (conf_.has_range_image_channel() && conf_.range_image_channel() != "" &&
+      node_) {
+    ADEBUG << "create range_image_channel " << conf_.range_image_channel();
+    range_image_writer_ =
+        node_->CreateWriter<RangeImage>(conf_.range_image_channel());
+    range_image_.reset(new ::innovusion::CframeRangeImage(
+        conf_.range_image_h_resolution(), conf_.range_image_v_resolution(),
+        conf_.range_image_h_fov(), conf_.range_image_v_fov()));
+  }
   if (conf_.has_imu_channel() && conf_.imu_channel() != "" && node_) {
     ADEBUG << "create imu_channel " << conf_.imu_channel();
     imu_writer_ = node_->CreateWriter<Imu>(conf_.imu_channel());
@@ -267,7 +412,14 @@ bool InnovusionComponent::Init() {
 
   } else if (std::regex_match(lidar_model, std::regex("rev_[g,e,h].*"))) {
     AWARN << "Init InnovusionDriverJaguar";
-    driver_.reset(new DriverJaguar(data_callback_s_, this));
+    if (conf_.cframe_pool_size() > 0) {
+      driver_.reset(new DriverJaguar(queue_callback_s_, this));
+      driver_->cframe_pool_size = conf_.cframe_pool_size();
+      convert_thread_handle_ =
+          std::thread(&InnovusionComponent::convert_thread_, this);
+    } else {
+      driver_.reset(new DriverJaguar(data_callback_s_, this));
+    }
   } else {
     AERROR << "Not support model:" << conf_.lidar_model();
     return false;
@@ -293,12 +445,41 @@ bool InnovusionComponent::Init() {
     driver_->set_falcon_eye = conf_.set_falcon_eye();
   if (conf_.has_roi_center_h()) driver_->roi_center_h = conf_.roi_center_h();
   if (conf_.has_roi_center_v()) driver_->roi_center_v = conf_.roi_center_v();
+  if (conf_.has_huge_page()) driver_->huge_page = conf_.huge_page();
+  if (conf_.has_frame_close_slack_ms())
+    driver_->frame_close_slack_ms = conf_.frame_close_slack_ms();
   if (conf_.has_inno_log_level())
     driver_->inno_log_level = conf_.inno_log_level();
   if (conf_.has_time_fix_err_ms())
     driver_->time_fix_err_ms = conf_.time_fix_err_ms();
+  for (const ThreadPlacementConfig &thread_placement :
+       conf_.thread_placement()) {
+    ThreadPlacement placement;
+    placement.thread = thread_placement.thread();
+    placement.cpus = thread_placement.cpus();
+    placement.has_priority = thread_placement.has_priority();
+    placement.priority = thread_placement.priority();
+    driver_->thread_placements.push_back(placement);
+  }
   if (conf_.has_enable_fast_sin_cos())
     enable_fast_sin_cos = conf_.enable_fast_sin_cos();
+  if (conf_.filter_size() > 0) {
+    filter_chain_.reset(new CframeFilterChain(conf_.filter_stats_interval(),
+                                              enable_fast_sin_cos));
+    for (const FilterConfig &filter : conf_.filter()) {
+      if (!filter_chain_->add_filter(filter)) return false;
+    }
+  }
+  if (conf_.has_deskew() && pointcloud_writer_ && node_) {
+    deskew_.reset(new MotionDeskew(conf_.deskew()));
+    localization_reader_ =
+        node_->CreateReader<apollo::localization::LocalizationEstimate>(
+            conf_.deskew().localization_channel(),
+            [this](const std::shared_ptr<
+                   apollo::localization::LocalizationEstimate> &msg) {
+              localization_callback_(msg);
+            });
+  }
   driver_->start();
   return true;
 };
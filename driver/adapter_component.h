@@ -1,10 +1,20 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cframe_filter.h"
 #include "cyber/cyber.h"
 #include "driver_factory.h"
 #include "modules/drivers/lidar/innovusion/proto/innovusion.pb.h"
 #include "modules/drivers/lidar/innovusion/proto/innovusion_config.pb.h"
 #include "modules/drivers/lidar/innovusion/proto/innovusion_imu.pb.h"
+#include "modules/localization/proto/localization.pb.h"
+#include "motion_deskew.h"
+#include "sdk_common/converter/cframe_range_image.h"
 
 namespace apollo {
 namespace drivers {
@@ -18,6 +28,7 @@ using apollo::drivers::innovusion::Imu;
 using apollo::drivers::innovusion::PointCloud;
 using apollo::drivers::innovusion::PointHVRIT;
 using apollo::drivers::innovusion::PointXYZIT;
+using apollo::drivers::innovusion::RangeImage;
 using apollo::drivers::innovusion::ScanCloud;
 
 class InnovusionComponent : public apollo::cyber::Component<> {
@@ -32,6 +43,23 @@ class InnovusionComponent : public apollo::cyber::Component<> {
   }
   // The callback actually
   int data_callback_(void *cframe);
+  void write_range_image_(const inno_cframe_header *frame);
+  // the ns timestamp of every point into point_ts_ns_
+  void fill_point_ts_ns_(const inno_cframe_header *frame,
+                         const uint32_t *point_offset_ns);
+  // x/y/z of every point into point_x_/y_/z_
+  void fill_point_xyz_(const inno_cframe_header *frame);
+  void localization_callback_(
+      const std::shared_ptr<apollo::localization::LocalizationEstimate> &msg);
+
+  // static callback wrapper, used when the driver has a cframe pool
+  static int queue_callback_s_(int lidar_handle, void *ctx, void *frame) {
+    return (reinterpret_cast<InnovusionComponent *>(ctx))
+        ->queue_callback_(frame);
+  }
+  // queue the frame to the convert thread, 1: the frame is kept
+  int queue_callback_(void *cframe);
+  void convert_thread_();
 
   // static callback wrapper, called by the driver_
   static int status_callback_s_(int lidar_handle, void *ctx,
@@ -49,11 +77,32 @@ class InnovusionComponent : public apollo::cyber::Component<> {
   std::shared_ptr<Writer<ScanCloud>> scan_writer_ = nullptr;
   std::shared_ptr<Writer<PointCloud>> pointcloud_writer_ = nullptr;
   std::shared_ptr<Writer<Imu>> imu_writer_ = nullptr;
+  std::shared_ptr<Writer<RangeImage>> range_image_writer_ = nullptr;
 
   std::shared_ptr<PointCloud> point_cloud_ptr_ = nullptr;
   std::shared_ptr<ScanCloud> scan_cloud_ptr_ = nullptr;
   std::shared_ptr<Imu> imu_ptr_ = nullptr;
+  std::shared_ptr<RangeImage> range_image_ptr_ = nullptr;
+  // planes are allocated once, reused by every frame
+  std::unique_ptr<::innovusion::CframeRangeImage> range_image_ = nullptr;
   uint32_t enable_fast_sin_cos{0};
+  std::unique_ptr<CframeFilterChain> filter_chain_ = nullptr;
+  // reused by every frame
+  std::vector<uint64_t> point_ts_ns_;
+  std::vector<float> point_x_;
+  std::vector<float> point_y_;
+  std::vector<float> point_z_;
+  std::unique_ptr<MotionDeskew> deskew_ = nullptr;
+  std::shared_ptr<Reader<apollo::localization::LocalizationEstimate>>
+      localization_reader_ = nullptr;
+
+  // frames of the driver's cframe pool, converted and given back in order
+  std::thread convert_thread_handle_;
+  std::mutex convert_mtx_;
+  std::condition_variable convert_cv_;
+  std::deque<void *> convert_queue_;
+  bool convert_exit_{false};
+  bool placement_reported_{false};
 };
 
 CYBER_REGISTER_COMPONENT(InnovusionComponent)
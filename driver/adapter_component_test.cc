@@ -2,13 +2,20 @@
 
 #include <time.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "cyber/cyber.h"
 #include "driver_factory.h"
 #include "falcon/driver_falcon.h"
 #include "gtest/gtest.h"
+#include "motion_deskew.h"
 
 namespace apollo {
 namespace drivers {
@@ -152,6 +159,314 @@ TEST_F(AdapterTest, DataPrase) {
   free(frame);
 }
 
+TEST(CframeFilterTest, RoiAndIntensity) {
+  int item_number = 1000;
+  inno_cframe_header *frame = reinterpret_cast<inno_cframe_header *>(
+      calloc(1, sizeof(struct inno_cframe_header) +
+                    sizeof(struct inno_cpoint) * item_number));
+  frame->item_number = item_number;
+  frame->type = INNO_CFRAME_CPOINT;
+  for (auto i = 0; i < item_number; i++) {
+    inno_cpoint &p = frame->cpoints[i];
+    p.h_angle = i - 500;
+    p.radius = 1000;
+    p.ref = i % 256;
+  }
+
+  CframeFilterChain chain;
+  FilterConfig roi;
+  roi.set_type("roi_crop");
+  roi.set_h_angle_min(-10);  // -455 cpoint units
+  roi.set_h_angle_max(10);
+  ASSERT_TRUE(chain.add_filter(roi));
+  FilterConfig intensity;
+  intensity.set_type("intensity");
+  intensity.set_intensity_min(100);
+  ASSERT_TRUE(chain.add_filter(intensity));
+  FilterConfig unknown;
+  unknown.set_type("unknown");
+  ASSERT_FALSE(chain.add_filter(unknown));
+
+  uint32_t kept = chain.process(frame);
+  ASSERT_EQ(kept, frame->item_number);
+  ASSERT_GT(kept, 0u);
+  for (uint32_t i = 0; i < kept; i++) {
+    inno_cpoint &p = frame->cpoints[i];
+    EXPECT_GE(p.h_angle, -455);
+    EXPECT_LE(p.h_angle, 455);
+    EXPECT_GE(p.ref & 0xFF, 100u);
+  }
+  free(frame);
+}
+
+TEST(CframeFilterTest, OutlierAlongScanLine) {
+  // as the lidar sends them: per firing 4 channels x 2 returns, a wall
+  // at 10m with the second return 1m behind, one spike at 30m; 2 scan
+  // lines of 250 firings
+  const int firings = 500;
+  int item_number = firings * 8;
+  inno_cframe_header *frame = reinterpret_cast<inno_cframe_header *>(
+      calloc(1, sizeof(struct inno_cframe_header) +
+                    sizeof(struct inno_cpoint) * item_number));
+  frame->item_number = item_number;
+  frame->type = INNO_CFRAME_CPOINT;
+  const int spike = 250 * 8 + 2 * 2;  // firing 250, channel 2, return 0
+  for (auto i = 0; i < item_number; i++) {
+    int firing = i / 8;
+    int ch = i % 8 / 2;
+    int m = i % 2;
+    inno_cpoint &p = frame->cpoints[i];
+    p.h_angle = firing % 250 * 4 - 500;
+    p.v_angle = ch * 40 + firing / 250 * 160;
+    p.scan_id = firing / 250;
+    p.scan_idx = firing % 250;
+    p.flags = ch | (m ? 0x4 : 0);
+    p.radius = i == spike ? 3000 : 1000 + m * 100;
+    p.ref = i;  // to find the points
+  }
+
+  CframeFilterChain chain;
+  FilterConfig outlier;
+  outlier.set_type("outlier");
+  outlier.set_mean_k(8);
+  outlier.set_stddev_mul(3.0);
+  ASSERT_TRUE(chain.add_filter(outlier));
+  uint32_t kept = chain.process(frame);
+  // the spike goes, with at most the neighbors it pulls above the
+  // threshold, all on its own scan line
+  EXPECT_LT(kept, static_cast<uint32_t>(item_number));
+  EXPECT_GE(kept, static_cast<uint32_t>(item_number) - 8);
+  std::vector<bool> is_kept(item_number, false);
+  for (uint32_t i = 0; i < kept; i++) {
+    is_kept[frame->cpoints[i].ref] = true;
+  }
+  EXPECT_FALSE(is_kept[spike]);
+  for (auto i = 0; i < item_number; i++) {
+    if (!is_kept[i]) {
+      EXPECT_EQ(spike / 2000, i / 2000);
+      EXPECT_EQ(spike % 8 / 2, i % 8 / 2);
+    }
+  }
+  free(frame);
+}
+
+TEST(CframeConverterTest, LostAndReordered) {
+  const int frame_number = 4;
+  const int packet_number = 10;
+  std::vector<std::vector<char>> frames[frame_number];
+  for (int f = 0; f < frame_number; f++) {
+    for (int p = 0; p < packet_number; p++) {
+      std::vector<char> buf(sizeof(InnoDataPacket), 0);
+      InnoDataPacket *pkt = reinterpret_cast<InnoDataPacket *>(&buf[0]);
+      pkt->common.size = sizeof(InnoDataPacket);
+      pkt->type = INNO_ITEM_TYPE_SPHERE_POINTCLOUD;
+      pkt->idx = f;
+      pkt->sub_seq = p;
+      pkt->is_last_sub_frame = p == packet_number - 1;
+      pkt->is_last_sequence = p == packet_number - 1;
+      frames[f].push_back(buf);
+    }
+  }
+  auto add = [](::innovusion::CframeConverter *converter,
+                const std::vector<char> &buf) {
+    return converter->add_data_packet(
+        reinterpret_cast<const InnoDataPacket *>(&buf[0]), 0);
+  };
+  ::innovusion::CframeConverter *converter =
+      new ::innovusion::CframeConverter();
+  const ::innovusion::CframeConverter::Completeness *completeness;
+
+  // frame 0: packet 1 comes after the first packets of frame 1, the
+  // frame waits for it
+  for (int p = 0; p < packet_number; p++) {
+    if (p != 1) EXPECT_EQ(nullptr, add(converter, frames[0][p]));
+  }
+  for (int p = 0; p < 3; p++) {
+    EXPECT_EQ(nullptr, add(converter, frames[1][p]));
+  }
+  inno_cframe_header *frame = add(converter, frames[0][1]);
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(0u, frame->idx);
+  EXPECT_EQ(0u, frame->flags);
+  EXPECT_EQ(0u, frame->sub_seq);
+  completeness = converter->get_completeness(frame);
+  ASSERT_NE(nullptr, completeness);
+  EXPECT_EQ(0u, completeness->lost_packets);
+  EXPECT_FALSE(completeness->no_frame_end);
+  // frame 1: closed on its last packet
+  for (int p = 3; p < packet_number - 1; p++) {
+    EXPECT_EQ(nullptr, add(converter, frames[1][p]));
+  }
+  frame = add(converter, frames[1][packet_number - 1]);
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(1u, frame->idx);
+  EXPECT_EQ(0u, converter->get_completeness(frame)->lost_packets);
+  EXPECT_EQ(nullptr, add(converter, frames[1][5]));  // duplicate
+
+  // frame 2: packet 1 is lost, returned once frame 3 is far enough
+  for (int p = 0; p < packet_number; p++) {
+    if (p != 1) EXPECT_EQ(nullptr, add(converter, frames[2][p]));
+  }
+  for (int p = 0; p < 7; p++) {
+    EXPECT_EQ(nullptr, add(converter, frames[3][p]));
+  }
+  frame = add(converter, frames[3][7]);
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(2u, frame->idx);
+  completeness = converter->get_completeness(frame);
+  ASSERT_NE(nullptr, completeness);
+  EXPECT_EQ(1u, completeness->lost_packets);
+  EXPECT_FALSE(completeness->no_frame_end);
+  EXPECT_EQ(nullptr, add(converter, frames[2][1]));  // too late
+  EXPECT_EQ(nullptr, add(converter, frames[3][8]));
+  frame = add(converter, frames[3][9]);
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(3u, frame->idx);
+
+  const ::innovusion::CframeConverter::Stats &stats = converter->get_stats();
+  EXPECT_EQ(4u, stats.frames);
+  EXPECT_EQ(1u, stats.incomplete_frames);
+  EXPECT_EQ(2u, stats.early_closed_frames);
+  EXPECT_EQ(1u, stats.lost_packets);
+  EXPECT_EQ(1u, stats.reordered_packets);
+  EXPECT_EQ(2u, stats.dropped_packets);
+  delete converter;
+}
+
+TEST(FrameDeadlineTest, CallbackOutsideLoopLock) {
+  // the callback waits for a lock held by a thread that creates a timer
+  std::mutex mtx;
+  std::atomic<int> fired(0);
+  FrameDeadlineTimer timer([&]() {
+    std::unique_lock<std::mutex> lk(mtx);
+    fired++;
+  });
+  {
+    std::unique_lock<std::mutex> lk(mtx);
+    ASSERT_TRUE(timer.arm(1000000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    FrameDeadlineTimer other([]() {});
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(1, fired.load());
+
+  // the destructor waits for the running callback
+  std::atomic<bool> entered(false);
+  std::atomic<bool> finished(false);
+  FrameDeadlineTimer *slow = new FrameDeadlineTimer([&]() {
+    entered = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    finished = true;
+  });
+  ASSERT_TRUE(slow->arm(1000));
+  while (!entered) std::this_thread::yield();
+  delete slow;
+  EXPECT_TRUE(finished.load());
+}
+
+// vehicle yawing at 1 rad/s while driving at 15 m/s, poses every 10ms
+static MotionPose deskew_test_pose(uint64_t ts_ns) {
+  double t = ts_ns * 1e-9;
+  double yaw = 0.3 + 1.0 * t;
+  MotionPose pose;
+  pose.ts_ns = ts_ns;
+  pose.position[0] = 100 + 15 * t;
+  pose.position[1] = -20 + 3 * t;
+  pose.position[2] = 0.5;
+  pose.rotation[0] = cos(yaw / 2);
+  pose.rotation[3] = sin(yaw / 2);
+  pose.has_velocity = true;
+  pose.linear_velocity[0] = 15;
+  pose.linear_velocity[1] = 3;
+  pose.angular_velocity[2] = 1.0;
+  return pose;
+}
+
+TEST(MotionDeskewTest, RotatingScene) {
+  DeskewConfig conf;
+  conf.set_x(1.2);
+  conf.set_z(1.8);
+  conf.set_qw(cos(0.05));  // yawed 0.1 rad on the vehicle
+  conf.set_qz(sin(0.05));
+  MotionDeskew deskew(conf);
+  double lidar_position[3] = {1.2, 0, 1.8};
+  double lidar_rotation[4] = {cos(0.05), 0, 0, sin(0.05)};
+  RigidTransform lidar_to_vehicle =
+      RigidTransform::from_pose(lidar_position, lidar_rotation);
+
+  const uint64_t kMs = 1000000;
+  const uint64_t start_ns = 1000 * kMs;
+  const uint64_t end_ns = start_ns + 100 * kMs;
+  // the last 40ms of the frame are extrapolated
+  for (uint64_t ts = start_ns - 50 * kMs; ts <= start_ns + 60 * kMs;
+       ts += 10 * kMs)
+    deskew.add_pose(deskew_test_pose(ts));
+
+  auto lidar_at = [&](uint64_t ts) {
+    MotionPose pose = deskew_test_pose(ts);
+    return RigidTransform::from_pose(pose.position, pose.rotation) *
+           lidar_to_vehicle;
+  };
+  RigidTransform end_to_world = lidar_at(end_ns);
+  RigidTransform world_to_end = end_to_world.inverse();
+
+  // static points 2-150m around, seen by the moving lidar in time order,
+  // but for a reordered one from late in the frame and a late one from
+  // before its start, taken as seen at the start
+  const uint32_t n = 50000;
+  std::vector<uint64_t> ts(n);
+  std::vector<float> x(n), y(n), z(n);
+  std::vector<double> ref(n * 3);
+  uint32_t seed = 1;
+  for (uint32_t i = 0; i < n; i++) {
+    ts[i] = start_ns + (end_ns - start_ns) * i / n;
+    if (i == n / 2) ts[i] = start_ns + 90 * kMs;
+    if (i == n / 4) ts[i] = start_ns - 3 * kMs;
+    seed = seed * 1103515245 + 12345;
+    double h = (seed >> 8) % 1200 / 1000.0 - 0.6;
+    double v = (seed >> 4) % 400 / 1000.0 - 0.2;
+    double r = 2 + (seed >> 12) % 148;
+    double p[3] = {r * cos(v) * cos(h), r * cos(v) * sin(h), r * sin(v)};
+    RigidTransform lidar = lidar_at(std::max(ts[i], start_ns));
+    double w[3];
+    for (int k = 0; k < 3; k++)
+      w[k] = lidar.r[k * 3] * p[0] + lidar.r[k * 3 + 1] * p[1] +
+             lidar.r[k * 3 + 2] * p[2] + lidar.t[k];
+    for (int k = 0; k < 3; k++)
+      ref[i * 3 + k] = world_to_end.r[k * 3] * w[0] +
+                       world_to_end.r[k * 3 + 1] * w[1] +
+                       world_to_end.r[k * 3 + 2] * w[2] + world_to_end.t[k];
+    x[i] = p[0];
+    y[i] = p[1];
+    z[i] = p[2];
+  }
+  auto max_error = [&]() {
+    double e = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      double dx = x[i] - ref[i * 3];
+      double dy = y[i] - ref[i * 3 + 1];
+      double dz = z[i] - ref[i * 3 + 2];
+      e = std::max(e, sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    return e;
+  };
+  double raw_error = max_error();
+
+  // before the first pose: not covered, untouched
+  std::vector<float> x0 = x;
+  EXPECT_FALSE(deskew.process(start_ns - 200 * kMs, start_ns - 100 * kMs,
+                              ts.data(), x.data(), y.data(), z.data(), n));
+  EXPECT_EQ(x0, x);
+
+  ASSERT_TRUE(deskew.process(start_ns, end_ns, ts.data(), x.data(), y.data(),
+                             z.data(), n));
+  double error = max_error();
+  std::cout << "deskew max error " << raw_error << "m -> " << error << "m, "
+            << deskew.get_stats() << std::endl;
+  EXPECT_GT(raw_error, 1.0);
+  EXPECT_LT(error, 0.002);
+}
+
 // live reconnect test -> falcon
 // has been manually tested 10 times -> OK
 // live reconnect test -> Jaguar
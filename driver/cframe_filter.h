@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "modules/drivers/lidar/innovusion/proto/innovusion_config.pb.h"
+#include "sdk_common/converter/cframe_legacy.h"
+
+namespace apollo {
+namespace drivers {
+namespace innovusion {
+
+// x/y/z in meters of n cpoints, fast_sin_cos is Config.enable_fast_sin_cos;
+// the published point cloud and the filters convert the same way
+void cpoints_to_xyz(const inno_cpoint *cpoints, uint32_t n,
+                    uint32_t fast_sin_cos, float *x, float *y, float *z);
+
+// One stage of the chain, works on the cpoints of the frame in place:
+// the points it keeps are moved to the front with move_point_() and
+// item_number is cut.
+class CframeFilter {
+ public:
+  explicit CframeFilter(const std::string &name) : name_(name){};
+  virtual ~CframeFilter(){};
+
+  // the frame is INNO_CFRAME_CPOINT, return the number of points kept
+  virtual uint32_t process(inno_cframe_header *frame) = 0;
+  const std::string &name() const { return name_; };
+
+ protected:
+  // the point and the per point data that goes with it
+  inline void move_point_(inno_cframe_header *frame, uint32_t from,
+                          uint32_t to) {
+    frame->cpoints[to] = frame->cpoints[from];
+    if (point_ts_ns_) point_ts_ns_[to] = point_ts_ns_[from];
+  }
+  inline void fill_xyz_(const inno_cframe_header *frame, float *x, float *y,
+                        float *z) const {
+    cpoints_to_xyz(frame->cpoints, frame->item_number, fast_sin_cos_, x, y,
+                   z);
+  }
+
+ private:
+  friend class CframeFilterChain;
+  std::string name_;
+  uint32_t *point_ts_ns_{nullptr};
+  uint32_t fast_sin_cos_{0};
+};
+
+class RoiCropFilter : public CframeFilter {
+ public:
+  explicit RoiCropFilter(const FilterConfig &conf);
+  uint32_t process(inno_cframe_header *frame) override;
+
+ private:
+  // in cpoint units
+  int32_t h_min_, h_max_, v_min_, v_max_;
+  uint32_t radius_min_, radius_max_;
+};
+
+class IntensityFilter : public CframeFilter {
+ public:
+  explicit IntensityFilter(const FilterConfig &conf);
+  uint32_t process(inno_cframe_header *frame) override;
+
+ private:
+  uint32_t min_, max_;
+};
+
+// statistical outlier removal: the neighbors of a point are the mean_k
+// nearest firings along its scan line (scan_id and channel, the points
+// of a frame interleave the channels and returns), not a kd-tree search,
+// so one frame costs O(n * mean_k)
+class OutlierFilter : public CframeFilter {
+ public:
+  explicit OutlierFilter(const FilterConfig &conf);
+  uint32_t process(inno_cframe_header *frame) override;
+
+ private:
+  static const uint32_t kLineNumber = 1024 * 4;
+  static uint32_t line_of_(const inno_cpoint &p) {
+    return p.scan_id * 4 + (p.flags & 3);
+  }
+
+ private:
+  uint32_t mean_k_;
+  double stddev_mul_;
+  // reused across frames
+  std::vector<float> x_, y_, z_;
+  std::vector<float> mean_dist_;
+  // the points of line l are line_points_[line_start_[l], line_start_[l+1])
+  std::vector<uint32_t> line_start_;
+  std::vector<uint32_t> line_fill_;
+  std::vector<uint32_t> line_points_;
+};
+
+class CframeFilterChain {
+ public:
+  typedef std::function<CframeFilter *(const FilterConfig &)> Creator;
+
+  struct Stats {
+    uint64_t frames{0};
+    uint64_t points_in{0};
+    uint64_t points_out{0};
+    uint64_t total_ns{0};
+    uint64_t max_ns{0};
+  };
+
+ public:
+  explicit CframeFilterChain(uint32_t stats_interval = 0,
+                             uint32_t fast_sin_cos = 0)
+      : stats_interval_(stats_interval), fast_sin_cos_(fast_sin_cos){};
+
+  // add filters of your own before the chain is built
+  static void register_filter(const std::string &type, Creator creator);
+  // false if a type is unknown
+  bool add_filter(const FilterConfig &conf);
+  bool empty() const { return filters_.empty(); };
+
+  // run all filters on the frame, return the number of points kept,
+  // point_ts_ns (if any) is compacted with the points
+  uint32_t process(inno_cframe_header *frame,
+                   uint32_t *point_ts_ns = nullptr);
+  std::string get_stats() const;
+
+ private:
+  static std::map<std::string, Creator> &creators_();
+
+ private:
+  std::vector<std::unique_ptr<CframeFilter>> filters_;
+  std::vector<Stats> stats_;
+  uint32_t stats_interval_;
+  uint32_t fast_sin_cos_;
+  uint64_t frames_{0};
+};
+
+}  // namespace innovusion
+}  // namespace drivers
+}  // namespace apollo
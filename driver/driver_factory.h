@@ -1,7 +1,11 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include "cyber/cyber.h"
 #include "httplib.h"
+#include "thread_placement.h"
 
 namespace apollo {
 namespace drivers {
@@ -38,14 +42,56 @@ class DriverFactory {
   virtual int set_lidar(const std::string &key, const std::string &value) = 0;
   virtual int set_config_name_value(const std::string &key,
                                     const std::string &value) = 0;
+  // give back a cframe that the cframe callback kept (returned 1)
+  virtual void release_cframe(void *cframe){};
+  // ns from ts_us_start of every point of the cframe being passed to the
+  // cframe callback, nullptr if the driver has none, valid until the
+  // callback returns. Kept by the converter built into the driver, the
+  // fitted clock of the sdk is not needed for it
+  virtual uint32_t *get_point_ts_ns(const void *cframe) { return nullptr; }
+  // completeness of the cframe being passed to the cframe callback,
+  // false if the driver does not track it
+  virtual bool get_frame_completeness(const void *cframe, bool *is_complete,
+                                      uint32_t *lost_packets) {
+    return false;
+  }
+
+  // place the calling adapter thread by its thread_placements entry and
+  // record what it got
+  void place_thread(const std::string &thread) {
+    std::string error;
+    std::string applied = self_thread_placement();
+    for (const ThreadPlacement &placement : thread_placements) {
+      if (placement.thread == thread) {
+        applied = apply_thread_placement(placement, &error);
+        break;
+      }
+    }
+    if (!error.empty()) AWARN << "thread " << thread << " placement: " << error;
+    AINFO << "thread " << thread << " placement " << applied;
+    std::unique_lock<std::mutex> lk(placement_mtx_);
+    placement_report_ += thread + ": " + applied + "\n";
+  }
+
+  // one "thread: cpus=.. policy=.." line per adapter thread
+  virtual std::string thread_placement_report() {
+    std::unique_lock<std::mutex> lk(placement_mtx_);
+    return placement_report_;
+  }
 
   virtual void StatusPollThread() {
     std::shared_ptr<httplib::Client> cli = nullptr;
+    bool placed = false;
     while (true) {
       {
         std::unique_lock<std::mutex> lk(mtx);
         cv.wait(lk, [&]() { return is_running_ != 0; });
       }
+      // the configuration is complete once the driver runs
+      if (!placed && is_running_ != -3) {
+        place_thread("status_poll");
+        placed = true;
+      }
       if (is_running_ > 0 && status_callback_ != nullptr) {
         if (cli != nullptr && !cli->is_valid()) {
           cli.reset();
@@ -126,6 +172,19 @@ class DriverFactory {
   bool set_falcon_eye{false};
   int32_t roi_center_h{0};
   int32_t roi_center_v{0};
+  // close a frame when no packet came for its duration + this, 0: wait for
+  // the first packet of the next frame
+  uint32_t frame_close_slack_ms{50};
+  // HugePageMode of the cframe converter buffers
+  uint32_t huge_page{0};
+
+  // jaguar
+  // number of frames in the external cframe memory pool, 0: sdk allocates
+  uint32_t cframe_pool_size{0};
+
+  // where the sdk and adapter threads run, see ThreadPlacementConfig in
+  // innovusion_config.proto
+  std::vector<ThreadPlacement> thread_placements;
 
   // status
   int is_running_{0};  //-1: live err, 0: default, 1: ok
@@ -139,6 +198,8 @@ class DriverFactory {
   void *cframe_callback_ctx_;
   InnoStatusCallBack status_callback_ = nullptr;
   std::thread sub_thread_status;
+  std::mutex placement_mtx_;
+  std::string placement_report_;
 
  private:
 };
@@ -1,5 +1,7 @@
 #include "driver_falcon.h"
 
+#include <time.h>
+
 #include "src/sdk_common/inno_lidar_api.h"
 #include "src/sdk_common/inno_lidar_other_api.h"
 
@@ -7,8 +9,49 @@ namespace apollo {
 namespace drivers {
 namespace innovusion {
 
+static uint64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+// called with converter_mtx_ held, the timer is armed once per deadline
+// not per packet
+void DriverFalcon::packet_received_() {
+  last_packet_ns_ = monotonic_ns();
+  if (!close_timer_armed_ &&
+      cframe_converter_->get_current_frame_span_us() >= 0) {
+    close_timer_armed_ = close_timer_->arm(frame_close_slack_ms * 1000000UL);
+  }
+}
+
+void DriverFalcon::close_timer_callback_() {
+  std::unique_lock<std::mutex> lk(converter_mtx_);
+  close_timer_armed_ = false;
+  int64_t span_us = cframe_converter_->get_current_frame_span_us();
+  if (span_us < 0) return;
+  uint64_t timeout_ns = span_us * 1000UL + frame_close_slack_ms * 1000000UL;
+  uint64_t idle_ns = monotonic_ns() - last_packet_ns_;
+  if (idle_ns < timeout_ns) {
+    close_timer_armed_ = close_timer_->arm(timeout_ns - idle_ns);
+    return;
+  }
+  // the previous frame first if it still waits for late packets
+  inno_cframe_header *cframe;
+  while ((cframe = cframe_converter_->close_current_frame_on_timeout()) !=
+         NULL) {
+    AWARN << "frame " << cframe->idx << " closed after no packet for "
+          << idle_ns / 1000000 << "ms";
+    cframe_callback_(handle_, cframe_callback_ctx_, (void *)cframe);
+  }
+}
+
 bool DriverFalcon::init_() {
   inno_lidar_set_log_level((enum InnoLogLevel)inno_log_level);
+  if (frame_close_slack_ms > 0 && !close_timer_) {
+    close_timer_.reset(
+        new FrameDeadlineTimer([this]() { close_timer_callback_(); }));
+  }
   enum InnoLidarProtocol protocol_;
   if (data_filename != "") {
     // setup read from file
@@ -62,6 +105,16 @@ bool DriverFalcon::init_() {
       }
     }
 
+    if (huge_page > 0) {
+      std::unique_lock<std::mutex> lk(converter_mtx_);
+      if (converter_huge_page_ != huge_page) {
+        delete cframe_converter_;
+        cframe_converter_ =
+            new ::innovusion::CframeConverter(huge_page, true);
+        converter_huge_page_ = huge_page;
+      }
+    }
+
     ret = inno_lidar_set_parameters(handle_, "", yaml_filename.c_str());
     if (ret != 0) AWARN << "set_parameters " << ret;
 
@@ -69,11 +122,35 @@ bool DriverFalcon::init_() {
         inno_lidar_set_callbacks(handle_, message_callback_s_, data_callback_s_,
                                  status_callback_s_, NULL, this);
     if (ret != 0) AWARN << "set_callbacks " << ret;
+
+    set_sdk_thread_placements_();
     return true;
   }
   return false;
 };
 
+void DriverFalcon::set_sdk_thread_placements_() {
+  // the linked sdk only places all of its threads together
+  for (const ThreadPlacement &placement : thread_placements) {
+    if (placement.thread == "status_poll" || placement.thread == "convert") {
+      continue;
+    }
+    if (placement.thread != "sdk") {
+      AWARN << "thread " << placement.thread
+            << " cannot be placed, use \"sdk\" for falcon";
+      continue;
+    }
+    cpu_set_t cpuset;
+    if (!parse_cpu_list(placement.cpus, &cpuset)) {
+      AWARN << "thread sdk: bad cpus '" << placement.cpus << "'";
+      continue;
+    }
+    int ret =
+        inno_lidar_thread_setaffinity_np(handle_, sizeof(cpuset), &cpuset, 0);
+    if (ret != 0) AWARN << "thread_setaffinity " << ret;
+  }
+}
+
 bool DriverFalcon::start() {
   // no blocking mode
   if (handle_ <= 0) init_();
@@ -107,6 +184,24 @@ int DriverFalcon::get_lidar(const std::string &cmd, std::string *result) {
     *result += "127.0.0.1";
     return 0;
   }
+  if (cmd == "cframe_converter_stats") {
+    std::unique_lock<std::mutex> lk(converter_mtx_);
+    const ::innovusion::CframeConverter::Stats &stats =
+        cframe_converter_->get_stats();
+    *result += "frames=" + std::to_string(stats.frames) +
+               " incomplete=" + std::to_string(stats.incomplete_frames) +
+               " early_closed=" + std::to_string(stats.early_closed_frames) +
+               " timeout_closed=" +
+               std::to_string(stats.timeout_closed_frames) +
+               " lost_packets=" + std::to_string(stats.lost_packets) +
+               " reordered=" + std::to_string(stats.reordered_packets) +
+               " dropped=" + std::to_string(stats.dropped_packets);
+    return 0;
+  }
+  if (cmd == "thread_placement") {
+    *result += thread_placement_report();
+    return 0;
+  }
   if (cmd == "fw_version") {
     ret = inno_lidar_get_fw_version(handle_, buffer, buffer_len);
   } else if (cmd == "sn") {
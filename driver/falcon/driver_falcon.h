@@ -1,6 +1,9 @@
 #pragma once
 
+#include <memory>
+
 #include "modules/drivers/lidar/innovusion/driver/driver_factory.h"
+#include "modules/drivers/lidar/innovusion/driver/falcon/frame_deadline.h"
 #include "sdk/src/sdk_common/converter/cframe_converter.h"
 
 namespace apollo {
@@ -13,11 +16,13 @@ class __attribute__((visibility("default"))) DriverFalcon
   DriverFalcon(InnoCframeCallBack data_callback, void *callback_context,
                InnoStatusCallBack status_callback = nullptr)
       : DriverFactory(data_callback, callback_context, status_callback) {
-    cframe_converter_ = new (::innovusion::CframeConverter);
+    cframe_converter_ =
+        new ::innovusion::CframeConverter(::innovusion::HUGE_PAGE_OFF, true);
   };
 
   ~DriverFalcon() {
     stop();  // make sure that handle_ has been closed
+    close_timer_.reset();
     if (cframe_converter_) {
       delete cframe_converter_;
       cframe_converter_ = NULL;
@@ -49,7 +54,9 @@ class __attribute__((visibility("default"))) DriverFalcon
   };
 
   int data_callback_(int handle_, void *ctx, const InnoDataPacket *pkt) {
+    std::unique_lock<std::mutex> lk(converter_mtx_);
     inno_cframe_header *cframe = cframe_converter_->add_data_packet(pkt, 0);
+    if (close_timer_) packet_received_();
     if (cframe != NULL) {
       cframe_callback_(handle_, cframe_callback_ctx_, (void *)cframe);
     }
@@ -58,6 +65,22 @@ class __attribute__((visibility("default"))) DriverFalcon
 
   int status_callback_(const InnoStatusPacket *pkt) { return 0; };
 
+  // the cframe callback runs with converter_mtx_ held
+  uint32_t *get_point_ts_ns(const void *cframe) override {
+    return cframe_converter_->get_point_ts_ns(
+        reinterpret_cast<const inno_cframe_header *>(cframe));
+  }
+  bool get_frame_completeness(const void *cframe, bool *is_complete,
+                              uint32_t *lost_packets) override {
+    const ::innovusion::CframeConverter::Completeness *c =
+        cframe_converter_->get_completeness(
+            reinterpret_cast<const inno_cframe_header *>(cframe));
+    if (c == NULL) return false;
+    *is_complete = c->lost_packets == 0 && !c->no_frame_end;
+    *lost_packets = c->lost_packets;
+    return true;
+  }
+
   // static callback warpper
   static void message_callback_s_(int handle_, void *ctx, uint32_t from_remote,
                                   enum InnoMessageLevel level,
@@ -89,8 +112,21 @@ class __attribute__((visibility("default"))) DriverFalcon
   int set_config_name_value(const std::string &key,
                             const std::string &value) override;
 
+ private:
+  // the "sdk" thread_placements entry
+  void set_sdk_thread_placements_();
+  // close a frame whose last packet is lost, see frame_close_slack_ms
+  void packet_received_();
+  void close_timer_callback_();
+
  private:
   ::innovusion::CframeConverter *cframe_converter_;
+  uint32_t converter_huge_page_{0};
+  // the sdk thread adds packets, the deadline thread closes frames
+  std::mutex converter_mtx_;
+  std::unique_ptr<FrameDeadlineTimer> close_timer_;
+  bool close_timer_armed_{false};
+  uint64_t last_packet_ns_{0};
   char sn_[InnoStatusPacket::kSnSize];
 };
 
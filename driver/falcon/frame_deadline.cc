@@ -0,0 +1,160 @@
+#include "frame_deadline.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "cyber/cyber.h"
+
+namespace apollo {
+namespace drivers {
+namespace innovusion {
+
+class FrameDeadlineLoop {
+ public:
+  static FrameDeadlineLoop &instance() {
+    static FrameDeadlineLoop loop;
+    return loop;
+  }
+
+  bool add(FrameDeadlineTimer *timer) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    if (!thread_.joinable()) {
+      thread_ = std::thread(&FrameDeadlineLoop::run_, this);
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = timer;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer->fd_, &ev) != 0) {
+      AERROR << "cannot add frame deadline timer, errno " << errno;
+      return false;
+    }
+    timers_.insert(timer);
+    return true;
+  }
+
+  // waits for the callback if it is running
+  void remove(FrameDeadlineTimer *timer) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, timer->fd_, NULL);
+    timers_.erase(timer);
+    done_cond_.wait(lk, [timer]() { return !timer->running_; });
+  }
+
+ private:
+  FrameDeadlineLoop() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+  }
+
+  ~FrameDeadlineLoop() {
+    stop_ = true;
+    uint64_t one = 1;
+    if (write(wake_fd_, &one, sizeof(one)) < 0) {
+      AWARN << "cannot wake the frame deadline loop";
+    }
+    if (thread_.joinable()) thread_.join();
+    close(wake_fd_);
+    close(epoll_fd_);
+  }
+
+  void run_() {
+    struct epoll_event events[16];
+    while (!stop_) {
+      int n = epoll_wait(epoll_fd_, events, 16, -1);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        AERROR << "frame deadline epoll_wait errno " << errno;
+        break;
+      }
+      expired_.clear();
+      {
+        std::unique_lock<std::mutex> lk(mtx_);
+        for (int i = 0; i < n; i++) {
+          FrameDeadlineTimer *timer =
+              reinterpret_cast<FrameDeadlineTimer *>(events[i].data.ptr);
+          // removed after epoll_wait returned
+          if (timer == NULL || timers_.count(timer) == 0) continue;
+          // a re-armed or re-created timer has nothing to read
+          uint64_t expirations;
+          if (read(timer->fd_, &expirations, sizeof(expirations)) !=
+              sizeof(expirations))
+            continue;
+          timer->running_ = true;
+          expired_.push_back(timer);
+        }
+      }
+      // without mtx_, a callback may take its driver's locks while
+      // another sensor adds or removes its timer
+      for (FrameDeadlineTimer *timer : expired_) {
+        {
+          std::unique_lock<std::mutex> lk(mtx_);
+          // removed in between, remove() waits for running_ to go down
+          if (timers_.count(timer) == 0) {
+            timer->running_ = false;
+            done_cond_.notify_all();
+            continue;
+          }
+        }
+        timer->callback_();
+        std::unique_lock<std::mutex> lk(mtx_);
+        timer->running_ = false;
+        done_cond_.notify_all();
+      }
+    }
+  }
+
+  int epoll_fd_{-1};
+  int wake_fd_{-1};
+  std::atomic<bool> stop_{false};
+  std::mutex mtx_;
+  // a running_ flag went down
+  std::condition_variable done_cond_;
+  std::set<FrameDeadlineTimer *> timers_;
+  // of one epoll_wait, used by the loop thread only
+  std::vector<FrameDeadlineTimer *> expired_;
+  std::thread thread_;
+};
+
+FrameDeadlineTimer::FrameDeadlineTimer(std::function<void()> callback)
+    : callback_(callback) {
+  fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd_ < 0) {
+    AERROR << "timerfd_create errno " << errno;
+    return;
+  }
+  FrameDeadlineLoop::instance().add(this);
+}
+
+FrameDeadlineTimer::~FrameDeadlineTimer() {
+  if (fd_ < 0) return;
+  FrameDeadlineLoop::instance().remove(this);
+  close(fd_);
+}
+
+bool FrameDeadlineTimer::arm(uint64_t ns) {
+  if (fd_ < 0) return false;
+  struct itimerspec spec = {};
+  // 0 would disarm
+  ns = ns > 0 ? ns : 1;
+  spec.it_value.tv_sec = ns / 1000000000;
+  spec.it_value.tv_nsec = ns % 1000000000;
+  return timerfd_settime(fd_, 0, &spec, NULL) == 0;
+}
+
+}  // namespace innovusion
+}  // namespace drivers
+}  // namespace apollo
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+namespace apollo {
+namespace drivers {
+namespace innovusion {
+
+// One-shot timer on the monotonic clock. Every timer of the process is a
+// timerfd served by the same epoll thread, so a sensor costs no thread.
+// The callback runs on that thread, the destructor waits for a running
+// callback and must not be called from it.
+class FrameDeadlineTimer {
+ public:
+  explicit FrameDeadlineTimer(std::function<void()> callback);
+  ~FrameDeadlineTimer();
+
+  // fire once, ns from now
+  bool arm(uint64_t ns);
+
+ private:
+  friend class FrameDeadlineLoop;
+  int fd_{-1};
+  std::function<void()> callback_;
+  // the callback is about to run or running, guarded by the loop
+  bool running_{false};
+};
+
+}  // namespace innovusion
+}  // namespace drivers
+}  // namespace apollo
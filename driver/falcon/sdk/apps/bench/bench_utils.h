@@ -0,0 +1,149 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+#ifndef BENCH_BENCH_UTILS_H_
+#define BENCH_BENCH_UTILS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "src/sdk_common/inno_lidar_packet.h"
+#include "src/sdk_common/inno_lidar_packet_utils.h"
+#include "src/utils/utils.h"
+
+namespace innovusion {
+
+class BenchTimer {
+ public:
+  BenchTimer() {
+    reset();
+  }
+  void reset() {
+    start_ns_ = InnoUtils::get_time_ns(CLOCK_MONOTONIC_RAW);
+  }
+  double elapsed_s() const {
+    return (InnoUtils::get_time_ns(CLOCK_MONOTONIC_RAW) - start_ns_) / 1e9;
+  }
+
+ private:
+  uint64_t start_ns_;
+};
+
+/*
+ * Generate sphere pointcloud packets that look like a real frame:
+ * angles sweep smoothly along the scan lines, radius/refl are random
+ * and about 5% of the points have no return.
+ */
+class BenchPacketGenerator {
+ public:
+  static const uint32_t kBlocksPerPacket = 30;
+
+  explicit BenchPacketGenerator(uint32_t seed = 1,
+                                InnoMultipleReturnMode mode =
+                                INNO_MULTIPLE_RETURN_MODE_SINGLE)
+      : seed_(seed)
+      , mode_(mode) {
+  }
+
+  // append one frame of packet_number packets to *out, return bytes added
+  size_t make_frame(uint64_t idx, uint32_t packet_number,
+                    std::vector<char> *out) {
+    size_t old_size = out->size();
+    size_t pkt_size =
+        InnoDataPacketUtils::get_data_packet_size(
+            INNO_ITEM_TYPE_SPHERE_POINTCLOUD, kBlocksPerPacket, mode_);
+    uint32_t mr = InnoDataPacketUtils::get_return_times(mode_);
+    size_t unit_size = mr == 2 ? sizeof(InnoBlock2) : sizeof(InnoBlock1);
+    double ts_start_us = 1600000000.0 * 1000000 + idx * 100000.0;
+    for (uint32_t p = 0; p < packet_number; p++) {
+      out->resize(out->size() + pkt_size);
+      InnoDataPacket *pkt = reinterpret_cast<InnoDataPacket *>(
+          &(*out)[out->size() - pkt_size]);
+      memset(pkt, 0, pkt_size);
+      pkt->common.version.magic_number = kInnoMagicNumberDataPacket;
+      pkt->common.version.major_version = kInnoMajorVersionDataPacket;
+      pkt->common.version.minor_version = kInnoMinorVersionDataPacket;
+      pkt->common.size = pkt_size;
+      pkt->common.ts_start_us = ts_start_us + p * 50;
+      pkt->common.lidar_mode = INNO_LIDAR_MODE_WORK_NORMAL;
+      pkt->common.lidar_status = INNO_LIDAR_STATUS_NORMAL;
+      pkt->idx = idx;
+      pkt->sub_idx = 0;
+      pkt->sub_seq = p;
+      pkt->type = INNO_ITEM_TYPE_SPHERE_POINTCLOUD;
+      pkt->item_number = kBlocksPerPacket;
+      pkt->item_size = unit_size;
+      pkt->multi_return_mode = mode_;
+      pkt->confidence_level = INNO_FULL_CONFIDENCE;
+      pkt->is_last_sub_frame = p == packet_number - 1;
+      pkt->is_last_sequence = p == packet_number - 1;
+      for (uint32_t b = 0; b < kBlocksPerPacket; b++) {
+        InnoBlock *block = reinterpret_cast<InnoBlock *>(
+            pkt->c + b * unit_size);
+        uint32_t n = p * kBlocksPerPacket + b;
+        InnoBlockHeader &h = block->header;
+        h.h_angle = -8192 + (n * 7) % 16384;
+        h.v_angle = -2048 + (n / 400) * 8;
+        h.ts_10us = (n * 5) / kBlocksPerPacket;
+        h.scan_idx = n % 400;
+        h.scan_id = (n / 400) & 0x1ff;
+        h.h_angle_diff_1 = next_() % 64 - 32;
+        h.h_angle_diff_2 = next_() % 128 - 64;
+        h.h_angle_diff_3 = next_() % 256 - 128;
+        h.v_angle_diff_1 = next_() % 64 - 32;
+        h.v_angle_diff_2 = next_() % 128 - 64;
+        h.v_angle_diff_3 = next_() % 128 - 64;
+        h.in_roi = next_() % 4;
+        h.facet = n % 5;
+        for (uint32_t i = 0; i < kInnoChannelNumber * mr; i++) {
+          InnoChannelPoint &pt = block->points[i];
+          uint32_t r = next_();
+          pt.radius = (r % 20) == 0 ? 0 : 400 + r % 60000;
+          pt.refl = r >> 17;
+          pt.is_2nd_return = i >= kInnoChannelNumber;
+          pt.type = 0;
+          pt.elongation = (r >> 8) & 0xf;
+        }
+      }
+      InnoPacketReader::set_packet_crc32(&pkt->common);
+    }
+    return out->size() - old_size;
+  }
+
+ private:
+  uint32_t next_() {
+    // xorshift32, deterministic across platforms
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    return seed_;
+  }
+
+ private:
+  uint32_t seed_;
+  InnoMultipleReturnMode mode_;
+};
+
+static inline void bench_report(const char *name, size_t bytes,
+                                size_t count, const char *unit,
+                                double seconds) {
+  if (seconds <= 0) {
+    seconds = 1e-9;
+  }
+  fprintf(stdout, "%-36s %10.1f MB/s %12.1f %s/s %10.3f s\n",
+          name, bytes / seconds / 1000000.0, count / seconds, unit,
+          seconds);
+}
+
+}  // namespace innovusion
+
+#endif  // BENCH_BENCH_UTILS_H_
@@ -0,0 +1,192 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * Epoch timestamps of a fpga clock that drifts DRIFT_PPM, with a clock
+ * update (utc second plus fpga time, jittered) every second: the offset
+ * of the last update (as StageDeliver used to) vs. LidarClockModel.
+ * Reports the error of the timestamps between updates (after the first
+ * 16 updates) and ns per conversion. The model must be more accurate
+ * and, with a single sample, give the old timestamps.
+ *
+ * The ns offsets the converter keeps per point are checked against the
+ * ts_100us of the points as well.
+ *
+ * usage: clock_model_bench [DRIFT_PPM] [SECONDS] [JITTER_NS]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "sdk/lidar_clock.h"
+#include "sdk/lidar_clock_model.h"
+#include "sdk_common/converter/cframe_converter.h"
+
+using innovusion::BenchPacketGenerator;
+using innovusion::BenchTimer;
+using innovusion::CframeConverter;
+using innovusion::LidarClock;
+using innovusion::LidarClockModel;
+using innovusion::LidarClockTransform;
+
+static const int64_t kNsInSecond = 1000000000LL;
+// 2021-01-01, a lidar booted then
+static const int64_t kBootEpochNs = 1609459200LL * kNsInSecond;
+
+struct Error {
+  double max_us;
+  double sum_us;
+  uint64_t count;
+};
+
+static void add_error(Error *e, double error_us) {
+  error_us = fabs(error_us);
+  e->max_us = error_us > e->max_us ? error_us : e->max_us;
+  e->sum_us += error_us;
+  e->count++;
+}
+
+static double average_us(const Error &e) {
+  return e.count ? e.sum_us / e.count : 0;
+}
+
+// true epoch ns of a fpga ns
+static int64_t truth_ns(int64_t fpga_ns, double drift) {
+  return kBootEpochNs + fpga_ns + llround(fpga_ns * drift);
+}
+
+static bool check_point_offsets() {
+  BenchPacketGenerator gen;
+  std::vector<char> buffer;
+  uint32_t packets = 100;
+  for (uint64_t idx = 0; idx < 3; idx++) {
+    gen.make_frame(idx, packets, &buffer);
+  }
+  CframeConverter converter(innovusion::HUGE_PAGE_OFF, true);
+  size_t pkt_size = buffer.size() / 3 / packets;
+  uint32_t frames = 0;
+  bool ok = true;
+  for (size_t off = 0; off < buffer.size(); off += pkt_size) {
+    const InnoDataPacket *pkt =
+        reinterpret_cast<const InnoDataPacket *>(&buffer[off]);
+    inno_cframe_header *frame = converter.add_data_packet(pkt, 0);
+    if (!frame) {
+      continue;
+    }
+    frames++;
+    const uint32_t *ns = converter.get_point_ts_ns(frame);
+    ok = ok && ns && frame->item_number > 0;
+    for (uint32_t i = 0; ok && i < frame->item_number; i++) {
+      // ts_100us is truncated twice, ns is not
+      int64_t d = static_cast<int64_t>(ns[i]) -
+                  frame->cpoints[i].ts_100us * 100000LL;
+      ok = d > -100000 && d < 200000;
+    }
+  }
+  CframeConverter off_converter;
+  ok = ok && frames == 3 &&
+       off_converter.get_point_ts_ns(off_converter.close_current_frame()) ==
+           NULL;
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  double drift_ppm = argc > 1 ? atof(argv[1]) : 35;
+  uint32_t seconds = argc > 2 ? strtoul(argv[2], NULL, 0) : 600;
+  int64_t jitter_ns = argc > 3 ? strtoll(argv[3], NULL, 0) : 2000;
+  double drift = drift_ppm / 1e6;
+
+  LidarClockModel model;
+  // errors are taken once the fit has all its samples
+  const uint32_t warmup = 16;
+  Error legacy_error = {0, 0, 0};
+  Error model_error = {0, 0, 0};
+  uint32_t seed = 1;
+  bool single_ok = true;
+  for (uint32_t s = 1; s <= seconds; s++) {
+    // the fpga time at which utc second s of the lidar's life is seen
+    int64_t fpga_ns = llround(s * kNsInSecond / (1 + drift));
+    seed = seed * 1103515245 + 12345;
+    fpga_ns += static_cast<int64_t>((seed >> 8) % (2 * jitter_ns + 1)) -
+               jitter_ns;
+    int64_t utc = (kBootEpochNs + s * kNsInSecond) / kNsInSecond;
+    // as LidarClock::init_clock_info() does
+    double bootup_utc = utc - fpga_ns / static_cast<double>(kNsInSecond);
+    model.add_sample(fpga_ns, utc * kNsInSecond);
+    if (s == 1) {
+      // a single sample is the old offset
+      int64_t t = fpga_ns + 12345678;
+      double old_us = LidarClock::to_epoch_us_(t, bootup_utc);
+      single_ok = fabs(model.get_transform().to_epoch_us(t) - old_us) < 1;
+    }
+    if (s <= warmup) {
+      continue;
+    }
+    // points until the next update
+    for (uint32_t ms = 0; ms < 1000; ms++) {
+      int64_t t = fpga_ns + ms * 1000000LL;
+      double truth_us = truth_ns(t, drift) / 1000.0;
+      add_error(&legacy_error,
+                LidarClock::to_epoch_us_(t, bootup_utc) - truth_us);
+      add_error(&model_error,
+                model.get_transform().to_epoch_us(t) - truth_us);
+    }
+  }
+
+  // ns per conversion
+  const uint32_t loops = 20 * 1000 * 1000;
+  LidarClockTransform transform = model.get_transform();
+  double bootup_utc = (transform.epoch_base_ns - transform.fpga_base_ns) /
+                      static_cast<double>(kNsInSecond);
+  volatile double sink_us = 0;
+  volatile int64_t sink_ns = 0;
+  BenchTimer t;
+  double acc_us = 0;
+  for (uint32_t i = 0; i < loops; i++) {
+    acc_us += LidarClock::to_epoch_us_(transform.fpga_base_ns + i * 1000LL,
+                                       bootup_utc);
+  }
+  double legacy_s = t.elapsed_s();
+  sink_us = acc_us;
+  t.reset();
+  int64_t acc_ns = 0;
+  for (uint32_t i = 0; i < loops; i++) {
+    acc_ns += transform.to_epoch_ns(transform.fpga_base_ns + i * 1000LL);
+  }
+  double model_s = t.elapsed_s();
+  sink_ns = acc_ns;
+  (void)sink_us;
+  (void)sink_ns;
+
+  bool offsets_ok = check_point_offsets();
+
+  fprintf(stdout, "drift %.1f ppm, %u s, jitter %ld ns, fitted %.3f ppm\n",
+          drift_ppm, seconds, jitter_ns, model.get_drift_ppm());
+  fprintf(stdout, "last update offset  max %8.3f us avg %8.3f us "
+          "%6.2f ns/conversion\n",
+          legacy_error.max_us, average_us(legacy_error),
+          legacy_s * 1e9 / loops);
+  fprintf(stdout, "clock model         max %8.3f us avg %8.3f us "
+          "%6.2f ns/conversion\n",
+          model_error.max_us, average_us(model_error),
+          model_s * 1e9 / loops);
+  fprintf(stdout, "converter point ns offsets %s\n",
+          offsets_ok ? "ok" : "wrong");
+  bool ok = single_ok && offsets_ok && model.get_restart_number() == 0 &&
+            (drift_ppm == 0 || model_error.count == 0 ||
+             model_error.max_us < legacy_error.max_us);
+  if (!ok) {
+    fprintf(stdout, "verify FAILED\n");
+    return 1;
+  }
+  return 0;
+}
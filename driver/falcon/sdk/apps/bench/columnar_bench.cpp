@@ -0,0 +1,198 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * Read/write throughput of the columnar recorder vs. inno_pc and rosbag.
+ *
+ * usage: columnar_bench [FRAME_NUMBER] [PACKETS_PER_FRAME] [OUT_DIR]
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "pcs/inno_pc_npy_recorder.h"
+#include "src/sdk_common/converter/columnar_recorder.h"
+#include "src/sdk_common/converter/rosbag_recorder.h"
+
+using innovusion::BenchPacketGenerator;
+using innovusion::BenchTimer;
+using innovusion::ColumnarReader;
+using innovusion::ColumnarRecorder;
+using innovusion::InnoColFrame;
+using innovusion::InnoPcNpyRecorder;
+using innovusion::RecorderBase;
+using innovusion::RosbagRecorder;
+
+static size_t file_size(const std::string &f) {
+  struct stat st;
+  if (stat(f.c_str(), &st) != 0) {
+    return 0;
+  }
+  return st.st_size;
+}
+
+static void write_all(RecorderBase *recorder,
+                      const std::vector<char> &packets) {
+  size_t off = 0;
+  while (off < packets.size()) {
+    const InnoDataPacket *pkt =
+        reinterpret_cast<const InnoDataPacket *>(&packets[off]);
+    recorder->add_block(pkt);
+    off += pkt->common.size;
+  }
+}
+
+static size_t read_file(const std::string &f, std::vector<char> *buf) {
+  size_t size = file_size(f);
+  buf->resize(size);
+  int fd = open(f.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  size_t got = 0;
+  while (got < size) {
+    ssize_t r = read(fd, &(*buf)[got], size - got);
+    if (r <= 0) {
+      break;
+    }
+    got += r;
+  }
+  close(fd);
+  return got;
+}
+
+int main(int argc, char **argv) {
+  size_t frame_number = argc > 1 ? strtoul(argv[1], NULL, 0) : 100;
+  uint32_t packet_number = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000;
+  std::string dir = argc > 3 ? argv[3] : "/tmp";
+  std::string inno_pc_file = dir + "/bench.inno_pc";
+  std::string rosbag_file = dir + "/bench.bag";
+  std::string col_file = dir + "/bench.inno_pc_col";
+
+  inno_log_info("generate %lu frames x %u packets", frame_number,
+                packet_number);
+  BenchPacketGenerator gen;
+  std::vector<char> packets;
+  for (size_t f = 0; f < frame_number; f++) {
+    gen.make_frame(f, packet_number, &packets);
+  }
+  size_t in_bytes = packets.size();
+  fprintf(stdout, "input: %lu frames, %lu bytes\n", frame_number, in_bytes);
+
+  // write
+  {
+    BenchTimer t;
+    InnoPcNpyRecorder *r = new InnoPcNpyRecorder(inno_pc_file, 0,
+                                                 false, false);
+    write_all(r, packets);
+    delete r;
+    innovusion::bench_report("write inno_pc", in_bytes, frame_number,
+                             "frames", t.elapsed_s());
+  }
+  {
+    BenchTimer t;
+    RosbagRecorder *r = new RosbagRecorder(rosbag_file.c_str(), NULL, NULL,
+                                           1000 * 1000);
+    write_all(r, packets);
+    r->add_block(NULL);
+    delete r;
+    innovusion::bench_report("write rosbag", in_bytes, frame_number,
+                             "frames", t.elapsed_s());
+  }
+  {
+    BenchTimer t;
+    ColumnarRecorder *r = new ColumnarRecorder(col_file, 0);
+    write_all(r, packets);
+    delete r;
+    innovusion::bench_report("write columnar", in_bytes, frame_number,
+                             "frames", t.elapsed_s());
+  }
+  fprintf(stdout, "size: inno_pc %lu, rosbag %lu, columnar %lu\n",
+          file_size(inno_pc_file), file_size(rosbag_file),
+          file_size(col_file));
+
+  // read whole file
+  {
+    BenchTimer t;
+    std::vector<char> buf;
+    size_t size = read_file(inno_pc_file, &buf);
+    size_t off = 0;
+    size_t points = 0;
+    while (off + sizeof(InnoDataPacket) <= size) {
+      const InnoDataPacket *pkt =
+          reinterpret_cast<const InnoDataPacket *>(&buf[off]);
+      points += InnoDataPacketUtils::get_points_count(*pkt);
+      off += pkt->common.size;
+    }
+    innovusion::bench_report("read inno_pc (all points)", size,
+                             frame_number, "frames", t.elapsed_s());
+    fprintf(stdout, "  %lu points\n", points);
+  }
+  {
+    // there is no bag parser in the sdk, this is the raw read cost only
+    BenchTimer t;
+    std::vector<char> buf;
+    size_t size = read_file(rosbag_file, &buf);
+    innovusion::bench_report("read rosbag (raw bytes)", size,
+                             frame_number, "frames", t.elapsed_s());
+  }
+  {
+    BenchTimer t;
+    ColumnarReader reader(col_file);
+    InnoColFrame frame;
+    size_t points = 0;
+    for (size_t f = 0; f < reader.get_frame_number(); f++) {
+      if (reader.read_frame(f, &frame) == 0) {
+        points += frame.index.point_number;
+      }
+    }
+    innovusion::bench_report("read columnar (all columns)",
+                             file_size(col_file), reader.get_frame_number(),
+                             "frames", t.elapsed_s());
+    fprintf(stdout, "  %lu points\n", points);
+  }
+  {
+    BenchTimer t;
+    ColumnarReader reader(col_file);
+    std::vector<int32_t> radius;
+    size_t bytes = 0;
+    for (size_t f = 0; f < reader.get_frame_number(); f++) {
+      const innovusion::InnoColFrameIndex *index = reader.get_frame_index(f);
+      radius.resize(index->point_number);
+      ssize_t n = reader.read_column(f, innovusion::INNO_COL_RADIUS, 0,
+                                     index->point_number, &radius[0]);
+      if (n > 0) {
+        bytes += n * sizeof(int32_t);
+      }
+    }
+    innovusion::bench_report("read columnar (radius column)", bytes,
+                             reader.get_frame_number(), "frames",
+                             t.elapsed_s());
+  }
+  {
+    // random access to a single frame
+    BenchTimer t;
+    ColumnarReader reader(col_file);
+    InnoColFrame frame;
+    size_t n = reader.get_frame_number();
+    size_t loops = 0;
+    for (size_t i = 0; n && i < 100; i++, loops++) {
+      reader.read_frame((i * 7919) % n, &frame);
+    }
+    innovusion::bench_report("read columnar (random frame)", 0, loops,
+                             "frames", t.elapsed_s());
+  }
+  return 0;
+}
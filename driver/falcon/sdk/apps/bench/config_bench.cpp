@@ -0,0 +1,122 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * Per-job config check cost of a stage: config_.copy_from_src(&base)
+ * with an unchanged version (lock-free version compare) vs. the
+ * previous two-mutex check, then the same with a writer thread calling
+ * set_key_value() every millisecond. The stage copy is checked to only
+ * ever see values the writer set.
+ *
+ * usage: config_bench [JOB_NUMBER]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "bench/bench_utils.h"
+#include "utils/config.h"
+
+using innovusion::BenchTimer;
+using innovusion::ExampleConfig;
+
+class BenchConfig : public ExampleConfig {
+ public:
+  /* what copy_from_src() did before: both mutexes on every call */
+  bool locked_check(BenchConfig *src) {
+    std::unique_lock<std::mutex> lk(src->mutex_);
+    std::unique_lock<std::mutex> lk2(mutex_);
+    return src->get_version_locked_() != get_version_locked_();
+  }
+};
+
+static void run_idle(size_t jobs) {
+  BenchConfig base;
+  BenchConfig config;
+  base.set_key_value("test1", "1");
+  config.copy_from_src(&base);
+
+  size_t copied = 0;
+  BenchTimer t;
+  for (size_t i = 0; i < jobs; i++) {
+    copied += config.locked_check(&base);
+  }
+  double s = t.elapsed_s();
+  innovusion::bench_report("locked check", 0, jobs, "jobs", s);
+  fprintf(stdout, "  %.1f ns/job, %lu changed\n", s * 1e9 / jobs, copied);
+
+  copied = 0;
+  t.reset();
+  for (size_t i = 0; i < jobs; i++) {
+    copied += config.copy_from_src(&base);
+  }
+  s = t.elapsed_s();
+  innovusion::bench_report("copy_from_src", 0, jobs, "jobs", s);
+  fprintf(stdout, "  %.1f ns/job, %lu copied\n", s * 1e9 / jobs, copied);
+}
+
+static bool run_writer(size_t jobs) {
+  BenchConfig base;
+  BenchConfig config;
+  std::atomic<bool> stop(false);
+  size_t sets = 0;
+  std::thread writer([&]() {
+    char value[32];
+    while (!stop.load()) {
+      // test1 counts up, test3 always holds the same value
+      snprintf(value, sizeof(value), "%lu", ++sets);
+      base.set_key_value("test1", value);
+      snprintf(value, sizeof(value), "%lu.5", sets);
+      base.set_key_value("test3", value);
+      usleep(1000);
+    }
+  });
+
+  size_t copied = 0;
+  bool ok = true;
+  uint64_t last = 0;
+  BenchTimer t;
+  for (size_t i = 0; i < jobs; i++) {
+    if (config.copy_from_src(&base)) {
+      copied++;
+      if (config.test1 < last ||
+          (config.test3 != 0 && config.test3 - 0.5 > config.test1)) {
+        ok = false;
+      }
+      last = config.test1;
+    }
+  }
+  double s = t.elapsed_s();
+  stop = true;
+  writer.join();
+  innovusion::bench_report("copy_from_src + writer", 0, jobs, "jobs", s);
+  fprintf(stdout, "  %.1f ns/job, %lu copied, %lu writes\n",
+          s * 1e9 / jobs, copied, sets);
+
+  config.copy_from_src(&base);
+  if (config.test1 != base.test1 || config.test3 != base.test3) {
+    ok = false;
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  size_t jobs = argc > 1 ? strtoul(argv[1], NULL, 0) : 20000000;
+
+  run_idle(jobs);
+  if (!run_writer(jobs)) {
+    fprintf(stdout, "verify FAILED\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * crc32 throughput of every implementation the cpu supports, across
+ * packet sizes, plus the full verify_packet_crc32 on real data packets.
+ *
+ * usage: crc32_bench [TOTAL_MB]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "bench/bench_utils.h"
+
+using innovusion::BenchPacketGenerator;
+using innovusion::BenchTimer;
+using innovusion::InnoUtils;
+
+int main(int argc, char **argv) {
+  size_t total = (argc > 1 ? strtoul(argv[1], NULL, 0) : 256) << 20;
+  static const size_t kSizes[] = {64, 256, 1024, 1500, 4096, 9000, 65536};
+
+  std::vector<char> buf(65536 + 8);
+  for (size_t i = 0; i < buf.size(); i++) {
+    buf[i] = i * 131 + (i >> 8);
+  }
+
+  for (int i = 0; i < InnoUtils::CRC32_IMPL_MAX; i++) {
+    InnoUtils::Crc32Impl impl = InnoUtils::Crc32Impl(i);
+    if (!InnoUtils::crc32_impl_supported(impl)) {
+      fprintf(stdout, "%s: not supported\n", InnoUtils::crc32_impl_name(impl));
+      continue;
+    }
+    for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); s++) {
+      size_t size = kSizes[s];
+      size_t loops = total / size;
+      uint32_t crc = InnoUtils::crc32_start();
+      BenchTimer t;
+      for (size_t l = 0; l < loops; l++) {
+        // +1: packets in a receive buffer are not always 8 bytes aligned
+        crc = InnoUtils::crc32_do_impl(impl, crc, &buf[1], size);
+      }
+      char name[64];
+      snprintf(name, sizeof(name), "%s %lu bytes (%08x)",
+               InnoUtils::crc32_impl_name(impl), size, crc);
+      innovusion::bench_report(name, loops * size, loops, "packets",
+                               t.elapsed_s());
+    }
+  }
+
+  // verify whole data packets, what check_data_packet does
+  {
+    BenchPacketGenerator gen;
+    std::vector<char> packets;
+    gen.make_frame(0, 2000, &packets);
+    size_t loops = total / packets.size() + 1;
+    size_t count = 0;
+    size_t bad = 0;
+    BenchTimer t;
+    for (size_t l = 0; l < loops; l++) {
+      size_t off = 0;
+      while (off < packets.size()) {
+        const InnoDataPacket *pkt =
+            reinterpret_cast<const InnoDataPacket *>(&packets[off]);
+        if (!InnoPacketReader::verify_packet_crc32(&pkt->common)) {
+          bad++;
+        }
+        count++;
+        off += pkt->common.size;
+      }
+    }
+    innovusion::bench_report("verify_packet_crc32", packets.size() * loops,
+                             count, "packets", t.elapsed_s());
+    if (bad) {
+      fprintf(stdout, "  %lu bad packets\n", bad);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * InnoGalvoMirrorCheck fed with synthetic bottom->top xyz frames of a
+ * flat road tilted by TILT_DEGREE, with 10% of the points off the road.
+ * Reports the time the deliver thread spends per frame, the time the
+ * plane fit takes on the galvo_check worker (what the deliver thread
+ * used to pay) and how far the results are behind. The mean deviated
+ * angle is checked against the tilt.
+ *
+ * usage: galvo_check_bench [FRAME_NUMBER] [FRAME_INTERVAL_US] [TILT_DEGREE]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "sdk_client/lidar_fault_check.h"
+
+using innovusion::BenchTimer;
+using innovusion::InnoGalvoMirrorCheck;
+
+static const uint32_t kPacketsPerFrame = 40;
+static const uint32_t kPointsPerPacket = 256;
+
+static uint32_t seed = 1;
+static double next_uniform() {
+  seed = seed * 1103515245 + 12345;
+  return ((seed >> 8) & 0xffff) / 65536.0;
+}
+
+static void make_packet(uint64_t idx, uint32_t sub_idx, double tilt,
+                        InnoDataPacket *pkt) {
+  memset(pkt, 0, sizeof(InnoDataPacket));
+  pkt->idx = idx;
+  pkt->sub_idx = sub_idx;
+  pkt->type = INNO_ITEM_TYPE_XYZ_POINTCLOUD;
+  pkt->item_number = kPointsPerPacket;
+  pkt->scanner_direction = innovusion::kInnoScanDirectionBottom2Top;
+  double slope = tan(tilt / 180.0 * M_PI);
+  for (uint32_t i = 0; i < kPointsPerPacket; i++) {
+    InnoXyzPoint &p = pkt->xyz_points[i];
+    memset(&p, 0, sizeof(p));
+    p.y = -0.45 + next_uniform() * 0.9;
+    p.z = 3.5 + next_uniform() * 21;
+    // x points down to the road
+    p.x = -1.5 + p.z * slope + (next_uniform() - 0.5) * 0.01;
+    if (next_uniform() < 0.1) {
+      p.x += 0.3 + next_uniform();
+    }
+    p.scan_id = 2 + (sub_idx + i) % 12;
+    p.scan_idx = (i * 2) % 8192;
+    p.ts_10us = sub_idx * 10 + i / 32;
+  }
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 300;
+  uint32_t interval_us = argc > 2 ? strtoul(argv[2], NULL, 0) : 10000;
+  double tilt = argc > 3 ? atof(argv[3]) : 1.0;
+
+  std::vector<char> buf(sizeof(InnoDataPacket) +
+                        kPointsPerPacket * sizeof(InnoXyzPoint));
+  InnoDataPacket *pkt = reinterpret_cast<InnoDataPacket *>(&buf[0]);
+
+  InnoGalvoMirrorCheck *check = new InnoGalvoMirrorCheck();
+  // the lidar x axis (down to the road) is the vehicle z axis
+  check->update_ext_ref(0, -M_PI / 2, 0, 0, 0, 0);
+
+  innovusion::InnoMean deliver_us;
+  innovusion::InnoMean check_us;
+  innovusion::InnoMean lag_us;
+  uint64_t max_lag_frames = 0;
+  uint64_t results = 0;
+  uint64_t fitted = 0;
+  double mean_angle = 0;
+  for (uint64_t f = 1; f <= frames; f++) {
+    check->update_vehicle_speed(80.0);
+    check->update_steering_wheel_angle(0.0);
+    for (uint32_t p = 0; p < kPacketsPerFrame; p++) {
+      make_packet(f, p, tilt, pkt);
+      innovusion::InnoGalvoCheckResult result;
+      BenchTimer t;
+      innovusion::InnoFrameCheckProcess ret =
+          check->galvo_mirror_offset_check(*pkt, true, &result);
+      deliver_us.add(t.elapsed_s() * 1e6);
+      if (ret == innovusion::INNO_FRAME_CHECK_LAST_COMPELETED) {
+        results++;
+        lag_us.add(result.lag_us);
+        if (result.lag_frames > max_lag_frames) {
+          max_lag_frames = result.lag_frames;
+        }
+        if (result.use_time_us > 0) {
+          check_us.add(result.use_time_us);
+        }
+        if (result.frame_check_code <=
+            innovusion::INNO_GALVO_CHECK_FRAME_CODE_DEVIATED) {
+          fitted++;
+          mean_angle += result.deviated_angle;
+        }
+      }
+    }
+    usleep(interval_us);
+  }
+  delete check;
+
+  mean_angle = fitted ? mean_angle / fitted : 0;
+  fprintf(stdout, "frames %u, results %lu, fitted %lu\n",
+          frames, results, fitted);
+  fprintf(stdout, "deliver thread   %8.2f us/packet\n",
+          deliver_us.mean());
+  fprintf(stdout, "worker check     %8.2f us/frame\n", check_us.mean());
+  fprintf(stdout, "result lag       %8.2f us, max %lu frames\n",
+          lag_us.mean(), max_lag_frames);
+  fprintf(stdout, "deviated angle   %8.3f degree, tilt %.3f\n",
+          mean_angle, tilt);
+  if (fitted == 0 || fabs(mean_angle - fabs(tilt)) > 0.2) {
+    fprintf(stdout, "verify FAILED\n");
+    return 1;
+  }
+  return 0;
+}
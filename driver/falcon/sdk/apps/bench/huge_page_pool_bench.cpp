@@ -0,0 +1,83 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * First and second pass over every unit of a MemPool sized like the
+ * signal job pool, as the first frames after start do: allocated by
+ * calloc (pages are faulted in by the first pass) vs. huge page backed
+ * (faulted in when the pool is created). Reports us per unit of each
+ * pass and the minor page faults taken by the passes, the huge page
+ * pool must take none.
+ *
+ * usage: huge_page_pool_bench [UNIT_NUMBER] [UNIT_SIZE] [HUGE_PAGE_MODE]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "utils/mem_pool_manager.h"
+
+using innovusion::BenchTimer;
+using innovusion::MemPool;
+
+static uint64_t minor_faults() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+static void run(const char *name, uint32_t units, uint32_t unit_size,
+                int huge_page, uint64_t *faults) {
+  BenchTimer t;
+  MemPool *pool = new MemPool(name, unit_size, units, 32, false, huge_page);
+  double create_s = t.elapsed_s();
+  std::vector<void *> buffers(units);
+  *faults = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    uint64_t f = minor_faults();
+    t.reset();
+    for (uint32_t i = 0; i < units; i++) {
+      buffers[i] = pool->alloc();
+      // a read block is written once
+      memset(buffers[i], pass + 1, unit_size);
+    }
+    double s = t.elapsed_s();
+    f = minor_faults() - f;
+    *faults += f;
+    for (uint32_t i = 0; i < units; i++) {
+      pool->free(buffers[i]);
+    }
+    fprintf(stdout, "%-10s pass %d %8.2f us/unit, %8lu page faults\n",
+            name, pass, s * 1e6 / units, f);
+  }
+  fprintf(stdout, "%-10s create %8.2f ms\n", name, create_s * 1e3);
+  delete pool;
+}
+
+int main(int argc, char **argv) {
+  uint32_t units = argc > 1 ? strtoul(argv[1], NULL, 0) : 1200;
+  uint32_t unit_size = argc > 2 ? strtoul(argv[2], NULL, 0) : 68 * 1024;
+  int huge_page = argc > 3 ? atoi(argv[3]) : innovusion::HUGE_PAGE_ON;
+
+  uint64_t calloc_faults;
+  uint64_t huge_faults;
+  run("calloc", units, unit_size, innovusion::HUGE_PAGE_OFF, &calloc_faults);
+  run("huge_page", units, unit_size, huge_page, &huge_faults);
+  // the pool is prefaulted unless no memory could be mapped at all
+  if (huge_faults * 100 > calloc_faults) {
+    fprintf(stdout, "verify FAILED: %lu vs %lu page faults\n",
+            huge_faults, calloc_faults);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,231 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * ns per log call on the calling thread: formatted on the caller and
+ * queued to AsyncLogManager (a format string on the heap takes that
+ * path) vs. recorded by DeferredLog and formatted on its thread. Logs
+ * go to /dev/null and a callback; every printf conversion DeferredLog
+ * carries is checked against snprintf before the run, and so is the
+ * order of logs from several threads that overflow their rings.
+ *
+ * The calls are made in bursts that fit in the queue or ring, flushed
+ * (untimed) between bursts, so the time is of logged calls only; the
+ * dropped ones, if any, are reported apart.
+ *
+ * usage: log_bench [CALL_NUMBER] [THREAD_NUMBER]
+ */
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "utils/log.h"
+
+using innovusion::BenchTimer;
+using innovusion::InnoLog;
+
+static std::atomic<uint64_t> callback_logs(0);
+static char expected[1024];
+static std::atomic<bool> matched(false);
+
+static void log_callback(void *ctx, enum InnoLogLevel level,
+                         const char *header1, const char *header2,
+                         const char *msg) {
+  callback_logs++;
+  if (strcmp(msg, expected) == 0) {
+    matched = true;
+  }
+}
+
+static std::atomic<int64_t> order_last(-1);
+static std::atomic<uint64_t> order_errors(0);
+
+static void order_callback(void *ctx, enum InnoLogLevel level,
+                           const char *header1, const char *header2,
+                           const char *msg) {
+  int64_t v;
+  if (sscanf(msg, "order %" SCNd64, &v) == 1) {
+    if (v != order_last + 1) {
+      order_errors++;
+    }
+    order_last = v;
+  }
+}
+
+// the calls are numbered under a lock, the numbers have to come out in
+// order although each thread has its own ring and the rings fill up
+static bool verify_order() {
+  static const int kThreads = 4;
+  static const int64_t kCalls = 20000;
+  InnoLog::get_instance().set_logs_callback(order_callback, NULL);
+  std::mutex mutex;
+  int64_t next = 0;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < kThreads; t++) {
+    workers.push_back(std::thread([&]() {
+      while (true) {
+        std::unique_lock<std::mutex> lk(mutex);
+        if (next == kCalls) {
+          break;
+        }
+        inno_log_with_level_no_discard(INNO_LOG_LEVEL_INFO,
+                                       "order %" PRId64 " %s", next,
+                                       "padding the record a little");
+        next++;
+      }
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+  InnoLog::get_instance().set_logs_callback(log_callback, NULL);
+  if (order_errors != 0 || order_last != kCalls - 1) {
+    fprintf(stdout, "verify FAILED: order, %" PRIu64 " errors, "
+            "last %" PRId64 "\n", order_errors.load(), order_last.load());
+    return false;
+  }
+  return true;
+}
+
+#define CHECK_FORMAT(...)                                               \
+  do {                                                                  \
+    snprintf(expected, sizeof(expected), __VA_ARGS__);                  \
+    matched = false;                                                    \
+    inno_log_warning(__VA_ARGS__);                                      \
+    InnoLog::get_instance().set_logs_callback(log_callback, NULL);      \
+    if (!matched) {                                                     \
+      fprintf(stdout, "verify FAILED: %s\n", expected);                 \
+      return false;                                                     \
+    }                                                                   \
+  } while (0)
+
+static bool verify() {
+  const char *s = "str";
+  CHECK_FORMAT("int %d %i %u %x %X %o %c end", -5, 7, 3000000000u,
+               0xbeef, 0xBEEF, 8, 'z');
+  CHECK_FORMAT("len %hhd %hd %ld %lld %zu %zd %jd %td", 300, 70000,
+               -1234567890123L, 1234567890123LL, (size_t)42,
+               (ssize_t)-42, (intmax_t)-9, (ptrdiff_t)9);
+  CHECK_FORMAT("double %f %.3f %10.2e %g %-8.1f| %a", 1.5, 3.14159,
+               123456.789, 0.0001, -2.25, 1.0);
+  CHECK_FORMAT("flags %+d %05d %-5d| %#x %'d % d", 5, 42, 7, 255, 1234, 3);
+  CHECK_FORMAT("star %*d %-*s| %.*s %*.*f", 6, 1, 5, "ab", 2, "xyz",
+               8, 2, 1.0 / 3);
+  CHECK_FORMAT("str %s %10s %-4s| %.2s %p %%", s, "right", "l", "abcdef",
+               reinterpret_cast<void *>(0x1234));
+  // the trailing newline is removed as on the direct path
+  snprintf(expected, sizeof(expected), "newline stripped");
+  matched = false;
+  inno_log_warning("newline %s\n", "stripped");
+  InnoLog::get_instance().set_logs_callback(log_callback, NULL);
+  if (!matched) {
+    fprintf(stdout, "verify FAILED: %s\n", expected);
+    return false;
+  }
+  // a format in writable static storage is formatted before it changes
+  static char writable_fmt[] = "writable %d";
+  snprintf(expected, sizeof(expected), "writable 1");
+  matched = false;
+  inno_log_warning(writable_fmt, 1);
+  memcpy(writable_fmt, "changed!", 8);
+  InnoLog::get_instance().set_logs_callback(log_callback, NULL);
+  if (!matched) {
+    fprintf(stdout, "verify FAILED: %s\n", expected);
+    return false;
+  }
+  return verify_order();
+}
+
+// calls per thread between two flushes: the records fit in a thread's
+// ring, the formatted logs in AsyncLogManager's queue of 60 jobs
+static const size_t kDeferredBurst = 256;
+static const size_t kCallerBurst = 48;
+
+static void run(const char *name, size_t calls, int threads, bool deferred) {
+  // a format string that is not a literal is formatted on the caller
+  std::string heap_fmt("bench %d frame %u angle %.3f %s");
+  const char *fmt = deferred ? "bench %d frame %u angle %.3f %s" :
+      heap_fmt.c_str();
+  uint64_t before = callback_logs;
+  size_t burst = deferred ? kDeferredBurst :
+      std::max(kCallerBurst / threads, static_cast<size_t>(1));
+  size_t rounds = (calls + burst - 1) / burst;
+  std::vector<std::thread> workers;
+  std::atomic<uint64_t> ns(0);
+  std::atomic<size_t> round(0);
+  std::atomic<int> done(0);
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&, t]() {
+      uint64_t thread_ns = 0;
+      for (size_t r = 0; r < rounds; r++) {
+        while (round.load() != r) {
+          std::this_thread::yield();
+        }
+        BenchTimer timer;
+        for (size_t i = r * burst; i < calls && i < (r + 1) * burst; i++) {
+          // as inno_log_info() does, with a format that may not be literal
+          inno_log_print(INNO_LOG_LEVEL_INFO, true, __FILE__, __LINE__,
+                         fmt, t, static_cast<uint32_t>(i), i * 0.001,
+                         "packet");
+        }
+        thread_ns += timer.elapsed_s() * 1e9;
+        done++;
+      }
+      ns += thread_ns;
+    }));
+  }
+  // the logs of a burst are flushed, untimed, before the next one
+  for (size_t r = 0; r < rounds; r++) {
+    while (done.load() != threads) {
+      std::this_thread::yield();
+    }
+    done = 0;
+    InnoLog::get_instance().set_logs_callback(log_callback, NULL);
+    round++;
+  }
+  for (size_t t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+  uint64_t total = calls * threads;
+  uint64_t logged = callback_logs - before;
+  fprintf(stdout, "%-32s %8.1f ns/logged call, %lu/%lu logged, "
+          "%lu dropped\n", name,
+          logged ? static_cast<double>(ns) / logged : 0.0, logged, total,
+          total - logged);
+}
+
+int main(int argc, char **argv) {
+  size_t calls = argc > 1 ? strtoul(argv[1], NULL, 0) : 200000;
+  int threads = argc > 2 ? atoi(argv[2]) : 1;
+
+  int null_fd = open("/dev/null", O_WRONLY);
+  InnoLog::get_instance().set_logs(null_fd, null_fd, NULL, 0, 0,
+                                   NULL, 0, 0, log_callback, NULL, true);
+  if (!verify()) {
+    return 1;
+  }
+  for (int i = 0; i < 2; i++) {
+    run("formatted on caller", calls, threads, false);
+    run("deferred", calls, threads, true);
+  }
+  InnoLog::get_instance().asynclog_info();
+  // null_fd stays open for the logs flushed at exit
+  return 0;
+}
@@ -0,0 +1,367 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * Time to load the calibration YAML at open: parsed into a map of
+ * strings and looked up key by key (as the generated setters used to)
+ * vs. the single pass LidarParams::parse_yaml() vs. LidarParams::parse()
+ * served from the md5 keyed cache. The YAML is YAML_FILE or a synthetic
+ * one with every field set. Both parsers must give the same IvParams,
+ * the single pass one must not allocate. A cache file of another cache
+ * version must be parsed again and replaced.
+ *
+ * With DATA_FILE (an inno_pc file), the time from process start to the
+ * first data callback of a file source is reported as well.
+ *
+ * usage: params_load_bench [YAML_FILE|-] [DATA_FILE] [LOOP_NUMBER]
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "sdk/params.h"
+#include "sdk_common/inno_lidar_api.h"
+#include "utils/inno_lidar_log.h"
+
+using innovusion::BenchTimer;
+using innovusion::IvParamField;
+using innovusion::IvParams;
+using innovusion::LidarParams;
+
+static std::atomic<uint64_t> malloc_count(0);
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *malloc(size_t size) {
+  malloc_count++;
+  return __libc_malloc(size);
+}
+#endif
+
+static void trim(std::string *s) {
+  const char *t = " \t\n\r\f\v";
+  s->erase(s->find_last_not_of(t) + 1);
+  s->erase(0, s->find_first_not_of(t));
+}
+
+// the parser and lookups LidarParams::parse() used before
+static void legacy_parse(const char *yaml, IvParams *params) {
+  memset(params, 0, sizeof(*params));
+  std::map<std::string, std::string> nvp;
+  std::istringstream infile(yaml);
+  std::string line;
+  std::string key;
+  int array_mode = 0;
+  while (std::getline(infile, line)) {
+    trim(&line);
+    std::istringstream is_line(line);
+    if (line.find(':') != std::string::npos) {
+      std::getline(is_line, key, ':');
+      array_mode = 0;
+      if (key[0] == '#') {
+        continue;
+      }
+      std::string value;
+      if (std::getline(is_line, value)) {
+        trim(&value);
+        if (value == "") {
+          array_mode = 1;
+        } else {
+          nvp[key] = value;
+        }
+      } else {
+        array_mode = 1;
+      }
+    } else if (array_mode && line.find('-') != std::string::npos) {
+      std::string value;
+      std::getline(is_line, value, '-');
+      if (std::getline(is_line, value)) {
+        trim(&value);
+        if (value != "") {
+          std::stringstream ss;
+          ss << array_mode - 1;
+          nvp[key + "_" + ss.str()] = value;
+          array_mode++;
+        }
+      }
+    }
+  }
+
+  size_t n;
+  const IvParamField *fields = LidarParams::get_fields(&n);
+  for (size_t f = 0; f < n; f++) {
+    char *p = reinterpret_cast<char *>(params) + fields[f].offset;
+    for (uint32_t i = 0; i < fields[f].count; i++) {
+      std::string name = fields[f].name;
+      if (fields[f].count > 1) {
+        std::stringstream ss;
+        ss << i;
+        name += "_" + ss.str();
+      }
+      std::map<std::string, std::string>::const_iterator it = nvp.find(name);
+      const char *v = it == nvp.end() ? NULL : it->second.c_str();
+      if (fields[f].type == innovusion::IV_PARAM_INT) {
+        reinterpret_cast<int *>(p)[i] = v ? atoi(v) : 0;
+      } else if (fields[f].type == innovusion::IV_PARAM_DOUBLE) {
+        reinterpret_cast<double *>(p)[i] = v ? atof(v) : 0;
+      } else {
+        reinterpret_cast<float *>(p)[i] = v ? atof(v) : 0;
+      }
+    }
+  }
+}
+
+static std::string synthetic_yaml() {
+  size_t n;
+  const IvParamField *fields = LidarParams::get_fields(&n);
+  std::string yaml = "# synthetic calibration\n";
+  char buf[128];
+  uint32_t seed = 1;
+  for (size_t f = 0; f < n; f++) {
+    const IvParamField &field = fields[f];
+    if (field.count > 1) {
+      yaml += std::string(field.name) + ":\n";
+    }
+    for (uint32_t i = 0; i < field.count; i++) {
+      seed = seed * 1103515245 + 12345;
+      int32_t r = static_cast<int32_t>((seed >> 8) & 0xffff) - 0x8000;
+      if (field.type == innovusion::IV_PARAM_INT) {
+        snprintf(buf, sizeof(buf), "%d", r);
+      } else {
+        snprintf(buf, sizeof(buf), "%.9g", r / 1234.5);
+      }
+      if (field.count > 1) {
+        yaml += std::string("  - ") + buf + "\n";
+      } else {
+        yaml += std::string(field.name) + ": " + buf + "\n";
+      }
+    }
+  }
+  return yaml;
+}
+
+static bool read_file(const char *filename, std::string *s) {
+  FILE *f = fopen(filename, "r");
+  if (!f) {
+    return false;
+  }
+  char buf[4096];
+  size_t r;
+  while ((r = fread(buf, 1, sizeof(buf), f)) > 0) {
+    s->append(buf, r);
+  }
+  fclose(f);
+  return true;
+}
+
+// seconds since boot when this process was started
+static double process_start_s() {
+  FILE *f = fopen("/proc/self/stat", "r");
+  if (!f) {
+    return 0;
+  }
+  unsigned long long start = 0;  // NOLINT
+  // comm may have spaces, the fields after it are counted from ')'
+  char buf[1024];
+  size_t r = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  buf[r] = 0;
+  const char *p = strrchr(buf, ')');
+  if (p == NULL || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u "
+                          "%*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+                          &start) != 1) {
+    return 0;
+  }
+  return static_cast<double>(start) / sysconf(_SC_CLK_TCK);
+}
+
+static double boottime_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_BOOTTIME, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static std::atomic<bool> got_data(false);
+
+static int data_callback(int handle, void *ctx,
+                         const InnoDataPacket *pkt) {
+  got_data = true;
+  return 0;
+}
+
+static void message_callback(int handle, void *ctx, uint32_t from_remote,
+                             enum InnoMessageLevel level,
+                             enum InnoMessageCode code, const char *msg) {
+}
+
+static int status_callback(int handle, void *ctx,
+                           const InnoStatusPacket *pkt) {
+  return 0;
+}
+
+static void run_file(const char *data_file, double main_s) {
+  BenchTimer t;
+  int handle = inno_lidar_open_file("bench", data_file, false, 0, 0, 0);
+  if (handle <= 0) {
+    fprintf(stdout, "cannot open %s\n", data_file);
+    return;
+  }
+  inno_lidar_set_callbacks(handle, message_callback, data_callback,
+                           status_callback, NULL, NULL);
+  inno_lidar_start(handle);
+  double open_s = t.elapsed_s();
+  while (!got_data && t.elapsed_s() < 10) {
+    usleep(100);
+  }
+  double first_s = t.elapsed_s();
+  double now_s = boottime_s();
+  inno_lidar_stop(handle);
+  inno_lidar_close(handle);
+  if (!got_data) {
+    fprintf(stdout, "no data from %s\n", data_file);
+    return;
+  }
+  double start_s = process_start_s();
+  fprintf(stdout, "open+start       %8.2f ms\n", open_s * 1e3);
+  fprintf(stdout, "first callback   %8.2f ms after open\n", first_s * 1e3);
+  if (start_s > 0) {
+    fprintf(stdout, "process start to main %8.2f ms, "
+            "to first callback %8.2f ms\n",
+            (main_s - start_s) * 1e3, (now_s - start_s) * 1e3);
+  }
+}
+
+int main(int argc, char **argv) {
+  double main_s = boottime_s();
+  const char *yaml_file = argc > 1 && strcmp(argv[1], "-") ? argv[1] : NULL;
+  const char *data_file = argc > 2 ? argv[2] : NULL;
+  uint32_t loops = argc > 3 ? strtoul(argv[3], NULL, 0) : 20;
+
+  inno_log_level_g = INNO_LOG_LEVEL_WARNING;
+  std::string yaml;
+  if (yaml_file) {
+    if (!read_file(yaml_file, &yaml)) {
+      fprintf(stdout, "cannot read %s\n", yaml_file);
+      return 1;
+    }
+  } else {
+    yaml = synthetic_yaml();
+  }
+
+  IvParams *legacy = new IvParams;
+  IvParams *single = new IvParams;
+  BenchTimer t;
+  for (uint32_t i = 0; i < loops; i++) {
+    legacy_parse(yaml.c_str(), legacy);
+  }
+  double legacy_s = t.elapsed_s() / loops;
+
+  uint64_t mallocs = malloc_count;
+  t.reset();
+  for (uint32_t i = 0; i < loops; i++) {
+    LidarParams::parse_yaml(yaml.c_str(), single);
+  }
+  double single_s = t.elapsed_s() / loops;
+  mallocs = malloc_count - mallocs;
+
+  // cold parse() fills the cache, the others are served from it
+  char dir[64];
+  snprintf(dir, sizeof(dir), "/tmp/params_load_bench.%d", getpid());
+  LidarParams::set_cache_dir(dir);
+  LidarParams *cold = new LidarParams();
+  t.reset();
+  int cold_ret = cold->parse(yaml.c_str());
+  double cold_s = t.elapsed_s();
+  LidarParams *cached = new LidarParams();
+  t.reset();
+  int cached_ret = 0;
+  for (uint32_t i = 0; i < loops; i++) {
+    cached_ret |= cached->parse(yaml.c_str());
+  }
+  double cached_s = t.elapsed_s() / loops;
+  uint32_t cache_files = 0;
+  std::string cache_file;
+  DIR *d = opendir(dir);
+  if (d) {
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+      if (strstr(e->d_name, ".bin") != NULL) {
+        cache_files++;
+        cache_file = std::string(dir) + "/" + e->d_name;
+      }
+    }
+    closedir(d);
+  }
+  // a cache file of another version (after the magic) is parsed again
+  // and replaced
+  bool stale_ok = false;
+  uint32_t version = 0;
+  FILE *f = fopen(cache_file.c_str(), "r+b");
+  if (f && fseek(f, 8, SEEK_SET) == 0 &&
+      fread(&version, sizeof(version), 1, f) == 1) {
+    uint32_t stale = version + 1;
+    fseek(f, 8, SEEK_SET);
+    fwrite(&stale, sizeof(stale), 1, f);
+    fclose(f);
+    LidarParams *reparsed = new LidarParams();
+    stale_ok = reparsed->parse(yaml.c_str()) == 0 &&
+               memcmp(&cold->iv_params, &reparsed->iv_params,
+                      sizeof(IvParams)) == 0;
+    delete reparsed;
+    uint32_t rewritten = 0;
+    f = fopen(cache_file.c_str(), "rb");
+    stale_ok = stale_ok && f && fseek(f, 8, SEEK_SET) == 0 &&
+               fread(&rewritten, sizeof(rewritten), 1, f) == 1 &&
+               rewritten == version;
+  }
+  if (f) {
+    fclose(f);
+  }
+  std::string cmd = std::string("rm -rf ") + dir;
+  if (system(cmd.c_str()) != 0) {
+    fprintf(stdout, "cannot remove %s\n", dir);
+  }
+
+  fprintf(stdout, "yaml %lu bytes\n", yaml.size());
+  fprintf(stdout, "map parser       %8.2f ms\n", legacy_s * 1e3);
+  fprintf(stdout, "single pass      %8.2f ms, %lu allocations\n",
+          single_s * 1e3, mallocs);
+  fprintf(stdout, "parse() cold     %8.2f ms\n", cold_s * 1e3);
+  fprintf(stdout, "parse() cached   %8.2f ms, %u cache files\n",
+          cached_s * 1e3, cache_files);
+  fprintf(stdout, "stale cache file %s\n", stale_ok ? "replaced" : "used");
+  bool ok = memcmp(legacy, single, sizeof(IvParams)) == 0 && mallocs == 0 &&
+            cold_ret == 0 && cached_ret == 0 && cache_files == 1 &&
+            stale_ok &&
+            memcmp(&cold->iv_params, &cached->iv_params,
+                   sizeof(IvParams)) == 0;
+  delete legacy;
+  delete single;
+  delete cold;
+  delete cached;
+
+  if (data_file) {
+    run_file(data_file, main_s);
+  }
+  if (!ok) {
+    fprintf(stdout, "verify FAILED\n");
+    return 1;
+  }
+  return 0;
+}
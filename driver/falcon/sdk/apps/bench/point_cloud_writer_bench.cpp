@@ -0,0 +1,225 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * Frames/s of the binary point cloud writers vs. the ascii pcd rows
+ * (snprintf per point, same format as get_pcd --ascii-pcd), one file
+ * per frame. The binary formats are written by PointCloudWriterPool
+ * with 1 and N threads. The binary_compressed pcd is decompressed
+ * and compared with the binary pcd columns before the run, and the las
+ * gps time with the binary pcd timestamp.
+ *
+ * usage: point_cloud_writer_bench [FRAME_NUMBER] [PACKETS_PER_FRAME]
+ *                                 [THREAD_NUMBER] [OUT_DIR]
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "src/sdk_common/converter/point_cloud_writer.h"
+#include "src/utils/utils.h"
+
+using innovusion::BenchPacketGenerator;
+using innovusion::BenchTimer;
+using innovusion::InnoUtils;
+using innovusion::PointCloudFileFormat;
+using innovusion::PointCloudFrame;
+using innovusion::PointCloudRecord;
+using innovusion::PointCloudWriter;
+using innovusion::PointCloudWriterPool;
+
+static bool verify_compressed(const PointCloudFrame &frame) {
+  std::vector<char> binary;
+  std::vector<char> compressed;
+  std::vector<char> scratch;
+  PointCloudWriter::encode(frame, innovusion::POINT_CLOUD_FILE_PCD_BINARY,
+                           &binary, &scratch);
+  PointCloudWriter::encode(frame,
+                           innovusion::POINT_CLOUD_FILE_PCD_BINARY_COMPRESSED,
+                           &compressed, &scratch);
+  size_t n = frame.get_point_number();
+  size_t data_size = n * sizeof(PointCloudRecord);
+  const char *records = &binary[binary.size() - data_size];
+  const char *tag = "DATA binary_compressed\n";
+  const char *p = strstr(&compressed[0], tag);
+  if (!p) {
+    return false;
+  }
+  p += strlen(tag);
+  uint32_t sizes[2];
+  memcpy(sizes, p, sizeof(sizes));
+  if (sizes[1] != data_size) {
+    return false;
+  }
+  std::vector<char> columns(data_size);
+  if (PointCloudWriter::lzf_decompress(p + sizeof(sizes), sizes[0],
+                                       &columns[0], data_size) != data_size) {
+    return false;
+  }
+  // x column then y column
+  for (size_t i = 0; i < n; i++) {
+    if (memcmp(&columns[i * 4], records + i * sizeof(PointCloudRecord), 4) ||
+        memcmp(&columns[n * 4 + i * 4],
+               records + i * sizeof(PointCloudRecord) + 4, 4)) {
+      return false;
+    }
+  }
+  fprintf(stdout, "binary_compressed verified, %u -> %u bytes\n",
+          sizes[1], sizes[0]);
+  return true;
+}
+
+// the las gps time of the first point is the unix time of the binary
+// pcd, as adjusted standard GPS time (GPS - UTC is 18 s since 2017)
+static bool verify_las(const PointCloudFrame &frame) {
+  std::vector<char> binary;
+  std::vector<char> las;
+  std::vector<char> scratch;
+  PointCloudWriter::encode(frame, innovusion::POINT_CLOUD_FILE_PCD_BINARY,
+                           &binary, &scratch);
+  PointCloudWriter::encode(frame, innovusion::POINT_CLOUD_FILE_LAS,
+                           &las, &scratch);
+  size_t n = frame.get_point_number();
+  const PointCloudRecord *record = reinterpret_cast<const PointCloudRecord *>(
+      &binary[binary.size() - n * sizeof(PointCloudRecord)]);
+  uint16_t global_encoding;
+  uint16_t header_size;
+  double gps_time;
+  memcpy(&global_encoding, &las[6], sizeof(global_encoding));
+  memcpy(&header_size, &las[94], sizeof(header_size));
+  // x y z intensity returns classification angle user_data source_id
+  memcpy(&gps_time, &las[header_size + 20], sizeof(gps_time));
+  double expected = record->timestamp - 315964800 + 18 - 1e9;
+  fprintf(stdout, "las gps time %.6f, unix %.6f\n", gps_time,
+          record->timestamp);
+  return n > 0 && record->timestamp > 1483228800 &&
+         (global_encoding & 1) && fabs(gps_time - expected) < 1e-6;
+}
+
+static void run_ascii(const std::vector<PointCloudFrame *> &frames,
+                      const std::string &dir) {
+  static const char *row =
+      "%.3f %.3f %.3f %u %u %u %u %u %u %u %u %u %.5f %u %u %" PRI_SIZEU "\n";
+  std::vector<char> buf(256 * 1024);
+  size_t bytes = 0;
+  BenchTimer t;
+  for (size_t f = 0; f < frames.size(); f++) {
+    std::string fn = dir + "/ascii-" + std::to_string(f) + ".pcd";
+    int fd = InnoUtils::open_file(fn.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                                  0644);
+    const std::vector<InnoXyzPoint> &points = frames[f]->get_points();
+    size_t used = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+      const InnoXyzPoint &pt = points[i];
+      if (used + 200 > buf.size()) {
+        bytes += write(fd, &buf[0], used);
+        used = 0;
+      }
+      used += snprintf(&buf[used], buf.size() - used, row,
+                       pt.x, pt.y, pt.z, pt.refl, pt.channel, pt.in_roi,
+                       pt.facet, pt.is_2nd_return, pt.is_2nd_return, 3,
+                       pt.type, pt.elongation, 1600000000.0 + i * 1e-5,
+                       pt.scan_id, pt.scan_idx, f);
+    }
+    bytes += write(fd, &buf[0], used);
+    close(fd);
+  }
+  innovusion::bench_report("pcd ascii (snprintf)", bytes, frames.size(),
+                           "frames", t.elapsed_s());
+}
+
+static void run_pool(const char *name, PointCloudFileFormat format,
+                     const std::vector<PointCloudFrame *> &frames,
+                     uint32_t thread_number, const std::string &dir) {
+  PointCloudWriterPool pool(thread_number, thread_number * 2);
+  // the pool takes the frame content, hand it copies
+  PointCloudFrame frame;
+  BenchTimer t;
+  for (size_t f = 0; f < frames.size(); f++) {
+    frame = *frames[f];
+    std::string fn = dir + "/" + name + "-" + std::to_string(f) + "." +
+                     PointCloudWriter::get_extension(format);
+    pool.add_frame(fn, format, &frame);
+  }
+  pool.wait_idle();
+  double s = t.elapsed_s();
+  char title[64];
+  snprintf(title, sizeof(title), "%s x%u", name, thread_number);
+  innovusion::bench_report(title, pool.get_written_bytes(),
+                           pool.get_written_frames(), "frames", s);
+  fprintf(stdout, "  %.1f KB/frame, failed %lu\n",
+          pool.get_written_bytes() / 1000.0 /
+          (pool.get_written_frames() ? pool.get_written_frames() : 1),
+          pool.get_failed_frames());
+}
+
+int main(int argc, char **argv) {
+  size_t frame_number = argc > 1 ? strtoul(argv[1], NULL, 0) : 100;
+  uint32_t packets = argc > 2 ? strtoul(argv[2], NULL, 0) : 500;
+  uint32_t thread_number = argc > 3 ? strtoul(argv[3], NULL, 0) : 4;
+  std::string dir = argc > 4 ? argv[4] : "/tmp/point_cloud_writer_bench";
+  mkdir(dir.c_str(), 0755);
+
+  BenchPacketGenerator gen(1, INNO_MULTIPLE_RETURN_MODE_2_STRONGEST);
+  std::vector<PointCloudFrame *> frames;
+  std::vector<char> buf;
+  for (size_t f = 0; f < frame_number; f++) {
+    buf.clear();
+    gen.make_frame(f, packets, &buf);
+    PointCloudFrame *frame = new PointCloudFrame();
+    size_t off = 0;
+    while (off < buf.size()) {
+      const InnoDataPacket *pkt =
+          reinterpret_cast<const InnoDataPacket *>(&buf[off]);
+      frame->add_packet(*pkt);
+      off += pkt->common.size;
+    }
+    frames.push_back(frame);
+  }
+  fprintf(stdout, "%lu frames x %lu points\n", frame_number,
+          frames.empty() ? 0 : frames[0]->get_point_number());
+  if (frames.empty() || !verify_compressed(*frames[0])) {
+    fprintf(stdout, "binary_compressed verify FAILED\n");
+    return 1;
+  }
+  if (!verify_las(*frames[0])) {
+    fprintf(stdout, "las gps time verify FAILED\n");
+    return 1;
+  }
+
+  run_ascii(frames, dir);
+  static const struct {
+    const char *name;
+    PointCloudFileFormat format;
+  } kFormats[] = {
+    {"pcd_binary", innovusion::POINT_CLOUD_FILE_PCD_BINARY},
+    {"pcd_compressed", innovusion::POINT_CLOUD_FILE_PCD_BINARY_COMPRESSED},
+    {"ply", innovusion::POINT_CLOUD_FILE_PLY},
+    {"las", innovusion::POINT_CLOUD_FILE_LAS},
+  };
+  for (size_t i = 0; i < sizeof(kFormats) / sizeof(kFormats[0]); i++) {
+    run_pool(kFormats[i].name, kFormats[i].format, frames, 1, dir);
+    if (thread_number > 1) {
+      run_pool(kFormats[i].name, kFormats[i].format, frames, thread_number,
+               dir);
+    }
+  }
+  for (size_t f = 0; f < frames.size(); f++) {
+    delete frames[f];
+  }
+  return 0;
+}
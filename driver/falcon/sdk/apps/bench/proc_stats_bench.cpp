@@ -0,0 +1,143 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * us per SystemStats sample of /proc/self/stat and /proc/stat: opened
+ * with fopen() and parsed by fscanf() every time (as SystemStats used
+ * to) vs. re-read with pread() from fds kept open and scanned in place
+ * by ProcScanner. The fields that do not change are checked against
+ * each other and the pread path must not allocate after warmup.
+ *
+ * usage: proc_stats_bench [SAMPLE_NUMBER]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "bench/bench_utils.h"
+#include "sdk/system_proc_structs.h"
+
+using innovusion::BenchTimer;
+using innovusion::ProcCpuStat;
+using innovusion::ProcFile;
+using innovusion::ProcPidStat;
+using innovusion::SystemStats;
+
+static std::atomic<uint64_t> malloc_count(0);
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *malloc(size_t size) {
+  malloc_count++;
+  return __libc_malloc(size);
+}
+#endif
+
+struct LegacyPidStat {
+  unsigned long pid, ppid, num_threads, start_time, utime, rss;  // NOLINT
+  bool is_valid;
+};
+
+static void legacy_pid_stat(const char *filename, LegacyPidStat *s) {
+  unsigned long skip;  // NOLINT
+  char tcomm[256];
+  char state;
+  FILE *input = fopen(filename, "r");
+  s->is_valid = input != NULL;
+  if (!input) {
+    return;
+  }
+  int fret = fscanf(input,
+                    "%lu %255s %c %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu "
+                    "%lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
+                    &s->pid, tcomm, &state, &s->ppid, &skip, &skip, &skip,
+                    &skip, &skip, &skip, &skip, &skip, &skip, &s->utime,
+                    &skip, &skip, &skip, &skip, &skip, &s->num_threads,
+                    &skip, &s->start_time, &skip, &s->rss);
+  s->is_valid = fret == 24;
+  fclose(input);
+}
+
+static void legacy_cpu_stat(uint64_t *idle) {
+  FILE *input = fopen("/proc/stat", "r");
+  if (!input) {
+    return;
+  }
+  char line[256];
+  for (uint32_t i = 0; i < SystemStats::kNProcsMax + 1; i++) {
+    if (!fgets(line, sizeof(line), input)) {
+      break;
+    }
+    unsigned long v[4];  // NOLINT
+    char name[32];
+    if (i > 0 && sscanf(line, "%31s %lu %lu %lu %lu", name,
+                        &v[0], &v[1], &v[2], &v[3]) == 5) {
+      idle[i - 1] = v[3];
+    }
+  }
+  fclose(input);
+}
+
+int main(int argc, char **argv) {
+  uint32_t samples = argc > 1 ? strtoul(argv[1], NULL, 0) : 20000;
+  const uint32_t warmup = 16;
+  char filename[64];
+  snprintf(filename, sizeof(filename), "/proc/%d/stat", getpid());
+
+  LegacyPidStat legacy;
+  uint64_t idle[SystemStats::kNProcsMax] = {0};
+  BenchTimer t;
+  for (uint32_t i = 0; i < samples; i++) {
+    legacy_pid_stat(filename, &legacy);
+    legacy_cpu_stat(idle);
+  }
+  double legacy_s = t.elapsed_s();
+
+  ProcFile *pid_file = new ProcFile("bench", filename);
+  ProcFile *cpu_file = new ProcFile("bench", "/proc/stat");
+  uint64_t mallocs = 0;
+  bool valid = true;
+  uint64_t pid = 0, ppid = 0, num_threads = 0, start_time = 0;
+  t.reset();
+  for (uint32_t i = 0; i < samples; i++) {
+    if (i == warmup) {
+      mallocs = malloc_count;
+    }
+    ProcPidStat stat("bench", pid_file);
+    ProcCpuStat cpu_stat("bench", cpu_file);
+    valid = valid && stat.is_valid && cpu_stat.is_valid;
+    pid = stat.pid;
+    ppid = stat.ppid;
+    num_threads = stat.num_threads;
+    start_time = stat.start_time;
+  }
+  double pread_s = t.elapsed_s();
+  mallocs = malloc_count - mallocs;
+  delete pid_file;
+  delete cpu_file;
+
+  fprintf(stdout, "fopen/fscanf  %8.2f us/sample\n",
+          legacy_s * 1e6 / samples);
+  fprintf(stdout, "pread/scanner %8.2f us/sample, "
+          "%lu allocations after warmup\n",
+          pread_s * 1e6 / samples, mallocs);
+  if (!valid || !legacy.is_valid || pid != legacy.pid ||
+      ppid != legacy.ppid || num_threads != legacy.num_threads ||
+      start_time != legacy.start_time || mallocs != 0) {
+    fprintf(stdout, "verify FAILED: pid %lu/%lu ppid %lu/%lu "
+            "threads %lu/%lu start %lu/%lu\n",
+            pid, legacy.pid, ppid, legacy.ppid, num_threads,
+            legacy.num_threads, start_time, legacy.start_time);
+    return 1;
+  }
+  return 0;
+}
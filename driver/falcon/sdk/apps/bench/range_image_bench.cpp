@@ -0,0 +1,168 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * Range image build time per frame: rebuild from xyz points with
+ * RangeImage (what a PointCloud consumer does, same as PngRecorder)
+ * vs. CframeRangeImage binning the cpoints by their angles. Every cell
+ * of the CframeRangeImage is checked against the nearest cpoint of
+ * the cell before the run.
+ *
+ * usage: range_image_bench [FRAME_NUMBER] [PACKETS_PER_FRAME]
+ *                          [RESOLUTION_DEGREE]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "src/sdk_common/converter/cframe_converter.h"
+#include "src/sdk_common/converter/cframe_range_image.h"
+#include "src/sdk_common/converter/png_range_image.h"
+
+using innovusion::BenchPacketGenerator;
+using innovusion::BenchTimer;
+using innovusion::CframeConverter;
+using innovusion::CframeRangeImage;
+using innovusion::RangeImage;
+
+static const double kFovH = 120;
+static const double kFovV = 30;
+
+static bool verify(const inno_cframe_header *frame, double resolution) {
+  CframeRangeImage image(resolution, resolution, kFovH, kFovV);
+  image.start();
+  image.add_cpoints(frame->cpoints, frame->item_number);
+  std::vector<float> nearest(image.get_range().size(), 0);
+  for (uint32_t i = 0; i < frame->item_number; i++) {
+    const inno_cpoint &p = frame->cpoints[i];
+    double h = p.h_angle * 180.0 / cpoint_angle_unit_per_PI_c;
+    double v = p.v_angle * 180.0 / cpoint_angle_unit_per_PI_c;
+    int col = floor((h + kFovH / 2) / resolution);
+    int row = floor((kFovV / 2 - v) / resolution);
+    if (p.radius == 0 || col < 0 || row < 0 ||
+        col >= static_cast<int>(image.get_width()) ||
+        row >= static_cast<int>(image.get_height())) {
+      continue;
+    }
+    float &n = nearest[row * image.get_width() + col];
+    float range = p.radius * (1.0f / cpoint_distance_unit_per_meter_c);
+    if (n == 0 || range < n) {
+      n = range;
+    }
+  }
+  if (memcmp(&nearest[0], &image.get_range()[0],
+             nearest.size() * sizeof(float))) {
+    return false;
+  }
+  // the next frame starts from an empty image
+  image.start();
+  for (size_t i = 0; i < image.get_range().size(); i++) {
+    if (image.get_range()[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void run_xyz(const std::vector<inno_cframe_header *> &frames,
+                    double resolution) {
+  float r = resolution * M_PI / 180;
+  size_t points = 0;
+  BenchTimer t;
+  for (size_t f = 0; f < frames.size(); f++) {
+    const inno_cframe_header *frame = frames[f];
+    RangeImage image(r, r, kFovH * M_PI / 180, kFovV * M_PI / 180);
+    image.start();
+    for (uint32_t i = 0; i < frame->item_number; i++) {
+      const inno_cpoint &p = frame->cpoints[i];
+      double radius = p.radius / 100.0;
+      double c = radius * cos(p.v_angle * cpoint_angle_unit_c);
+      image.insert_point(radius * sin(p.v_angle * cpoint_angle_unit_c),
+                         c * sin(p.h_angle * cpoint_angle_unit_c),
+                         c * cos(p.h_angle * cpoint_angle_unit_c),
+                         p.ref & 0xff);
+    }
+    points += frame->item_number;
+  }
+  double s = t.elapsed_s();
+  innovusion::bench_report("xyz + RangeImage", 0, frames.size(), "frames",
+                           s);
+  fprintf(stdout, "  %.3f ms/frame, %.1f M points/s\n",
+          s * 1000 / frames.size(), points / s / 1000000.0);
+}
+
+static void run_cpoint(const std::vector<inno_cframe_header *> &frames,
+                       double resolution) {
+  CframeRangeImage image(resolution, resolution, kFovH, kFovV);
+  size_t points = 0;
+  size_t filled = 0;
+  BenchTimer t;
+  for (size_t f = 0; f < frames.size(); f++) {
+    const inno_cframe_header *frame = frames[f];
+    image.start();
+    image.add_cpoints(frame->cpoints, frame->item_number);
+    points += frame->item_number;
+    filled += image.get_filled_cells();
+  }
+  double s = t.elapsed_s();
+  innovusion::bench_report("CframeRangeImage", 0, frames.size(), "frames", s);
+  fprintf(stdout, "  %.3f ms/frame, %.1f M points/s, %ux%u, %.1f%% filled\n",
+          s * 1000 / frames.size(), points / s / 1000000.0,
+          image.get_width(), image.get_height(),
+          100.0 * filled / frames.size() / image.get_range().size());
+}
+
+int main(int argc, char **argv) {
+  size_t frame_number = argc > 1 ? strtoul(argv[1], NULL, 0) : 50;
+  uint32_t packets = argc > 2 ? strtoul(argv[2], NULL, 0) : 500;
+  double resolution = argc > 3 ? atof(argv[3]) : 0.1;
+
+  // the converter keeps a few frames inline, keep it off the stack
+  CframeConverter *converter = new CframeConverter();
+  BenchPacketGenerator gen(1, INNO_MULTIPLE_RETURN_MODE_SINGLE);
+  std::vector<inno_cframe_header *> frames;
+  std::vector<char> buf;
+  for (size_t f = 0; f <= frame_number; f++) {
+    buf.clear();
+    gen.make_frame(f, packets, &buf);
+    size_t off = 0;
+    while (off < buf.size()) {
+      const InnoDataPacket *pkt =
+          reinterpret_cast<const InnoDataPacket *>(&buf[off]);
+      inno_cframe_header *frame = converter->add_data_packet(pkt, 0);
+      if (frame) {
+        size_t size = sizeof(inno_cframe_header) + frame->get_size();
+        inno_cframe_header *copy =
+            reinterpret_cast<inno_cframe_header *>(malloc(size));
+        memcpy(copy, frame, size);
+        frames.push_back(copy);
+      }
+      off += pkt->common.size;
+    }
+  }
+  delete converter;
+  fprintf(stdout, "%lu frames x %u points, %.2f degree per pixel\n",
+          frames.size(), frames.empty() ? 0 : frames[0]->item_number,
+          resolution);
+  if (frames.empty() || !verify(frames[0], resolution)) {
+    fprintf(stdout, "verify FAILED\n");
+    return 1;
+  }
+
+  run_xyz(frames, resolution);
+  run_cpoint(frames, resolution);
+  for (size_t f = 0; f < frames.size(); f++) {
+    free(frames[f]);
+  }
+  return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * Sustained raw4 capture: datagrams are built straight in RawReceiver
+ * pool segments (where recvfrom() lands them) and handed to a RawSaver,
+ * which writes them to a file in SAVE_DIR with writev(). Reports MB/s
+ * until the file is renamed and the heap allocations made by any thread
+ * between warmup and the last packet, which must be 0.
+ *
+ * Then the same with one sid missing in the middle: the saver must skip
+ * it right away and still write every datagram after it.
+ *
+ * usage: raw_capture_bench [PACKET_NUMBER] [PAYLOAD_SIZE] [SAVE_DIR]
+ */
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+
+#include "bench/bench_utils.h"
+#include "sdk_client/lidar_client.h"
+#include "sdk_client/raw_recorder.h"
+#include "sdk_common/inno_lidar_packet_utils.h"
+
+using innovusion::BenchTimer;
+using innovusion::RawReceiver;
+using innovusion::RawSaver;
+using innovusion::RawSegment;
+
+static std::atomic<uint64_t> malloc_count(0);
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *malloc(size_t size) {
+  malloc_count++;
+  return __libc_malloc(size);
+}
+#endif
+
+static void send(RawReceiver *receiver, RawSaver *saver,
+                 uint8_t type, uint32_t sid, bool end,
+                 const char *payload, uint32_t payload_size,
+                 uint64_t *stalls) {
+  RawSegment *segment;
+  while ((segment = receiver->get_pool()->alloc()) == NULL) {
+    (*stalls)++;
+    sched_yield();
+  }
+  Raw4UdpHeader &header = segment->header;
+  header.idx = 1;
+  header.field_type = type;
+  header.field_sequence_id = sid;
+  header.flag = end ? Raw4UdpHeader::kFlagFieldEnd : 0;
+  InnoDataPacketUtils::raw4_header_to_net(
+      header, segment->start, RawSegment::kCapacity);
+  memcpy(segment->start + Raw4UdpHeader::kHeaderSize, payload, payload_size);
+  segment->len = Raw4UdpHeader::kHeaderSize + payload_size;
+  saver->add_data(segment);
+}
+
+// sends sid 0..packets-1 except lost_sid, returns the file size or -1
+static int64_t capture(innovusion::InnoLidarClient *client,
+                       RawReceiver *receiver, const std::string &dir,
+                       const char *cause, uint32_t packets,
+                       const char *payload, uint32_t payload_size,
+                       uint32_t warmup, uint32_t lost_sid,
+                       uint64_t *mallocs, uint64_t *stalls, double *s) {
+  std::string file = dir + "/snBENCH-" + cause +
+                     (lost_sid < packets ? "-incomplete" : "") + ".inno_raw";
+  unlink(file.c_str());
+  RawSaver *saver = new RawSaver(client, receiver, 1);
+  send(receiver, saver, InnoRaw4Packet::TYPE_SN, 0, true,
+       "BENCH", 5, stalls);
+  send(receiver, saver, InnoRaw4Packet::TYPE_CAUSE, 0, true,
+       cause, strlen(cause), stalls);
+  BenchTimer t;
+  for (uint32_t sid = 0; sid < packets; sid++) {
+    if (sid == warmup) {
+      *mallocs = malloc_count;
+    }
+    if (sid == packets - 1) {
+      *mallocs = malloc_count - *mallocs;
+    }
+    if (sid != lost_sid) {
+      send(receiver, saver, InnoRaw4Packet::TYPE_RAWDATA, sid,
+           sid == packets - 1, payload, payload_size, stalls);
+    }
+  }
+  struct stat st;
+  // the saver gives up after kDataStreamingStopTimeOutDefaultS
+  for (uint32_t i = 0; stat(file.c_str(), &st) != 0; i++) {
+    if (i > 40 * 1000 * 10) {
+      st.st_size = -1;
+      break;
+    }
+    usleep(100);
+  }
+  *s = t.elapsed_s();
+  saver->shutdown();
+  delete saver;
+  unlink(file.c_str());
+  return st.st_size;
+}
+
+int main(int argc, char **argv) {
+  uint32_t packets = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+  uint32_t payload_size = argc > 2 ? strtoul(argv[2], NULL, 0) : 8192;
+  std::string dir = argc > 3 ? argv[3] : "/tmp/raw_capture_bench";
+  const uint32_t warmup = 1024;
+  if (payload_size + Raw4UdpHeader::kHeaderSize > RawSegment::kCapacity ||
+      packets <= warmup) {
+    fprintf(stdout, "bad PACKET_NUMBER or PAYLOAD_SIZE\n");
+    return 1;
+  }
+  mkdir(dir.c_str(), 0755);
+
+  char *payload = reinterpret_cast<char *>(malloc(payload_size));
+  for (uint32_t i = 0; i < payload_size; i++) {
+    payload[i] = static_cast<char>(i * 7);
+  }
+
+  innovusion::InnoLidarClient *client =
+      new innovusion::InnoLidarClient("bench", "/dev/null", 0, 0, 0);
+  RawReceiver *receiver = new RawReceiver(client, 0, dir);
+
+  uint64_t bytes = static_cast<uint64_t>(packets) * payload_size;
+  uint64_t mallocs = 0;
+  uint64_t stalls = 0;
+  double s = 0;
+  int64_t size = capture(client, receiver, dir, "bench", packets, payload,
+                         payload_size, warmup, packets, &mallocs, &stalls,
+                         &s);
+  innovusion::bench_report("raw capture", bytes, packets, "packets", s);
+  fprintf(stdout, "  %lu pool stalls, %lu allocations after warmup\n",
+          stalls, mallocs);
+  bool ok = static_cast<uint64_t>(size) == bytes && mallocs == 0;
+
+  // one datagram lost in the middle, everything after it must still be
+  // written, and well before kExpectIdTimeOutDefaultS
+  uint64_t gap_mallocs = 0;
+  uint64_t gap_stalls = 0;
+  double gap_s = 0;
+  int64_t gap_size = capture(client, receiver, dir, "gap", packets,
+                             payload, payload_size, warmup, packets / 2,
+                             &gap_mallocs, &gap_stalls, &gap_s);
+  innovusion::bench_report("raw capture, 1 lost", bytes - payload_size,
+                           packets - 1, "packets", gap_s);
+  fprintf(stdout, "  %lu pool stalls\n", gap_stalls);
+  bool gap_ok = static_cast<uint64_t>(gap_size) == bytes - payload_size &&
+                gap_s < s + RawSaver::kExpectIdTimeOutDefaultS / 2.0;
+
+  delete receiver;
+  free(payload);
+  if (!ok || !gap_ok) {
+    fprintf(stdout, "verify FAILED: file size %ld, with 1 lost %ld\n",
+            size, gap_size);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,249 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * Latency and receiver cpu time of the shared memory ring vs. loopback
+ * udp and tcp, publisher and receiver run as two threads in one process
+ * and every message carries its send time.
+ *
+ * usage: shm_ring_bench [MESSAGE_NUMBER] [MESSAGE_SIZE] [INTERVAL_US]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "src/utils/shm_ring.h"
+
+using innovusion::BenchTimer;
+using innovusion::InnoUtils;
+using innovusion::ShmRing;
+
+static const uint16_t kPort = 18731;
+
+struct BenchResult {
+  std::vector<uint64_t> latency_ns;
+  double cpu_s;
+};
+
+static double thread_cpu_s() {
+  struct rusage r;
+  getrusage(RUSAGE_THREAD, &r);
+  return r.ru_utime.tv_sec + r.ru_stime.tv_sec +
+      (r.ru_utime.tv_usec + r.ru_stime.tv_usec) / 1e6;
+}
+
+static void fill_message(std::vector<char> *buf) {
+  uint64_t now = InnoUtils::get_time_ns(CLOCK_MONOTONIC_RAW);
+  memcpy(&(*buf)[0], &now, sizeof(now));
+}
+
+static void add_latency(const char *buf, BenchResult *result) {
+  uint64_t sent;
+  memcpy(&sent, buf, sizeof(sent));
+  result->latency_ns.push_back(
+      InnoUtils::get_time_ns(CLOCK_MONOTONIC_RAW) - sent);
+}
+
+static void report(const char *name, BenchResult *result, size_t size,
+                   double seconds) {
+  std::vector<uint64_t> &l = result->latency_ns;
+  if (l.empty()) {
+    fprintf(stdout, "%s: nothing received\n", name);
+    return;
+  }
+  std::sort(l.begin(), l.end());
+  innovusion::bench_report(name, l.size() * size, l.size(), "msgs",
+                           seconds);
+  fprintf(stdout, "  latency us p50 %.1f p99 %.1f max %.1f, "
+          "receiver cpu %.3f s\n",
+          l[l.size() / 2] / 1e3, l[l.size() * 99 / 100] / 1e3,
+          l.back() / 1e3, result->cpu_s);
+}
+
+static void bench_shm(size_t number, size_t size, uint32_t interval_us) {
+  ShmRing writer(kPort, true);
+  ShmRing reader(kPort, false);
+  if (!writer.is_valid() || !reader.is_valid()) {
+    fprintf(stdout, "shm ring not available\n");
+    return;
+  }
+  BenchResult result;
+  result.latency_ns.reserve(number);
+  std::thread t([&]() {
+    std::vector<char> buf(ShmRing::kSlotSize);
+    double cpu = thread_cpu_s();
+    while (result.latency_ns.size() < number) {
+      ssize_t r = reader.read(&buf[0], buf.size(), 500);
+      if (r <= 0) {
+        break;
+      }
+      add_latency(&buf[0], &result);
+    }
+    result.cpu_s = thread_cpu_s() - cpu;
+  });
+  std::vector<char> buf(size);
+  BenchTimer timer;
+  for (size_t i = 0; i < number; i++) {
+    fill_message(&buf);
+    writer.publish(&buf[0], size);
+    if (interval_us) {
+      usleep(interval_us);
+    }
+  }
+  t.join();
+  report("shm ring", &result, size, timer.elapsed_s());
+  fprintf(stdout, "  lost %lu\n", reader.get_lost());
+}
+
+static void bench_udp(size_t number, size_t size, uint32_t interval_us) {
+  int rfd = socket(AF_INET, SOCK_DGRAM, 0);
+  int sfd = socket(AF_INET, SOCK_DGRAM, 0);
+  int rcvbuf = 8 * 1024 * 1024;
+  setsockopt(rfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  struct timeval tv = {0, 500000};
+  setsockopt(rfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(rfd, reinterpret_cast<struct sockaddr *>(&addr),
+           sizeof(addr)) < 0) {
+    perror("udp bind");
+    close(rfd);
+    close(sfd);
+    return;
+  }
+  BenchResult result;
+  result.latency_ns.reserve(number);
+  std::thread t([&]() {
+    std::vector<char> buf(65536);
+    double cpu = thread_cpu_s();
+    while (result.latency_ns.size() < number) {
+      ssize_t r = recvfrom(rfd, &buf[0], buf.size(), 0, NULL, NULL);
+      if (r <= 0) {
+        break;
+      }
+      add_latency(&buf[0], &result);
+    }
+    result.cpu_s = thread_cpu_s() - cpu;
+  });
+  std::vector<char> buf(size);
+  BenchTimer timer;
+  for (size_t i = 0; i < number; i++) {
+    fill_message(&buf);
+    sendto(sfd, &buf[0], size, 0,
+           reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+    if (interval_us) {
+      usleep(interval_us);
+    }
+  }
+  t.join();
+  report("udp loopback", &result, size, timer.elapsed_s());
+  close(rfd);
+  close(sfd);
+}
+
+static void bench_tcp(size_t number, size_t size, uint32_t interval_us) {
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  int enable = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(lfd, reinterpret_cast<struct sockaddr *>(&addr),
+           sizeof(addr)) < 0 || listen(lfd, 1) < 0) {
+    perror("tcp listen");
+    close(lfd);
+    return;
+  }
+  int cfd = socket(AF_INET, SOCK_STREAM, 0);
+  if (connect(cfd, reinterpret_cast<struct sockaddr *>(&addr),
+              sizeof(addr)) < 0) {
+    perror("tcp connect");
+    close(cfd);
+    close(lfd);
+    return;
+  }
+  int sfd = accept(lfd, NULL, NULL);
+  setsockopt(sfd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+  BenchResult result;
+  result.latency_ns.reserve(number);
+  std::thread t([&]() {
+    std::vector<char> buf(size);
+    double cpu = thread_cpu_s();
+    while (result.latency_ns.size() < number) {
+      // same framing as pcs tcp: fixed size messages back to back
+      size_t got = 0;
+      while (got < size) {
+        ssize_t r = recv(cfd, &buf[got], size - got, 0);
+        if (r <= 0) {
+          break;
+        }
+        got += r;
+      }
+      if (got < size) {
+        break;
+      }
+      add_latency(&buf[0], &result);
+    }
+    result.cpu_s = thread_cpu_s() - cpu;
+  });
+  std::vector<char> buf(size);
+  BenchTimer timer;
+  for (size_t i = 0; i < number; i++) {
+    fill_message(&buf);
+    size_t sent = 0;
+    while (sent < size) {
+      ssize_t r = send(sfd, &buf[sent], size - sent, 0);
+      if (r <= 0) {
+        break;
+      }
+      sent += r;
+    }
+    if (interval_us) {
+      usleep(interval_us);
+    }
+  }
+  t.join();
+  report("tcp loopback", &result, size, timer.elapsed_s());
+  close(sfd);
+  close(cfd);
+  close(lfd);
+}
+
+int main(int argc, char **argv) {
+  size_t number = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+  size_t size = argc > 2 ? strtoul(argv[2], NULL, 0) : 8000;
+  uint32_t interval_us = argc > 3 ? strtoul(argv[3], NULL, 0) : 20;
+  size = std::max(size, sizeof(uint64_t));
+  size = std::min(size, static_cast<size_t>(ShmRing::kSlotSize));
+
+  fprintf(stdout, "%lu messages x %lu bytes, %u us apart\n",
+          number, size, interval_us);
+  bench_shm(number, size, interval_us);
+  bench_udp(number, std::min(size, static_cast<size_t>(65000)),
+            interval_us);
+  bench_tcp(number, size, interval_us);
+  return 0;
+}
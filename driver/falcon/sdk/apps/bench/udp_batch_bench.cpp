@@ -0,0 +1,91 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * Cost of the pcs data udp output: one sendto per packet vs. the
+ * sendmmsg batch thread, with and without UDP_SEGMENT, sending real
+ * size data packets to a local udp sink. cpu is the whole process
+ * (caller plus batch thread), the sink is not read. The caller yields
+ * and retries when the batch queue is full so that every mode sends
+ * the same packets.
+ *
+ * usage: udp_batch_bench [PACKET_NUMBER] [BATCH_SIZE] [INTERVAL_US]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "bench/bench_utils.h"
+#include "pcs/udp_sender.h"
+
+using innovusion::BenchPacketGenerator;
+using innovusion::BenchTimer;
+using innovusion::UdpSender;
+
+static double process_cpu_s() {
+  struct rusage r;
+  getrusage(RUSAGE_SELF, &r);
+  return r.ru_utime.tv_sec + r.ru_stime.tv_sec +
+      (r.ru_utime.tv_usec + r.ru_stime.tv_usec) / 1e6;
+}
+
+static void run(const char *name, const std::vector<char> &packets,
+                size_t packet_number, uint32_t batch_size,
+                uint32_t interval_us, bool gso) {
+  UdpSender *sender = new UdpSender("127.0.0.1", 18733);
+  if (batch_size > 1 &&
+      sender->start_batch(batch_size, interval_us, gso) != 0) {
+    fprintf(stdout, "%s: not supported\n", name);
+    delete sender;
+    return;
+  }
+  size_t bytes = 0;
+  size_t sent = 0;
+  double cpu = process_cpu_s();
+  BenchTimer t;
+  while (sent < packet_number) {
+    size_t off = 0;
+    while (off < packets.size() && sent < packet_number) {
+      const InnoDataPacket *pkt =
+          reinterpret_cast<const InnoDataPacket *>(&packets[off]);
+      while (sender->write_batched(pkt, pkt->common.size) < 0) {
+        std::this_thread::yield();
+      }
+      bytes += pkt->common.size;
+      off += pkt->common.size;
+      sent++;
+    }
+  }
+  std::string stats = sender->is_batching() ? sender->get_batch_stats() : "";
+  // flushes the queue
+  delete sender;
+  innovusion::bench_report(name, bytes, sent, "packets", t.elapsed_s());
+  fprintf(stdout, "  cpu %.3f s %s\n", process_cpu_s() - cpu,
+          stats.c_str());
+}
+
+int main(int argc, char **argv) {
+  size_t packet_number = argc > 1 ? strtoul(argv[1], NULL, 0) : 200000;
+  uint32_t batch_size = argc > 2 ? strtoul(argv[2], NULL, 0) : 32;
+  uint32_t interval_us = argc > 3 ? strtoul(argv[3], NULL, 0) : 1000;
+
+  BenchPacketGenerator gen;
+  std::vector<char> packets;
+  gen.make_frame(0, 1000, &packets);
+
+  run("sendto per packet", packets, packet_number, 0, 0, false);
+  run("sendmmsg batch", packets, packet_number, batch_size, interval_us,
+      false);
+  run("sendmmsg + gso batch", packets, packet_number, batch_size,
+      interval_us, true);
+  return 0;
+}
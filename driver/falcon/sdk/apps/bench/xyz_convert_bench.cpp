@@ -0,0 +1,72 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+/*
+ * Sphere to xyz conversion: per-point reference path vs. block path.
+ *
+ * usage: xyz_convert_bench [PACKET_NUMBER] [LOOPS]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "bench/bench_utils.h"
+
+using innovusion::BenchPacketGenerator;
+using innovusion::BenchTimer;
+
+static void run(const char *name, const std::vector<char> &packets,
+                size_t packet_number, uint32_t loops, bool per_point) {
+  std::vector<char> out(1 << 20);
+  InnoDataPacket *dest = reinterpret_cast<InnoDataPacket *>(&out[0]);
+  size_t points = 0;
+  BenchTimer t;
+  for (uint32_t l = 0; l < loops; l++) {
+    size_t off = 0;
+    while (off < packets.size()) {
+      const InnoDataPacket *pkt =
+          reinterpret_cast<const InnoDataPacket *>(&packets[off]);
+      bool ok = per_point ?
+          InnoDataPacketUtils::convert_to_xyz_pointcloud_per_point(
+              *pkt, dest, out.size(), false) :
+          InnoDataPacketUtils::convert_to_xyz_pointcloud(
+              *pkt, dest, out.size(), false);
+      if (ok) {
+        points += dest->item_number;
+      }
+      off += pkt->common.size;
+    }
+  }
+  double s = t.elapsed_s();
+  innovusion::bench_report(name, packets.size() * loops,
+                           packet_number * loops, "packets", s);
+  fprintf(stdout, "  %.1f M points/s\n", points / s / 1000000.0);
+}
+
+int main(int argc, char **argv) {
+  uint32_t packet_number = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000;
+  uint32_t loops = argc > 2 ? strtoul(argv[2], NULL, 0) : 20;
+
+  {
+    BenchPacketGenerator gen(1, INNO_MULTIPLE_RETURN_MODE_SINGLE);
+    std::vector<char> packets;
+    gen.make_frame(0, packet_number, &packets);
+    run("single return, per-point", packets, packet_number, loops, true);
+    run("single return, block", packets, packet_number, loops, false);
+  }
+  {
+    BenchPacketGenerator gen(1, INNO_MULTIPLE_RETURN_MODE_2_STRONGEST);
+    std::vector<char> packets;
+    gen.make_frame(0, packet_number, &packets);
+    run("dual return, per-point", packets, packet_number, loops, true);
+    run("dual return, block", packets, packet_number, loops, false);
+  }
+  return 0;
+}
@@ -17,11 +17,14 @@
 #include <iostream>
 #include <fstream>
 
+#include <algorithm>
 #include <limits>
 #include <string>
+#include <thread>  // NOLINT
 
 #include "src/sdk_common/converter/cframe_converter.h"
 #include "src/sdk_common/converter/png_recorder.h"
+#include "src/sdk_common/converter/point_cloud_writer.h"
 #include "src/sdk_common/converter/rosbag_recorder.h"
 #include "src/sdk_common/inno_lidar_api.h"
 #include "src/sdk_common/inno_lidar_packet_utils.h"
@@ -31,6 +34,7 @@
 static const double kUsInSecond = 1000000.0;
 static const double k10UsInSecond = 100000.0;
 static const uint32_t kMaxMsgBuf = 1500;
+static const uint32_t kMaxWriterThreads = 4;
 
 /***********************
  * class FileRecorder
@@ -46,6 +50,9 @@ class FileRecorder {
     FILE_TYPE_INNO_CFRAME,
     FILE_TYPE_BAG,
     FILE_TYPE_PNG,
+    FILE_TYPE_PCD_COMPRESSED,
+    FILE_TYPE_PLY,
+    FILE_TYPE_LAS,
     FILE_TYPE_MAX,
   };
 
@@ -79,7 +86,8 @@ class FileRecorder {
   explicit FileRecorder(const std::string &filename,
                         const uint64_t frame_id,
                         bool reflectance,
-                        enum FileType file_type)
+                        enum FileType file_type,
+                        innovusion::PointCloudWriterPool *writer_pool)
       : filename_(filename)
       , fd_(-1)
       , point_count_(0)
@@ -89,7 +97,8 @@ class FileRecorder {
       , byte_written_(0)
       , cframe_converter_(NULL)
       , rosbag_stream_(NULL)
-      , png_stream_(NULL) {
+      , png_stream_(NULL)
+      , writer_pool_(writer_pool) {
     if (can_record_cframe()) {
       cframe_converter_ = new innovusion::CframeConverter();
       inno_log_verify(cframe_converter_, "cframe_converter_");
@@ -106,6 +115,10 @@ class FileRecorder {
 
     if (can_record_bag()) {
       fd_ = -1;
+    } else if (can_record_frame()) {
+      // the whole file is written by writer_pool_ when it is closed
+      inno_log_verify(writer_pool_, "writer_pool_");
+      fd_ = -1;
     } else {
       fd_ = innovusion::InnoUtils::open_file(filename_.c_str(),
                                              O_WRONLY | O_CREAT | O_TRUNC,
@@ -120,8 +133,8 @@ class FileRecorder {
 
   ~FileRecorder() {
     if (can_record_cframe() && cframe_converter_) {
-      inno_cframe_header *cframe = cframe_converter_->close_current_frame();
-      if (cframe) {
+      inno_cframe_header *cframe;
+      while ((cframe = cframe_converter_->close_current_frame()) != NULL) {
         write_buffer_(cframe, cframe->get_size());
       }
     }
@@ -141,6 +154,11 @@ class FileRecorder {
       delete png_stream_;
       png_stream_ = NULL;
     }
+    if (can_record_frame()) {
+      inno_log_info("queue %" PRI_SIZELU " points to %s",
+                    frame_.get_point_number(), filename_.c_str());
+      writer_pool_->add_frame(filename_, get_frame_format_(), &frame_);
+    }
     close_();
     if (fd_ >= 0) {
       close(fd_);
@@ -170,6 +188,12 @@ class FileRecorder {
     return file_type_ == FILE_TYPE_PNG;
   }
 
+  bool can_record_frame() const {
+    return file_type_ == FILE_TYPE_PCD_COMPRESSED ||
+        file_type_ == FILE_TYPE_PLY ||
+        file_type_ == FILE_TYPE_LAS;
+  }
+
   InnoDataPacket *convert_to_data_xyz_point_(const InnoDataPacket &pkt) {
     // 1. calculate max size and allocate new data packet
     size_t new_pkt_size = InnoDataPacketUtils::get_data_packet_size(
@@ -250,6 +274,11 @@ class FileRecorder {
     return;
   }
 
+  void add_data_packet_to_frame(const InnoDataPacket &pkt) {
+    frame_.add_packet(pkt);
+    return;
+  }
+
   void add_points(const uint64_t frame_id,
                   const double x, const double y, const double z,
                   const uint32_t ref, const uint32_t channel,
@@ -325,6 +354,20 @@ class FileRecorder {
   }
 
  private:
+  innovusion::PointCloudFileFormat get_frame_format_() const {
+    switch (file_type_) {
+      case FILE_TYPE_PCD_COMPRESSED:
+        return innovusion::POINT_CLOUD_FILE_PCD_BINARY_COMPRESSED;
+      case FILE_TYPE_PLY:
+        return innovusion::POINT_CLOUD_FILE_PLY;
+      case FILE_TYPE_LAS:
+        return innovusion::POINT_CLOUD_FILE_LAS;
+      default:
+        inno_log_panic("invalid type %d", file_type_);
+        return innovusion::POINT_CLOUD_FILE_MAX;
+    }
+  }
+
   void write_dummy_header_() {
     size_t write_size = 0;
     switch (file_type_) {
@@ -467,6 +510,8 @@ class FileRecorder {
   innovusion::CframeConverter *cframe_converter_;
   innovusion::RosbagRecorder *rosbag_stream_;
   innovusion::PngRecorder *png_stream_;
+  innovusion::PointCloudWriterPool *writer_pool_;
+  innovusion::PointCloudFrame frame_;
 };
 
 /***********************
@@ -481,6 +526,7 @@ class ExampleProcessor {
                    int use_xyz_point,
                    std::string latency_file,
                    int ascii_pcd,
+                   int compressed_pcd,
                    int extract_message)
       : filename_(filename)
       , frame_start_(frame_start)
@@ -492,6 +538,7 @@ class ExampleProcessor {
       , frame_so_far_(-1)
       , file_so_far_(0)
       , file_recorder_(NULL)
+      , writer_pool_(NULL)
       , file_type_(FileRecorder::FILE_TYPE_PCD)
       , done_(false) {
     // create status and message file
@@ -518,16 +565,36 @@ class ExampleProcessor {
         file_type_ = FileRecorder::FILE_TYPE_PNG;
         inno_log_info("force to use sphere coordinate to record PNG file");
         use_xyz_point_ = 0;
+      } else if (strcasecmp(file_extension_.c_str(),
+                            ".ply") == 0) {
+        file_type_ = FileRecorder::FILE_TYPE_PLY;
+      } else if (strcasecmp(file_extension_.c_str(),
+                            ".las") == 0) {
+        file_type_ = FileRecorder::FILE_TYPE_LAS;
       } else {
         file_type_ = ascii_pcd ?
                      FileRecorder::FILE_TYPE_PCD :
-                     FileRecorder::FILE_TYPE_PCD_BINARY;
+                     (compressed_pcd ?
+                      FileRecorder::FILE_TYPE_PCD_COMPRESSED :
+                      FileRecorder::FILE_TYPE_PCD_BINARY);
       }
     } else {
       filename_base_ = filename_;
       file_type_ = ascii_pcd ?
                    FileRecorder::FILE_TYPE_PCD :
-                   FileRecorder::FILE_TYPE_PCD_BINARY;
+                   (compressed_pcd ?
+                    FileRecorder::FILE_TYPE_PCD_COMPRESSED :
+                    FileRecorder::FILE_TYPE_PCD_BINARY);
+    }
+    if (file_type_ == FileRecorder::FILE_TYPE_PCD_COMPRESSED ||
+        file_type_ == FileRecorder::FILE_TYPE_PLY ||
+        file_type_ == FileRecorder::FILE_TYPE_LAS) {
+      // frames of different files are encoded and written in parallel
+      uint32_t threads = std::max(1U, std::min(
+          std::thread::hardware_concurrency(), kMaxWriterThreads));
+      writer_pool_ = new innovusion::PointCloudWriterPool(threads,
+                                                          threads);
+      inno_log_verify(writer_pool_, "writer_pool_");
     }
     if (extract_message) {
       status_filename_ = filename_ + "_status_log.txt";
@@ -553,6 +620,11 @@ class ExampleProcessor {
       delete file_recorder_;
       file_recorder_ = NULL;
     }
+    if (writer_pool_) {
+      // wait for the queued files
+      delete writer_pool_;
+      writer_pool_ = NULL;
+    }
     if (msg_fd_ >= 0) {
       close(msg_fd_);
       msg_fd_ = -1;
@@ -810,7 +882,8 @@ class ExampleProcessor {
         file_recorder_ = new FileRecorder(fn,
                                           frame_id,
                                           reflectance,
-                                          file_type_);
+                                          file_type_,
+                                          writer_pool_);
         file_so_far_++;
         inno_log_verify(file_recorder_ != NULL,
                         "cannot create file recorder");
@@ -876,6 +949,8 @@ class ExampleProcessor {
         recorder->add_data_packet_to_bag(pkt);
       } else if (recorder->can_record_png()) {
         recorder->add_data_packet_to_png(pkt);
+      } else if (recorder->can_record_frame()) {
+        recorder->add_data_packet_to_frame(pkt);
       } else {
         for (uint32_t i = 0; i < pkt.item_number; i++) {
           const InnoXyzPoint &pt = pkt.xyz_points[i];
@@ -937,6 +1012,9 @@ class ExampleProcessor {
     } else if (recorder->can_record_packet()) {
       recorder->add_data_packet(pkt);
       return;
+    } else if (recorder->can_record_frame()) {
+      recorder->add_data_packet_to_frame(pkt);
+      return;
     }
 
     InnoDataPacketUtils::get_block_size_and_number_return(pkt,
@@ -996,6 +1074,7 @@ class ExampleProcessor {
   int64_t frame_so_far_;
   int file_so_far_;
   FileRecorder *file_recorder_;
+  innovusion::PointCloudWriterPool *writer_pool_;
   std::string msg_filename_;
   std::string status_filename_;
   std::string galvo_check_filename_;
@@ -1035,8 +1114,9 @@ void usage(const char *arg0) {
           "\t[--frame-start <Nth_FRAME_TO_RECORD>]\n"
           "\t[--frame-number <NUMBER_OF_FRAME_TO_RECORD>]\n"
           "\t[--output-filename <OUTPUT_FILENAME."
-               "pcd|csv|inno_pc|inno_pc_xyz|inno_cframe|bag|png>]\n"
+               "pcd|csv|inno_pc|inno_pc_xyz|inno_cframe|bag|png|ply|las>]\n"
           "\t[--ascii-pcd]\n"
+          "\t[--compressed-pcd]\n"
           "\t[--extract-message]\n", arg0);
   inno_fprintf(2,
           "\n"
@@ -1061,8 +1141,14 @@ void usage(const char *arg0) {
           "--frame-start 10 --frame-number 1 "
           "--file-number 20 "
           "--output-filename test.pcd\n\n"
+          " --same as above but save to binary las files, "
+          "the files are written in parallel\n"
+          "   %s --inno-pc-filename input.inno_pc "
+          "--frame-start 10 --frame-number 1 "
+          "--file-number 20 "
+          "--output-filename test.las\n\n"
           "Please see more usage examples in test_get_pcd.bash\n",
-          arg0, arg0, arg0, arg0);
+          arg0, arg0, arg0, arg0, arg0);
   return;
 }
 
@@ -1097,6 +1183,7 @@ int main(int argc, char **argv) {
   int extract_message = 0;
   int use_tcp = 0;
   int ascii_pcd = 0;
+  int compressed_pcd = 0;
   enum InnoLidarMode lidar_mode = INNO_LIDAR_MODE_NONE;
   enum InnoReflectanceMode reflectance = INNO_REFLECTANCE_MODE_NONE;
   enum InnoMultipleReturnMode multireturn = INNO_MULTIPLE_RETURN_MODE_NONE;
@@ -1126,6 +1213,7 @@ int main(int argc, char **argv) {
     {"extract-message", no_argument, &extract_message, 1},
     {"use-tcp", no_argument, &use_tcp, 1},
     {"ascii-pcd", no_argument, &ascii_pcd, 1},
+    {"compressed-pcd", no_argument, &compressed_pcd, 1},
     {"latency-file", required_argument, 0, 'l'},
     {"help", no_argument, NULL, 'h'},
     {0, 0, 0, 0}
@@ -1270,7 +1358,7 @@ int main(int argc, char **argv) {
   ExampleProcessor processor(filename, frame_start,
                              frame_number, file_number,
                              use_xyz_point, latency_file, ascii_pcd,
-                             extract_message);
+                             compressed_pcd, extract_message);
 
   /***********************
    * open lidar handle
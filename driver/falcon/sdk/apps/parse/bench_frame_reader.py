@@ -0,0 +1,151 @@
+#  Copyright (C) 2021 - Innovusion Inc.
+#
+#  All Rights Reserved.
+#
+#  $Id$
+#
+# Frames/s of the per-packet api (parse_inno_package() per udp payload,
+# one Eigen double matrix per frame, the python loop splits the file)
+# vs. FrameReader (the whole file is parsed on a C++ thread, frames are
+# float32 numpy arrays without copy). The frames of both paths are
+# compared before the timing.
+#
+# usage: python3 bench_frame_reader.py -i xxx.pcap|xxx.inno_pc
+
+import argparse
+import struct
+import time
+
+import numpy as np
+import inno_falcon_b_parse as falcon
+
+
+def inno_pc_payloads(filename):
+    with open(filename, 'rb') as f:
+        data = f.read()
+    off = 0
+    while off + 14 <= len(data):
+        # InnoCommonHeader.size
+        size = struct.unpack_from('<I', data, off + 10)[0]
+        if size < 14:
+            break
+        yield data[off:off + size]
+        off += size
+
+
+def pcap_payloads(filename, port):
+    with open(filename, 'rb') as f:
+        data = f.read()
+    endian = '<' if data[:4] in (b'\xd4\xc3\xb2\xa1', b'\x4d\x3c\xb2\xa1') \
+        else '>'
+    link_type = struct.unpack_from(endian + 'I', data, 20)[0]
+    if link_type != 1:
+        raise ValueError('only ethernet pcap files are supported')
+    off = 24
+    fragments = {}
+    while off + 16 <= len(data):
+        caplen = struct.unpack_from(endian + 'I', data, off + 8)[0]
+        pkt = data[off + 16:off + 16 + caplen]
+        off += 16 + caplen
+        if len(pkt) < 34 or pkt[12:14] != b'\x08\x00' or pkt[23] != 17:
+            continue
+        ihl = (pkt[14] & 0x0f) * 4
+        total_len, ip_id, frag = struct.unpack_from('>HHH', pkt, 16)
+        payload = pkt[14 + ihl:14 + total_len]
+        key = (pkt[26:34], ip_id)
+        if frag & 0x3fff:
+            # fragments are assumed in order, as in falcon_parser.py
+            fragments[key] = fragments.get(key, b'') + payload
+            if frag & 0x2000:
+                continue
+            payload = fragments.pop(key)
+        dport, udp_len = struct.unpack_from('>HH', payload, 2)
+        if port and dport != port:
+            continue
+        yield payload[8:udp_len]
+
+
+def payloads(filename, port):
+    with open(filename, 'rb') as f:
+        magic = f.read(4)
+    if magic in (b'\xd4\xc3\xb2\xa1', b'\xa1\xb2\xc3\xd4',
+                 b'\x4d\x3c\xb2\xa1', b'\xa1\xb2\x3c\x4d'):
+        return pcap_payloads(filename, port)
+    return inno_pc_payloads(filename)
+
+
+def per_packet_frames(filename, port):
+    falcon.init()
+    for i, payload in enumerate(payloads(filename, port)):
+        pcd = falcon.parse_inno_package(payload, len(payload), i)
+        if pcd.shape[0] > 1:
+            yield falcon.idx(), pcd
+
+
+def verify(filename, port):
+    old = dict(per_packet_frames(filename, port))
+    compared = 0
+    for frame in falcon.FrameReader(filename, columns=['x', 'y', 'z'],
+                                    port=port):
+        if frame.idx not in old:
+            continue
+        a = np.asarray(frame)
+        pcd = old[frame.idx]
+        if a.shape[0] != pcd.shape[0]:
+            print('frame %d: %d points vs %d' %
+                  (frame.idx, a.shape[0], pcd.shape[0]))
+            return False
+        xyz = a.view(np.float32).reshape(-1, 3)
+        err = np.abs(xyz - pcd[:, :3]).max() if len(xyz) else 0
+        if err > 1e-3:
+            print('frame %d: max xyz error %f' % (frame.idx, err))
+            return False
+        compared += 1
+    print('%d frames verified' % compared)
+    return compared > 0
+
+
+def report(name, frames, points, seconds):
+    print('%-36s %8.1f frames/s %8.2f Mpoints/s' %
+          (name, frames / seconds, points / seconds / 1e6))
+
+
+def run_per_packet(filename, port):
+    frames = 0
+    points = 0
+    t = time.time()
+    for _, pcd in per_packet_frames(filename, port):
+        frames += 1
+        points += pcd.shape[0]
+    report('parse_inno_package (per packet)', frames, points,
+           time.time() - t)
+
+
+def run_frame_reader(name, filename, port, columns):
+    frames = 0
+    points = 0
+    t = time.time()
+    for frame in falcon.FrameReader(filename, columns=columns, port=port):
+        a = np.asarray(frame)
+        frames += 1
+        points += a.shape[0]
+    report(name, frames, points, time.time() - t)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="FrameReader benchmark")
+    parser.add_argument("-i", "--input", type=str, required=True,
+                        help='input pcap or inno_pc file')
+    parser.add_argument("-p", "--port", type=int, default=8010,
+                        help='udp port of the data packets in the pcap file')
+    parser.add_argument("-r", "--repeat", type=int, default=3)
+    args = parser.parse_args()
+    if not verify(args.input, args.port):
+        print('verify FAILED')
+        exit(1)
+    for _ in range(args.repeat):
+        run_per_packet(args.input, args.port)
+        run_frame_reader('FrameReader (all columns)', args.input, args.port,
+                         None)
+        run_frame_reader('FrameReader (x y z intensity)', args.input,
+                         args.port, ['x', 'y', 'z', 'intensity'])
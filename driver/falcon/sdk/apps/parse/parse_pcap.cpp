@@ -27,16 +27,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <string>
 #include <algorithm>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <list>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
 #include <vector>
 #include <unordered_map>
 #include <map>
 #include "src/sdk_common/inno_lidar_api.h"
 #include "src/sdk_common/inno_lidar_packet_utils.h"
 #include "src/utils/inno_lidar_log.h"
+#include "parse/pcap_reader.h"
 
 
 #define   PORT        8010
@@ -51,6 +59,7 @@ static const uint32_t kInnoMaxListSize = 10;
 
 typedef struct  {
   int record_pcd;
+  int thread_number;
 }ParseConfig;
 
 typedef struct {
@@ -515,8 +524,11 @@ class PcapProcessor {
 
  protected:
   void process_data_cpoint_(const InnoDataPacket &pkt);
+  static void add_packet_points_(const InnoDataPacket &pkt,
+                                 PcdRecorder *recorder);
+  static double get_packet_timestamp_sec_(const InnoDataPacket &pkt);
   bool parse_status_(char *data, int len);
-  bool parse_data_(char *data, int len);
+  virtual bool parse_data_(char *data, int len);
   bool parse_message_(char *data, int len);
   bool parse_raw_(char *data, int len);
   void counter_total_(bool ret);
@@ -527,52 +539,6 @@ class PcapProcessor {
   int create_folder_(const char* path);
   InnoDataPacket* get_and_cache_data_(const InnoDataPacket &pkt);
 
- private:
-  inline void add_point_to_pcd_recorder_(const double ts_start_us,
-                                         const int64_t frame_id,
-                                         const double x, const double y,
-                                         const double z,
-                                         const uint32_t ref,
-                                         const uint32_t channel,
-                                         const uint32_t in_roi,
-                                         const uint32_t facet,
-                                         const uint32_t m_ret,
-                                         const uint32_t confidence_level,
-                                         const uint32_t flags,
-                                         const uint32_t elongation,
-                                         const double timestamp_sec,
-                                         const uint32_t scanline,
-                                         const uint32_t scan_idx,
-                                         const bool reflectance) {
-    // how many frames we have seen so far?
-    // we want to skip the first frame, which may be partial
-    if ((config_.record_pcd) &&
-       (frame_so_far_ == -1 || current_frame_ != frame_id)) {
-      frame_so_far_++;
-      if (frame_so_far_ > 0) {
-        if (pcd_recorder_) {
-          delete pcd_recorder_;
-          pcd_recorder_ = NULL;
-        }
-        pcd_recorder_ = new PcdRecorder(current_pcd_folder_,
-                                        frame_id,
-                                        timestamp_sec,
-                                        reflectance);
-        inno_log_verify(pcd_recorder_ != NULL, "cannot create pcd recorder");
-      }
-      current_frame_ = frame_id;
-    }
-    if (pcd_recorder_) {
-      pcd_recorder_->add_points(frame_id, x, y, z,
-                                  ref, channel,
-                                  in_roi, facet, m_ret, confidence_level,
-                                  flags, elongation,
-                                  timestamp_sec,
-                                  scanline, scan_idx);
-    }
-    return;
-  }
-
  protected:
   std::string filename_;
   std::string output_foldername_;
@@ -605,16 +571,49 @@ class PcapProcessor {
   std::unordered_map<uint32_t, RawDataMessage*> raw_fd_map_;
 };
 
+void PcapProcessor::process_data_cpoint_(const InnoDataPacket &pkt) {
+  // summary date package frame and sub frame
+  summary_package_.summary_data_package(pkt);
+  // how many frames we have seen so far?
+  // we want to skip the first frame, which may be partial
+  if ((config_.record_pcd) &&
+     (frame_so_far_ == -1 || current_frame_ != int64_t(pkt.idx))) {
+    frame_so_far_++;
+    if (frame_so_far_ > 0) {
+      if (pcd_recorder_) {
+        delete pcd_recorder_;
+        pcd_recorder_ = NULL;
+      }
+      pcd_recorder_ = new PcdRecorder(current_pcd_folder_,
+                                      pkt.idx,
+                                      get_packet_timestamp_sec_(pkt),
+                                      pkt.use_reflectance);
+      inno_log_verify(pcd_recorder_ != NULL, "cannot create pcd recorder");
+    }
+    current_frame_ = pkt.idx;
+  }
+  if (pcd_recorder_) {
+    add_packet_points_(pkt, pcd_recorder_);
+  }
+  return;
+}
+
+double PcapProcessor::get_packet_timestamp_sec_(const InnoDataPacket &pkt) {
+  const InnoBlock *block =
+      reinterpret_cast<const InnoBlock *>(&pkt.inno_block1s[0]);
+  return pkt.common.ts_start_us / kUsInSecond +
+      (pkt.item_number ? block->header.ts_10us / k10UsInSecond : 0);
+}
+
 /*
   this function shows how to enumerate blocks and points in the packet
   directly, and use InnoDataPacketUtils::get_xyzr_meter to get each
   point's x,y,z coodindate, then add it to the pcd recorder
 */
-void PcapProcessor::process_data_cpoint_(const InnoDataPacket &pkt) {
+void PcapProcessor::add_packet_points_(const InnoDataPacket &pkt,
+                                       PcdRecorder *recorder) {
   uint32_t return_number;
   uint32_t unit_size;
-  // summary date package frame and sub frame
-  summary_package_.summary_data_package(pkt);
   InnoDataPacketUtils::get_block_size_and_number_return(pkt,
                                                         &unit_size,
                                                         &return_number);
@@ -640,19 +639,17 @@ void PcapProcessor::process_data_cpoint_(const InnoDataPacket &pkt) {
               full_angles.angles[channel],
               pt.radius, channel,
               &xyzr);
-          add_point_to_pcd_recorder_(pkt.common.ts_start_us,
-                                      pkt.idx, xyzr.x, xyzr.y, xyzr.z,
-                                      pt.refl, channel,
-                                      block->header.in_roi,
-                                      block->header.facet,
-                                      m,
-                                      pkt.confidence_level,
-                                      pt.type, pt.elongation,
-                                      frame_timestamp_sec +
-                                      block->header.ts_10us / k10UsInSecond,
-                                      block->header.scan_id,
-                                      block->header.scan_idx,
-                                      pkt.use_reflectance);
+          recorder->add_points(pkt.idx, xyzr.x, xyzr.y, xyzr.z,
+                               pt.refl, channel,
+                               block->header.in_roi,
+                               block->header.facet,
+                               m,
+                               pkt.confidence_level,
+                               pt.type, pt.elongation,
+                               frame_timestamp_sec +
+                               block->header.ts_10us / k10UsInSecond,
+                               block->header.scan_id,
+                               block->header.scan_idx);
         }
       }
     }
@@ -1137,6 +1134,390 @@ bool handler_pcap_(std::string filename, u_char *user) {
 
 
 
+/***********************
+ * class ParallelPcapProcessor
+ *
+ * mmaps a classic pcap file and walks the records in place, PcapReader
+ * decodes them. The udp datagrams that are not fragmented are parsed
+ * where they are in the map, fragments are put together by PcapReader
+ * first. The data packets are appended to the open frame of
+ * their source, a frame is handed to the worker threads when the
+ * source has moved past it, and the workers convert and write the
+ * frames in parallel. Status, message and raw packets are still
+ * written by the reading thread, in order.
+ ***********************/
+class ParallelPcapProcessor : public PcapProcessor {
+ public:
+  static const uint32_t kOpenFrameNumber = 2;
+
+ public:
+  ParallelPcapProcessor(const std::string &pcap_filename,
+                        const std::string &output_foldername,
+                        const ParseConfig &config)
+      : PcapProcessor(pcap_filename, output_foldername, config)
+      , thread_number_(config.thread_number > 0 ? config.thread_number : 1)
+      , current_saddr_(0)
+      , current_source_(NULL)
+      , packet_counter_(0)
+      , late_packet_counter_(0)
+      , reader_([this](uint32_t saddr, const char *udp, size_t len) {
+          process_datagram_(saddr, udp, len);
+        })
+      , frame_number_(0)
+      , shutdown_(false) {
+  }
+
+  ~ParallelPcapProcessor() {
+    finish_();
+    for (auto &item : sources_) {
+      delete item.second;
+    }
+    sources_.clear();
+    for (size_t i = 0; i < free_frames_.size(); i++) {
+      delete free_frames_[i];
+    }
+    free_frames_.clear();
+  }
+
+  /*
+   * @brief Check the pcap file header, pcapng and the link types
+   *        PcapReader does not know are left to libpcap
+   */
+  static bool is_supported_file(const std::string &filename);
+
+  /*
+   * @brief Parse the whole file
+   * @return false if the file cannot be mapped or is not supported,
+   *         nothing has been parsed then
+   */
+  bool process();
+
+ protected:
+  bool parse_data_(char *data, int len) override;
+
+ private:
+  struct FrameJob {
+    std::string pcd_folder;
+    uint64_t idx;
+    bool reflectance;
+    std::vector<char> data;        // the packets of the frame back to back
+    std::vector<uint32_t> offsets;
+  };
+
+  struct Source {
+    FrameJob *frames[kOpenFrameNumber];   // oldest first
+    uint32_t open_frame_number;
+    uint64_t frame_so_far;
+  };
+
+  Source *get_source_(uint32_t saddr);
+  void process_datagram_(uint32_t saddr, const char *udp, size_t len);
+  void add_packet_to_frame_(const InnoDataPacket &pkt);
+  void dispatch_frame_(Source *source);
+  FrameJob *get_free_frame_();
+  void worker_loop_();
+  void write_frame_(FrameJob *frame);
+  void finish_();
+
+ private:
+  uint32_t thread_number_;
+  std::unordered_map<uint32_t, Source *> sources_;
+  uint32_t current_saddr_;
+  Source *current_source_;
+  uint64_t packet_counter_;
+  uint64_t late_packet_counter_;
+  innovusion::PcapReader reader_;
+
+  std::mutex mutex_;
+  std::condition_variable job_cond_;
+  std::condition_variable free_cond_;
+  std::deque<FrameJob *> jobs_;
+  std::vector<FrameJob *> free_frames_;
+  std::vector<std::thread *> threads_;
+  size_t frame_number_;
+  bool shutdown_;
+};
+
+bool ParallelPcapProcessor::is_supported_file(const std::string &filename) {
+  char header[innovusion::PcapReader::kFileHeaderSize];
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  ssize_t r = read(fd, header, sizeof(header));
+  close(fd);
+  if (r != ssize_t(sizeof(header))) {
+    return false;
+  }
+  innovusion::PcapReader reader((innovusion::PcapReader::DatagramCallback()));
+  return reader.set_file_header(header);
+}
+
+bool ParallelPcapProcessor::process() {
+  int fd = open(filename_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    inno_log_error("cannot open %s", filename_.c_str());
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 ||
+      size_t(st.st_size) < innovusion::PcapReader::kFileHeaderSize) {
+    close(fd);
+    return false;
+  }
+  size_t file_size = st.st_size;
+  void *map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    inno_log_error("cannot mmap %s, error: %d", filename_.c_str(), errno);
+    return false;
+  }
+  madvise(map, file_size, MADV_SEQUENTIAL);
+  const char *base = reinterpret_cast<const char *>(map);
+  if (!reader_.set_file_header(base)) {
+    inno_log_error("%s is not a supported pcap file", filename_.c_str());
+    munmap(map, file_size);
+    return false;
+  }
+
+  inno_log_info("start to parse %s with %u threads",
+                filename_.c_str(), thread_number_);
+  for (uint32_t i = 0; i < thread_number_; i++) {
+    std::thread *t = new std::thread(&ParallelPcapProcessor::worker_loop_,
+                                     this);
+    inno_log_verify(t, "thread");
+    threads_.push_back(t);
+  }
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  size_t off = innovusion::PcapReader::kFileHeaderSize;
+  while (off + innovusion::PcapReader::kRecordHeaderSize <= file_size) {
+    uint32_t caplen = reader_.get_caplen(base + off);
+    off += innovusion::PcapReader::kRecordHeaderSize;
+    if (caplen > file_size - off) {
+      inno_log_warning("truncated pcap record at the end of the file");
+      break;
+    }
+    reader_.add_record(base + off, caplen);
+    packet_counter_++;
+    off += caplen;
+  }
+  finish_();
+  // datagrams that never completed
+  partial_sub_frame_counter += reader_.get_dropped_datagram_number();
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  munmap(map, file_size);
+  if (seconds <= 0) {
+    seconds = 1e-9;
+  }
+  inno_log_info("parsed %" PRI_SIZEU " packets, %.1f MB in %.3f s, "
+                "%.0f packets/s, %.1f MB/s, %u threads, "
+                "late_packet_counter = %" PRI_SIZEU
+                ", dropped_datagram_counter = %" PRI_SIZEU,
+                packet_counter_, file_size / 1e6, seconds,
+                packet_counter_ / seconds, file_size / 1e6 / seconds,
+                thread_number_, late_packet_counter_,
+                reader_.get_dropped_datagram_number());
+  return true;
+}
+
+ParallelPcapProcessor::Source *
+ParallelPcapProcessor::get_source_(uint32_t saddr) {
+  std::unordered_map<uint32_t, Source *>::iterator it = sources_.find(saddr);
+  if (it != sources_.end()) {
+    return it->second;
+  }
+  Source *source = new Source();
+  inno_log_verify(source, "source");
+  source->open_frame_number = 0;
+  source->frame_so_far = 0;
+  sources_[saddr] = source;
+  return source;
+}
+
+void ParallelPcapProcessor::process_datagram_(uint32_t saddr,
+                                              const char *udp, size_t len) {
+  if (len < sizeof(struct udphdr)) {
+    return;
+  }
+  uint16_t destport = (uint8_t(udp[2]) << 8) | uint8_t(udp[3]);
+  if (destport != PORT && destport != RAW_PORT) {
+    return;
+  }
+  uint32_t udp_len = (uint8_t(udp[4]) << 8) | uint8_t(udp[5]);
+  if (udp_len >= sizeof(struct udphdr) && udp_len < len) {
+    len = udp_len;
+  }
+  if (set_current_ip_dispatcher(saddr) < 0) {
+    return;
+  }
+  if (saddr != current_saddr_ || !current_source_) {
+    current_source_ = get_source_(saddr);
+    current_saddr_ = saddr;
+  }
+  // the packet is only read, the map is read-only
+  parse_inno_package(destport,
+                     const_cast<char *>(udp) + sizeof(struct udphdr),
+                     len - sizeof(struct udphdr));
+}
+
+bool ParallelPcapProcessor::parse_data_(char *data, int len) {
+  InnoDataPacket *pkt = reinterpret_cast<InnoDataPacket *>(data);
+  data_counter++;
+  // sanity check after relase-2.0.0-rc138
+  if (!InnoDataPacketUtils::check_data_packet(*pkt, 0)) {
+    inno_log_error("check data error pkt->idx = %" PRI_SIZEU ",  "
+                  "miss sub frame due to lost IP segment= %u",
+                  pkt->idx, pkt->sub_idx);
+    error_data_counter++;
+    return false;
+  }
+  summary_package_.summary_data_package(*pkt);
+  if (config_.record_pcd) {
+    add_packet_to_frame_(*pkt);
+  }
+  return true;
+}
+
+void ParallelPcapProcessor::add_packet_to_frame_(const InnoDataPacket &pkt) {
+  Source *source = current_source_;
+  FrameJob *frame = NULL;
+  for (uint32_t i = 0; i < source->open_frame_number; i++) {
+    if (source->frames[i]->idx == pkt.idx) {
+      frame = source->frames[i];
+      break;
+    }
+  }
+  if (!frame) {
+    if (source->open_frame_number > 0 &&
+        pkt.idx < source->frames[0]->idx &&
+        source->frames[0]->idx - pkt.idx <= kOpenFrameNumber) {
+      // its frame has been handed to the workers
+      late_packet_counter_++;
+      return;
+    }
+    if (source->open_frame_number == kOpenFrameNumber) {
+      dispatch_frame_(source);
+    }
+    frame = get_free_frame_();
+    frame->pcd_folder = current_pcd_folder_;
+    frame->idx = pkt.idx;
+    frame->reflectance = pkt.use_reflectance;
+    source->frames[source->open_frame_number++] = frame;
+  }
+  frame->offsets.push_back(frame->data.size());
+  const char *p = reinterpret_cast<const char *>(&pkt);
+  frame->data.insert(frame->data.end(), p, p + pkt.common.size);
+}
+
+void ParallelPcapProcessor::dispatch_frame_(Source *source) {
+  FrameJob *frame = source->frames[0];
+  source->open_frame_number--;
+  for (uint32_t i = 0; i < source->open_frame_number; i++) {
+    source->frames[i] = source->frames[i + 1];
+  }
+  std::unique_lock<std::mutex> lk(mutex_);
+  // we want to skip the first frame, which may be partial
+  if (source->frame_so_far++ == 0) {
+    free_frames_.push_back(frame);
+    return;
+  }
+  jobs_.push_back(frame);
+  job_cond_.notify_one();
+}
+
+ParallelPcapProcessor::FrameJob *ParallelPcapProcessor::get_free_frame_() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  // bounds the memory, the reading thread waits for the workers
+  size_t max_frames = thread_number_ * 2 + sources_.size() * kOpenFrameNumber;
+  while (free_frames_.empty() &&
+         frame_number_ >= max_frames) {
+    free_cond_.wait(lk);
+  }
+  if (!free_frames_.empty()) {
+    FrameJob *frame = free_frames_.back();
+    free_frames_.pop_back();
+    // keeps the capacity
+    frame->data.clear();
+    frame->offsets.clear();
+    return frame;
+  }
+  frame_number_++;
+  FrameJob *frame = new FrameJob();
+  inno_log_verify(frame, "frame");
+  return frame;
+}
+
+void ParallelPcapProcessor::worker_loop_() {
+  while (true) {
+    FrameJob *frame;
+    {
+      std::unique_lock<std::mutex> lk(mutex_);
+      job_cond_.wait(lk, [this] {
+        return !jobs_.empty() || shutdown_;
+      });
+      if (jobs_.empty()) {
+        return;
+      }
+      frame = jobs_.front();
+      jobs_.pop_front();
+    }
+    write_frame_(frame);
+    std::unique_lock<std::mutex> lk(mutex_);
+    free_frames_.push_back(frame);
+    free_cond_.notify_one();
+  }
+}
+
+void ParallelPcapProcessor::write_frame_(FrameJob *frame) {
+  if (frame->offsets.empty()) {
+    return;
+  }
+  const char *data = &frame->data[0];
+  // packets may be captured out of order
+  std::stable_sort(frame->offsets.begin(), frame->offsets.end(),
+                   [data](uint32_t a, uint32_t b) {
+                     return reinterpret_cast<const InnoDataPacket *>(
+                         data + a)->sub_idx <
+                         reinterpret_cast<const InnoDataPacket *>(
+                         data + b)->sub_idx;
+                   });
+  const InnoDataPacket *first =
+      reinterpret_cast<const InnoDataPacket *>(data + frame->offsets[0]);
+  PcdRecorder *recorder = new PcdRecorder(frame->pcd_folder, frame->idx,
+                                          get_packet_timestamp_sec_(*first),
+                                          frame->reflectance);
+  inno_log_verify(recorder != NULL, "cannot create pcd recorder");
+  for (size_t i = 0; i < frame->offsets.size(); i++) {
+    add_packet_points_(*reinterpret_cast<const InnoDataPacket *>(
+        data + frame->offsets[i]), recorder);
+  }
+  delete recorder;
+}
+
+void ParallelPcapProcessor::finish_() {
+  if (threads_.empty()) {
+    return;
+  }
+  for (auto &item : sources_) {
+    while (item.second->open_frame_number) {
+      dispatch_frame_(item.second);
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    shutdown_ = true;
+  }
+  job_cond_.notify_all();
+  for (size_t i = 0; i < threads_.size(); i++) {
+    threads_[i]->join();
+    delete threads_[i];
+  }
+  threads_.clear();
+}
+
+
 /***********************
  * class DatProcessor
  ***********************/
@@ -1226,7 +1607,9 @@ void usage(const char *arg0) {
           "[-i <input pcap file>] "
           "[-o <output folder>]"
           "[--debug <log_level>]"
-          "[--record-pcd <0 no record, default 1 record>]\n", arg0);
+          "[--record-pcd <0 no record, default 1 record>]"
+          "[--threads <number of pcd threads, 0 to parse with libpcap, "
+          "default is the number of cpus>]\n", arg0);
   return;
 }
 
@@ -1243,6 +1626,10 @@ int main(int argc, char **argv) {
   ParseConfig config;
   enum InnoLogLevel debug_level = INNO_LOG_LEVEL_INFO;
   config.record_pcd = 1;
+  config.thread_number = std::thread::hardware_concurrency();
+  if (config.thread_number <= 0) {
+    config.thread_number = 1;
+  }
 
   /***********************
    * parse command line
@@ -1256,10 +1643,11 @@ int main(int argc, char **argv) {
     {"output-fold", required_argument, 0, 'o'},
     {"debug", required_argument, 0, 'd'},
     {"record-pcd", required_argument, 0, 'r'},
+    {"threads", required_argument, 0, 't'},
     {"help", no_argument, NULL, 'h'},
     {0, 0, 0, 0},
   };
-  const char *optstring = "i:o:h:d:r";
+  const char *optstring = "i:o:h:d:r:t:";
   while (1) {
     int option_index = 0;
     c = getopt_long(argc, argv, optstring, long_options, &option_index);
@@ -1292,6 +1680,10 @@ int main(int argc, char **argv) {
         config.record_pcd = atoi(optarg);
         break;
 
+      case 't':
+        config.thread_number = atoi(optarg);
+        break;
+
       case 'i':
         filename = optarg;
         break;
@@ -1329,6 +1721,10 @@ int main(int argc, char **argv) {
   if (pos != filename.npos) {
     DatProcessor processor(filename, output_foldername, config);
     handler_dat_(filename, &processor);
+  } else if (config.thread_number > 0 &&
+             ParallelPcapProcessor::is_supported_file(filename)) {
+    ParallelPcapProcessor processor(filename, output_foldername, config);
+    processor.process();
   } else {
     /***********************
      * create PcapProcessor object
@@ -5,21 +5,34 @@
  *
  *  $Id$
  */
+#include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 #include "sdk_common/converter/cframe_legacy.h"
 #include "sdk_common/inno_lidar_api.h"
 #include "sdk_common/inno_lidar_packet_utils.h"
 #include "utils/inno_lidar_log.h"
+#include "parse/pcap_reader.h"
 #include "pybind11/pybind11.h"
 #include "pybind11/eigen.h"
+#include "pybind11/stl.h"
+
+namespace py = pybind11;
 
 
 static const double kUsInSecond = 1000000.0;
@@ -297,6 +310,491 @@ void summary_print() {
 }
 
 
+/***********************
+ * FrameReader
+ *
+ * The whole inno_pc or pcap file is parsed on a C++ thread, python
+ * only waits (with the GIL released) for full frames. A frame is
+ * handed over as a FrameArray: packed float32 records in a buffer
+ * owned by C++ and exported through the buffer protocol, so
+ * np.asarray(frame) is a structured array that does not copy.
+ ***********************/
+enum FrameColumn {
+  FRAME_COLUMN_X = 0,
+  FRAME_COLUMN_Y,
+  FRAME_COLUMN_Z,
+  FRAME_COLUMN_INTENSITY,
+  FRAME_COLUMN_TIMESTAMP,    /* seconds since ts_start_us of the frame */
+  FRAME_COLUMN_SCAN_ID,
+  FRAME_COLUMN_SCAN_IDX,
+  FRAME_COLUMN_CHANNEL,
+  FRAME_COLUMN_ROI,
+  FRAME_COLUMN_FACET,
+  FRAME_COLUMN_IS_2ND_RETURN,
+  FRAME_COLUMN_ELONGATION,
+  FRAME_COLUMN_MAX,
+};
+
+static const char *kFrameColumnNames[FRAME_COLUMN_MAX] = {
+  "x", "y", "z", "intensity", "timestamp", "scan_id", "scan_idx",
+  "channel", "roi", "facet", "is_2nd_return", "elongation",
+};
+
+/*
+ * selected columns and the PEP 3118 format of one record,
+ * shared by the reader and all its frames
+ */
+struct FrameLayout {
+  std::vector<uint32_t> columns;
+  std::vector<std::string> names;
+  std::string format;
+};
+
+class FrameArray {
+ public:
+  FrameArray(uint64_t idx, InnoTimestampUs ts_start_us,
+             const std::shared_ptr<const FrameLayout> &layout)
+      : idx_(idx)
+      , ts_start_us_(ts_start_us)
+      , layout_(layout) {
+  }
+
+  inline std::vector<float> *get_data() {
+    return &data_;
+  }
+  inline size_t get_point_number() const {
+    return data_.size() / layout_->columns.size();
+  }
+  inline uint64_t get_idx() const {
+    return idx_;
+  }
+  inline InnoTimestampUs get_ts_start_us() const {
+    return ts_start_us_;
+  }
+  inline const FrameLayout &get_layout() const {
+    return *layout_;
+  }
+
+  py::buffer_info get_buffer_info() {
+    size_t record_size = sizeof(float) * layout_->columns.size();
+    return py::buffer_info(data_.empty() ? NULL : &data_[0],
+                           record_size, layout_->format, 1,
+                           {get_point_number()}, {record_size});
+  }
+
+ private:
+  std::vector<float> data_;
+  uint64_t idx_;
+  InnoTimestampUs ts_start_us_;
+  std::shared_ptr<const FrameLayout> layout_;
+};
+
+class FrameReader {
+ private:
+  static const size_t kReadBufferSize = 4 * 1024 * 1024;
+  static const size_t kMaxInnoPacketSize = 1024 * 1024;
+
+ public:
+  FrameReader(const std::string &filename,
+              const std::vector<std::string> &columns,
+              uint16_t port, uint32_t max_queue_frames,
+              bool skip_first_frame)
+      : fd_(-1)
+      , port_(port)
+      , max_queue_frames_(max_queue_frames ? max_queue_frames : 1)
+      , skip_first_frame_(skip_first_frame)
+      , pcap_reader_([this](uint32_t saddr, const char *udp, size_t len) {
+          add_udp_packet_(udp, len);
+        })
+      , buffer_pos_(0)
+      , buffer_end_(0)
+      , current_frame_(NULL)
+      , frame_so_far_(0)
+      , last_frame_idx_(0)
+      , last_frame_size_(0)
+      , done_(false)
+      , stop_(false)
+      , thread_(NULL) {
+    std::shared_ptr<FrameLayout> layout(new FrameLayout());
+    layout->format = "T{";
+    for (size_t i = 0; i < columns.size(); i++) {
+      uint32_t c = 0;
+      while (c < FRAME_COLUMN_MAX &&
+             columns[i] != kFrameColumnNames[c]) {
+        c++;
+      }
+      if (c == FRAME_COLUMN_MAX) {
+        throw py::value_error("unknown column " + columns[i]);
+      }
+      layout->columns.push_back(c);
+      layout->names.push_back(columns[i]);
+      layout->format += std::string("f:") + kFrameColumnNames[c] + ":";
+    }
+    if (layout->columns.empty()) {
+      throw py::value_error("no column selected");
+    }
+    layout->format += "}";
+    layout_ = layout;
+
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      throw std::runtime_error("cannot open " + filename + ": " +
+                               strerror(errno));
+    }
+    buffer_.resize(kReadBufferSize);
+    thread_ = new std::thread(&FrameReader::read_loop_, this);
+    inno_log_verify(thread_, "thread_");
+  }
+
+  ~FrameReader() {
+    close();
+  }
+
+  void close() {
+    {
+      std::unique_lock<std::mutex> lk(mutex_);
+      stop_ = true;
+    }
+    not_full_cond_.notify_all();
+    not_empty_cond_.notify_all();
+    if (thread_) {
+      thread_->join();
+      delete thread_;
+      thread_ = NULL;
+    }
+    while (!queue_.empty()) {
+      delete queue_.front();
+      queue_.pop_front();
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  /*
+   * @brief Wait for the next frame, the GIL is released while waiting
+   * @return the frame, owned by the caller, NULL after the last one
+   */
+  FrameArray *next() {
+    FrameArray *frame = NULL;
+    {
+      py::gil_scoped_release release;
+      std::unique_lock<std::mutex> lk(mutex_);
+      not_empty_cond_.wait(lk, [this] {
+        return !queue_.empty() || done_ || stop_;
+      });
+      if (!queue_.empty()) {
+        frame = queue_.front();
+        queue_.pop_front();
+        not_full_cond_.notify_one();
+      }
+    }
+    return frame;
+  }
+
+  inline const FrameLayout &get_layout() const {
+    return *layout_;
+  }
+
+  py::dict get_stats() const {
+    py::dict d;
+    d["bytes"] = uint64_t(bytes_);
+    d["packets"] = uint64_t(packets_);
+    d["data_packets"] = uint64_t(data_packets_);
+    d["status_packets"] = uint64_t(status_packets_);
+    d["message_packets"] = uint64_t(message_packets_);
+    d["bad_packets"] = uint64_t(bad_packets_);
+    d["frames"] = uint64_t(frames_);
+    d["missed_frames"] = uint64_t(missed_frames_);
+    d["dropped_ip_packets"] = uint64_t(dropped_ip_packets_);
+    return d;
+  }
+
+ private:
+  /*
+   * @brief Make n bytes of the file readable at the returned pointer,
+   *        valid until the next call
+   * @return NULL at the end of the file
+   */
+  const char *peek_(size_t n) {
+    if (buffer_end_ - buffer_pos_ < n) {
+      memmove(&buffer_[0], &buffer_[buffer_pos_], buffer_end_ - buffer_pos_);
+      buffer_end_ -= buffer_pos_;
+      buffer_pos_ = 0;
+      if (buffer_.size() < n) {
+        buffer_.resize(n);
+      }
+      while (buffer_end_ < n) {
+        ssize_t r = read(fd_, &buffer_[buffer_end_],
+                         buffer_.size() - buffer_end_);
+        if (r < 0 && errno == EINTR) {
+          continue;
+        }
+        if (r <= 0) {
+          if (r < 0) {
+            inno_log_error("read error %d", errno);
+          }
+          return NULL;
+        }
+        buffer_end_ += r;
+        bytes_ += r;
+      }
+    }
+    return &buffer_[buffer_pos_];
+  }
+
+  inline const char *read_(size_t n) {
+    const char *p = peek_(n);
+    if (p) {
+      buffer_pos_ += n;
+    }
+    return p;
+  }
+
+  static inline uint16_t be16_(const char *p) {
+    const uint8_t *u = reinterpret_cast<const uint8_t *>(p);
+    return (u[0] << 8) | u[1];
+  }
+
+  void read_loop_() {
+    const char *p = peek_(sizeof(uint32_t));
+    if (p) {
+      if (innovusion::PcapReader::is_pcap_magic(p)) {
+        read_pcap_();
+      } else {
+        read_inno_pc_();
+      }
+    }
+    finish_frame_();
+    std::unique_lock<std::mutex> lk(mutex_);
+    done_ = true;
+    not_empty_cond_.notify_all();
+  }
+
+  void read_inno_pc_() {
+    while (!stop_) {
+      const char *p = peek_(sizeof(InnoCommonHeader));
+      if (!p) {
+        break;
+      }
+      const InnoCommonHeader *header =
+          reinterpret_cast<const InnoCommonHeader *>(p);
+      size_t size = header->size;
+      if ((header->version.magic_number != kInnoMagicNumberDataPacket &&
+           header->version.magic_number != kInnoMagicNumberStatusPacket) ||
+          size < sizeof(InnoCommonHeader) || size > kMaxInnoPacketSize) {
+        inno_log_error("bad packet at %" PRI_SIZEU ", size %" PRI_SIZEU,
+                       uint64_t(bytes_) - (buffer_end_ - buffer_pos_), size);
+        bad_packets_++;
+        break;
+      }
+      p = read_(size);
+      if (!p) {
+        inno_log_warning("truncated packet at the end of the file");
+        break;
+      }
+      add_inno_packet_(p, size);
+    }
+  }
+
+  void read_pcap_() {
+    const char *p = read_(innovusion::PcapReader::kFileHeaderSize);
+    if (!p) {
+      return;
+    }
+    if (!pcap_reader_.set_file_header(p)) {
+      inno_log_error("unsupported pcap link type %u",
+                     pcap_reader_.get_link_type());
+      return;
+    }
+    while (!stop_) {
+      p = read_(innovusion::PcapReader::kRecordHeaderSize);
+      if (!p) {
+        break;
+      }
+      uint32_t caplen = pcap_reader_.get_caplen(p);
+      p = read_(caplen);
+      if (!p) {
+        inno_log_warning("truncated pcap record at the end of the file");
+        break;
+      }
+      pcap_reader_.add_record(p, caplen);
+      dropped_ip_packets_ = pcap_reader_.get_dropped_datagram_number();
+    }
+  }
+
+  void add_udp_packet_(const char *p, size_t len) {
+    if (len < 8) {
+      return;
+    }
+    if (port_ && be16_(p + 2) != port_) {
+      return;
+    }
+    size_t udp_len = be16_(p + 4);
+    if (udp_len >= 8 && udp_len < len) {
+      len = udp_len;
+    }
+    add_inno_packet_(p + 8, len - 8);
+  }
+
+  void add_inno_packet_(const char *p, size_t len) {
+    packets_++;
+    if (len < sizeof(InnoCommonHeader)) {
+      bad_packets_++;
+      return;
+    }
+    const InnoCommonHeader *header =
+        reinterpret_cast<const InnoCommonHeader *>(p);
+    if (header->version.magic_number == kInnoMagicNumberStatusPacket) {
+      status_packets_++;
+      return;
+    }
+    const InnoDataPacket *pkt = reinterpret_cast<const InnoDataPacket *>(p);
+    if (header->version.magic_number != kInnoMagicNumberDataPacket ||
+        len < sizeof(InnoDataPacket) ||
+        !InnoDataPacketUtils::check_data_packet(*pkt, len)) {
+      bad_packets_++;
+      return;
+    }
+    if (pkt->type == INNO_ITEM_TYPE_SPHERE_POINTCLOUD ||
+        pkt->type == INNO_ITEM_TYPE_XYZ_POINTCLOUD) {
+      data_packets_++;
+      add_data_packet_(*pkt);
+    } else {
+      message_packets_++;
+    }
+  }
+
+  void add_data_packet_(const InnoDataPacket &pkt) {
+    if (!current_frame_ || current_frame_->get_idx() != pkt.idx) {
+      if (current_frame_ && pkt.idx > last_frame_idx_ + 1) {
+        missed_frames_ += pkt.idx - last_frame_idx_ - 1;
+      }
+      finish_frame_();
+      current_frame_ = new FrameArray(pkt.idx, pkt.common.ts_start_us,
+                                      layout_);
+      inno_log_verify(current_frame_, "current_frame_");
+      current_frame_->get_data()->reserve(last_frame_size_);
+      last_frame_idx_ = pkt.idx;
+    }
+
+    const InnoDataPacket *xyz = &pkt;
+    if (pkt.type == INNO_ITEM_TYPE_SPHERE_POINTCLOUD) {
+      size_t size = InnoDataPacketUtils::get_data_packet_size(
+          INNO_ITEM_TYPE_XYZ_POINTCLOUD,
+          InnoDataPacketUtils::get_max_points_count(pkt),
+          INNO_MULTIPLE_RETURN_MODE_NONE);
+      if (convert_buffer_.size() < size) {
+        convert_buffer_.resize(size);
+      }
+      InnoDataPacket *dest =
+          reinterpret_cast<InnoDataPacket *>(&convert_buffer_[0]);
+      if (!InnoDataPacketUtils::convert_to_xyz_pointcloud(pkt, dest,
+                                                          size, false)) {
+        bad_packets_++;
+        return;
+      }
+      xyz = dest;
+    }
+
+    const std::vector<uint32_t> &columns = layout_->columns;
+    size_t column_number = columns.size();
+    std::vector<float> *data = current_frame_->get_data();
+    size_t base = data->size();
+    data->resize(base + xyz->item_number * column_number);
+    float *dst = &(*data)[0] + base;
+    double offset_s = (xyz->common.ts_start_us -
+                       current_frame_->get_ts_start_us()) / kUsInSecond;
+    float v[FRAME_COLUMN_MAX];
+    for (uint32_t i = 0; i < xyz->item_number; i++) {
+      const InnoXyzPoint &pt = xyz->xyz_points[i];
+      v[FRAME_COLUMN_X] = pt.x;
+      v[FRAME_COLUMN_Y] = pt.y;
+      v[FRAME_COLUMN_Z] = pt.z;
+      v[FRAME_COLUMN_INTENSITY] = pt.refl;
+      v[FRAME_COLUMN_TIMESTAMP] = offset_s + pt.ts_10us / k10UsInSecond;
+      v[FRAME_COLUMN_SCAN_ID] = pt.scan_id;
+      v[FRAME_COLUMN_SCAN_IDX] = pt.scan_idx;
+      v[FRAME_COLUMN_CHANNEL] = pt.channel;
+      v[FRAME_COLUMN_ROI] = pt.in_roi;
+      v[FRAME_COLUMN_FACET] = pt.facet;
+      v[FRAME_COLUMN_IS_2ND_RETURN] = pt.is_2nd_return;
+      v[FRAME_COLUMN_ELONGATION] = pt.elongation;
+      for (size_t c = 0; c < column_number; c++) {
+        *dst++ = v[columns[c]];
+      }
+    }
+  }
+
+  void finish_frame_() {
+    FrameArray *frame = current_frame_;
+    current_frame_ = NULL;
+    if (!frame) {
+      return;
+    }
+    last_frame_size_ = frame->get_data()->size();
+    // the first frame may be partial
+    if (frame_so_far_++ == 0 && skip_first_frame_) {
+      delete frame;
+      return;
+    }
+    std::unique_lock<std::mutex> lk(mutex_);
+    not_full_cond_.wait(lk, [this] {
+      return queue_.size() < max_queue_frames_ || stop_;
+    });
+    if (stop_) {
+      delete frame;
+      return;
+    }
+    queue_.push_back(frame);
+    frames_++;
+    not_empty_cond_.notify_one();
+  }
+
+ private:
+  std::shared_ptr<const FrameLayout> layout_;
+  int fd_;
+  uint16_t port_;
+  uint32_t max_queue_frames_;
+  bool skip_first_frame_;
+
+  // only used by the read thread
+  innovusion::PcapReader pcap_reader_;
+  std::vector<char> buffer_;
+  size_t buffer_pos_;
+  size_t buffer_end_;
+  std::vector<char> convert_buffer_;
+  FrameArray *current_frame_;
+  uint64_t frame_so_far_;
+  uint64_t last_frame_idx_;
+  size_t last_frame_size_;
+
+  std::mutex mutex_;
+  std::condition_variable not_full_cond_;
+  std::condition_variable not_empty_cond_;
+  std::deque<FrameArray *> queue_;
+  bool done_;
+  std::atomic<bool> stop_;
+  std::thread *thread_;
+
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<uint64_t> packets_{0};
+  std::atomic<uint64_t> data_packets_{0};
+  std::atomic<uint64_t> status_packets_{0};
+  std::atomic<uint64_t> message_packets_{0};
+  std::atomic<uint64_t> bad_packets_{0};
+  std::atomic<uint64_t> frames_{0};
+  std::atomic<uint64_t> missed_frames_{0};
+  std::atomic<uint64_t> dropped_ip_packets_{0};
+};
+
+static std::vector<std::string> frame_columns() {
+  return std::vector<std::string>(kFrameColumnNames,
+                                  kFrameColumnNames + FRAME_COLUMN_MAX);
+}
+
+
 PYBIND11_MODULE(inno_falcon_b_parse, m) {
   m.def("init", &init);
   m.def("parse_inno_package", &parse_inno_package);
@@ -308,4 +806,41 @@ PYBIND11_MODULE(inno_falcon_b_parse, m) {
                  { return current_status.idx; });
   m.def("in_faults", []() { return current_status.in_faults.faults; });
   m.def("ex_faults", []() { return current_status.ex_faults.faults; });
+
+  py::class_<FrameArray>(m, "FrameArray", py::buffer_protocol())
+      .def_buffer(&FrameArray::get_buffer_info)
+      .def("__len__", &FrameArray::get_point_number)
+      .def_property_readonly("idx", &FrameArray::get_idx)
+      .def_property_readonly("ts_start_us", &FrameArray::get_ts_start_us)
+      .def_property_readonly("columns", [](const FrameArray &f) {
+        return f.get_layout().names;
+      });
+  py::class_<FrameReader>(m, "FrameReader")
+      .def(py::init([](const std::string &filename, py::object columns,
+                       uint16_t port, uint32_t max_queue_frames,
+                       bool skip_first_frame) {
+             return new FrameReader(
+                 filename,
+                 columns.is_none() ? frame_columns() :
+                 columns.cast<std::vector<std::string> >(),
+                 port, max_queue_frames, skip_first_frame);
+           }),
+           py::arg("filename"), py::arg("columns") = py::none(),
+           py::arg("port") = 8010, py::arg("max_queue_frames") = 4,
+           py::arg("skip_first_frame") = true)
+      .def("__iter__", [](FrameReader &r) -> FrameReader & { return r; },
+           py::return_value_policy::reference_internal)
+      .def("__next__", [](FrameReader &r) {
+             FrameArray *frame = r.next();
+             if (!frame) {
+               throw py::stop_iteration();
+             }
+             return frame;
+           }, py::return_value_policy::take_ownership)
+      .def_property_readonly("columns", [](const FrameReader &r) {
+        return r.get_layout().names;
+      })
+      .def("stats", &FrameReader::get_stats)
+      .def("close", &FrameReader::close);
+  m.def("frame_columns", &frame_columns);
 }
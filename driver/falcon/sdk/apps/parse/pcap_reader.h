@@ -0,0 +1,319 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+#ifndef PARSE_PCAP_READER_H_
+#define PARSE_PCAP_READER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <vector>
+
+namespace innovusion {
+
+/***********************
+ * class PcapReader
+ *
+ * Decodes the records of a classic pcap file down to the udp datagrams,
+ * the caller reads the file and hands over one record at a time.
+ * Datagrams that are not fragmented are passed on in place, IPv4
+ * fragments are copied into a fixed pool of reassembly slots and the
+ * datagram is passed on once every 8 byte unit of it is received, a
+ * duplicated or overlapping fragment does not count twice. Both parse_pcap and the python
+ * FrameReader use it.
+ ***********************/
+class PcapReader {
+ public:
+  static const uint32_t kPcapMagic = 0xa1b2c3d4;
+  static const uint32_t kPcapMagicNs = 0xa1b23c4d;
+  static const size_t kFileHeaderSize = 24;
+  static const size_t kRecordHeaderSize = 16;
+  static const uint32_t kMaxIpDatagramSize = 65536;
+  static const uint32_t kReassemblySlotNumber = 16;
+  // fragment offsets are in 8 bytes
+  static const uint32_t kFragmentUnitSize = 8;
+  static const uint32_t kUnitMapSize = kMaxIpDatagramSize /
+                                       kFragmentUnitSize / 64;
+  enum LinkType {
+    LINK_TYPE_NULL = 0,
+    LINK_TYPE_ETHERNET = 1,
+    LINK_TYPE_RAW = 101,
+    LINK_TYPE_LINUX_SLL = 113,
+    LINK_TYPE_IPV4 = 228,
+    LINK_TYPE_LINUX_SLL2 = 276,
+  };
+  /*
+   * saddr is in network order, udp points to the udp header and is only
+   * valid during the call
+   */
+  typedef std::function<void(uint32_t saddr, const char *udp, size_t len)>
+      DatagramCallback;
+
+ private:
+  // one ip datagram being reassembled, fragments are copied at their offset
+  struct Reassembly {
+    char *buffer;
+    uint64_t *unit_map;            // a bit for each received unit
+    bool in_use;
+    uint32_t saddr;
+    uint32_t daddr;
+    uint16_t ip_id;
+    uint32_t received_units;
+    uint32_t total;                // 0 until the last fragment is seen
+    uint64_t seq;
+  };
+
+ public:
+  explicit PcapReader(const DatagramCallback &callback)
+      : callback_(callback)
+      , swapped_(false)
+      , link_type_(LINK_TYPE_ETHERNET)
+      , fragment_seq_(0)
+      , dropped_datagram_number_(0) {
+    for (uint32_t i = 0; i < kReassemblySlotNumber; i++) {
+      slots_[i].buffer = NULL;
+      slots_[i].unit_map = NULL;
+      slots_[i].in_use = false;
+    }
+  }
+
+  /*
+   * @brief Check the magic of a file, p has at least 4 bytes
+   * @return true for a classic pcap file of either byte order
+   */
+  static bool is_pcap_magic(const char *p) {
+    uint32_t magic;
+    memcpy(&magic, p, sizeof(magic));
+    return magic == kPcapMagic || magic == kPcapMagicNs ||
+           __builtin_bswap32(magic) == kPcapMagic ||
+           __builtin_bswap32(magic) == kPcapMagicNs;
+  }
+
+  static bool is_supported_link_type(uint32_t link_type) {
+    return link_type == LINK_TYPE_NULL || link_type == LINK_TYPE_ETHERNET ||
+           link_type == LINK_TYPE_RAW || link_type == LINK_TYPE_LINUX_SLL ||
+           link_type == LINK_TYPE_IPV4 || link_type == LINK_TYPE_LINUX_SLL2;
+  }
+
+  /*
+   * @brief Parse the kFileHeaderSize bytes of the file header
+   * @return false if it is not a pcap file or the link type is not
+   *         supported
+   */
+  bool set_file_header(const char *p) {
+    if (!is_pcap_magic(p)) {
+      return false;
+    }
+    uint32_t magic;
+    memcpy(&magic, p, sizeof(magic));
+    swapped_ = magic != kPcapMagic && magic != kPcapMagicNs;
+    link_type_ = get32_(p + 20);
+    return is_supported_link_type(link_type_);
+  }
+
+  /*
+   * @brief The captured length of a record, p points to the
+   *        kRecordHeaderSize bytes of its header
+   */
+  inline uint32_t get_caplen(const char *p) const {
+    return get32_(p + 8);
+  }
+
+  inline uint32_t get_link_type() const {
+    return link_type_;
+  }
+
+  inline uint64_t get_dropped_datagram_number() const {
+    return dropped_datagram_number_;
+  }
+
+  /*
+   * @brief Decode one record, the callback is called for each complete
+   *        udp datagram
+   */
+  void add_record(const char *p, size_t len) {
+    size_t off = 0;
+    uint16_t ether_type = 0x0800;
+    switch (link_type_) {
+      case LINK_TYPE_NULL: {
+        uint32_t family;
+        if (len < 4) {
+          return;
+        }
+        memcpy(&family, p, sizeof(family));
+        if (family != 2 && __builtin_bswap32(family) != 2) {
+          return;
+        }
+        off = 4;
+        break;
+      }
+      case LINK_TYPE_ETHERNET:
+        if (len < 14) {
+          return;
+        }
+        ether_type = be16_(p + 12);
+        off = 14;
+        // vlan tags
+        while ((ether_type == 0x8100 || ether_type == 0x88a8) &&
+               len >= off + 4) {
+          ether_type = be16_(p + off + 2);
+          off += 4;
+        }
+        break;
+      case LINK_TYPE_LINUX_SLL:
+        if (len < 16) {
+          return;
+        }
+        ether_type = be16_(p + 14);
+        off = 16;
+        break;
+      case LINK_TYPE_LINUX_SLL2:
+        if (len < 20) {
+          return;
+        }
+        ether_type = be16_(p);
+        off = 20;
+        break;
+      default:
+        break;
+    }
+    if (ether_type == 0x0800) {
+      add_ip_packet_(p + off, len - off);
+    }
+  }
+
+ private:
+  static inline uint16_t be16_(const char *p) {
+    const uint8_t *u = reinterpret_cast<const uint8_t *>(p);
+    return (u[0] << 8) | u[1];
+  }
+
+  inline uint32_t get32_(const char *p) const {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped_ ? __builtin_bswap32(v) : v;
+  }
+
+  void add_ip_packet_(const char *p, size_t len) {
+    if (len < 20 || (p[0] & 0xf0) != 0x40 || p[9] != 17) {
+      return;
+    }
+    size_t header_len = (p[0] & 0x0f) * 4;
+    size_t total_len = be16_(p + 2);
+    if (total_len < len) {
+      // ethernet padding
+      len = total_len;
+    }
+    if (header_len < 20 || len < header_len) {
+      return;
+    }
+    uint16_t frag = be16_(p + 6);
+    bool more_fragments = frag & 0x2000;
+    uint32_t offset = (frag & 0x1fff) * 8;
+    uint32_t saddr;
+    uint32_t daddr;
+    memcpy(&saddr, p + 12, sizeof(saddr));
+    memcpy(&daddr, p + 16, sizeof(daddr));
+    const char *payload = p + header_len;
+    size_t payload_len = len - header_len;
+    if (!more_fragments && offset == 0) {
+      // not fragmented, passed on in place
+      callback_(saddr, payload, payload_len);
+    } else {
+      add_fragment_(saddr, daddr, be16_(p + 4), offset, more_fragments,
+                    payload, payload_len);
+    }
+  }
+
+  void add_fragment_(uint32_t saddr, uint32_t daddr, uint16_t ip_id,
+                     uint32_t offset, bool more_fragments,
+                     const char *p, size_t len) {
+    if (offset + len > kMaxIpDatagramSize) {
+      dropped_datagram_number_++;
+      return;
+    }
+    Reassembly *slot = NULL;
+    Reassembly *free_slot = NULL;
+    Reassembly *oldest = NULL;
+    for (uint32_t i = 0; i < kReassemblySlotNumber; i++) {
+      Reassembly *s = &slots_[i];
+      if (!s->in_use) {
+        free_slot = s;
+      } else if (s->ip_id == ip_id && s->saddr == saddr &&
+                 s->daddr == daddr) {
+        slot = s;
+        break;
+      } else if (!oldest || s->seq < oldest->seq) {
+        oldest = s;
+      }
+    }
+    if (!slot) {
+      slot = free_slot;
+      if (!slot) {
+        // a datagram that never completed
+        dropped_datagram_number_++;
+        slot = oldest;
+      }
+      if (slot_buffer_.empty()) {
+        // only allocated once a fragment is seen
+        slot_buffer_.resize(kReassemblySlotNumber * kMaxIpDatagramSize);
+        unit_map_.resize(kReassemblySlotNumber * kUnitMapSize);
+        for (uint32_t i = 0; i < kReassemblySlotNumber; i++) {
+          slots_[i].buffer = &slot_buffer_[i * kMaxIpDatagramSize];
+          slots_[i].unit_map = &unit_map_[i * kUnitMapSize];
+        }
+      }
+      slot->in_use = true;
+      slot->saddr = saddr;
+      slot->daddr = daddr;
+      slot->ip_id = ip_id;
+      slot->received_units = 0;
+      slot->total = 0;
+      slot->seq = fragment_seq_++;
+      memset(slot->unit_map, 0, kUnitMapSize * sizeof(uint64_t));
+    }
+    if (slot->total && offset + len > slot->total) {
+      // past the end given by the last fragment
+      return;
+    }
+    memcpy(slot->buffer + offset, p, len);
+    // offset is a multiple of the unit, only the last fragment may end
+    // in the middle of one
+    uint32_t unit_end = (offset + len + kFragmentUnitSize - 1) /
+                        kFragmentUnitSize;
+    for (uint32_t u = offset / kFragmentUnitSize; u < unit_end; u++) {
+      uint64_t bit = 1ULL << (u % 64);
+      if (!(slot->unit_map[u / 64] & bit)) {
+        slot->unit_map[u / 64] |= bit;
+        slot->received_units++;
+      }
+    }
+    if (!more_fragments) {
+      slot->total = offset + len;
+    }
+    if (slot->total && slot->received_units ==
+        (slot->total + kFragmentUnitSize - 1) / kFragmentUnitSize) {
+      slot->in_use = false;
+      callback_(saddr, slot->buffer, slot->total);
+    }
+  }
+
+ private:
+  DatagramCallback callback_;
+  bool swapped_;
+  uint32_t link_type_;
+  Reassembly slots_[kReassemblySlotNumber];
+  std::vector<char> slot_buffer_;
+  std::vector<uint64_t> unit_map_;
+  uint64_t fragment_seq_;
+  uint64_t dropped_datagram_number_;
+};
+
+}  // namespace innovusion
+
+#endif  // PARSE_PCAP_READER_H_
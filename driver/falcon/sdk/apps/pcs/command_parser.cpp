@@ -84,6 +84,9 @@ CommandParser::CommandParser(int argc, char *argv[])
   udp_port_message = kDefaultUdpPort_;
   tcp_port = kDefaultServerTcpPort_;
   tcp_port_is_default_ = true;
+  udp_batch_size = 0;
+  udp_batch_interval_us = 1000;
+  udp_gso = 0;
 
   status_interval_ms = 50;
   record_inno_pc_size_in_m = 0;
@@ -98,6 +101,8 @@ CommandParser::CommandParser(int argc, char *argv[])
   error_log_file_max_size_k = 1000;
 
   rosbag_size_in_m = 0;
+  record_columnar_size_in_m = 0;
+  shm_ring = 0;
 
   get_version = false;
   show_viewer = 0;
@@ -138,7 +143,11 @@ void CommandParser::usage_() {
           "\t  [--udp-port-message <MESSAGE_UDP_DEST_PORT>]]\n"
           "\t  [--udp-port-raw <RAW_UDP_DEST_PORT>]]\n"
           "\t[--udp-port-status-local <LOCAL_STATUS_UDP_DEST_PORT>]\n"
+          "\t[--udp-batch-size <PACKETS_PER_BATCH> "
+          "[--udp-batch-interval-us <MAX_DELAY_IN_US>] [--udp-gso]]\n"
           "\t[--tcp-port <TCP_LISTEN_PORT>]\n"
+          "\t[--ws-send-queue <MAX_QUEUED_MESSAGES>[,oldest|frame|none]]\n"
+          "\t[--shm-ring]\n"
           "\t[--status-interval-ms <INTERVAL_IN_MS>]\n"
           "\t[--record-inno-pc-filename <RECORD_INNO_PC_FILE>\n"
           "\t  [--record-inno-pc-size-in-m <RECORD_INNO_PC_FILE_SIZE>]\n"
@@ -146,6 +155,8 @@ void CommandParser::usage_() {
           "\t[--record-png-filename <RECORD_PNG_FILE>\n"
           "\t[--record-rosbag-filename <RECORD_ROSBAG_FILE>\n"
           "\t  [--record-rosbag-size-in-m <RECORD_ROSBAG_SIZE>]]\n"
+          "\t[--record-columnar-filename <RECORD_COLUMNAR_FILE>\n"
+          "\t  [--record-columnar-size-in-m <RECORD_COLUMNAR_SIZE>]]\n"
           "\t[--record-raw-filename <RECORD_RAW_FILE>\n"
           "\t  [--record-raw-size-in-m <RECORD_RAW_FILE_SIZE>]]\n"
           "\t[--config <CONFIG_FILE>]\n"
@@ -198,6 +209,11 @@ void CommandParser::parse_parameter_(int argc, char *argv[]) {
     {"udp-port-raw", required_argument, 0, 'k'},
     {"udp-port-status-local", required_argument, 0, 'l'},
     {"tcp-port", required_argument, 0, 'p'},
+    {"udp-batch-size", required_argument, 0, OPT_UDP_BATCH_SIZE},
+    {"udp-batch-interval-us", required_argument, 0,
+     OPT_UDP_BATCH_INTERVAL_US},
+    {"udp-gso", no_argument, &udp_gso, 1},
+    {"ws-send-queue", required_argument, 0, OPT_WS_SEND_QUEUE},
     {"status-interval-ms", required_argument, 0, 'I'},
     {"record-inno-pc-filename", required_argument, 0, 'o'},
     {"record-inno-pc-size-in-m", required_argument, 0, 'm'},
@@ -205,7 +221,12 @@ void CommandParser::parse_parameter_(int argc, char *argv[]) {
     {"record-png-filename", required_argument, 0, 't'},
     {"record-rosbag-filename", required_argument, 0, 'b'},
     {"record-rosbag-size-in-m", required_argument, 0, 'B'},
+    {"record-columnar-filename", required_argument, 0,
+     OPT_RECORD_COLUMNAR_FILENAME},
+    {"record-columnar-size-in-m", required_argument, 0,
+     OPT_RECORD_COLUMNAR_SIZE_IN_M},
     {"record-raw-filename", required_argument, 0, 'r'},
+    {"shm-ring", no_argument, &shm_ring, 1},
     {"record-raw-size-in-m", required_argument, 0, 'R'},
     {"config", required_argument, 0, 'g'},
     {"config2", required_argument, 0, 'G'},
@@ -377,6 +398,26 @@ void CommandParser::parse_parameter_(int argc, char *argv[]) {
         rosbag_size_in_m = strtoul(optarg, NULL, 0);
         break;
 
+      case OPT_RECORD_COLUMNAR_FILENAME:
+        record_columnar_filename = optarg;
+        break;
+
+      case OPT_RECORD_COLUMNAR_SIZE_IN_M:
+        record_columnar_size_in_m = strtoul(optarg, NULL, 0);
+        break;
+
+      case OPT_UDP_BATCH_SIZE:
+        udp_batch_size = strtoul(optarg, NULL, 0);
+        break;
+
+      case OPT_UDP_BATCH_INTERVAL_US:
+        udp_batch_interval_us = strtoul(optarg, NULL, 0);
+        break;
+
+      case OPT_WS_SEND_QUEUE:
+        ws_send_queue = optarg;
+        break;
+
       case 'r':
         record_raw_filename = optarg;
         break;
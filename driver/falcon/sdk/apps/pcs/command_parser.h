@@ -18,6 +18,14 @@
 
 namespace innovusion {
 
+// long options without a short letter, all letters are used
+enum CommandParserLongOption {
+  OPT_RECORD_COLUMNAR_FILENAME = 256,
+  OPT_RECORD_COLUMNAR_SIZE_IN_M,
+  OPT_UDP_BATCH_SIZE,
+  OPT_UDP_BATCH_INTERVAL_US,
+  OPT_WS_SEND_QUEUE,
+};
 
 class CommandParser;
 class LidarCommandConfig {
@@ -94,6 +102,10 @@ class CommandParser {
   uint16_t udp_port_status_local;  // l
   uint16_t udp_port_message;      // w
   uint16_t tcp_port;              // p
+  uint32_t udp_batch_size;        // OPT_UDP_BATCH_SIZE
+  uint32_t udp_batch_interval_us;  // OPT_UDP_BATCH_INTERVAL_US
+  int udp_gso;                    // udp-gso
+  std::string ws_send_queue;      // OPT_WS_SEND_QUEUE
   uint32_t status_interval_ms;    // I
   std::string record_inno_pc_filename;   // o
   size_t record_inno_pc_size_in_m;       // m
@@ -103,6 +115,9 @@ class CommandParser {
   std::string png_filename;              // t
   std::string rosbag_filename;    // b
   size_t rosbag_size_in_m;        // B
+  std::string record_columnar_filename;  // OPT_RECORD_COLUMNAR_FILENAME
+  size_t record_columnar_size_in_m;      // OPT_RECORD_COLUMNAR_SIZE_IN_M
+  int shm_ring;                   // shm-ring
   std::string config_filename;    // g
   std::string config_filename2;   // G
   std::string dtc_filename;       // H
@@ -14,10 +14,12 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <string>
 #include <vector>
 
 #include "src/sdk_common/converter/png_recorder.h"
+#include "src/sdk_common/converter/point_cloud_writer.h"
 #include "src/sdk_common/converter/rosbag_recorder.h"
 #include "src/sdk_common/inno_lidar_api.h"
 #include "src/sdk_common/inno_lidar_packet_utils.h"
@@ -148,9 +150,16 @@ int InnoPcFrameCapture::add_capture_job(const std::string &type,
     }
     reset_job_state_with_lock_();
     job_duration_ = atoi(duration.c_str());
-    if (type == "pcd" || type == "pcd_binary" || type == "csv") {
+    if (type == "pcd" || type == "pcd_binary" || type == "csv" ||
+        type == "pcd_compressed" || type == "ply" || type == "las") {
       if (type == "csv") {
         job_type_ = CAPTURE_TYPE_CSV;
+      } else if (type == "pcd_compressed") {
+        job_type_ = CAPTURE_TYPE_PCD_COMPRESSED;
+      } else if (type == "ply") {
+        job_type_ = CAPTURE_TYPE_PLY;
+      } else if (type == "las") {
+        job_type_ = CAPTURE_TYPE_LAS;
       } else {
         job_type_ = type == "pcd" ?
                     CAPTURE_TYPE_PCD :
@@ -488,9 +497,7 @@ void InnoPcFrameCapture::received_data_packet(const InnoDataPacket *pkt) {
     return;
   }
   // quick check without lock
-  if (job_type_ == CAPTURE_TYPE_PCD ||
-      job_type_ == CAPTURE_TYPE_PCD_BINARY ||
-      job_type_ == CAPTURE_TYPE_CSV) {
+  if (is_pcd_type_(job_type_)) {
     pcd_received_data_packet_(pkt);
   } else if (job_type_ == CAPTURE_TYPE_PC ||
              job_type_ == CAPTURE_TYPE_PC_XYZ ||
@@ -527,9 +534,7 @@ void InnoPcFrameCapture::png_received_data_packet_(const InnoDataPacket *pkt) {
 void InnoPcFrameCapture::pcd_received_data_packet_(const InnoDataPacket *pkt) {
   {
     std::unique_lock<std::mutex> lk(mutex_);
-    if (job_type_ != CAPTURE_TYPE_PCD &&
-        job_type_ != CAPTURE_TYPE_PCD_BINARY &&
-        job_type_ != CAPTURE_TYPE_CSV) {
+    if (!is_pcd_type_(job_type_)) {
       return;
     }
   }
@@ -567,7 +572,11 @@ void InnoPcFrameCapture::pcd_received_data_packet_(const InnoDataPacket *pkt) {
         inno_log_verify(worker_ == NULL, "worker_");
         worker_ = new std::thread([this]() {
           InnoUtils::set_self_thread_priority(-20);
-          send_pcd_capture_thread_();
+          if (is_point_file_type_(job_type_)) {
+            send_point_file_capture_thread_();
+          } else {
+            send_pcd_capture_thread_();
+          }
         });
         inno_log_verify(worker_, "worker");
       }
@@ -666,9 +675,7 @@ void InnoPcFrameCapture::pcd_add_data_packet_(const InnoDataPacket *pkt) {
   inno_log_verify(pkt, "pkt");
   {
     std::unique_lock<std::mutex> lk(mutex_);
-    inno_log_verify(job_type_ == CAPTURE_TYPE_PCD ||
-                    job_type_ == CAPTURE_TYPE_PCD_BINARY ||
-                    job_type_ == CAPTURE_TYPE_CSV,
+    inno_log_verify(is_pcd_type_(job_type_),
                     "job_type_ %d", job_type_);
     inno_log_verify(pcd_last_frame_ >= 0, "pcd_last_frame_ %" PRI_SIZED,
                     pcd_last_frame_);
@@ -935,6 +942,112 @@ void InnoPcFrameCapture::send_pcd_capture_thread_() {
                 capture_filename_.c_str(), total_sent);
 }
 
+void InnoPcFrameCapture::send_point_file_capture_thread_() {
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    inno_log_verify(is_point_file_type_(job_type_),
+                    "job_type_ %d", job_type_);
+    inno_log_verify(pcd_last_frame_ >= 0, "pcd_last_frame_ %" PRI_SIZED,
+                    pcd_last_frame_);
+  }
+  const size_t kMaxChunkLen = 65536;
+  char buffer[kMaxChunkLen];
+  size_t total_sent = 0;
+  PointCloudFileFormat format =
+      job_type_ == CAPTURE_TYPE_PLY ? POINT_CLOUD_FILE_PLY :
+      (job_type_ == CAPTURE_TYPE_LAS ? POINT_CLOUD_FILE_LAS :
+       POINT_CLOUD_FILE_PCD_BINARY_COMPRESSED);
+
+  // send header
+  prepare_http_header(buffer, sizeof(buffer),
+                      'F',
+                      display_job_duration_,
+                      "application/octet-stream",
+                      PointCloudWriter::get_extension(format));
+  int rt = PcServerWsProcessor::write_buffer_to_ws_socket_full_s(
+      &job_conn_, buffer,
+      strlen(buffer));
+  if (rt < 0) {
+    end_worker_();
+    inno_log_info("point file capture %s failed sending %"
+                  PRI_SIZELU " bytes.",
+                  capture_filename_.c_str(), total_sent);
+    return;
+  }
+
+  // saved blocks to xyz points, one segment per packet
+  PointCloudFrame frame;
+  frame.set_reflectance(reflectance_);
+  size_t block_so_far = 0;
+  for (size_t p = 0; p < pcd_packet_so_far_ &&
+                     block_so_far < pcd_block_so_far_; p++) {
+    const InnoDataPacket &header = pcd_saved_packet_headers_[p];
+    frame.add_segment(header.common.ts_start_us, header.idx,
+                      header.confidence_level);
+    size_t block_end = std::min(block_so_far + header.item_number,
+                                static_cast<size_t>(pcd_block_so_far_));
+    for (; block_so_far < block_end; block_so_far++) {
+      const InnoBlock2 &block = pcd_saved_packet_->inno_block2s[block_so_far];
+      InnoBlockFullAngles full_angles;
+      InnoDataPacketUtils::get_block_full_angles(&full_angles, block.header);
+      for (uint32_t ch = 0; ch < kInnoChannelNumber; ch++) {
+        for (uint32_t m = 0; m < 2; m++) {
+          const InnoChannelPoint &pt = block.points[InnoBlock2::get_idx(ch, m)];
+          if (pt.radius > 0) {
+            InnoXyzPoint xyz;
+            InnoDataPacketUtils::get_xyz_point(block.header, pt,
+                                               full_angles.angles[ch],
+                                               ch, &xyz);
+            frame.add_point(xyz);
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<char> file;
+  std::vector<char> scratch;
+  PointCloudWriter::encode(frame, format, &file, &scratch);
+  inno_log_info(
+      "send_capture first_frame=%" PRI_SIZED
+      " duration=%" PRI_SIZELU ", "
+      "blocks=%u, point=%" PRI_SIZELU ", bytes=%" PRI_SIZELU,
+      pcd_start_frame_, job_duration_, pcd_block_so_far_,
+      frame.get_point_number(), file.size());
+
+  for (size_t off = 0; off < file.size(); off += kMaxChunkLen) {
+    size_t len = std::min(kMaxChunkLen, file.size() - off);
+    rt = PcServerWsProcessor::write_chunk_to_ws_socket_full_s(
+        &job_conn_, &file[off], len);
+    if (rt < 0) {
+      end_worker_();
+      inno_log_info("point file capture %s failed sending %"
+                    PRI_SIZELU " bytes.",
+                    capture_filename_.c_str(), total_sent);
+      return;
+    }
+    total_sent += len;
+    // actively slow down
+    usleep(3000);
+  }
+
+  // stop chunks and flush
+  rt = PcServerWsProcessor::write_chunk_to_ws_socket_full_s(&job_conn_,
+                                                            NULL, 0);
+  if (rt < 0) {
+    end_worker_();
+    inno_log_info("point file capture %s failed sending %"
+                  PRI_SIZELU " bytes.",
+                  capture_filename_.c_str(), total_sent);
+    return;
+  }
+  PcServerWsProcessor::flush_buffer_s(&job_conn_);
+
+  end_worker_();
+  inno_log_info("point file capture %s done sending %" PRI_SIZELU " bytes.",
+                capture_filename_.c_str(), total_sent);
+}
+
 void InnoPcFrameCapture::send_inno_pc_capture_thread_() {
   {
     std::unique_lock<std::mutex> lk(mutex_);
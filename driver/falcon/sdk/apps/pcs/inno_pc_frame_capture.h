@@ -47,6 +47,9 @@ class InnoPcFrameCapture {
     CAPTURE_TYPE_CSV = 9,
     CAPTURE_TYPE_RAW_RAW = 10,
     CAPTURE_TYPE_YAML = 11,
+    CAPTURE_TYPE_PCD_COMPRESSED = 12,
+    CAPTURE_TYPE_PLY = 13,
+    CAPTURE_TYPE_LAS = 14,
     CAPTURE_TYPE_MAX,
   };
 
@@ -91,6 +94,19 @@ class InnoPcFrameCapture {
         recorder_callback_raw2_(type, buffer, len);
   }
   static int write_to_wconn_s_(void *ctx, const void *buf, size_t buf_len);
+  // captures that save the blocks of a few frames and send them at once
+  static inline bool is_pcd_type_(enum CaptureType type) {
+    return type == CAPTURE_TYPE_PCD ||
+        type == CAPTURE_TYPE_PCD_BINARY ||
+        type == CAPTURE_TYPE_CSV ||
+        is_point_file_type_(type);
+  }
+  // encoded by PointCloudWriter
+  static inline bool is_point_file_type_(enum CaptureType type) {
+    return type == CAPTURE_TYPE_PCD_COMPRESSED ||
+        type == CAPTURE_TYPE_PLY ||
+        type == CAPTURE_TYPE_LAS;
+  }
 
  public:
   explicit InnoPcFrameCapture(PCS *pcs);
@@ -137,6 +153,7 @@ class InnoPcFrameCapture {
   void send_bag_capture_thread_();
   void send_png_capture_thread_();
   void send_pcd_capture_thread_();
+  void send_point_file_capture_thread_();
   void send_inno_pc_capture_thread_();
 
   int recorder_callback_raw2_(enum InnoRecorderCallbackType type,
@@ -56,6 +56,11 @@ int PcServerWsProcessor::parse_query_string_(void *conn,
     ret = pcs_->get_pcs(name.substr(4), value, reply, conn, true);
   } else if (name.find("set_") == 0) {
     ret = pcs_->set_pcs(name.substr(4), value, conn);
+  } else if (name == "send_queue") {
+    ret = set_send_queue_s(conn, value);
+    if (ret) {
+      inno_log_error("Invalid send_queue %s", value.c_str());
+    }
   } else if (name == "lidar_id") {
     // do nothing
   } else if (name.size() == 0) {
@@ -326,9 +331,15 @@ int PcServerWsProcessor::write_ws_socket_cpacket(
     uint32_t context,
     const InnoCommonHeader *packet) {
   if (pc_server_) {
+    // pieces of one frame share a frame_id, +1 since 0 means no frame
+    uint64_t frame_id = 0;
+    if (packet->version.magic_number == kInnoMagicNumberDataPacket) {
+      frame_id = reinterpret_cast<const InnoDataPacket *>(packet)->idx + 1;
+    }
     return pc_server_->write_socket_var_struct(
                        packet,
-                       packet->size);
+                       packet->size,
+                       frame_id);
   }
   return 0;
 }
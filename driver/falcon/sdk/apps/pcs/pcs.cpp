@@ -36,10 +36,12 @@ __forceinline char *__cdecl asctime_r(const struct tm *_Tm, char *_Str) {
 #include <vector>
 
 #include "src/sdk_common/converter/cframe_converter.h"
+#include "src/sdk_common/converter/columnar_recorder.h"
 #include "src/sdk_common/converter/png_recorder.h"
 #include "src/sdk_common/converter/rosbag_recorder.h"
 #include "src/sdk_common/inno_lidar_api.h"
 #include "src/utils/inno_lidar_log.h"
+#include "src/utils/shm_ring.h"
 #include "src/utils/utils.h"
 
 #include "pcs/command_parser.h"
@@ -68,6 +70,7 @@ PCS::PCS(const CommandParser &c)
     , status_udp_sender_(NULL)
     , message_udp_sender_(NULL)
     , status_local_udp_sender_(NULL)
+    , shm_ring_(NULL)
     , cali_data_udp_sender_(NULL)
     , is_send_cali_data(false)
     , raw_udp_sender_(NULL)
@@ -77,6 +80,7 @@ PCS::PCS(const CommandParser &c)
     , bad_data_recorder_(NULL)
     , inno_pc_npy_recorder_(NULL)
     , rosbag_recorder_(NULL)
+    , columnar_recorder_(NULL)
     , png_recorder_(NULL)
     , frame_capturer_(NULL)
     , ws_(NULL)
@@ -140,6 +144,11 @@ PCS::PCS(const CommandParser &c)
                                   cmd_parser_.lidar.lidar_id,
                                   this);
     inno_log_verify(ws_, "ws");
+    if (!cmd_parser_.ws_send_queue.empty() &&
+        ws_->set_default_send_queue(cmd_parser_.ws_send_queue) != 0) {
+      inno_log_error("Invalid ws-send-queue %s",
+                     cmd_parser_.ws_send_queue.c_str());
+    }
     frame_capturer_ = new InnoPcFrameCapture(this);
     inno_log_verify(frame_capturer_, "frame_capturer_");
   }
@@ -205,6 +214,24 @@ PCS::PCS(const CommandParser &c)
     inno_log_verify(rosbag_recorder_, "rosbag_recorder");
   }
 
+  if (cmd_parser_.record_columnar_filename.size()) {
+    columnar_recorder_ =
+        new ColumnarRecorder(cmd_parser_.record_columnar_filename,
+                             cmd_parser_.record_columnar_size_in_m);
+    inno_log_verify(columnar_recorder_, "columnar_recorder");
+  }
+
+  if (cmd_parser_.shm_ring) {
+    // local clients attach with INNO_LIDAR_PROTOCOL_PCS_SHM and tcp_port
+    shm_ring_ = new ShmRing(cmd_parser_.tcp_port, true);
+    inno_log_verify(shm_ring_, "shm_ring");
+    if (!shm_ring_->is_valid()) {
+      inno_log_error("cannot create shm ring");
+      delete shm_ring_;
+      shm_ring_ = NULL;
+    }
+  }
+
   if (lidar_->is_live_direct_memory()) {
     fw_log_listener_ =
         new UdpLogListener("fw_log_listener", 7999, {0, 500 * 1000}, this);
@@ -315,6 +342,19 @@ PCS::~PCS() {
     delete inno_pc_npy_recorder_;
     inno_pc_npy_recorder_ = NULL;
   }
+  if (columnar_recorder_) {
+    delete columnar_recorder_;
+    columnar_recorder_ = NULL;
+  }
+  if (png_recorder_) {
+    // waits for the png being encoded
+    delete png_recorder_;
+    png_recorder_ = NULL;
+  }
+  if (shm_ring_) {
+    delete shm_ring_;
+    shm_ring_ = NULL;
+  }
   if (fw_log_listener_) {
     delete fw_log_listener_;
     fw_log_listener_ = NULL;
@@ -398,7 +438,7 @@ void PCS::load_config_(const char *filename) {
 }
 
 void PCS::setup_udp_(const std::string &udp_ip, uint16_t port,
-                     std::mutex *mutex, UdpSender **sender) {
+                     std::mutex *mutex, UdpSender **sender, bool batch) {
   inno_log_verify(sender, "sender");
   inno_log_verify(mutex, "mutex");
   inno_log_info("request to create udp_sender to %s:%hu", udp_ip.c_str(), port);
@@ -416,10 +456,19 @@ void PCS::setup_udp_(const std::string &udp_ip, uint16_t port,
     }
 
     *sender = new UdpSender(udp_ip, port);
+    if (batch && *sender && cmd_parser_.udp_batch_size > 1) {
+      (*sender)->start_batch(cmd_parser_.udp_batch_size,
+                             cmd_parser_.udp_batch_interval_us,
+                             cmd_parser_.udp_gso);
+    }
   }
 
   inno_log_verify(*sender, "udp_sender_ %s %hu", udp_ip.c_str(), port);
   inno_log_info("create udp_sender to %s:%hu", udp_ip.c_str(), port);
+  if ((*sender)->is_batching()) {
+    inno_log_info("udp_sender %s:%hu %s", udp_ip.c_str(), port,
+                  (*sender)->get_batch_stats().c_str());
+  }
 }
 
 //
@@ -454,7 +503,7 @@ void PCS::setup_udps_(const std::string &udp_ip, uint16_t data_port,
   }
 
   setup_udp_(udp_ip, message_port, &message_udp_mutex_, &message_udp_sender_);
-  setup_udp_(udp_ip, data_port, &data_udp_mutex_, &data_udp_sender_);
+  setup_udp_(udp_ip, data_port, &data_udp_mutex_, &data_udp_sender_, true);
   setup_udp_(udp_ip, cali_data_port, &cali_data_udp_mutex_,
     &cali_data_udp_sender_);
   setup_udp_(udp_ip, status_port, &status_udp_mutex_, &status_udp_sender_);
@@ -742,6 +791,17 @@ int PCS::get_pcs(const std::string &name,
     } else {
       *result += "," + cmd_parser_.udp_client_ip + "," + source_ip;
     }
+  } else if (name == "ws_send_stats") {
+    if (ws_) {
+      *result += ws_->get_send_stats();
+    }
+  } else if (name == "udp_batch_stats") {
+    std::unique_lock<std::mutex> lk(data_udp_mutex_);
+    if (data_udp_sender_ && data_udp_sender_->is_batching()) {
+      *result += data_udp_sender_->get_batch_stats();
+    } else {
+      *result += "disabled";
+    }
   } else if (name == "udp_raw_port") {
     *result +=
         std::to_string(effective_raw_port_) + "," + effective_udp_raw_ip_;
@@ -772,6 +832,8 @@ int PCS::get_pcs(const std::string &name,
          "return_mode",
          "udp_ports_ip",
          "udp_raw_port",
+         "udp_batch_stats",
+         "ws_send_stats",
          "debug",
          "uptime",
          "system_stats",
@@ -1268,6 +1330,10 @@ void PCS::write_log_(int level, int code,
     }
   }
 
+  if (shm_ring_) {
+    shm_ring_->publish(&packet, packet.common.size);
+  }
+
   if (has_ws_()) {
     ws_->write_ws_socket_cpacket(
         cmd_parser_.lidar.lidar_id,
@@ -1479,12 +1545,20 @@ int PCS::data_callback_(const InnoDataPacket *pkt) {
   if (is_send_cali_data)
     return 0;
 
+  if (shm_ring_) {
+    shm_ring_->publish(pkt, pkt->common.size);
+  }
+
   {
     // do not print log here
     // log udp sender is in blocking mode, log here will be
     // blocked if log udp sender was blocked.
     std::unique_lock<std::mutex> lk(data_udp_mutex_);
-    if (data_udp_sender_) {
+    if (data_udp_sender_ && data_udp_sender_->is_batching()) {
+      // the batch thread sends and retries, a full queue drops the
+      // packet and counts it in udp_batch_stats
+      data_udp_sender_->write_batched(pkt, pkt->common.size);
+    } else if (data_udp_sender_) {
       // inno_log_debug("data size=%u", pkt->common.size);
       int write_err_cnt = 0;
       int err = 0;
@@ -1514,7 +1588,8 @@ int PCS::data_callback_(const InnoDataPacket *pkt) {
         std::string udp_ip = std::string(data_udp_sender_->get_ip_str());
         uint16_t data_port = data_udp_sender_->get_port();
         lk.unlock();
-        setup_udp_(udp_ip, data_port, &data_udp_mutex_, &data_udp_sender_);
+        setup_udp_(udp_ip, data_port, &data_udp_mutex_, &data_udp_sender_,
+                   true);
         lk.lock();
         if (data_udp_sender_) {
           data_udp_sender_->write(pkt, pkt->common.size, false);
@@ -1550,11 +1625,16 @@ int PCS::data_callback_(const InnoDataPacket *pkt) {
      rosbag_recorder_->add_block(pkt);
   }
 
+  if (columnar_recorder_) {
+    columnar_recorder_->add_block(pkt);
+  }
+
   if (png_recorder_) {
      bool is_saving = png_recorder_->capture(pkt);
      if (is_saving) {
-       png_recorder_->save(cmd_parser_.png_filename);
-
+       // encode off the data path
+       png_recorder_->save_async(cmd_parser_.png_filename);
+     } else if (png_recorder_->is_finished()) {
        delete png_recorder_;
        png_recorder_ = nullptr;
      }
@@ -1676,6 +1756,9 @@ int PCS::status_callback_(const InnoStatusPacket *pkt) {
       status_local_udp_sender_->write(pkt, pkt->common.size);
     }
   }
+  if (shm_ring_) {
+    shm_ring_->publish(pkt, pkt->common.size);
+  }
   if (has_ws_()) {
     ws_->write_ws_socket_cpacket(
         cmd_parser_.lidar.lidar_id,
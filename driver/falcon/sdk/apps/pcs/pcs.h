@@ -25,6 +25,7 @@
 namespace innovusion {
 
 class CframeConverter;
+class ColumnarRecorder;
 class CommandParser;
 class CommandTest;
 class DataRecorder;
@@ -35,6 +36,7 @@ class LidarSource;
 class PcServerWsProcessor;
 class PngRecorder;
 class RosbagRecorder;
+class ShmRing;
 class UdpLogListener;
 class UdpSender;
 class TimeSyncUdpListener;
@@ -105,7 +107,8 @@ class PCS {
   bool checke_udp_port_conflict_(uint16_t raw_port);
 
   void setup_udp_(const std::string &udp_ip, uint16_t port,
-                  std::mutex *mutex, UdpSender **sender);
+                  std::mutex *mutex, UdpSender **sender,
+                  bool batch = false);
   void setup_udps_(const std::string &udp_ip, uint16_t data_port,
                    uint16_t cali_data_port, uint16_t message_port,
                    uint16_t status_port);
@@ -202,6 +205,7 @@ class PCS {
   UdpSender *status_udp_sender_;
   UdpSender *message_udp_sender_;
   UdpSender *status_local_udp_sender_;
+  ShmRing *shm_ring_;
   std::mutex data_udp_mutex_;
   std::mutex status_udp_mutex_;
   std::mutex message_udp_mutex_;
@@ -225,6 +229,7 @@ class PCS {
   DataRecorder *bad_data_recorder_;
   InnoPcNpyRecorder *inno_pc_npy_recorder_;
   RosbagRecorder *rosbag_recorder_;
+  ColumnarRecorder *columnar_recorder_;
   PngRecorder *png_recorder_;
   InnoPcFrameCapture *frame_capturer_;
   PcServerWsProcessor *ws_;
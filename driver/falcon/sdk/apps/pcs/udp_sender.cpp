@@ -19,8 +19,10 @@
 #include <net/if.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #else
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
@@ -35,11 +37,48 @@
 #endif
 
 #include <string>
+#include <vector>
 
 #include "src/utils/inno_lidar_log.h"
 
+#if defined(__linux__) && !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103
+#endif
+
 namespace innovusion {
-UdpSender::UdpSender(const std::string &ip, uint16_t port) {
+#ifdef __linux__
+// sendmmsg() arguments, only used by the batch thread
+struct UdpBatchBuffers {
+  explicit UdpBatchBuffers(size_t n)
+      : msgs(n)
+      , iovs(n)
+      , first(n)
+      , cmsgs(n * CMSG_SPACE(sizeof(uint16_t))) {
+  }
+  std::vector<struct mmsghdr> msgs;
+  std::vector<struct iovec> iovs;
+  std::vector<size_t> first;   // index of the first packet of each msg
+  std::vector<char> cmsgs;
+};
+#else
+struct UdpBatchBuffers {
+  explicit UdpBatchBuffers(size_t n) {
+  }
+};
+#endif
+
+UdpSender::UdpSender(const std::string &ip, uint16_t port)
+    : batch_thread_(NULL)
+    , batch_stop_(false)
+    , batch_size_(0)
+    , batch_interval_us_(0)
+    , batch_gso_(false)
+    , batch_queued_(0)
+    , batch_count_(0)
+    , batch_packets_(0)
+    , batch_partial_(0)
+    , batch_dropped_(0)
+    , batch_gso_sends_(0) {
 #ifdef __MINGW64__
   WSADATA wsaData;
   int res = WSAStartup(MAKEWORD(2, 2), &wsaData);
@@ -167,6 +206,7 @@ UdpSender::UdpSender(const std::string &ip, uint16_t port) {
 }
 
 UdpSender::~UdpSender() {
+  stop_batch_();
   if (fd_ >= 0) {
     close(fd_);
     fd_ = -1;
@@ -195,13 +235,31 @@ ssize_t UdpSender::write(const void *buffer, size_t size, bool blocking) {
 //
 ssize_t UdpSender::write_raw(const void *header, size_t header_size,
                              const void *body, size_t body_size) {
+#ifndef __MINGW64__
+  // header and body in one datagram, one syscall
+  struct iovec iov[2];
+  iov[0].iov_base = const_cast<void *>(header);
+  iov[0].iov_len = header_size;
+  iov[1].iov_base = const_cast<void *>(body);
+  iov[1].iov_len = body_size;
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = &sockaddr_;
+  msg.msg_namelen = sizeof(sockaddr_);
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  ssize_t ret = sendmsg(fd_, &msg, 0);
+  if (ret == -1) {
+    inno_log_warning("sendmsg faild, errno: %d", errno);
+    return 0;
+  }
+  return ret;
+#else
   ssize_t written = 0;
 
   {
-#if (defined(__APPLE__) || defined(__MINGW64__))
 #ifndef MSG_MORE
 # define MSG_MORE 0
-#endif
 #endif
     ssize_t ret = sendto(fd_, header, header_size, MSG_MORE,
                       (struct sockaddr *)&sockaddr_, sizeof(sockaddr_));
@@ -223,6 +281,215 @@ ssize_t UdpSender::write_raw(const void *header, size_t header_size,
   }
 
   return written;
+#endif
+}
+
+int UdpSender::start_batch(uint32_t batch_size, uint32_t interval_us,
+                           bool use_gso) {
+#ifdef __linux__
+  inno_log_verify(batch_thread_ == NULL, "batch already started");
+  if (batch_size <= 1) {
+    return -1;
+  }
+  if (use_gso) {
+    int v = 0;
+    socklen_t len = sizeof(v);
+    if (getsockopt(fd_, IPPROTO_UDP, UDP_SEGMENT, &v, &len) != 0) {
+      // kernel older than 4.18, sendmmsg only
+      use_gso = false;
+    }
+  }
+  batch_size_ = batch_size;
+  batch_interval_us_ = interval_us;
+  batch_gso_ = use_gso;
+  batch_stop_ = false;
+  batch_queued_ = 0;
+  batch_queue_.resize(batch_size * kBatchQueueFactor);
+  batch_sending_.resize(batch_queue_.size());
+  batch_thread_ = new std::thread(&UdpSender::batch_loop_, this);
+  inno_log_verify(batch_thread_, "batch_thread_");
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+void UdpSender::stop_batch_() {
+  if (!batch_thread_) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lk(batch_mutex_);
+    batch_stop_ = true;
+  }
+  batch_cond_.notify_one();
+  batch_thread_->join();
+  delete batch_thread_;
+  batch_thread_ = NULL;
+}
+
+ssize_t UdpSender::write_batched(const void *buffer, size_t size) {
+  if (!batch_thread_) {
+    return write(buffer, size, false);
+  }
+  if (size > kUdpMaxMsgSize) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+  bool notify = false;
+  {
+    std::unique_lock<std::mutex> lk(batch_mutex_);
+    if (batch_queued_ >= batch_queue_.size()) {
+      batch_dropped_++;
+      errno = ENOBUFS;
+      return -1;
+    }
+    // the buffer keeps its capacity, no allocation after warm up
+    std::vector<char> &b = batch_queue_[batch_queued_];
+    b.resize(size);
+    memcpy(&b[0], buffer, size);
+    batch_queued_++;
+    if (batch_queued_ == 1) {
+      batch_first_ts_ = std::chrono::steady_clock::now();
+      notify = true;
+    } else if (batch_queued_ == batch_size_) {
+      notify = true;
+    }
+  }
+  if (notify) {
+    batch_cond_.notify_one();
+  }
+  return size;
+}
+
+void UdpSender::batch_loop_() {
+  UdpBatchBuffers buffers(batch_queue_.size());
+  std::unique_lock<std::mutex> lk(batch_mutex_);
+  while (true) {
+    if (batch_queued_ == 0) {
+      if (batch_stop_) {
+        break;
+      }
+      batch_cond_.wait(lk);
+      continue;
+    }
+    if (batch_queued_ < batch_size_ && !batch_stop_) {
+      // bounded latency: flush interval_us after the first packet
+      std::chrono::steady_clock::time_point deadline =
+          batch_first_ts_ + std::chrono::microseconds(batch_interval_us_);
+      if (std::chrono::steady_clock::now() < deadline) {
+        batch_cond_.wait_until(lk, deadline);
+        continue;
+      }
+    }
+    size_t count = batch_queued_;
+    batch_queue_.swap(batch_sending_);
+    batch_queued_ = 0;
+    lk.unlock();
+    send_batch_(batch_sending_, count, &buffers);
+    lk.lock();
+  }
+}
+
+void UdpSender::send_batch_(const std::vector<std::vector<char> > &packets,
+                            size_t count, UdpBatchBuffers *b) {
+#ifdef __linux__
+  size_t i = 0;
+  while (i < count) {
+    // build up to batch_size_ messages, with gso a message carries
+    // several same size packets (the last one may be shorter)
+    size_t m = 0;
+    size_t iov_n = 0;
+    while (i < count && m < batch_size_) {
+      struct msghdr &hdr = b->msgs[m].msg_hdr;
+      memset(&hdr, 0, sizeof(hdr));
+      hdr.msg_name = &sockaddr_;
+      hdr.msg_namelen = sizeof(sockaddr_);
+      hdr.msg_iov = &b->iovs[iov_n];
+      b->first[m] = i;
+      size_t seg = packets[i].size();
+      size_t total = 0;
+      size_t n = 0;
+      do {
+        struct iovec &iov = b->iovs[iov_n + n];
+        iov.iov_base = const_cast<char *>(&packets[i][0]);
+        iov.iov_len = packets[i].size();
+        total += iov.iov_len;
+        n++;
+        i++;
+      } while (batch_gso_ && i < count && n < kGsoMaxSegments &&
+               packets[i - 1].size() == seg &&
+               packets[i].size() <= seg &&
+               total + packets[i].size() <= kUdpMaxMsgSize);
+      hdr.msg_iovlen = n;
+      if (n > 1) {
+        char *c = &b->cmsgs[m * CMSG_SPACE(sizeof(uint16_t))];
+        hdr.msg_control = c;
+        hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&hdr);
+        cm->cmsg_level = IPPROTO_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t gso_size = seg;
+        memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+        batch_gso_sends_++;
+      }
+      iov_n += n;
+      m++;
+    }
+
+    size_t sent = 0;
+    int retry = 0;
+    while (sent < m) {
+      int r = sendmmsg(fd_, &b->msgs[sent], m - sent, MSG_DONTWAIT);
+      if (r > 0) {
+        batch_count_++;
+        for (int k = 0; k < r; k++) {
+          batch_packets_ += b->msgs[sent + k].msg_hdr.msg_iovlen;
+        }
+        sent += r;
+        if (sent < m) {
+          batch_partial_++;
+        }
+        continue;
+      }
+      if ((errno == EAGAIN || errno == EWOULDBLOCK) &&
+          ++retry < kBatchSendRetry) {
+        usleep(200);
+        continue;
+      }
+      if (batch_gso_ && (errno == EIO || errno == EINVAL)) {
+        // the device or route cannot do segmentation offload,
+        // resend the rest packet by packet
+        inno_log_warning("udp gso send failed, errno: %d, disable gso",
+                         errno);
+        batch_gso_ = false;
+        i = b->first[sent];
+        break;
+      }
+      // drop the rest of this round
+      for (size_t k = sent; k < m; k++) {
+        batch_dropped_ += b->msgs[k].msg_hdr.msg_iovlen;
+      }
+      break;
+    }
+  }
+#endif
+}
+
+std::string UdpSender::get_batch_stats() const {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "batch_size=%u interval_us=%u gso=%d batches=%" PRI_SIZELU
+           " packets=%" PRI_SIZELU " gso_sends=%" PRI_SIZELU
+           " partial=%" PRI_SIZELU " dropped=%" PRI_SIZELU,
+           batch_size_, batch_interval_us_, batch_gso_ ? 1 : 0,
+           static_cast<uint64_t>(batch_count_),
+           static_cast<uint64_t>(batch_packets_),
+           static_cast<uint64_t>(batch_gso_sends_),
+           static_cast<uint64_t>(batch_partial_),
+           static_cast<uint64_t>(batch_dropped_));
+  return buf;
 }
 
 }  // namespace innovusion
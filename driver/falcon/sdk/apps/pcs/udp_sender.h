@@ -20,9 +20,17 @@
 #include <ws2tcpip.h>
 #endif
 
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 namespace innovusion {
+struct UdpBatchBuffers;
+
 class UdpSender {
  public:
   explicit UdpSender(const std::string &ip, uint16_t port);
@@ -30,6 +38,11 @@ class UdpSender {
 
   static constexpr uint16_t kUdpMaxMsgSize =
       65535 - 20 /*ip header*/ - 8 /*udp header*/;
+  // max segments the kernel accepts in one UDP_SEGMENT send
+  static const uint32_t kGsoMaxSegments = 64;
+  // the batch queue holds this many batches before dropping
+  static const uint32_t kBatchQueueFactor = 8;
+  static const int kBatchSendRetry = 5;
 
  public:
   ssize_t write(const void *buffer, size_t size, bool blocking = true);
@@ -37,6 +50,30 @@ class UdpSender {
   ssize_t write_raw(const void *header, size_t header_size, const void *body,
                     size_t body_size);
 
+  /*
+   * @brief Start the batch thread. write_batched() queues the packets,
+   *        the thread sends them with sendmmsg() when batch_size packets
+   *        are queued or interval_us after the first queued one.
+   * @param use_gso Also merge same size packets into one UDP_SEGMENT
+   *        send if the kernel supports it
+   *        No log here, the caller may hold the sender mutex
+   * @return 0 if batching is started, -1 if not supported
+   */
+  int start_batch(uint32_t batch_size, uint32_t interval_us, bool use_gso);
+
+  /*
+   * @brief Queue one packet if batching is started, otherwise the same
+   *        as write(buffer, size, false). Never blocks.
+   * @return size if queued, -1 if the queue is full (packet dropped)
+   */
+  ssize_t write_batched(const void *buffer, size_t size);
+
+  bool is_batching() const {
+    return batch_thread_ != NULL;
+  }
+
+  std::string get_batch_stats() const;
+
   std::string get_udp_ip_string() const {
     return udp_ip_str_;
   }
@@ -53,11 +90,40 @@ class UdpSender {
     return htons(sockaddr_.sin_port);
   }
 
+ private:
+  void stop_batch_();
+  void batch_loop_();
+  void send_batch_(const std::vector<std::vector<char> > &packets,
+                   size_t count, UdpBatchBuffers *buffers);
+
  private:
   std::string udp_ip_str_;
   struct sockaddr_in sockaddr_;
   int fd_;
   bool multicast_;
+
+  // batch mode
+  std::thread *batch_thread_;
+  std::mutex batch_mutex_;
+  std::condition_variable batch_cond_;
+  bool batch_stop_;
+  uint32_t batch_size_;
+  uint32_t batch_interval_us_;
+  // turned off by the batch thread if the kernel rejects UDP_SEGMENT,
+  // read by get_batch_stats()
+  std::atomic<bool> batch_gso_;
+  // packets queued by write_batched(), swapped with batch_sending_
+  // by the batch thread, the buffers are reused
+  std::vector<std::vector<char> > batch_queue_;
+  std::vector<std::vector<char> > batch_sending_;
+  size_t batch_queued_;
+  std::chrono::steady_clock::time_point batch_first_ts_;
+
+  std::atomic<uint64_t> batch_count_;
+  std::atomic<uint64_t> batch_packets_;
+  std::atomic<uint64_t> batch_partial_;
+  std::atomic<uint64_t> batch_dropped_;
+  std::atomic<uint64_t> batch_gso_sends_;
 };
 
 }  // namespace innovusion
@@ -32,12 +32,10 @@ int inno_lidar_open_live(const char *name,
                                     protocol == INNO_LIDAR_PROTOCOL_RAW_TCP);
       break;
     case INNO_LIDAR_PROTOCOL_PCS_UDP:
-      l = new innovusion::InnoLidarClient(name, lidar_ip, port,
-                                          false, udp_port);
-      break;
     case INNO_LIDAR_PROTOCOL_PCS_TCP:
+    case INNO_LIDAR_PROTOCOL_PCS_SHM:
       l = new innovusion::InnoLidarClient(name, lidar_ip, port,
-                                          true, udp_port);
+                                          protocol, udp_port);
       break;
     default:
       inno_log_panic("invalid protocol %d", protocol);
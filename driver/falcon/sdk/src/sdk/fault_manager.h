@@ -47,7 +47,7 @@ class FaultConfig : public Config {
     return name.c_str();
   }
 
-  int set_key_value_(const std::string &key, double value) override {
+  int set_key_value_(const ConfigKey &key, double value) override {
     SET_CFG(set_fault_debounce);
     SET_CFG(heal_fault_debounce);
     SET_CFG(heal_history_cycle_threshold);
@@ -56,7 +56,7 @@ class FaultConfig : public Config {
     return 0;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      const std::string value) override {
     // no string attribute
     return -1;
@@ -271,11 +271,16 @@ void InnoLidar::init_() {
 }
 
 void InnoLidar::setup_job_pools_() {
+  // config_ is copied before inno_lidar_set_config_name_value() is called
+  LidarConfig config;
+  config.copy_from_src(&config_base_);
+  int huge_page = config.huge_page;
   stage_signal_job_pool_ = new StageSignalJobPool(
       "SignalJobPool",
       kSignalJobPoolSize,
       StageSignal::kWriteBlockSize,
-      StageSignal::kMaxLeftoverSize);
+      StageSignal::kMaxLeftoverSize,
+      32, huge_page);
   inno_log_verify(stage_signal_job_pool_, "stage_signal_job_pool_");
   unsigned int block_number = InnoConsts::kMaxTriggerPerSecond *
           InnoConsts::kSecondInMinute / InnoConsts::kMinPolygonRPM /
@@ -286,7 +291,8 @@ void InnoLidar::setup_job_pools_() {
                           config_.encodes_per_polygon - 1 :
                           config_.encodes_per_polygon),
                           block_number,
-                          config_.encodes_per_polygon);
+                          config_.encodes_per_polygon,
+                          huge_page);
   inno_log_verify(stage_angle_job_pool_, "stage_angle_job_pool_");
   if (is_live_direct_memory_lidar_()) {
     // verify every RawChannelPoint array is 64 bytes align
@@ -309,7 +315,8 @@ void InnoLidar::setup_job_pools_() {
   stage_deliver_points_job_pool_ =
       new StageDeliverPointsJobPool("DeliverPointsJobPool",
                                     kDeliverPointsJobPoolSize,
-                                    kDeliverPointsMaxBlockNumber);
+                                    kDeliverPointsMaxBlockNumber,
+                                    huge_page);
   inno_log_verify(stage_deliver_points_job_pool_,
                   "stage_deliver_points_job_pool_");
 
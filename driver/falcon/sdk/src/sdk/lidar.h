@@ -79,22 +79,24 @@ class LidarConfig: public Config {
     max_h_roi = 60;
     // todo zhuhe
     encodes_per_polygon = 5;
+    huge_page = HUGE_PAGE_OFF;
   }
     const char* get_type() const override {
     return "Lidar_Lidar";
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                              double value) override {
     SET_CFG(min_v_roi);
     SET_CFG(max_v_roi);
     SET_CFG(min_h_roi);
     SET_CFG(max_h_roi);
     SET_CFG(encodes_per_polygon);
+    SET_CFG(huge_page);
     return -1;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      const std::string value) override {
     // no string attribute
     return -1;
@@ -106,6 +108,9 @@ class LidarConfig: public Config {
   double min_h_roi;
   double max_h_roi;
   uint32_t encodes_per_polygon;
+  // HugePageMode of the signal, angle and deliver points job pools,
+  // read by start()
+  uint32_t huge_page;
   END_CFG_MEMBER()
 };
 
@@ -35,6 +35,10 @@ void LidarClock::reset(enum InnoTimeSyncConfig sync_config,
                        const LidarClockConfig &config) {
   this->config_.copy_from_src(const_cast<LidarClockConfig *>(&config));
   this->config_.print();
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    model_.set_limits(config_.model_samples, config_.model_reset_us * 1000LL);
+  }
 
   update_sync_config_(sync_config);
 }
@@ -45,6 +49,8 @@ void LidarClock::reset(enum InnoTimeSyncConfig sync_config,
 //
 void LidarClock::update_config(const LidarClockConfig &config) {
   this->config_.copy_from_src(const_cast<LidarClockConfig *>(&config));
+  std::unique_lock<std::mutex> lk(mutex_);
+  model_.set_limits(config_.model_samples, config_.model_reset_us * 1000LL);
 }
 
 //
@@ -175,13 +181,17 @@ void LidarClock::print_status_() const {
       "update time=%" PRI_SIZELU ", config=%s state=%s, fpga_clock=%"
       PRI_SIZEU " ts=%s utc=%ld bootup_utc=%f, "
       "bootup_utc offset >100ms(%u) >10ms(%u) >1ms(%u) "
-      ">100us(%u), ppm >1000(%u) >500(%u) >100(%u) >40(%u).",
+      ">100us(%u), ppm >1000(%u) >500(%u) >100(%u) >40(%u), "
+      "model drift=%.3fppm samples=%u residual=%" PRI_SIZED "ns "
+      "restarts=%u.",
       this->stat_.update_time_counter, SyncConfigName[this->sync_config_],
       SyncTypeName[this->sync_type_], this->fpga_clock_, this->utc_str_,
       this->utc_, this->bootup_utc_, this->stat_.bootup_100ms_,
       this->stat_.bootup_10ms_, this->stat_.bootup_1ms_,
       this->stat_.bootup_100us_, this->stat_.ppm_1000_, this->stat_.ppm_500_,
-      this->stat_.ppm_100_, this->stat_.ppm_40_);
+      this->stat_.ppm_100_, this->stat_.ppm_40_, model_.get_drift_ppm(),
+      model_.get_sample_number(), model_.get_last_residual_ns(),
+      model_.get_restart_number());
 }
 
 //
@@ -251,6 +261,7 @@ bool LidarClock::update_sync_config_(enum InnoTimeSyncConfig target) {
     this->sync_type_ = init_sync_type;
 
     this->bootup_utc_ = 0;
+    model_.reset();
     this->fpga_clock_ = 0;
     this->utc_ = 0;
     utc_str_[0] = '\0';
@@ -298,6 +309,12 @@ void LidarClock::update_sync_state_(const ClockData &clock) {
       strncpy(this->utc_str_, clock.utc_str, sizeof(clock.utc_str));
 
       this->bootup_utc_ = clock.bootup_utc;
+      // fpga_clock counts 8ns
+      if (!model_.add_sample(clock.fpga_clock * 8,
+                             clock.utc * InnoConsts::kNsInSecond)) {
+        inno_log_info("%s clock model restarted, residual %" PRI_SIZED "ns",
+                      clock.log_token, model_.get_last_residual_ns());
+      }
     }
   }
 
@@ -371,6 +388,23 @@ enum InnoTimeSyncType LidarClock::get_sync_state_and_diff(double *diff) {
   return ret;
 }
 
+//
+//
+//
+enum InnoTimeSyncType LidarClock::get_sync_state_and_transform(
+    LidarClockTransform *transform) {
+  inno_log_verify(transform, "invalid address");
+
+  enum InnoTimeSyncType ret;
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    ret = sync_type_;
+    *transform = model_.get_transform();
+  }
+
+  return ret;
+}
+
 //
 //
 //
@@ -13,6 +13,7 @@
 #include <string>
 #include "sdk/rawdata_type.h"
 #include "sdk/lidar_clock_config.h"
+#include "sdk/lidar_clock_model.h"
 #include "sdk_common/inno_lidar_packet.h"
 #include "utils/config.h"
 #include "utils/log.h"
@@ -101,6 +102,9 @@ class LidarClock {
 
   //
   enum InnoTimeSyncType get_sync_state_and_diff(double *diff);
+  // fpga ns to epoch ns with the fitted drift, for per point timestamps
+  enum InnoTimeSyncType get_sync_state_and_transform(
+      LidarClockTransform *transform);
 
   //
   enum class LostType { NOP, HEAL, LOST };
@@ -145,6 +149,7 @@ class LidarClock {
   std::mutex mutex_;
   enum InnoTimeSyncType sync_type_ { INNO_TIME_SYNC_TYPE_NONE };
   double bootup_utc_{0};
+  LidarClockModel model_;
 
   uint64_t fpga_clock_{0};
   time_t utc_{0};
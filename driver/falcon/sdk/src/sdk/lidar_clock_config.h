@@ -23,17 +23,21 @@ class LidarClockConfig : public Config {
   LidarClockConfig() : Config() {
     lost_check_after_machine_up_ms = 5 * 60 * 1000;  // 5 minutes
     lost_check_after_progress_up_ms = 5 * 1000;      // 5s
+    model_samples = 16;
+    model_reset_us = 1000;  // 1ms
   }
 
   const char *get_type() const override { return "Lidar_Clock"; }
 
-  int set_key_value_(const std::string &key, double value) override {
+  int set_key_value_(const ConfigKey &key, double value) override {
     SET_CFG(lost_check_after_machine_up_ms);
     SET_CFG(lost_check_after_progress_up_ms);
+    SET_CFG(model_samples);
+    SET_CFG(model_reset_us);
     return -1;
   }
 
-  int set_key_value_(const std::string &key, const std::string value) override {
+  int set_key_value_(const ConfigKey &key, const std::string value) override {
     // no string attribute
     return -1;
   }
@@ -41,13 +45,19 @@ class LidarClockConfig : public Config {
   BEGIN_CFG_MEMBER()
   uint32_t lost_check_after_machine_up_ms;
   uint32_t lost_check_after_progress_up_ms;
+  // clock updates the drift is fitted over, see LidarClockModel
+  uint32_t model_samples;
+  // an update off the fitted line by more restarts the fit
+  uint32_t model_reset_us;
   END_CFG_MEMBER()
 
  public:
   void print() {
     inno_log_info(
-        "lost_check_after_machine_up_ms=%u lost_check_after_progress_up_ms=%u",
-        lost_check_after_machine_up_ms, lost_check_after_progress_up_ms);
+        "lost_check_after_machine_up_ms=%u lost_check_after_progress_up_ms=%u "
+        "model_samples=%u model_reset_us=%u",
+        lost_check_after_machine_up_ms, lost_check_after_progress_up_ms,
+        model_samples, model_reset_us);
   }
 };
 
@@ -63,14 +73,14 @@ class PTPConfig : public Config {
 
   const char *get_type() const override { return "PTP"; }
 
-  int set_key_value_(const std::string &key, double value) override {
+  int set_key_value_(const ConfigKey &key, double value) override {
     SET_CFG(lost_timeout_ms);
     SET_CFG(print_interval);
 
     return -1;
   }
 
-  int set_key_value_(const std::string &key, const std::string value) override {
+  int set_key_value_(const ConfigKey &key, const std::string value) override {
     // no string attribute
     return -1;
   }
@@ -99,14 +109,14 @@ class NTPConfig : public Config {
 
   const char *get_type() const override { return "NTP"; }
 
-  int set_key_value_(const std::string &key, double value) override {
+  int set_key_value_(const ConfigKey &key, double value) override {
     SET_CFG(lost_timeout_ms);
     SET_CFG(print_interval);
 
     return -1;
   }
 
-  int set_key_value_(const std::string &key, const std::string value) override {
+  int set_key_value_(const ConfigKey &key, const std::string value) override {
     // no string attribute
     return -1;
   }
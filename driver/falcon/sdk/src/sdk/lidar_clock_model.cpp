@@ -0,0 +1,112 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+#include "sdk/lidar_clock_model.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+namespace innovusion {
+
+LidarClockModel::LidarClockModel() {
+  max_samples_ = 16;
+  reset_ns_ = 1000 * 1000;  // 1ms
+  restart_number_ = 0;
+  reset();
+}
+
+void LidarClockModel::set_limits(uint32_t samples, int64_t reset_ns) {
+  if (samples < 1) {
+    samples = 1;
+  } else if (samples > kMaxSamples) {
+    samples = kMaxSamples;
+  }
+  max_samples_ = samples;
+  reset_ns_ = reset_ns;
+  if (sample_number_ > max_samples_) {
+    sample_start_ = (sample_start_ + sample_number_ - max_samples_) %
+                    kMaxSamples;
+    sample_number_ = max_samples_;
+    fit_();
+  }
+}
+
+void LidarClockModel::reset() {
+  sample_start_ = 0;
+  sample_number_ = 0;
+  last_residual_ns_ = 0;
+  transform_ = LidarClockTransform();
+}
+
+bool LidarClockModel::add_sample(InnoEpNs fpga_ns, int64_t epoch_ns) {
+  bool restart = false;
+  if (sample_number_ > 0) {
+    uint32_t last = (sample_start_ + sample_number_ - 1) % kMaxSamples;
+    last_residual_ns_ = epoch_ns - transform_.to_epoch_ns(fpga_ns);
+    restart = fpga_ns <= fpga_ns_[last] ||
+              llabs(last_residual_ns_) > reset_ns_;
+  }
+  if (restart) {
+    sample_start_ = 0;
+    sample_number_ = 0;
+    restart_number_++;
+  } else if (sample_number_ == max_samples_) {
+    sample_start_ = (sample_start_ + 1) % kMaxSamples;
+    sample_number_--;
+  }
+  uint32_t k = (sample_start_ + sample_number_) % kMaxSamples;
+  fpga_ns_[k] = fpga_ns;
+  offset_ns_[k] = epoch_ns - fpga_ns;
+  sample_number_++;
+  fit_();
+  return !restart;
+}
+
+//
+// least squares over the samples, relative to the last one so that the
+// sums stay small enough for double
+//
+void LidarClockModel::fit_() {
+  uint32_t last = (sample_start_ + sample_number_ - 1) % kMaxSamples;
+  InnoEpNs x_ref = fpga_ns_[last];
+  int64_t y_ref = offset_ns_[last];
+  double sx = 0;
+  double sy = 0;
+  double sxx = 0;
+  double sxy = 0;
+  for (uint32_t i = 0; i < sample_number_; i++) {
+    uint32_t k = (sample_start_ + i) % kMaxSamples;
+    double dx = static_cast<double>(fpga_ns_[k] - x_ref);
+    double dy = static_cast<double>(offset_ns_[k] - y_ref);
+    sx += dx;
+    sy += dy;
+    sxx += dx * dx;
+    sxy += dx * dy;
+  }
+  double n = sample_number_;
+  double mean_x = sx / n;
+  double mean_y = sy / n;
+  double var_x = sxx - sx * mean_x;
+  double drift = 0;
+  if (sample_number_ > 1 && var_x > 0) {
+    drift = (sxy - sx * mean_y) / var_x;
+  }
+  static const double kMaxDrift = kMaxDriftPpm / 1e6;
+  if (drift > kMaxDrift) {
+    drift = kMaxDrift;
+  } else if (drift < -kMaxDrift) {
+    drift = -kMaxDrift;
+  }
+  // the line at the last sample
+  double y_last = mean_y - drift * mean_x;
+  transform_.fpga_base_ns = x_ref;
+  transform_.epoch_base_ns = x_ref + y_ref + llround(y_last);
+  transform_.drift_q32 = llround(drift * 4294967296.0);
+}
+
+}  // namespace innovusion
@@ -0,0 +1,111 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+#ifndef SDK_LIDAR_CLOCK_MODEL_H_
+#define SDK_LIDAR_CLOCK_MODEL_H_
+
+#include <stdint.h>
+
+#include "sdk_common/inno_lidar_packet.h"
+#include "utils/types_consts.h"
+
+namespace innovusion {
+
+//
+// fpga ns to epoch ns, integer only:
+//   epoch = epoch_base_ns + d + d * drift, d = fpga - fpga_base_ns
+// drift_q32 is the drift in 1/2^32 units, with drift_q32 == 0 it is the
+// fpga time plus a fixed offset.
+//
+struct LidarClockTransform {
+  InnoEpNs fpga_base_ns{0};
+  int64_t epoch_base_ns{0};
+  int64_t drift_q32{0};
+
+  inline int64_t to_epoch_ns(InnoEpNs fpga_ns) const {
+    int64_t d = fpga_ns - fpga_base_ns;
+    // |drift_q32| < 2^23, d * drift_q32 fits while |d| < 2^40 (~18min)
+    static const int64_t kDirectLimit = 1LL << 40;
+    int64_t drift_ns;
+    if (d < kDirectLimit && d > -kDirectLimit) {
+      drift_ns = (d * drift_q32) >> 32;
+    } else {
+      drift_ns = ((d >> 12) * drift_q32) >> 20;
+    }
+    return epoch_base_ns + d + drift_ns;
+  }
+
+  inline InnoTimestampUs to_epoch_us(InnoEpNs fpga_ns) const {
+    return to_epoch_ns(fpga_ns) / 1000.0;
+  }
+};
+
+//
+// Fits epoch - fpga (the bootup utc) of the last samples with a line,
+// so the timestamps between two clock updates follow the drift of the
+// fpga clock instead of jumping at each update. A sample off the line
+// by more than reset_ns (e.g. the master changed) or going back in fpga
+// time (the lidar restarted) starts the fit over.
+// It is part of libinnolidarsdk only. The apollo driver links the
+// prebuilt sdk/lib, which predates it, and keeps the plain bootup utc
+// offset until those libs are rebuilt.
+//
+class LidarClockModel {
+ public:
+  static const uint32_t kMaxSamples = 64;
+  // a fitted drift beyond is clamped
+  static const int64_t kMaxDriftPpm = 1000;
+
+ public:
+  LidarClockModel();
+  ~LidarClockModel() {
+  }
+
+  // samples is clamped to [1, kMaxSamples], the history is kept
+  void set_limits(uint32_t samples, int64_t reset_ns);
+  void reset();
+  // the fpga time of an epoch time, false if the history was restarted
+  bool add_sample(InnoEpNs fpga_ns, int64_t epoch_ns);
+
+  const LidarClockTransform &get_transform() const {
+    return transform_;
+  }
+  uint32_t get_sample_number() const {
+    return sample_number_;
+  }
+  double get_drift_ppm() const {
+    return transform_.drift_q32 * 1e6 / 4294967296.0;
+  }
+  // of the last sample to the line before it
+  int64_t get_last_residual_ns() const {
+    return last_residual_ns_;
+  }
+  uint32_t get_restart_number() const {
+    return restart_number_;
+  }
+
+ private:
+  void fit_();
+
+ private:
+  uint32_t max_samples_;
+  int64_t reset_ns_;
+
+  // ring of the last max_samples_ samples, offset is epoch - fpga
+  InnoEpNs fpga_ns_[kMaxSamples];
+  int64_t offset_ns_[kMaxSamples];
+  uint32_t sample_start_;
+  uint32_t sample_number_;
+
+  LidarClockTransform transform_;
+  int64_t last_residual_ns_;
+  uint32_t restart_number_;
+};
+
+}  // namespace innovusion
+#endif  // SDK_LIDAR_CLOCK_MODEL_H_
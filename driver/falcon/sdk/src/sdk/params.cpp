@@ -8,150 +8,355 @@
 
 #include "sdk/params.h"
 
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
+#include <atomic>
 #include <cmath>
 #include <fstream>
 #include <iostream>
 #include <limits>
 #include <map>
+#include <mutex>  // NOLINT
 #include <sstream>
 #include <string>
 
+#include "sdk_common/inno_lidar_api.h"
 #include "sdk_common/inno_lidar_packet.h"
+#include "utils/config.h"
 #include "utils/inno_lidar_log.h"
+#include "utils/md5.h"
 
 namespace innovusion {
-class SimpleYAMLParser {
- public:
-  SimpleYAMLParser() {
-  }
+#include "sdk/iv_params_code_gen.gen_cc"
 
-  ~SimpleYAMLParser() {
-  }
+static const size_t kIvParamFieldNumber =
+    sizeof(kIvParamFields) / sizeof(kIvParamFields[0]);
 
-  bool load_yaml(const char *file) {
-    return simple_read_yaml_file(file, &nvp_);
-  }
+static constexpr size_t iv_param_type_size(IvParamType type) {
+  return type == IV_PARAM_INT ? sizeof(int) :
+         type == IV_PARAM_DOUBLE ? sizeof(double) : sizeof(float);
+}
 
-  std::string to_string() {
-    std::stringstream ss;
-    for (std::map<std::string, std::string>::const_iterator it = nvp_.begin();
-         it != nvp_.end();
-         ++it) {
-      ss << it->first << ": " << it->second << "\n";
-    }
-    return ss.str();
+// find_field() does a binary search on the hash
+static constexpr bool iv_param_fields_sorted(size_t i) {
+  return i >= kIvParamFieldNumber ||
+         (kIvParamFields[i - 1].hash <= kIvParamFields[i].hash &&
+          iv_param_fields_sorted(i + 1));
+}
+
+static constexpr bool iv_param_fields_match(size_t i) {
+  return i >= kIvParamFieldNumber ||
+         (kIvParamFields[i].count > 0 &&
+          kIvParamFields[i].count * iv_param_type_size(kIvParamFields[i].type)
+          == kIvParamFields[i].size &&
+          iv_param_fields_match(i + 1));
+}
+
+static_assert(iv_param_fields_sorted(1),
+              "kIvParamFields is not sorted by hash");
+static_assert(iv_param_fields_match(0),
+              "kIvParamFields type or count differs from IvParams");
+static const char kCacheMagic[8] = "INNOPRM";
+/*
+ * the cache holds IvParams after the unit conversions of parse() and
+ * set_default_for_missing(), bump it with any change to them
+ */
+static const uint32_t kCacheVersion = 1;
+static std::mutex cache_dir_mutex;
+static char cache_dir[PATH_MAX] = "/tmp/inno_params_cache";
+
+/* written before the IvParams in a cache file */
+struct ParamsCacheHeader {
+  char magic[8];
+  uint32_t version;  // kCacheVersion
+  uint32_t layout;  // changes with the IvParams fields
+  uint32_t size;
+  unsigned char md5[16];
+  char sdk[64];  // SDK version and build tag that wrote it
+};
+
+static void cache_sdk(char *sdk, size_t size) {
+  memset(sdk, 0, size);
+  snprintf(sdk, size, "%s %s", inno_api_version(), inno_api_build_tag());
+}
+
+static uint32_t params_layout() {
+  uint32_t h = ConfigKey::hash_of("");
+  for (size_t i = 0; i < kIvParamFieldNumber; i++) {
+    const IvParamField &f = kIvParamFields[i];
+    uint32_t v[4] = {f.hash, f.type, static_cast<uint32_t>(f.offset),
+                     f.count};
+    h = (h ^ ConfigKey::hash_of(reinterpret_cast<const char *>(v),
+                                sizeof(v))) * ConfigKey::kHashPrime;
   }
+  return h;
+}
 
-  void get_param_value_from_map(const char *name, int *value) const {
-    if (nvp_.find(name) == nvp_.end()) {
-      *value = 0;
+static const IvParamField *find_field(const char *name, size_t size) {
+  uint32_t hash = ConfigKey::hash_of(name, size);
+  size_t lo = 0;
+  size_t hi = kIvParamFieldNumber;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (kIvParamFields[mid].hash < hash) {
+      lo = mid + 1;
     } else {
-      *value = atoi(nvp_.find(name)->second.c_str());
+      hi = mid;
     }
   }
-
-  void get_param_value_from_map(const char *name, double *value) const {
-    if (nvp_.find(name) == nvp_.end()) {
-      *value = 0;
-    } else {
-      *value = atof(nvp_.find(name)->second.c_str());
+  for (; lo < kIvParamFieldNumber && kIvParamFields[lo].hash == hash; lo++) {
+    const IvParamField &f = kIvParamFields[lo];
+    if (strncmp(f.name, name, size) == 0 && f.name[size] == 0) {
+      return &f;
     }
   }
+  return NULL;
+}
 
-  void get_param_value_from_map(const char *name, float *value) const {
-    if (nvp_.find(name) == nvp_.end()) {
-      *value = 0;
-    } else {
-      *value = atof(nvp_.find(name)->second.c_str());
+/*
+ * name is a scalar field or <array field>_<index>, like the keys the
+ * generated setters used to look up. value ends at a space or newline.
+ */
+static void set_param(IvParams *params, const char *name, size_t size,
+                      const char *value) {
+  const IvParamField *field = find_field(name, size);
+  uint32_t index = 0;
+  if (field == NULL || field->count != 1) {
+    size_t digits = size;
+    while (digits > 0 && name[digits - 1] >= '0' && name[digits - 1] <= '9') {
+      digits--;
+    }
+    size_t n = size - digits;
+    // no leading 0, index was printed with <<
+    if (n == 0 || n > 9 || digits < 2 || name[digits - 1] != '_' ||
+        (n > 1 && name[digits] == '0')) {
+      return;
+    }
+    for (size_t i = digits; i < size; i++) {
+      index = index * 10 + (name[i] - '0');
     }
+    field = find_field(name, digits - 1);
+    if (field == NULL || field->count == 1 || index >= field->count) {
+      return;
+    }
+  }
+  char *p = reinterpret_cast<char *>(params) + field->offset;
+  switch (field->type) {
+    case IV_PARAM_INT:
+      reinterpret_cast<int *>(p)[index] = atoi(value);
+      break;
+    case IV_PARAM_DOUBLE:
+      reinterpret_cast<double *>(p)[index] = atof(value);
+      break;
+    case IV_PARAM_FLOAT:
+      reinterpret_cast<float *>(p)[index] = atof(value);
+      break;
   }
+}
 
- private:
-  // trim from left
-  static inline std::string& ltrim_line(std::string *s,
-                                        const char *t = " \t\n\r\f\v") {
-    s->erase(0, s->find_first_not_of(t));
-    return *s;
-  }
-
-  // trim from right
-  inline std::string& rtrim_line(std::string *s,
-                                 const char *t = " \t\n\r\f\v") {
-    s->erase(s->find_last_not_of(t) + 1);
-    return *s;
-  }
-
-  // trim from left & right
-  inline std::string& trim_line(std::string *s,
-                                const char *t = " \t\n\r\f\v") {
-    return ltrim_line(&rtrim_line(s, t), t);
-  }
-
-  bool simple_read_yaml_file(const char *yaml,
-                             std::map<std::string, std::string> *nvp) {
-    inno_log_trace("yaml %s", yaml);
-    std::istringstream infile(yaml);
-    std::string line;
-    std::string key;
-    int array_mode = 0;
-    while (std::getline(infile, line)) {
-      inno_log_trace("%s", line.c_str());
-      trim_line(&line);
-      std::istringstream is_line(line);
-      if (line.find(':') != std::string::npos) {
-        std::getline(is_line, key, ':');
-        // std::cout << "key= " << key << "\n";
-        array_mode = 0;
-        if (key[0] == '#') {
-          continue;
-        }
-        std::string value;
-        if (std::getline(is_line, value)) {
-          trim_line(&value);
-          if (value == "") {
-            // std::cout << "array\n";
-            array_mode = 1;
-          } else {
-            (*nvp)[key] = value;
-            // std::cout << key << " = " << value << "\n";
-          }
-        } else {
-          // std::cout << "array\n";
-          array_mode = 1;
-        }
+static inline void trim_line(const char **start, const char **end) {
+  while (*start < *end && isspace(static_cast<unsigned char>(**start))) {
+    (*start)++;
+  }
+  while (*end > *start && isspace(static_cast<unsigned char>((*end)[-1]))) {
+    (*end)--;
+  }
+}
+
+/*
+ * one pass over the yaml in place, without allocation:
+ *   name: value
+ *   name:
+ *     - value of name_0
+ *     - value of name_1
+ * fields that are not in the yaml are 0.
+ */
+void LidarParams::parse_yaml(const char *yaml, IvParams *params) {
+  inno_log_trace("yaml %s", yaml);
+  memset(params, 0, sizeof(*params));
+  const char *key = NULL;
+  size_t key_size = 0;
+  uint32_t array_mode = 0;
+  char name[128];
+  const char *p = yaml;
+  while (*p) {
+    const char *line = p;
+    const char *end = strchr(p, '\n');
+    if (end) {
+      p = end + 1;
+    } else {
+      end = line + strlen(line);
+      p = end;
+    }
+    trim_line(&line, &end);
+    const char *colon = reinterpret_cast<const char *>(
+        memchr(line, ':', end - line));
+    if (colon) {
+      key = line;
+      key_size = colon - line;
+      array_mode = 0;
+      if (key_size > 0 && key[0] == '#') {
+        continue;
+      }
+      const char *value = colon + 1;
+      trim_line(&value, &end);
+      if (value == end) {
+        array_mode = 1;
       } else {
-        if (array_mode) {
-          std::string value;
-          if (line.find('-') != std::string::npos) {
-            std::getline(is_line, value, '-');
-            if (std::getline(is_line, value)) {
-              // std::cout << "value:" << value << "\n";
-              trim_line(&value);
-              if (value != "") {
-                std::stringstream ss;
-                ss << array_mode - 1;
-                std::string s = ss.str();
-                std::string ka = key + "_" + s;
-                (*nvp)[ka] = value;
-                // std::cout << ka << " = " << value << "\n";
-                array_mode++;
-              }
-            }
-          }
+        set_param(params, key, key_size, value);
+      }
+    } else if (array_mode) {
+      const char *dash = reinterpret_cast<const char *>(
+          memchr(line, '-', end - line));
+      if (dash == NULL) {
+        continue;
+      }
+      const char *value = dash + 1;
+      trim_line(&value, &end);
+      if (value == end) {
+        continue;
+      }
+      if (key_size + 12 <= sizeof(name)) {
+        // name_<index>
+        char digits[10];
+        size_t n = 0;
+        uint32_t index = array_mode - 1;
+        do {
+          digits[n++] = '0' + index % 10;
+          index /= 10;
+        } while (index);
+        size_t size = key_size;
+        memcpy(name, key, key_size);
+        name[size++] = '_';
+        while (n) {
+          name[size++] = digits[--n];
         }
+        set_param(params, name, size, value);
       }
+      array_mode++;
     }
-    return true;
   }
+}
 
- private:
-  std::map<std::string, std::string> nvp_;
-};
+const IvParamField *LidarParams::get_fields(size_t *number) {
+  *number = kIvParamFieldNumber;
+  return kIvParamFields;
+}
 
-#include "sdk/iv_params_code_gen.gen_cc"
+void LidarParams::set_cache_dir(const char *dir) {
+  std::unique_lock<std::mutex> lk(cache_dir_mutex);
+  snprintf(cache_dir, sizeof(cache_dir), "%s", dir ? dir : "");
+}
+
+bool LidarParams::open_cache_dir_(char *dir, size_t dir_size) {
+  {
+    std::unique_lock<std::mutex> lk(cache_dir_mutex);
+    snprintf(dir, dir_size, "%s", cache_dir);
+  }
+  if (dir[0] == 0) {
+    return false;
+  }
+  if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+    inno_log_warning_errno("cannot create params cache dir %s", dir);
+    return false;
+  }
+  // others must not be able to plant params
+  struct stat st;
+  if (lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) ||
+      st.st_uid != geteuid() || (st.st_mode & 077) != 0) {
+    inno_log_warning("params cache dir %s is not private, not used", dir);
+    return false;
+  }
+  return true;
+}
+
+bool LidarParams::load_cache_(const unsigned char *md5) {
+  char dir[PATH_MAX];
+  if (!open_cache_dir_(dir, sizeof(dir))) {
+    return false;
+  }
+  char md5_str[33];
+  MD5_print(md5_str, sizeof(md5_str), md5);
+  char filename[PATH_MAX + 64];
+  snprintf(filename, sizeof(filename), "%s/%s.bin", dir, md5_str);
+  int fd = open(filename, O_RDONLY | O_NOFOLLOW);
+  if (fd < 0) {
+    return false;
+  }
+  ParamsCacheHeader header;
+  struct iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = &iv_params;
+  iov[1].iov_len = sizeof(iv_params);
+  ssize_t r = readv(fd, iov, 2);
+  close(fd);
+  char sdk[sizeof(header.sdk)];
+  cache_sdk(sdk, sizeof(sdk));
+  // written by another SDK the values may differ, it is parsed again
+  if (r == static_cast<ssize_t>(sizeof(header) + sizeof(iv_params)) &&
+      memcmp(header.magic, kCacheMagic, sizeof(header.magic)) == 0 &&
+      header.version == kCacheVersion &&
+      memcmp(header.sdk, sdk, sizeof(sdk)) == 0 &&
+      header.layout == params_layout() &&
+      header.size == sizeof(iv_params) &&
+      memcmp(header.md5, md5, sizeof(header.md5)) == 0) {
+    inno_log_info("params from cache %s", filename);
+    return true;
+  }
+  inno_log_warning("bad params cache %s", filename);
+  return false;
+}
+
+void LidarParams::save_cache_(const unsigned char *md5) {
+  char dir[PATH_MAX];
+  if (!open_cache_dir_(dir, sizeof(dir))) {
+    return;
+  }
+  char md5_str[33];
+  MD5_print(md5_str, sizeof(md5_str), md5);
+  char filename[PATH_MAX + 64];
+  char tmp_filename[PATH_MAX + 64];
+  snprintf(filename, sizeof(filename), "%s/%s.bin", dir, md5_str);
+  static std::atomic<uint32_t> tmp_seq(0);
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s/%s.%d.%u.tmp",
+           dir, md5_str, getpid(), tmp_seq++);
+  int fd = open(tmp_filename, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW,
+                0600);
+  if (fd < 0) {
+    inno_log_warning_errno("cannot create %s", tmp_filename);
+    return;
+  }
+  ParamsCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kCacheMagic, sizeof(header.magic));
+  header.version = kCacheVersion;
+  cache_sdk(header.sdk, sizeof(header.sdk));
+  header.layout = params_layout();
+  header.size = sizeof(iv_params);
+  memcpy(header.md5, md5, sizeof(header.md5));
+  struct iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = &iv_params;
+  iov[1].iov_len = sizeof(iv_params);
+  ssize_t w = writev(fd, iov, 2);
+  close(fd);
+  // readers see the whole file or none
+  if (w != static_cast<ssize_t>(sizeof(header) + sizeof(iv_params)) ||
+      rename(tmp_filename, filename) != 0) {
+    inno_log_warning_errno("cannot write params cache %s", filename);
+    unlink(tmp_filename);
+  }
+}
 
 int LidarParams::read(const char *filename) {
   std::string file_fullpath = filename;
@@ -212,29 +417,33 @@ int LidarParams::read(const char *filename) {
 
 int LidarParams::parse(const char *yaml) {
   initialized = false;
-  try {
-    SimpleYAMLParser p;
-    p.load_yaml(yaml);
-    get_params_from_simple_parser(p, &iv_params);
+  unsigned char md5[16];
+  MD5_CTX md5_ctx;
+  MD5_Init(&md5_ctx);
+  MD5_Update(&md5_ctx, yaml, strlen(yaml));
+  MD5_Final(md5, &md5_ctx);
+  if (load_cache_(md5)) {
+    initialized = true;
+    inno_log_info("Use YAML file init=%d", initialized);
+    inno_log_info("YAML file content:\n%s", to_string().c_str());
+    return 0;
+  }
 
-    for (int i = 0; i < 3; i++) {
-      iv_params.ctr[i] = pow(10, iv_params.ctr[i]/10.0);
-    }
-    iv_params.tilt_n_x = sin(iv_params.tilt_angle * M_PI / 180.0);
-    iv_params.tilt_n_z = cos(iv_params.tilt_angle * M_PI / 180.0);
-    iv_params.shift_n_y = sin(iv_params.shift_angle * M_PI / 180.0);
-    iv_params.shift_n_z = cos(iv_params.shift_angle * M_PI / 180.0);
-
-    // convert from meter to distance unit
-    iv_params.k_dis *= kInnoDistanceUnitPerMeter;
-    iv_params.k_dis_2 *= kInnoDistanceUnitPerMeter;
-    for (int i = 0; i < 4; i++) {
-      iv_params.distance_correction[i] *= kInnoDistanceUnitPerMeter;
-      iv_params.distance_correction_2[i] *= kInnoDistanceUnitPerMeter;
-    }
-  } catch (...) {
-    inno_log_error("Invalid YAML file");
-    return !initialized;
+  parse_yaml(yaml, &iv_params);
+  for (int i = 0; i < 3; i++) {
+    iv_params.ctr[i] = pow(10, iv_params.ctr[i]/10.0);
+  }
+  iv_params.tilt_n_x = sin(iv_params.tilt_angle * M_PI / 180.0);
+  iv_params.tilt_n_z = cos(iv_params.tilt_angle * M_PI / 180.0);
+  iv_params.shift_n_y = sin(iv_params.shift_angle * M_PI / 180.0);
+  iv_params.shift_n_z = cos(iv_params.shift_angle * M_PI / 180.0);
+
+  // convert from meter to distance unit
+  iv_params.k_dis *= kInnoDistanceUnitPerMeter;
+  iv_params.k_dis_2 *= kInnoDistanceUnitPerMeter;
+  for (int i = 0; i < 4; i++) {
+    iv_params.distance_correction[i] *= kInnoDistanceUnitPerMeter;
+    iv_params.distance_correction_2[i] *= kInnoDistanceUnitPerMeter;
   }
 
   // check if important params are set
@@ -243,6 +452,7 @@ int LidarParams::parse(const char *yaml) {
   } else {
     initialized = true;
     set_default_for_missing();
+    save_cache_(md5);
     inno_log_info("Use YAML file init=%d", initialized);
     inno_log_info("YAML file content:\n%s", to_string().c_str());
   }
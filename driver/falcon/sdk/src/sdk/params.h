@@ -9,11 +9,31 @@
 #ifndef SDK_PARAMS_H_
 #define SDK_PARAMS_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <map>
 #include <string>
 
 namespace innovusion {
 #include "sdk/iv_params_code_gen.gen_h"
+
+enum IvParamType {
+  IV_PARAM_INT = 0,
+  IV_PARAM_DOUBLE = 1,
+  IV_PARAM_FLOAT = 2,
+};
+
+/* an IvParams field set by the YAML file, array items are name_<index> */
+struct IvParamField {
+  const char *name;
+  uint32_t hash;  // ConfigKey::hash_of(name)
+  IvParamType type;
+  size_t offset;
+  uint32_t count;
+  uint32_t size;  // sizeof the IvParams member
+};
+
 class LidarParams {
  public:
   LidarParams()
@@ -41,6 +61,24 @@ class LidarParams {
     return version;
   }
 
+  /* fill params from yaml in one pass, the fields not in it are 0 */
+  static void parse_yaml(const char *yaml, IvParams *params);
+  /* all the fields, sorted by hash */
+  static const IvParamField *get_fields(size_t *number);
+  /*
+   * parsed params are cached in dir as <md5 of the YAML>.bin, the dir
+   * must be owned by the user and not accessible by others.
+   * NULL disables the cache. A cache file written by another SDK
+   * version or build is not used. Thread safe, takes effect for the
+   * lidars opened after it.
+   */
+  static void set_cache_dir(const char *dir);
+
+ private:
+  static bool open_cache_dir_(char *dir, size_t dir_size);
+  bool load_cache_(const unsigned char *md5);
+  void save_cache_(const unsigned char *md5);
+
  public:
   IvParams iv_params;
 
@@ -12,6 +12,7 @@
 #include <mutex>  // NOLINT
 
 #include "sdk_common/inno_lidar_packet.h"
+#include "sdk/lidar_clock_model.h"
 #include "sdk/stage_signal.h"
 #include "utils/log.h"
 #include "utils/types_consts.h"
@@ -319,6 +320,7 @@ class ScanLines {
     ref_count_ = 1;
     time_sync_state = INNO_TIME_SYNC_TYPE_NONE;
     host_lidar_time_diff_sec = 0;
+    clock_transform = LidarClockTransform();
     auto_galvo_mode_ = INNO_GALVO_MODE_NONE;
 
     memset(stage_ts, 0, sizeof(stage_ts));
@@ -640,6 +642,7 @@ class ScanLines {
 
   enum InnoTimeSyncType time_sync_state;
   double host_lidar_time_diff_sec;
+  LidarClockTransform clock_transform;
 
   InnoEpSecondDouble stage_ts[STAGE_TIME_MAX];
 
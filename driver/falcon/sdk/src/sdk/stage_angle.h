@@ -50,21 +50,21 @@ class StageAngleConfig: public Config {
     return "Lidar_StageAngle";
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                              double value) override {
-    if (strcmp(key.c_str(), "fov_top_left_angle") == 0 ||
-        strcmp(key.c_str(), "fov_top_right_angle") == 0 ||
-        strcmp(key.c_str(), "fov_top_low_angle") == 0 ||
-        strcmp(key.c_str(), "fov_top_high_angle") == 0 ||
-        strcmp(key.c_str(), "filt_intensity_galvo_angle") == 0 ||
-        strcmp(key.c_str(), "fov_left_cal") == 0 ||
-        strcmp(key.c_str(), "fov_right_cal") == 0 ||
-        strcmp(key.c_str(), "fov_bottom_cal") == 0 ||
-        strcmp(key.c_str(), "fov_up_cal") == 0 ||
-        strcmp(key.c_str(), "galvo_tracking_angle_threshold") == 0) {
+    if (CFG_KEY_IS("fov_top_left_angle") ||
+        CFG_KEY_IS("fov_top_right_angle") ||
+        CFG_KEY_IS("fov_top_low_angle") ||
+        CFG_KEY_IS("fov_top_high_angle") ||
+        CFG_KEY_IS("filt_intensity_galvo_angle") ||
+        CFG_KEY_IS("fov_left_cal") ||
+        CFG_KEY_IS("fov_right_cal") ||
+        CFG_KEY_IS("fov_bottom_cal") ||
+        CFG_KEY_IS("fov_up_cal") ||
+        CFG_KEY_IS("galvo_tracking_angle_threshold")) {
       value *= kInnoAngleUnitPerDegree;
-    } else if (strcmp(key.c_str(), "cross_talk_distance1") == 0 ||
-               strcmp(key.c_str(), "cross_talk_distance2") == 0) {
+    } else if (CFG_KEY_IS("cross_talk_distance1") ||
+               CFG_KEY_IS("cross_talk_distance2")) {
       value *= kInnoDistanceUnitPerMeter;
     }
     SET_CFG(fov_top_left_angle);
@@ -84,7 +84,7 @@ class StageAngleConfig: public Config {
     return -1;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      const std::string value) override {
     // no string attribute
     return -1;
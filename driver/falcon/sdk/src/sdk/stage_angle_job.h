@@ -24,12 +24,13 @@ class StageAngleJobPool {
                     unsigned int block_number =
                     ScanLine::kMaxBlocksBetweenP +
                     ScanLine::kMaxBlocksInScanLine * 2,
-                    uint32_t encodes_pre_polygon = 1)
+                    uint32_t encodes_pre_polygon = 1,
+                    int huge_page = HUGE_PAGE_OFF)
       : pool_(name,
               sizeof(StageAngleJob) +
               sizeof(RawBlock) * block_number,
               unit_number,
-              64)
+              64, false, huge_page)
       , payload_size_(block_number)
       , encodes_pre_polygon_(encodes_pre_polygon) {
     inno_log_info("sizeof(StageAngleJob)=%" PRI_SIZELU " 0x%" PRI_SIZELX
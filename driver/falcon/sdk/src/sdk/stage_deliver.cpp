@@ -247,7 +247,7 @@ int StageDeliver::process(void *in_job, void *ctx,
   current_block = 0;                                                    \
   start_trigger_time = raw_block->trigger_ts_ns;                        \
   packet->common.ts_start_us =                                          \
-    LidarClock::to_epoch_us_(start_trigger_time, host_lidar_time_diff_sec);
+    clock_transform.to_epoch_us(start_trigger_time);
 
 // process_job_ exceeding 500 lines
 // move some code in this function
@@ -413,7 +413,7 @@ int StageDeliver::process_job_(StageAngleJob *job, bool prefer) {
   InnoChannelPoint *inno_points;
   RawBlock *raw_block = &job->blocks[job->lines[0].active_blocks_start];
   RawChannelPoint *raw_point = NULL;
-  double host_lidar_time_diff_sec = job->host_lidar_time_diff_sec;
+  const LidarClockTransform &clock_transform = job->clock_transform;
   InnoEpNs start_trigger_time;
   int current_block = 0;
   size_t total_points = 0;
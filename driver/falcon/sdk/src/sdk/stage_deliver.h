@@ -48,19 +48,19 @@ class StageDeliverConfig: public Config {
     return "Lidar_StageDeliver";
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                              double value) override {
-    if (strcmp(key.c_str(), "hori_roi_size") == 0) {
+    if (CFG_KEY_IS("hori_roi_size")) {
       value *= kInnoAngleUnitPerDegree / 2;
-    } else if (strcmp(key.c_str(), "flyback_angle_threshold") == 0 ||
-               strcmp(key.c_str(), "blooming_min_vert_angle_diff") == 0 ||
-               strcmp(key.c_str(), "blooming_max_vert_angle_diff") == 0) {
+    } else if (CFG_KEY_IS("flyback_angle_threshold") ||
+               CFG_KEY_IS("blooming_min_vert_angle_diff") ||
+               CFG_KEY_IS("blooming_max_vert_angle_diff")) {
       value *= kInnoAngleUnitPerDegree;
-    } else if (strcmp(key.c_str(), "min_distance") == 0 ||
-               strcmp(key.c_str(), "max_distance") == 0 ||
-               strcmp(key.c_str(), "blooming_up_distance_diff") == 0 ||
-               strcmp(key.c_str(), "blooming_down_distance_diff") == 0 ||
-               strcmp(key.c_str(), "retro_distance_diff") == 0) {
+    } else if (CFG_KEY_IS("min_distance") ||
+               CFG_KEY_IS("max_distance") ||
+               CFG_KEY_IS("blooming_up_distance_diff") ||
+               CFG_KEY_IS("blooming_down_distance_diff") ||
+               CFG_KEY_IS("retro_distance_diff")) {
       value *= kInnoDistanceUnitPerMeter;
     }
     SET_CFG(published_frames);
@@ -84,7 +84,7 @@ class StageDeliverConfig: public Config {
     return -1;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      const std::string value) override {
     // no string attribute
     return -1;
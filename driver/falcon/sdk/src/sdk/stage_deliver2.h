@@ -27,12 +27,12 @@ class StageDeliver2Config: public Config {
     return "Lidar_StageDeliver2";
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                              double value) override {
     return -1;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      const std::string value) override {
     // no string attribute
     return -1;
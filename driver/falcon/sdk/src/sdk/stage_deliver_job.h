@@ -23,11 +23,12 @@ class StageDeliverPointsJobPool {
  public:
   StageDeliverPointsJobPool(const char *name,
                             unsigned int unit_number,
-                            unsigned int block_number)
+                            unsigned int block_number,
+                            int huge_page = HUGE_PAGE_OFF)
       : pool_(name,
               sizeof(InnoDataPacket) + sizeof(InnoBlock2) * block_number,
               unit_number,
-              32)
+              32, false, huge_page)
       , payload_size_(block_number) {
   }
 
@@ -55,15 +55,15 @@ class StageNoiseFilterConfig: public Config {
     return "Lidar_StageNoiseFilter";
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                              double value) override {
-    if (strcmp(key.c_str(), "filter_threshold") == 0 ||
-        strcmp(key.c_str(), "filter_threshold_2") == 0 ||
-        strcmp(key.c_str(), "road_point_filter_threshold") == 0 ||
-        strcmp(key.c_str(), "filter_threshold_s") == 0 ||
-        strcmp(key.c_str(), "filter_threshold_2_s") == 0 ||
-        strcmp(key.c_str(), "near_field_distance") == 0 ||
-        strcmp(key.c_str(), "near_field_filter_threshold") == 0) {
+    if (CFG_KEY_IS("filter_threshold") ||
+        CFG_KEY_IS("filter_threshold_2") ||
+        CFG_KEY_IS("road_point_filter_threshold") ||
+        CFG_KEY_IS("filter_threshold_s") ||
+        CFG_KEY_IS("filter_threshold_2_s") ||
+        CFG_KEY_IS("near_field_distance") ||
+        CFG_KEY_IS("near_field_filter_threshold")) {
       value *= kInnoDistanceUnitPerMeter;
     }
     SET_CFG(roi_pattern);
@@ -96,7 +96,7 @@ class StageNoiseFilterConfig: public Config {
     return -1;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      const std::string value) override {
     // no string attribute
     return -1;
@@ -36,13 +36,13 @@ class StageReadConfig: public Config {
     return "Lidar_StageRead";
   }
 
-  int set_key_value_(const std::string &key, double value) override {
+  int set_key_value_(const ConfigKey &key, double value) override {
     SET_CFG(file_read_block);
     SET_CFG(mem_read_block);
     return -1;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                              const std::string value) override {
     // no string attribute
     return -1;
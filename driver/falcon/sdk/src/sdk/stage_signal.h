@@ -100,25 +100,25 @@ class StageSignalConfig: public Config {
     return "Lidar_StageSignal";
   }
 
-  int set_key_value_(const std::string &key, double value) override {
-    if (strcmp(key.c_str(), "exclude_distance") == 0 ||
-        strcmp(key.c_str(), "min_distance") == 0 ||
-        strcmp(key.c_str(), "max_distance") == 0 ||
-        strcmp(key.c_str(), "sw_start") == 0 ||
-        strcmp(key.c_str(), "sw_end") == 0) {
+  int set_key_value_(const ConfigKey &key, double value) override {
+    if (CFG_KEY_IS("exclude_distance") ||
+        CFG_KEY_IS("min_distance") ||
+        CFG_KEY_IS("max_distance") ||
+        CFG_KEY_IS("sw_start") ||
+        CFG_KEY_IS("sw_end")) {
       value *= kInnoDistanceUnitPerMeter;
-    } else if (strcmp(key.c_str(), "g_encoder_delay") == 0 ||
-               strcmp(key.c_str(), "time_sync_packet_timeout") == 0 ||
-               strcmp(key.c_str(), "time_sync_packet_timeout_ntp") == 0 ||
-               strcmp(key.c_str(), "time_sync_ignore_jobs") == 0) {
+    } else if (CFG_KEY_IS("g_encoder_delay") ||
+               CFG_KEY_IS("time_sync_packet_timeout") ||
+               CFG_KEY_IS("time_sync_packet_timeout_ntp") ||
+               CFG_KEY_IS("time_sync_ignore_jobs")) {
       value *= 1000;
-    } else if (strcmp(key.c_str(), "ref_window_center") == 0 ||
-               strcmp(key.c_str(), "ref_window_half_width_init") == 0 ||
-               strcmp(key.c_str(), "ref_window_half_width_init_yaml") == 0 ||
-               strcmp(key.c_str(), "ref_window_half_width_min") == 0 ||
-               strcmp(key.c_str(), "ref_window_half_width_max") == 0 ||
-               strcmp(key.c_str(), "ref_window_left_limit") == 0 ||
-               strcmp(key.c_str(), "ref_window_right_limit") == 0) {
+    } else if (CFG_KEY_IS("ref_window_center") ||
+               CFG_KEY_IS("ref_window_half_width_init") ||
+               CFG_KEY_IS("ref_window_half_width_init_yaml") ||
+               CFG_KEY_IS("ref_window_half_width_min") ||
+               CFG_KEY_IS("ref_window_half_width_max") ||
+               CFG_KEY_IS("ref_window_left_limit") ||
+               CFG_KEY_IS("ref_window_right_limit")) {
       value *= 32;
     }
     SET_CFG(ref_window_center);
@@ -163,7 +163,7 @@ class StageSignalConfig: public Config {
     return -1;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      const std::string value) override {
     // no string attribute
     return -1;
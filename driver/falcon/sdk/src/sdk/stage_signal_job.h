@@ -155,11 +155,12 @@ class StageSignalJobPool {
                      unsigned int unit_number,
                      size_t write_block_size,
                      size_t max_leftover_size,
-                     unsigned int alignment = 32)
+                     unsigned int alignment = 32,
+                     int huge_page = HUGE_PAGE_OFF)
       : pool_(name,
               sizeof(StageSignalJob) + write_block_size + max_leftover_size,
               unit_number,
-              alignment)
+              alignment, false, huge_page)
       , write_block_size_(write_block_size)
       , max_leftover_size_(max_leftover_size) {
   }
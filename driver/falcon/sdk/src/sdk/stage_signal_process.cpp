@@ -759,6 +759,8 @@ void StageSignal::process_encoder_polygon_(InnoFpgaNs fpga_ns,
     double diff;
     enum InnoTimeSyncType state =
         lidar_->get_clock().get_sync_state_and_diff(&diff);
+    lidar_->get_clock().get_sync_state_and_transform(
+        &cur_lines_->clock_transform);
 
     // xxx todo: switch to a new cur_lines_ if state changes
     cur_lines_->time_sync_state = state;
@@ -30,13 +30,13 @@ class StatusReportConfig: public Config {
     return "Lidar_StatusReport";
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      double value) override {
     SET_CFG(interval_ms);
     return -1;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      const std::string value) override {
     SET_CFG(interface_name);
     return -1;
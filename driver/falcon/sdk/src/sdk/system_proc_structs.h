@@ -9,92 +9,205 @@
 #ifndef SDK_SYSTEM_PROC_STRUCTS_H_
 #define SDK_SYSTEM_PROC_STRUCTS_H_
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
 #ifndef __MINGW64__
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #else
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdint.h>
-
-// if typedef doesn't exist (msvc, blah)
-typedef intptr_t ssize_t;
+#include <ws2tcpip.h>
+#endif
+#include <sys/stat.h>
+#include <utils/inno_lidar_log.h>
+#include "sdk/system_stats.h"
 
-ssize_t getline(char **lineptr, size_t *n, FILE *stream) {
-  size_t pos;
-  int c;
+namespace innovusion {
 
-  if (lineptr == NULL || stream == NULL || n == NULL) {
-    errno = EINVAL;
-    return -1;
+/*
+ * A /proc or /sys file that is opened once and re-read from offset 0
+ * with pread() into a fixed buffer, so a sample costs neither an
+ * open()/close() pair nor a heap allocation. Files longer than the
+ * buffer are truncated, only the head of /proc/stat is used.
+ */
+class ProcFile {
+ public:
+  static const size_t kBufferSize = 4096;
+
+ public:
+  ProcFile(const char *lidar_name, const char *filename)
+      : lidar_name_(lidar_name)
+      , fd_(-1)
+      , open_failed_(false) {
+    snprintf(filename_, sizeof(filename_), "%s", filename);
+    buffer_[0] = 0;
+    open_();
   }
 
-  c = getc(stream);
-  if (c == EOF) {
-    return -1;
+  ~ProcFile() {
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
   }
 
-  if (*lineptr == NULL) {
-    *lineptr = malloc(128);
-    if (*lineptr == NULL) {
+  // return the length read or -1, data() is NUL terminated
+  ssize_t read() {
+    buffer_[0] = 0;
+    if (fd_ < 0 && !open_()) {
       return -1;
     }
-    *n = 128;
+#ifdef __linux__
+    ssize_t r = pread(fd_, buffer_, sizeof(buffer_) - 1, 0);
+    if (r < 0) {
+      inno_log_error_errno("%s cannot read %s", lidar_name_, filename_);
+      // reopen at the next sample
+      close(fd_);
+      fd_ = -1;
+      return -1;
+    }
+    buffer_[r] = 0;
+    return r;
+#else
+    return -1;
+#endif
+  }
+
+  const char *data() const {
+    return buffer_;
   }
 
-  pos = 0;
-  while (c != EOF) {
-    if (pos + 1 >= *n) {
-      size_t new_size = *n + (*n >> 2);
-      if (new_size < 128) {
-        new_size = 128;
+  const char *get_filename() const {
+    return filename_;
+  }
+
+ private:
+  bool open_() {
+#ifdef __linux__
+    fd_ = open(filename_, O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+      // log once, the file may be missing for good
+      if (!open_failed_) {
+        inno_log_error_errno("%s cannot open %s", lidar_name_, filename_);
+        open_failed_ = true;
       }
-      char *new_ptr = realloc(*lineptr, new_size);
-      if (new_ptr == NULL) {
-        return -1;
+      return false;
+    }
+    open_failed_ = false;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+ private:
+  const char *lidar_name_;
+  char filename_[PATH_MAX];
+  int fd_;
+  bool open_failed_;
+  char buffer_[kBufferSize];
+};
+
+/*
+ * Scans whitespace separated fields of a NUL terminated buffer in
+ * place, nothing is allocated or copied except the tokens asked for.
+ */
+class ProcScanner {
+ public:
+  explicit ProcScanner(const char *s)
+      : p_(s) {
+  }
+
+  // like fscanf("%lu"), a leading '-' wraps around
+  bool next_unsigned(uint64_t *v) {
+    skip_spaces_();
+    bool negative = *p_ == '-';
+    const char *p = negative ? p_ + 1 : p_;
+    if (!isdigit(static_cast<unsigned char>(*p))) {
+      return false;
+    }
+    uint64_t r = 0;
+    for (; isdigit(static_cast<unsigned char>(*p)); p++) {
+      r = r * 10 + (*p - '0');
+    }
+    *v = negative ? 0 - r : r;
+    p_ = p;
+    return true;
+  }
+
+  // the token ends at a space or at delim, which is consumed
+  bool next_token(char *buf, size_t size, char delim = ' ') {
+    skip_spaces_();
+    if (*p_ == 0) {
+      return false;
+    }
+    size_t n = 0;
+    for (; *p_ && !isspace(static_cast<unsigned char>(*p_)) &&
+             *p_ != delim; p_++) {
+      if (n + 1 < size) {
+        buf[n++] = *p_;
       }
-      *n = new_size;
-      *lineptr = new_ptr;
     }
+    buf[n] = 0;
+    if (*p_ == delim) {
+      p_++;
+    }
+    return true;
+  }
 
-    ((unsigned char *)(*lineptr))[pos++] = c;
-    if (c == '\n') {
-      break;
+  bool next_char(char *c) {
+    skip_spaces_();
+    if (*p_ == 0) {
+      return false;
     }
-    c = getc(stream);
+    *c = *p_++;
+    return true;
   }
 
-  (*lineptr)[pos] = '\0';
-  return pos;
-}
+  // copy the text up to the last close and continue after it
+  bool next_until_last(char close, char *buf, size_t size) {
+    skip_spaces_();
+    const char *e = strrchr(p_, close);
+    if (!e) {
+      return false;
+    }
+    size_t n = e - p_;
+    if (n >= size) {
+      n = size - 1;
+    }
+    memcpy(buf, p_, n);
+    buf[n] = 0;
+    p_ = e + 1;
+    return true;
+  }
 
-#include <ws2tcpip.h>
-#endif
-#include <sys/stat.h>
-#include <utils/inno_lidar_log.h>
-#include "sdk/system_stats.h"
+  void skip_line() {
+    const char *e = strchr(p_, '\n');
+    p_ = e ? e + 1 : p_ + strlen(p_);
+  }
 
-namespace innovusion {
+ private:
+  void skip_spaces_() {
+    while (isspace(static_cast<unsigned char>(*p_))) {
+      p_++;
+    }
+  }
 
-#define checkfret(x, expect_ret) if (fret != (expect_ret)) { \
-inno_log_warning_errno("%s read %s failed %d", lidar_name, x, fret);}
-#define readone(x) do { \
-fret = fscanf(input, "%ld ", x); checkfret(#x, 1) } while (0)
+ private:
+  const char *p_;
+};
+
+#define checkfret(x) if (!fret) { \
+inno_log_warning("%s parse %s failed", lidar_name, x);}
 #define readunsigned(x) do { \
-fret = fscanf(input, "%" PRI_SIZEU " ", x); checkfret(#x, 1) } while (0)
+fret = scanner.next_unsigned(x); checkfret(#x) } while (0)
 #define readstr(x) do { \
-fret = fscanf(input, "%256s ", x); checkfret(#x, 1) } while (0)
+fret = scanner.next_token(x, sizeof(x)); checkfret(#x) } while (0)
 #define readchar(x) do { \
-fret = fscanf(input, "%c ", x); checkfret(#x, 1) } while (0)
-#define skiponeline(line, len) do {                      \
-(line) = NULL;                                        \
-(len) = 0;                                            \
-fret = getline(&(line), &(len), input);               \
-if (line) { free(line); (line) = NULL; (len) = 0; }   \
-} while (0)
+fret = scanner.next_char(x); checkfret(#x) } while (0)
 
 // porc structures
 //
@@ -140,21 +253,18 @@ struct ProcPidStat {
   //
   bool is_valid;
 
-  ProcPidStat(const char* lidar_name, const char *proc_filename) {
-#ifndef __linux__
-  is_valid = false;
-  return;
-#else
-    FILE *input = fopen(proc_filename, "r");
-    if (!input) {
-      inno_log_error_errno("%s cannot open %s", lidar_name, proc_filename);
+  ProcPidStat(const char* lidar_name, ProcFile *file) {
+    if (file->read() <= 0) {
       is_valid = false;
       return;
     }
 
-    int fret;
+    ProcScanner scanner(file->data());
+    bool fret;
     readunsigned(&pid);
-    readstr(tcomm);
+    // tcomm is "(comm)" and comm may contain spaces and ')'
+    fret = scanner.next_until_last(')', tcomm, sizeof(tcomm));
+    checkfret("tcomm");
     readchar(&state);
     readunsigned(&ppid);
     readunsigned(&pgid);
@@ -178,7 +288,6 @@ struct ProcPidStat {
     readunsigned(&vsize);
     readunsigned(&rss);
     readunsigned(&rsslim);
-    fclose(input);
 
     //
     time_user_cpu = cutime + utime;
@@ -187,7 +296,6 @@ struct ProcPidStat {
 
     //
     is_valid = true;
-#endif
   }
 };
 
@@ -218,35 +326,31 @@ struct ProcNetDevStat{
   uint64_t tx_mulitcast;
 
   bool is_valid = false;
-  ProcNetDevStat(const char* lidar_name, const char *dev_name) {
-    const char *file_name = "/proc/net/dev";
+  ProcNetDevStat(const char* lidar_name, ProcFile *file,
+                 const char *dev_name) {
     static bool interface_exist = true;
     if (!interface_exist) {
       return;  // is_valid == false;
     }
-    FILE *input = fopen(file_name, "r");
-    if (!input) {
-      inno_log_error_errno("%s cannot open %s", lidar_name, file_name);
+    if (file->read() <= 0) {
       is_valid = false;
       return;
     }
 
-    int fret;
+    ProcScanner scanner(file->data());
+    bool fret;
     // read fields
-    char *drop_line = NULL;
-    size_t drop_len = 0;
-    skiponeline(drop_line, drop_len);
-    skiponeline(drop_line, drop_len);
+    scanner.skip_line();
+    scanner.skip_line();
     interface_exist = false;
     while (true) {
-      readstr(interface_);
-      if (fret == EOF) {
+      // "eth0:" may be followed by the first number without a space
+      fret = scanner.next_token(interface_, sizeof(interface_), ':');
+      if (!fret) {
         break;
       }
-      char dev_name_tmp[MAX_INTERFACE_LEN] = {0};
-      snprintf(dev_name_tmp, sizeof(dev_name_tmp), "%s:", dev_name);
-      if (strcmp(dev_name_tmp, interface_) != 0) {
-        skiponeline(drop_line, drop_len);
+      if (strcmp(dev_name, interface_) != 0) {
+        scanner.skip_line();
         continue;
       }
       interface_exist = true;
@@ -269,8 +373,7 @@ struct ProcNetDevStat{
       readunsigned(&tx_mulitcast);
       break;
     }
-    fclose(input);
-    if (fret == EOF) {
+    if (!fret) {
       is_valid = false;
       return;
     }
@@ -305,25 +408,25 @@ struct ProcCpuStat {
   uint64_t softirq[SystemStats::kNProcsMax];
   bool is_valid;
 
-  explicit ProcCpuStat(const char *lidar_name) {
-  #ifndef __linux__
-    is_valid = false;
-    return;
-  #else
-    const char *proc_filename = "/proc/stat";
-    FILE *input = fopen(proc_filename, "r");
-    if (!input) {
-      inno_log_error_errno("%s cannot open %s", lidar_name, proc_filename);
+  ProcCpuStat(const char *lidar_name, ProcFile *file) {
+    if (file->read() <= 0) {
       is_valid = false;
       return;
     }
 
-    int fret;
-    char *drop_line = NULL;
-    size_t drop_len = 0;
+    ProcScanner scanner(file->data());
+    bool fret;
     for (uint32_t i = 0; i < SystemStats::kNProcsMax; ++i) {
-      skiponeline(drop_line, drop_len);
+      scanner.skip_line();
       readstr(name);
+      if (strncmp(name, "cpu", 3) != 0) {
+        // fewer cores than kNProcsMax
+        for (; i < SystemStats::kNProcsMax; ++i) {
+          user[i] = nice[i] = system[i] = idle[i] = 0;
+          iowait[i] = irq[i] = softirq[i] = 0;
+        }
+        break;
+      }
       readunsigned(&user[i]);
       readunsigned(&nice[i]);
       readunsigned(&system[i]);
@@ -333,9 +436,7 @@ struct ProcCpuStat {
       readunsigned(&softirq[i]);
     }
 
-    fclose(input);
     is_valid = true;
-#endif
   }
 };
 }  // namespace innovusion
@@ -63,6 +63,24 @@ SystemStats::SystemStats(InnoLidar *l)
   snprintf(pid_stat_filename_,
            sizeof(pid_stat_filename_),
            "/proc/%d/stat", pid);
+  pid_stat_file_ = new ProcFile(lidar_->get_name(), pid_stat_filename_);
+  cpu_stat_file_ = new ProcFile(lidar_->get_name(), "/proc/stat");
+  net_dev_file_ = new ProcFile(lidar_->get_name(), "/proc/net/dev");
+  operstate_file_ = new ProcFile(lidar_->get_name(),
+                                 "/sys/class/net/eth0/operstate");
+  carrier_file_ = new ProcFile(lidar_->get_name(),
+                               "/sys/class/net/eth0/carrier");
+
+  // log_fault.sh may take seconds, keep it off the stats path
+  cp_log_fault_ = new ConsumerProducer("log_fault", -1, 1,
+                                       SystemStats::process_log_fault,
+                                       this,
+                                       kLogFaultQueueSize,
+                                       kLogFaultQueueSize,
+                                       0,
+                                       0, NULL);
+  inno_log_verify(cp_log_fault_, "log_fault");
+  cp_log_fault_->start();
   {
     std::unique_lock<std::mutex> lk(mutex_);
     last_stats_buffer_[0] = 0;
@@ -72,12 +90,39 @@ SystemStats::SystemStats(InnoLidar *l)
   }
 }
 
+SystemStats::~SystemStats() {
+  cp_log_fault_->shutdown();
+  delete cp_log_fault_;
+  cp_log_fault_ = NULL;
+  delete pid_stat_file_;
+  delete cpu_stat_file_;
+  delete net_dev_file_;
+  delete operstate_file_;
+  delete carrier_file_;
+}
+
+void SystemStats::add_collect_cost_(uint64_t start_ns) {
+  uint64_t cost_ns = InnoUtils::get_time_ns(CLOCK_MONOTONIC_RAW) - start_ns;
+  std::unique_lock<std::mutex> lk(mutex_);
+  collect_cost_us_.add(cost_ns / 1000.0);
+}
+
+void SystemStats::get_collect_cost_us(double *mean_us, double *max_us) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  *mean_us = collect_cost_us_.mean();
+  *max_us = collect_cost_us_.max();
+}
+
 void SystemStats::get_extra_info_(char *buf, size_t buf_size,
                                   double time_diff) {
-  ProcPidStat stat(lidar_->get_name(), pid_stat_filename_);
+  uint64_t start_ns = InnoUtils::get_time_ns(CLOCK_MONOTONIC_RAW);
+  ProcPidStat stat(lidar_->get_name(), pid_stat_file_);
   if (!stat.is_valid) {
     return;
   }
+  double cost_mean_us;
+  double cost_max_us;
+  get_collect_cost_us(&cost_mean_us, &cost_max_us);
 
   int ret = snprintf(
       buf, buf_size,
@@ -92,7 +137,8 @@ void SystemStats::get_extra_info_(char *buf, size_t buf_size,
       PRI_SIZELU "/%" PRI_SIZELU "/%" PRI_SIZELU ", "
       "q_dropped=%" PRI_SIZEU "/%" PRI_SIZEU
       "/%" PRI_SIZELU "/%" PRI_SIZELU "/%" PRI_SIZELU
-      "/%" PRI_SIZELU "/%" PRI_SIZELU "/%" PRI_SIZELU "/%" PRI_SIZELU,
+      "/%" PRI_SIZELU "/%" PRI_SIZELU "/%" PRI_SIZELU "/%" PRI_SIZELU ", "
+      "stats_us=%.1f/%.1f, log_fault_dropped=%" PRI_SIZELU,
       stat.time_user_cpu * 1.0 / cpu_HZ_,
       stat.time_sys_cpu * 1.0 / cpu_HZ_,
       (stat.time_user_cpu - lastp_time_user_cpu_) * 100.0/cpu_HZ_/time_diff,
@@ -129,7 +175,9 @@ void SystemStats::get_extra_info_(char *buf, size_t buf_size,
       lidar_server_->cp_noise_filter_phase0_->dropped_job_count(),
       lidar_server_->cp_noise_filter_phase1_->dropped_job_count(),
       lidar_server_->cp_deliver_->dropped_job_count(),
-      lidar_server_->cp_help_->dropped_job_count());
+      lidar_server_->cp_help_->dropped_job_count(),
+      cost_mean_us, cost_max_us,
+      cp_log_fault_->dropped_job_count());
 
   if (ret >= ssize_t(buf_size)) {
     inno_log_error("buffer too small %d", ret);
@@ -145,6 +193,7 @@ void SystemStats::get_extra_info_(char *buf, size_t buf_size,
 
   lastp_time_user_cpu_ = stat.time_user_cpu;
   lastp_time_sys_cpu_ = stat.time_sys_cpu;
+  add_collect_cost_(start_ns);
   return;
 }
 
@@ -164,6 +213,7 @@ void SystemStats::get_sys_stats(InnoStatusCounters *counters) {
   constexpr uint16_t PERCENT = 100;
   constexpr uint16_t MS_PRE_SEC = 1000;
 
+  uint64_t start_ns = InnoUtils::get_time_ns(CLOCK_MONOTONIC_RAW);
   int64_t now_ms = lidar_->get_monotonic_raw_time_ms();
 #if (defined(__APPLE__) || defined(__MINGW64__))
   uint32_t info_uptime =
@@ -172,7 +222,7 @@ void SystemStats::get_sys_stats(InnoStatusCounters *counters) {
   struct sysinfo info;
   inno_log_verify(sysinfo(&info) == 0, "get sysinfo failed!");
 #endif
-  ProcPidStat stat(lidar_->get_name(), pid_stat_filename_);
+  ProcPidStat stat(lidar_->get_name(), pid_stat_file_);
   if (stat.is_valid) {
     // The time the process started after system boot.
     uint32_t start_time = static_cast<uint32_t>(stat.start_time / cpu_HZ_);
@@ -209,9 +259,8 @@ void SystemStats::get_sys_stats(InnoStatusCounters *counters) {
 #else
     if (info.uptime > kNetStatStartTimeS && time_diff >= kNetStatIntervalMs) {
 #endif
-      ProcNetDevStat netstat =
-          ProcNetDevStat(lidar_->get_name(),
-                        stat_netstat_interface_name_.c_str());
+      ProcNetDevStat netstat(lidar_->get_name(), net_dev_file_,
+                             stat_netstat_interface_name_.c_str());
       if (netstat.is_valid) {
         if (stat_netstat_last_time_ > 0 && time_diff > 0) {
           counters->netstat_rx_speed_kBps = static_cast<uint16_t>(MS_PRE_SEC *
@@ -241,7 +290,7 @@ void SystemStats::get_sys_stats(InnoStatusCounters *counters) {
   if (info.uptime > kCpuUsageFaultDetectStartTimeS &&
       time_diff > kStatSysCpuIntervalMs) {
 #endif
-    ProcCpuStat cpu_stat = ProcCpuStat(lidar_->get_name());
+    ProcCpuStat cpu_stat(lidar_->get_name(), cpu_stat_file_);
     if (cpu_stat.is_valid) {
       uint16_t max_cpu = 0;
       int index = -1;
@@ -254,7 +303,8 @@ void SystemStats::get_sys_stats(InnoStatusCounters *counters) {
                              cpu_stat.irq[i] +
                              cpu_stat.softirq[i];
 
-        if (stat_sys_cpu_last_time_ > 0) {
+        if (stat_sys_cpu_last_time_ > 0 &&
+            total_cpu != stat_sys_cpu_total_last_v_[i]) {
           // set meaningful value to counters
           // cpu_usage = 1 - (idle - idel_last) / (total - total_last)
           // total = user + nice + system + idle + iowait + irq + softirq
@@ -344,6 +394,7 @@ void SystemStats::get_sys_stats(InnoStatusCounters *counters) {
       }
     }
   }
+  add_collect_cost_(start_ns);
 }
 
 
@@ -353,12 +404,31 @@ void SystemStats::init_config(const StatusReportConfig *config) {
 
 void SystemStats::log_fault_(enum InnoLidarInFault fault_id,
                              const char *fault_info) {
-  std::string cmd("/app/pointcloud/log_fault.sh " +
-                  std::to_string(fault_id) + " \"" + fault_info + " \"");
-//  std::thread t1([cmd]() {
-  FILE *fp = popen(cmd.c_str(), "r");
+  LogFaultJob *job = new LogFaultJob;
+  inno_log_verify(job, "log_fault job");
+  job->fault_id = fault_id;
+  snprintf(job->info, sizeof(job->info), "%s", fault_info);
+  cp_log_fault_->add_job(job);
+}
+
+int SystemStats::process_log_fault(void *job, void *ctx, bool prefer) {
+  SystemStats *stats = reinterpret_cast<SystemStats *>(ctx);
+  LogFaultJob *log_fault_job = reinterpret_cast<LogFaultJob *>(job);
+  // prefer is false for the job dropped by a full queue
+  if (prefer) {
+    stats->run_log_fault_(log_fault_job);
+  }
+  delete log_fault_job;
+  return 0;
+}
+
+void SystemStats::run_log_fault_(const LogFaultJob *job) {
+  char cmd[sizeof(job->info) + 64];
+  snprintf(cmd, sizeof(cmd), "/app/pointcloud/log_fault.sh %d \"%s \"",
+           job->fault_id, job->info);
+  FILE *fp = popen(cmd, "r");
   if (fp == nullptr) {
-    inno_log_error("exec '%s' failed", cmd.c_str());
+    inno_log_error("exec '%s' failed", cmd);
     return;
   }
   char line[300];
@@ -368,16 +438,12 @@ void SystemStats::log_fault_(enum InnoLidarInFault fault_id,
   }
   inno_log_error("%s", print_info.c_str());
   pclose(fp);
-//  });
-//  t1.detach();
 }
 
 int SystemStats::detect_network_() {
   int ret_op = -1;
   int ret_carr = -1;
 
-  const char *operstate = "/sys/class/net/eth0/operstate";
-  const char *carrier = "/sys/class/net/eth0/carrier";
   /*
    * Up-Ready to pass packets
    * Down-If admin status is down, then operational status should be down
@@ -393,14 +459,14 @@ int SystemStats::detect_network_() {
   // 1: physical link is up  0:physical link is down
   const char *carrier_1 = "1";
   char op_buffer[512] = {'\0'};
-  ret_op = find_str_infile_(operstate, operstate_up,
+  ret_op = find_str_infile_(operstate_file_, operstate_up,
                             op_buffer, sizeof(op_buffer));
   if (ret_op < 0) {
     return -1;
   }
 
   char carr_buffer[512] = {'\0'};
-  ret_carr = find_str_infile_(carrier, carrier_1,
+  ret_carr = find_str_infile_(carrier_file_, carrier_1,
                               carr_buffer, sizeof(carr_buffer));
   if (ret_carr < 0) {
     return -1;
@@ -431,35 +497,24 @@ int SystemStats::detect_network_() {
 }
 
 
-int SystemStats::find_str_infile_(const char* filename, const char* str,
+int SystemStats::find_str_infile_(ProcFile *file, const char* str,
                                   char* buf, int buf_len) {
-  char    buffer[256] = {0};
-  FILE    *fd = NULL;
-  int     ret = -1;
-  int     len = -1;
-  fd = fopen(filename, "r");
-  if (!fd) {
-    inno_log_error("cannot open %s", filename);
-    return -1;
-  }
-  len = fread(buffer, sizeof(char), sizeof(buffer), fd);
+  int ret = -1;
+  ssize_t len = file->read();
   if (len >= 0) {
     // can't find
-    if (strstr(buffer, str) == NULL) {
+    if (strstr(file->data(), str) == NULL) {
       ret = 0;
       int r = snprintf(buf, buf_len,
                       "%s can't find the %s in %s.",
-                       filename, str, buffer);
+                       file->get_filename(), str, file->data());
       if (r > buf_len) {
         buf = NULL;
       }
     } else {
       ret = 1;
     }
-  } else {
-    inno_log_error_errno("cannot read the %s", filename);
   }
-  fclose(fd);
   return ret;
 }
 
@@ -17,15 +17,17 @@
 #include "sdk_common/resource_stats.h"
 #include "sdk_common/inno_lidar_packet.h"
 #include "sdk/status_report.h"
+#include "utils/utils.h"
 
 namespace innovusion {
+class ConsumerProducer;
 class InnoLidar;
+class ProcFile;
 
 class SystemStats : public ResourceStats {
  public:
   explicit SystemStats(InnoLidar *l);
-  ~SystemStats() {
-  }
+  ~SystemStats();
 
  protected:
   void get_extra_info_(char *buf, size_t buf_size,
@@ -35,11 +37,22 @@ class SystemStats : public ResourceStats {
   void get_last_info_buffer(char *buf, size_t buf_size);
   void get_sys_stats(InnoStatusCounters *counters);
   void init_config(const StatusReportConfig *config);
+  // the time get_sys_stats() and get_extra_info_() take per sample
+  void get_collect_cost_us(double *mean_us, double *max_us);
+  static int process_log_fault(void *job, void *ctx, bool prefer);
+
+ private:
+  struct LogFaultJob {
+    enum InnoLidarInFault fault_id;
+    char info[2048];
+  };
 
  private:
   void log_fault_(enum InnoLidarInFault fault_id, const char *fault_info);
+  void run_log_fault_(const LogFaultJob *job);
+  void add_collect_cost_(uint64_t start_ns);
   int detect_network_();
-  int find_str_infile_(const char* filename, const char* str,
+  int find_str_infile_(ProcFile *file, const char* str,
                        char* buf, int buf_len);
 
  public:
@@ -47,6 +60,9 @@ class SystemStats : public ResourceStats {
   static const uint32_t kNetStatStartTimeS = 20;
   static const uint32_t kStatSysCpuIntervalMs = 2000;
   static const uint32_t kNProcsMax = 4;
+  // log_fault.sh calls waiting for the log_fault worker, the oldest
+  // one is dropped when full
+  static const uint32_t kLogFaultQueueSize = 4;
   // hysteresis high/low limit for cpu usage percentage
   static const uint32_t kCpuUsageFaultSetThreshold = 95;
   static const uint32_t kCpuUsageFaultHealThreshold = 90;
@@ -78,6 +94,15 @@ class SystemStats : public ResourceStats {
   char pid_stat_filename_[PATH_MAX];
   char last_stats_buffer_[512];
 
+  // kept open and re-read with pread() every sample
+  ProcFile *pid_stat_file_;
+  ProcFile *cpu_stat_file_;
+  ProcFile *net_dev_file_;
+  ProcFile *operstate_file_;
+  ProcFile *carrier_file_;
+  ConsumerProducer *cp_log_fault_;
+  InnoMean collect_cost_us_;
+
   uint64_t stat_lastp_time_cpu_;
   int64_t stat_lastp_now_ms;
 
@@ -30,8 +30,9 @@ int inno_lidar_open_live(const char *name,
       inno_log_NOT_IMPLEMENTED();
       break;
     case INNO_LIDAR_PROTOCOL_PCS_UDP:
+    case INNO_LIDAR_PROTOCOL_PCS_SHM:
       l = new innovusion::InnoLidarClient(name, lidar_ip, port,
-                                          false, udp_port);
+                                          protocol, udp_port);
       break;
     case INNO_LIDAR_PROTOCOL_RAW_TCP:
       inno_log_info("raw_tcp not supported, "
@@ -39,7 +40,8 @@ int inno_lidar_open_live(const char *name,
       // fall through
     case INNO_LIDAR_PROTOCOL_PCS_TCP:
       l = new innovusion::InnoLidarClient(name, lidar_ip, port,
-                                          true, udp_port);
+                                          INNO_LIDAR_PROTOCOL_PCS_TCP,
+                                          udp_port);
       break;
     default:
       inno_log_panic("invalid protocol %d", protocol);
@@ -31,13 +31,13 @@ namespace innovusion {
 InnoLidarClient::InnoLidarClient(const char *name,
                                  const char *lidar_ip,
                                  uint16_t port,
-                                 bool use_tcp,
+                                 enum InnoLidarProtocol protocol,
                                  uint16_t udp_port)
     : InnoLidarBase("LidarClient_", name) {
   init_();
   ip_ = strdup(lidar_ip);
   port_ = port;
-  use_tcp_ = use_tcp;
+  protocol_ = protocol;
   udp_port_ = udp_port;
   lidar_source_ = LIDAR_SOURCE_LIVE;
 
@@ -45,7 +45,7 @@ InnoLidarClient::InnoLidarClient(const char *name,
   inno_log_verify(comm_,
                   "%s cannot allocate comm",
                   name_);
-  stage_read_ = new StageClientRead(this, comm_, use_tcp, udp_port, 1);
+  stage_read_ = new StageClientRead(this, comm_, protocol, udp_port, 1);
   inno_log_verify(stage_read_,
                   "%s cannot allocate stage_read",
                   name_);
@@ -156,7 +156,7 @@ void InnoLidarClient::init_() {
   comm_ = NULL;
   ip_ = NULL;
   port_ = 0;
-  use_tcp_ = false;
+  protocol_ = INNO_LIDAR_PROTOCOL_NONE;
   udp_port_ = 0;
   filename_ = NULL;
 
@@ -169,6 +169,7 @@ void InnoLidarClient::init_() {
                              kMaxPacketSize,
                              kPacketPoolSize, 32);
   inno_log_verify(packet_pool_, "packet_pool");
+  packet_pool_huge_page_ = HUGE_PAGE_OFF;
 
   force_xyz_pointcloud_ = false;
 
@@ -743,6 +744,17 @@ void InnoLidarClient::start() {
                   "%s forget to call stop before restart?",
                   name_);
 
+  int huge_page = stage_read_->get_huge_page();
+  if (huge_page != packet_pool_huge_page_) {
+    // every packet is back in the pool before start
+    delete packet_pool_;
+    packet_pool_ = new MemPool("packet_pool",
+                               kMaxPacketSize,
+                               kPacketPoolSize, 32, false, huge_page);
+    inno_log_verify(packet_pool_, "packet_pool");
+    packet_pool_huge_page_ = huge_page;
+  }
+
   stage_deliver_ = new StageClientDeliver(this);
   inno_log_verify(stage_deliver_, "stage_deliver_");
 
@@ -70,7 +70,8 @@ friend class RawReceiver;
 
  public:
   InnoLidarClient(const char *name, const char *lidar_ip,
-                  uint16_t port, bool use_tcp, uint16_t udp_port);
+                  uint16_t port, enum InnoLidarProtocol protocol,
+                  uint16_t udp_port);
   InnoLidarClient(const char *name, const char *filename, int play_rate,
                   int rewind, int64_t skip);
   ~InnoLidarClient();
@@ -148,7 +149,7 @@ friend class RawReceiver;
   enum LidarSource lidar_source_;
   char *ip_;
   uint16_t port_;
-  bool use_tcp_;
+  enum InnoLidarProtocol protocol_;
   uint16_t udp_port_;
 
   char *filename_;
@@ -157,6 +158,7 @@ friend class RawReceiver;
   LidarClientCommunication *comm_;
 
   MemPool *packet_pool_;
+  int packet_pool_huge_page_;
   ConsumerProducer *cp_read_;
   ConsumerProducer *cp_deliver_;
 
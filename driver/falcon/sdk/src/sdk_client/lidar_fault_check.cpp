@@ -9,6 +9,10 @@
 
 #include <float.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <random>
 
 namespace innovusion {
@@ -19,12 +23,36 @@ namespace innovusion {
 
 InnoGalvoMirrorCheck::InnoGalvoMirrorCheck() {
   init_();
+  // the check of a frame must not hold up the deliver thread, it runs
+  // on a low priority worker, see galvo_mirror_offset_check()
+  cp_check_ = new ConsumerProducer("galvo_check",
+                                   kInnoGalvoCheckThreadPriority,
+                                   1, InnoGalvoMirrorCheck::process,
+                                   this,
+                                   kInnoGalvoCheckJobNumber,
+                                   0,
+                                   0,
+                                   0, NULL);
+  inno_log_verify(cp_check_, "galvo_check");
+  cp_check_->start();
 }
 
 InnoGalvoMirrorCheck::~InnoGalvoMirrorCheck() {
+  cp_check_->shutdown();
+  delete cp_check_;
+  cp_check_ = NULL;
   check_galvo_ground_points_.clear();
 }
 
+int InnoGalvoMirrorCheck::process(void *job, void *ctx, bool prefer) {
+  InnoGalvoMirrorCheck *galvo_check =
+      reinterpret_cast<InnoGalvoMirrorCheck *>(ctx);
+  CheckJob *check_job = reinterpret_cast<CheckJob *>(job);
+  galvo_check->check_job_(check_job);
+  check_job->state.store(JOB_STATE_DONE, std::memory_order_release);
+  return 0;
+}
+
 void InnoGalvoMirrorCheck::init_() {
   input_vector_ = {0, 0, 0};
   input_delta_ = {0, 0, 0};
@@ -42,10 +70,17 @@ void InnoGalvoMirrorCheck::init_() {
   last_vehicle_speed_ = 0.0;
   last_frame_idx_ = 0;
   need_ground_points_ = false;
+  skipped_check_times_ = 0;
   memset(check_angles_, 0, sizeof(check_angles_));
   memset(check_speeds_, 0, sizeof(check_speeds_));
   check_galvo_ground_points_.reserve(kInnoGroundPointsReservedSize);
   check_galvo_ground_points_.clear();
+  for (int i = 0; i < kInnoGalvoCheckJobNumber; i++) {
+    jobs_[i].state = JOB_STATE_FREE;
+    jobs_[i].points.reserve(kInnoGroundPointsReservedSize);
+  }
+  ransac_points_.reserve(kInnoGroundPointsReservedSize);
+  filter_points_.reserve(kInnoGroundPointsReservedSize);
 }
 
 /*
@@ -126,10 +161,14 @@ void InnoGalvoMirrorCheck::reset_check_times() {
 
 /**
  * Galvo mirror offset check entrance
+ * The ground points of a frame are collected here, in the deliver
+ * thread. At the end of the frame they are queued to the galvo_check
+ * worker which fits the plane, the result is handed out by a later call
+ * once the worker is done.
  * @param  pkt  input data packet
  * @param  has_force_xyz  has been converted to xyz point
  * @param  check_result  output galvo check result
- * @return InnoFrameCheckProcess
+ * @return INNO_FRAME_CHECK_LAST_COMPELETED if check_result is set
  */
 InnoFrameCheckProcess InnoGalvoMirrorCheck::galvo_mirror_offset_check(
                                   const InnoDataPacket &pkt,
@@ -138,80 +177,24 @@ InnoFrameCheckProcess InnoGalvoMirrorCheck::galvo_mirror_offset_check(
   if (pkt.scanner_direction != kInnoScanDirectionBottom2Top) {
     return INNO_FRAME_CHECK_CONTINUE;
   }
-  // Check the external reference.
-  // If no external reference return immediately.
-  if (!ref_has_set_()) {
-    if (last_frame_idx_ != pkt.idx) {
-      last_frame_idx_ = pkt.idx;
-      inno_log_verify(check_result, "Invalid check_result!");
-      check_result->fault_status
-                    = INNO_GALVO_FAULT_STATUS_INVALID_CHECK_SKIP;
-      check_result->frame_check_code
-                    = INNO_GALVO_CHECK_FRAME_CODE_INVALID_EXT_REF;
-      reset_check_times();
-      return INNO_FRAME_CHECK_LAST_COMPELETED;
-    }
-    return INNO_FRAME_CHECK_CONTINUE;
-  }
-  // Init check process flag
-  InnoFrameCheckProcess check_process = INNO_FRAME_CHECK_CONTINUE;
+  inno_log_verify(check_result, "Invalid check_result!");
   if (last_frame_idx_ != pkt.idx) {
     // Check last frame and ready to new frame
     uint64_t idx_diff = pkt.idx - last_frame_idx_;
-    check_process = INNO_FRAME_CHECK_LAST_COMPELETED;
-    check_result->frame = last_frame_idx_;
+    submit_check_job_(idx_diff);
     last_frame_idx_ = pkt.idx;
-    check_result->speed = frame_start_speed_;
-    check_result->speed_update_ts_ms = frame_start_speed_ts_ms_;
-    check_result->steering_wheel_angle = frame_start_steering_angle_;
-    check_result->steering_update_ts_ms = frame_start_steering_angle_ts_ms_;
-    bool need_to_check_galvo_mirror = true;
-    // Check the update time of speed.
-    // If speed update timeout return immediately.
-    uint64_t curr_timestamp_ms = InnoUtils::get_time_ms(CLOCK_MONOTONIC_RAW);
-    uint64_t time_diff = curr_timestamp_ms
-                       - check_result->speed_update_ts_ms;
-    uint64_t time_diff1 = curr_timestamp_ms
-                       - check_result->steering_update_ts_ms;
-    if (time_diff > kInnoUpdateSpeedMaxDelayTime
-        || time_diff1 > kInnoUpdateSteeringMaxDelayTime) {
-      check_result->fault_status
-                  = INNO_GALVO_FAULT_STATUS_INVALID_CHECK_SKIP;
-      check_result->frame_check_code
-                  = INNO_GALVO_CHECK_FRAME_CODE_EXT_TIMEOUT;
-      need_to_check_galvo_mirror = false;
-      reset_check_times();
-    }
-    // Check the diff of frame idx.
-    // No need return, just continue to check current frame.
-    if (need_to_check_galvo_mirror && idx_diff > kInnoFrameIdxMaxDiff) {
-      check_result->fault_status
-                = INNO_GALVO_FAULT_STATUS_INVALID_CHECK_SKIP;
-      check_result->frame_check_code
-                = INNO_GALVO_CHECK_FRAME_CODE_LAST_FRAME_IDX_OUT;
-      need_to_check_galvo_mirror = false;
-      reset_check_times();
-    }
-    // Start to check galvo mirror offset for last frame
-    if (need_to_check_galvo_mirror) {
-      check_result->input_vector = input_vector_;
-      check_result->input_delta = input_delta_;
-      check_result->points_count = check_galvo_ground_points_.size();
-      uint64_t start_time = InnoUtils::get_time_us(CLOCK_MONOTONIC_RAW);
-      cal_and_get_galvo_check_result_(check_galvo_ground_points_, check_result);
-      check_result->use_time_us = InnoUtils::get_time_us(CLOCK_MONOTONIC_RAW)
-                                                                - start_time;
-    }
     // NEW FRAME
     frame_start_speed_ = vehicle_speed_;
     frame_start_speed_ts_ms_ = speed_update_ts_ms_;
     frame_start_steering_angle_ = steering_wheel_angle_;
     frame_start_steering_angle_ts_ms_ = steering_update_ts_ms_;
-    time_diff = InnoUtils::get_time_ms(CLOCK_MONOTONIC_RAW)
+    uint64_t time_diff = InnoUtils::get_time_ms(CLOCK_MONOTONIC_RAW)
                                           - speed_update_ts_ms_;
-    time_diff1 = InnoUtils::get_time_ms(CLOCK_MONOTONIC_RAW)
+    uint64_t time_diff1 = InnoUtils::get_time_ms(CLOCK_MONOTONIC_RAW)
                                           - steering_update_ts_ms_;
-    if (frame_start_speed_ >= kInnoMinGalvoVehicleSpeed
+    // If no external reference no need to collect.
+    if (ref_has_set_()
+        && frame_start_speed_ >= kInnoMinGalvoVehicleSpeed
         && frame_start_steering_angle_ <= kInnoGalvoCheckMaxSteeringAngle
         && time_diff < kInnoUpdateSpeedMaxDelayTime
         && time_diff1 < kInnoUpdateSteeringMaxDelayTime) {
@@ -225,7 +208,124 @@ InnoFrameCheckProcess InnoGalvoMirrorCheck::galvo_mirror_offset_check(
   if (need_ground_points_) {
     collect_ground_points_(pkt, has_force_xyz);
   }
-  return check_process;
+  if (get_done_check_result_(pkt.idx, check_result)) {
+    return INNO_FRAME_CHECK_LAST_COMPELETED;
+  }
+  return INNO_FRAME_CHECK_CONTINUE;
+}
+
+/**
+ * Queue the frame that just ended (last_frame_idx_) to the worker, its
+ * ground points are swapped into the job, not copied.
+ * If all the jobs are still in use the frame is not checked.
+ * @param  idx_diff  frame idx diff to the new frame
+ */
+void InnoGalvoMirrorCheck::submit_check_job_(const uint64_t idx_diff) {
+  CheckJob *job = NULL;
+  for (int i = 0; i < kInnoGalvoCheckJobNumber; i++) {
+    if (jobs_[i].state.load(std::memory_order_acquire) == JOB_STATE_FREE) {
+      job = &jobs_[i];
+      break;
+    }
+  }
+  if (job == NULL) {
+    ++skipped_check_times_;
+    return;
+  }
+  InnoGalvoCheckResult *check_result = &job->result;
+  memset(check_result, 0, sizeof(*check_result));
+  check_result->frame = last_frame_idx_;
+  check_result->speed = frame_start_speed_;
+  check_result->speed_update_ts_ms = frame_start_speed_ts_ms_;
+  check_result->steering_wheel_angle = frame_start_steering_angle_;
+  check_result->steering_update_ts_ms = frame_start_steering_angle_ts_ms_;
+  check_result->input_vector = input_vector_;
+  check_result->input_delta = input_delta_;
+  check_result->points_count = check_galvo_ground_points_.size();
+  check_result->skipped_times = skipped_check_times_;
+  job->has_ref = ref_has_set_();
+  job->idx_diff = idx_diff;
+  job->frame_end_ts_ms = InnoUtils::get_time_ms(CLOCK_MONOTONIC_RAW);
+  job->frame_end_ts_us = InnoUtils::get_time_us(CLOCK_MONOTONIC_RAW);
+  memcpy(job->rotation_matrix, rotation_matrix_, sizeof(rotation_matrix_));
+  job->points.swap(&check_galvo_ground_points_);
+  job->state.store(JOB_STATE_QUEUED, std::memory_order_release);
+  cp_check_->add_job(job);
+}
+
+/**
+ * Hand out the oldest result the worker has done.
+ * @param  curr_frame_idx  idx of the frame being delivered
+ * @param  check_result  output galvo check result
+ * @return true if check_result is set
+ */
+bool InnoGalvoMirrorCheck::get_done_check_result_(
+                                  const uint64_t curr_frame_idx,
+                                  InnoGalvoCheckResult *check_result) {
+  CheckJob *done = NULL;
+  for (int i = 0; i < kInnoGalvoCheckJobNumber; i++) {
+    if (jobs_[i].state.load(std::memory_order_acquire) == JOB_STATE_DONE
+        && (done == NULL || jobs_[i].result.frame < done->result.frame)) {
+      done = &jobs_[i];
+    }
+  }
+  if (done == NULL) {
+    return false;
+  }
+  *check_result = done->result;
+  check_result->lag_us = InnoUtils::get_time_us(CLOCK_MONOTONIC_RAW)
+                                          - done->frame_end_ts_us;
+  check_result->lag_frames = curr_frame_idx - done->result.frame;
+  done->state.store(JOB_STATE_FREE, std::memory_order_release);
+  return true;
+}
+
+/**
+ * Check one frame, in the worker
+ */
+void InnoGalvoMirrorCheck::check_job_(CheckJob *job) {
+  InnoGalvoCheckResult *check_result = &job->result;
+  // Check the external reference.
+  if (!job->has_ref) {
+    check_result->fault_status
+                  = INNO_GALVO_FAULT_STATUS_INVALID_CHECK_SKIP;
+    check_result->frame_check_code
+                  = INNO_GALVO_CHECK_FRAME_CODE_INVALID_EXT_REF;
+    reset_check_times();
+    return;
+  }
+  bool need_to_check_galvo_mirror = true;
+  // Check the update time of speed at the end of the frame.
+  uint64_t time_diff = job->frame_end_ts_ms
+                     - check_result->speed_update_ts_ms;
+  uint64_t time_diff1 = job->frame_end_ts_ms
+                      - check_result->steering_update_ts_ms;
+  if (time_diff > kInnoUpdateSpeedMaxDelayTime
+      || time_diff1 > kInnoUpdateSteeringMaxDelayTime) {
+    check_result->fault_status
+                = INNO_GALVO_FAULT_STATUS_INVALID_CHECK_SKIP;
+    check_result->frame_check_code
+                = INNO_GALVO_CHECK_FRAME_CODE_EXT_TIMEOUT;
+    need_to_check_galvo_mirror = false;
+    reset_check_times();
+  }
+  // Check the diff of frame idx.
+  if (need_to_check_galvo_mirror && job->idx_diff > kInnoFrameIdxMaxDiff) {
+    check_result->fault_status
+              = INNO_GALVO_FAULT_STATUS_INVALID_CHECK_SKIP;
+    check_result->frame_check_code
+              = INNO_GALVO_CHECK_FRAME_CODE_LAST_FRAME_IDX_OUT;
+    need_to_check_galvo_mirror = false;
+    reset_check_times();
+  }
+  // Start to check galvo mirror offset for the frame
+  if (need_to_check_galvo_mirror) {
+    uint64_t start_time = InnoUtils::get_time_us(CLOCK_MONOTONIC_RAW);
+    cal_and_get_galvo_check_result_(job->points, job->rotation_matrix,
+                                    check_result);
+    check_result->use_time_us = InnoUtils::get_time_us(CLOCK_MONOTONIC_RAW)
+                                                              - start_time;
+  }
 }
 
 /**
@@ -289,7 +389,7 @@ int InnoGalvoMirrorCheck::collect_ground_points_process_(
         }
         if (point.scan_id < kInnoCheckBottomScanId1) {
           check_galvo_ground_points_.push_back(
-                                {point.x, point.y, point.z, point.ts_10us});
+                                point.x, point.y, point.z, point.ts_10us);
         } else {
           if (point.z < kInnoCheckMinDistance
             || point.z > kInnoCheckMaxDistance) {
@@ -298,7 +398,7 @@ int InnoGalvoMirrorCheck::collect_ground_points_process_(
           if (point.scan_id < kInnoCheckBottomMaxScanId1
             && (point.scan_idx % kInnoGroundDivideScanIdxSize == 0)) {
             check_galvo_ground_points_.push_back(
-                                 {point.x, point.y, point.z, point.ts_10us});
+                                 point.x, point.y, point.z, point.ts_10us);
           }
         }
       }
@@ -316,7 +416,8 @@ int InnoGalvoMirrorCheck::collect_ground_points_process_(
  * @return int < 0: failed  0: success
  */
 int InnoGalvoMirrorCheck::cal_and_get_galvo_check_result_(
-                                      const InnoCheckPoints &ground_points,
+                                      const InnoGroundPoints &ground_points,
+                                      const double *rotation_matrix,
                                       InnoGalvoCheckResult *check_result) {
   uint8_t check_angle_idx
           = static_cast<uint8_t>(check_times_ % kInnoGalvoCheckMaxTimes);
@@ -411,15 +512,15 @@ int InnoGalvoMirrorCheck::cal_and_get_galvo_check_result_(
     return -1;
   }
   /******** rotated normal vector of ground plane ********/
-  rotated_vector.x = rotation_matrix_[0] * coeff_plane.a
-                   + rotation_matrix_[1] * coeff_plane.b
-                   + rotation_matrix_[2] * coeff_plane.c;
-  rotated_vector.y = rotation_matrix_[3] * coeff_plane.a
-                   + rotation_matrix_[4] * coeff_plane.b
-                   + rotation_matrix_[5] * coeff_plane.c;
-  rotated_vector.z = rotation_matrix_[6] * coeff_plane.a
-                   + rotation_matrix_[7] * coeff_plane.b
-                   + rotation_matrix_[8] * coeff_plane.c;
+  rotated_vector.x = rotation_matrix[0] * coeff_plane.a
+                   + rotation_matrix[1] * coeff_plane.b
+                   + rotation_matrix[2] * coeff_plane.c;
+  rotated_vector.y = rotation_matrix[3] * coeff_plane.a
+                   + rotation_matrix[4] * coeff_plane.b
+                   + rotation_matrix[5] * coeff_plane.c;
+  rotated_vector.z = rotation_matrix[6] * coeff_plane.a
+                   + rotation_matrix[7] * coeff_plane.b
+                   + rotation_matrix[8] * coeff_plane.c;
   check_result->variance
               = get_fitting_plane_variance_(ground_points, coeff_plane);
   check_result->ground_coeff = coeff_plane;
@@ -541,16 +642,18 @@ inline double InnoGalvoMirrorCheck::calculate_vector_module_(
  * @return double  variance of ground points
  */
 inline double InnoGalvoMirrorCheck::get_fitting_plane_variance_(
-                               const InnoCheckPoints &ground_points,
+                               const InnoGroundPoints &ground_points,
                                const InnoGroundCoeff &coeff_plane) {
     const size_t points_size = ground_points.size();
     if (points_size > 0) {
+      const double *x = ground_points.x.data();
+      const double *y = ground_points.y.data();
+      const double *z = ground_points.z.data();
       double temp_value = 0.0;
       double plane_variance = 0.0;
       for (size_t i = 0; i < points_size; i++) {
-        InnoPointXYZT point = ground_points[i];
-        temp_value = point.x * coeff_plane.a + point.y * coeff_plane.b
-                              + coeff_plane.c * point.z + coeff_plane.d;
+        temp_value = x[i] * coeff_plane.a + y[i] * coeff_plane.b
+                              + coeff_plane.c * z[i] + coeff_plane.d;
         plane_variance += temp_value * temp_value;
       }
       return plane_variance / points_size;
@@ -657,18 +760,21 @@ int InnoGalvoMirrorCheck::convert_rotation_angle_to_matrix_() {
  * @return < 0 failed, 0 success
  */
 int InnoGalvoMirrorCheck::fitting_plane_from_points_(
-                            const InnoCheckPoints &ground_points,
+                            const InnoGroundPoints &ground_points,
                             InnoGroundCoeff *coeff_plane) {
   const int points_count = static_cast<int>(ground_points.size());
   if (points_count < 3) {
     // inno_log_info("Not enough points to fitting plane, %d", points_count);
     return -1;
   }
+  const double *x = ground_points.x.data();
+  const double *y = ground_points.y.data();
+  const double *z = ground_points.z.data();
   InnoPointXYZT sum = {0, 0, 0};
   for (int i = 0; i < points_count; i++) {
-    sum.x += ground_points[i].x;
-    sum.y += ground_points[i].y;
-    sum.z += ground_points[i].z;
+    sum.x += x[i];
+    sum.y += y[i];
+    sum.z += z[i];
   }
   InnoPointXYZT centroid = {0, 0, 0};
   centroid.x = sum.x / static_cast<double>(points_count);
@@ -677,9 +783,9 @@ int InnoGalvoMirrorCheck::fitting_plane_from_points_(
   double xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
   for (int i = 0; i < points_count; i++) {
     InnoPointXYZT temp;
-    temp.x = ground_points[i].x - centroid.x;
-    temp.y = ground_points[i].y - centroid.y;
-    temp.z = ground_points[i].z - centroid.z;
+    temp.x = x[i] - centroid.x;
+    temp.y = y[i] - centroid.y;
+    temp.z = z[i] - centroid.z;
 
     xx += temp.x * temp.x;
     xy += temp.x * temp.y;
@@ -735,22 +841,27 @@ int InnoGalvoMirrorCheck::fitting_plane_from_points_(
 
 /**
  * Use 3 points to fit plane
- * @param  p0  input point 1
- * @param  p1  input point 2
- * @param  p2  input point 3
+ * @param  points  input points
+ * @param  i0  index of point 1
+ * @param  i1  index of point 2
+ * @param  i2  index of point 3
  * @param  plane  output the coeff of plane
  * @return double  output module
  */
-double InnoGalvoMirrorCheck::estimate_param_(const InnoPointXYZT &p0,
-                                            const InnoPointXYZT &p1,
-                                            const InnoPointXYZT &p2,
+double InnoGalvoMirrorCheck::estimate_param_(const InnoGroundPoints &points,
+                                            const uint32_t i0,
+                                            const uint32_t i1,
+                                            const uint32_t i2,
                                             InnoGroundCoeff *plane) {
-    std::vector<double> vec1{p1.x - p0.x, p1.y - p0.y, p1.z - p0.z};
-    std::vector<double> vec2{p2.x - p1.x, p2.y - p1.y, p2.z - p1.z};
+    const double *x = points.x.data();
+    const double *y = points.y.data();
+    const double *z = points.z.data();
+    double vec1[3] = {x[i1] - x[i0], y[i1] - y[i0], z[i1] - z[i0]};
+    double vec2[3] = {x[i2] - x[i1], y[i2] - y[i1], z[i2] - z[i1]};
     plane->a = vec1[1] * vec2[2] - vec1[2] * vec2[1];
     plane->b = vec1[2] * vec2[0] - vec1[0] * vec2[2];
     plane->c = vec1[0] * vec2[1] - vec1[1] * vec2[0];
-    plane->d = -(plane->a * p0.x + plane->b * p0.y + plane->c * p0.z);
+    plane->d = -(plane->a * x[i0] + plane->b * y[i0] + plane->c * z[i0]);
     return std::sqrt(plane->a * plane->a
                      + plane->b * plane->b
                      + plane->c * plane->c);
@@ -758,109 +869,134 @@ double InnoGalvoMirrorCheck::estimate_param_(const InnoPointXYZT &p0,
 
 /**
  * Compute all distance of points to plane
- * @param  in_points input ground points
+ * @param  in_points input ground points, every step-th point of the frame
+ * @param  step  sample step of in_points
  * @param  plane input plane coeff
  * @param  module input module
- * @param  valid_count  output valid points count
+ * @param  valid_count  output valid points count, scaled by step
  * @return  double  output mean distance
  */
 double InnoGalvoMirrorCheck::compute_distance_(
-                            const InnoCheckPoints &in_points,
+                            const InnoGroundPoints &in_points,
+                            const uint32_t step,
                             const InnoGroundCoeff &plane,
                             const double &module,
                             uint32_t *valid_count) {
   if (module <= 0) {
     return -1.0;
   }
-  size_t points_size = in_points.size();
+  const size_t points_size = in_points.size();
   if (points_size < 3) return -1;
-  uint32_t index = 0;
+  const double *x = in_points.x.data();
+  const double *y = in_points.y.data();
+  const double *z = in_points.z.data();
+  size_t index = 0;
   uint32_t valid_index = 0;
-  uint32_t step = 1;
-  if (points_size > 400) {
-    step = 2;
-  }
   double total = 0.0;
-  while (index < points_size) {
-    double distance = std::abs((plane.a * in_points[index].x
-                                  + plane.b * in_points[index].y
-                                  + plane.c * in_points[index].z
+#if defined(__SSE2__)
+  // 2 points at a time, same per point arithmetic as the loop below
+  const __m128d a = _mm_set1_pd(plane.a);
+  const __m128d b = _mm_set1_pd(plane.b);
+  const __m128d c = _mm_set1_pd(plane.c);
+  const __m128d d = _mm_set1_pd(plane.d);
+  const __m128d m = _mm_set1_pd(module);
+  const __m128d sign = _mm_set1_pd(-0.0);
+  const __m128d threshold = _mm_set1_pd(kInnoGroundDistanceThreshold2);
+  const __m128d one = _mm_set1_pd(1.0);
+  __m128d sum = _mm_setzero_pd();
+  __m128d valid = _mm_setzero_pd();
+  for (; index + 2 <= points_size; index += 2) {
+    __m128d distance = _mm_add_pd(
+        _mm_add_pd(_mm_add_pd(_mm_mul_pd(a, _mm_loadu_pd(x + index)),
+                              _mm_mul_pd(b, _mm_loadu_pd(y + index))),
+                   _mm_mul_pd(c, _mm_loadu_pd(z + index))),
+        d);
+    distance = _mm_andnot_pd(sign, _mm_div_pd(distance, m));
+    sum = _mm_add_pd(sum, distance);
+    valid = _mm_add_pd(valid,
+                       _mm_and_pd(_mm_cmplt_pd(distance, threshold), one));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, sum);
+  total = lanes[0] + lanes[1];
+  _mm_storeu_pd(lanes, valid);
+  valid_index = static_cast<uint32_t>(lanes[0] + lanes[1]);
+#endif
+  for (; index < points_size; index++) {
+    double distance = std::abs((plane.a * x[index]
+                                  + plane.b * y[index]
+                                  + plane.c * z[index]
                                   + plane.d) / module);
-    if (distance < kInnoGroundDistanceThreshold2) {
-      ++valid_index;
-    }
-    index += step;
+    valid_index += distance < kInnoGroundDistanceThreshold2;
     total += distance;
   }
-  if (index == 0) {
-    return -1.0;
-  }
   *valid_count = valid_index * step;
-  return total / index / step;
+  return total / (points_size * step) / step;
 }
 
 /**
  * Quick fit plane by RANSAC
  * @param  in_points  input points
- * @param  threshold_distance  min distance threshold
- * @param  is_fine  true: more times to fit
  * @param  out_plane  output plane coeff
  * @return  < 0 failed, 0 success
  */
 int InnoGalvoMirrorCheck::quick_ransac_plane_(
-                                const InnoCheckPoints &in_points,
+                                const InnoGroundPoints &in_points,
                                 InnoGroundCoeff *out_plane) {
   uint32_t points_size = static_cast<uint32_t>(in_points.size());
   if (points_size < 3) {
     return -1;
   }
+  // The distances of a big frame are computed for every other point,
+  // take that sample once for all the iterations.
+  uint32_t step = 1;
+  const InnoGroundPoints *sample_points = &in_points;
+  if (points_size > kInnoRansacFullSampleMaxCount) {
+    step = 2;
+    ransac_points_.clear();
+    for (uint32_t i = 0; i < points_size; i += step) {
+      ransac_points_.push_back(in_points.x[i], in_points.y[i],
+                               in_points.z[i], in_points.ts_10us[i]);
+    }
+    sample_points = &ransac_points_;
+  }
   uint32_t max_times = 30;
   std::default_random_engine randomEngine;
   std::uniform_int_distribution<uint32_t> uniform{0, points_size - 1};
   randomEngine.seed(10U);
   uint32_t valid_threshold = static_cast<uint32_t>(points_size
                                          * kInnoCheckValidFitPercent);
-  // uint32_t max_valid_threshold = static_cast<uint32_t>(num * 0.95);
   uint32_t valid_count = 0;
-  // uint32_t max_valid_count = 0;
-  int radom0 = 0;
-  int radom1 = 0;
-  int radom2 = 0;
+  uint32_t radom0 = 0;
+  uint32_t radom1 = 0;
+  uint32_t radom2 = 0;
   InnoGroundCoeff plane_coeff = {0, 0, 0, 0};
   while (max_times--) {
     radom0 = uniform(randomEngine);
     radom1 = uniform(randomEngine);
     radom2 = uniform(randomEngine);
-    double module = estimate_param_(in_points[radom0], in_points[radom1],
-                                   in_points[radom2], &plane_coeff);
+    double module = estimate_param_(in_points, radom0, radom1, radom2,
+                                   &plane_coeff);
     if (module < DBL_MIN) {
         continue;
     }
-    double meanDistance
-         = compute_distance_(in_points, plane_coeff, module, &valid_count);
+    double meanDistance = compute_distance_(*sample_points, step,
+                                            plane_coeff, module,
+                                            &valid_count);
     if (meanDistance < 0) {
         continue;
     }
     // inno_log_info("meanDistance=%lf, valid_count=%d, threshold=%d",
     //               meanDistance, valid_count, consensusThreshold);
     if (valid_count > valid_threshold) {
-      // max_valid_count = valid_count;
       out_plane->a = plane_coeff.a;
       out_plane->b = plane_coeff.b;
       out_plane->c = plane_coeff.c;
       out_plane->d = plane_coeff.d;
-      // if (max_valid_count > max_valid_threshold) {
-      //   break;
-      // }
       return 0;
     }
   }
   return -2;
-  // if (max_valid_count > valid_threshold) {
-  //   return 0;
-  // } else {
-  //   return -2;
-  // }
 }
 
 /**
@@ -870,7 +1006,7 @@ int InnoGalvoMirrorCheck::quick_ransac_plane_(
  * @return  < 0 failed, 0 success
  */
 int InnoGalvoMirrorCheck::fitting_plane_ransac_least_(
-                           const InnoCheckPoints &in_points,
+                           const InnoGroundPoints &in_points,
                            const double delta_z_per_10us,
                            InnoGroundCoeff *coeff) {
   int ret = quick_ransac_plane_(in_points, coeff);
@@ -878,28 +1014,33 @@ int InnoGalvoMirrorCheck::fitting_plane_ransac_least_(
     // inno_log_warning("!quick_ransac_plane ret=%d", ret);
     return -1;
   }
-  InnoCheckPoints filter_points;
   double module = std::sqrt(coeff->a * coeff->a
                           + coeff->b * coeff->b
                           + coeff->c * coeff->c);
   if (module <= 0) {
     return -2;
   }
+  const double *x = in_points.x.data();
+  const double *y = in_points.y.data();
+  const double *z = in_points.z.data();
+  const uint16_t *ts_10us = in_points.ts_10us.data();
+  const size_t points_size = in_points.size();
+  filter_points_.clear();
   double delta_z = 0.0;
-  for (auto &p : in_points) {
-    double distance = (coeff->a * p.x
-                     + coeff->b * p.y
-                     + coeff->c * p.z + coeff->d) / module;
+  for (size_t i = 0; i < points_size; i++) {
+    double distance = (coeff->a * x[i]
+                     + coeff->b * y[i]
+                     + coeff->c * z[i] + coeff->d) / module;
     if (std::abs(distance) < kInnoGroundDistanceThreshold1) {
       // motion compensation
       // bottom -> top, very close to start time
-      if (p.reserved < 100) {
-        delta_z = delta_z_per_10us * p.reserved;
+      if (ts_10us[i] < 100) {
+        delta_z = delta_z_per_10us * ts_10us[i];
       }
-      filter_points.push_back({p.x, p.y, p.z + delta_z});
+      filter_points_.push_back(x[i], y[i], z[i] + delta_z, ts_10us[i]);
     }
   }
-  ret = fitting_plane_from_points_(filter_points, coeff);
+  ret = fitting_plane_from_points_(filter_points_, coeff);
   return ret;
 }
 
@@ -10,10 +10,13 @@
 #define SDK_CLIENT_LIDAR_FAULT_CHECK_H_
 
 #include <algorithm>
+#include <atomic>
+#include <utility>
 #include <vector>
 
 #include "sdk_common/inno_lidar_packet.h"
 #include "sdk_common/inno_lidar_packet_utils.h"
+#include "utils/consumer_producer.h"
 #include "utils/utils.h"
 
 namespace innovusion {
@@ -118,6 +121,9 @@ DEFINE_INNO_COMPACT_STRUCT(InnoGalvoCheckResult) {
   /* the fault status of 50 times */
   InnoGalvoFaultCheckStatus fault_status: 8;
   uint64_t use_time_us;          /* galvo check use time (us) */
+  uint64_t lag_us;               /* frame end to result delivered (us) */
+  uint64_t lag_frames;           /* frames delivered in the meantime */
+  uint64_t skipped_times;        /* frames not checked, worker busy */
 };
 DEFINE_INNO_COMPACT_STRUCT_END
 
@@ -143,6 +149,49 @@ DEFINE_INNO_COMPACT_STRUCT_END
 
 typedef std::vector<InnoPointXYZT> InnoCheckPoints;
 
+/*
+ * Galvo check ground points in SoA layout, so the distance loops run
+ * over plain double arrays. clear() keeps the capacity, the buffers are
+ * reused frame after frame.
+ */
+class InnoGroundPoints {
+ public:
+  void reserve(const size_t size) {
+    x.reserve(size);
+    y.reserve(size);
+    z.reserve(size);
+    ts_10us.reserve(size);
+  }
+  void clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    ts_10us.clear();
+  }
+  size_t size() const {
+    return x.size();
+  }
+  void push_back(const double px, const double py, const double pz,
+                 const uint16_t ts) {
+    x.push_back(px);
+    y.push_back(py);
+    z.push_back(pz);
+    ts_10us.push_back(ts);
+  }
+  void swap(InnoGroundPoints *other) {
+    x.swap(other->x);
+    y.swap(other->y);
+    z.swap(other->z);
+    ts_10us.swap(other->ts_10us);
+  }
+
+ public:
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> z;
+  std::vector<uint16_t> ts_10us;
+};
+
 /* Scan direction */
 static const int kInnoScanDirectionTop2Bottom = 0;
 static const int kInnoScanDirectionBottom2Top = 1;
@@ -202,11 +251,41 @@ class InnoGalvoMirrorCheck {
   /* Max steering wheel angle */
   static constexpr double kInnoGalvoCheckMaxSteeringAngle = 6.0;
   static constexpr double kInnoGalvoCheckSteeringResetAngle = 12.0;
+  /* Points of a frame checked by RANSAC one by one, above every other */
+  static const uint32_t kInnoRansacFullSampleMaxCount = 400;
+  /* Frames queued to or checked by the worker at the same time */
+  static const int kInnoGalvoCheckJobNumber = 3;
+  /* Below 0: the worker runs with SCHED_IDLE */
+  static const int kInnoGalvoCheckThreadPriority = -1;
+
+ private:
+  /*
+   * One frame to check. The deliver thread fills it at the end of the
+   * frame and queues it, the worker fills result and marks it done, the
+   * deliver thread hands the result out and frees it.
+   */
+  enum JobState {
+    JOB_STATE_FREE = 0,
+    JOB_STATE_QUEUED = 1,
+    JOB_STATE_DONE = 2,
+  };
+  struct CheckJob {
+    std::atomic<int> state;
+    bool has_ref;
+    uint64_t idx_diff;
+    uint64_t frame_end_ts_ms;
+    uint64_t frame_end_ts_us;
+    double rotation_matrix[kInnoGroundMatrixSize];
+    InnoGroundPoints points;
+    InnoGalvoCheckResult result;
+  };
 
  public:
   InnoGalvoMirrorCheck();
   ~InnoGalvoMirrorCheck();
 
+  static int process(void *job, void *ctx, bool prefer);
+
   void reset_ref_idx();
   void reset_check_times();
   void update_ext_ref(const double vec_x,
@@ -230,23 +309,30 @@ class InnoGalvoMirrorCheck {
   int collect_ground_points_(const InnoDataPacket &pkt,
                              const bool has_force_xyz);
   int collect_ground_points_process_(const InnoDataPacket &pkt);
+  void submit_check_job_(const uint64_t idx_diff);
+  bool get_done_check_result_(const uint64_t curr_frame_idx,
+                              InnoGalvoCheckResult *check_result);
+  void check_job_(CheckJob *job);
   int cal_and_get_galvo_check_result_(
-                      const InnoCheckPoints &ground_points,
+                      const InnoGroundPoints &ground_points,
+                      const double *rotation_matrix,
                       InnoGalvoCheckResult *check_result);
   double calculate_vector_module_(const InnoVector3D &vector_3d);
-  double get_fitting_plane_variance_(const InnoCheckPoints &ground_points,
+  double get_fitting_plane_variance_(const InnoGroundPoints &ground_points,
                                     const InnoGroundCoeff &coeff_plane);
-  int fitting_plane_from_points_(const InnoCheckPoints &ground_points,
+  int fitting_plane_from_points_(const InnoGroundPoints &ground_points,
                                  InnoGroundCoeff *coeff_plane);
-  double estimate_param_(const InnoPointXYZT &p0, const InnoPointXYZT &p1,
-                        const InnoPointXYZT &p2, InnoGroundCoeff *plane);
-  double compute_distance_(const InnoCheckPoints &in_points,
+  double estimate_param_(const InnoGroundPoints &points,
+                        const uint32_t i0, const uint32_t i1,
+                        const uint32_t i2, InnoGroundCoeff *plane);
+  double compute_distance_(const InnoGroundPoints &in_points,
+                          const uint32_t step,
                           const InnoGroundCoeff &plane,
                           const double &module,
                           uint32_t *valid_count);
-  int quick_ransac_plane_(const InnoCheckPoints &in_points,
+  int quick_ransac_plane_(const InnoGroundPoints &in_points,
                          InnoGroundCoeff *out_plane);
-  int fitting_plane_ransac_least_(const InnoCheckPoints &in_points,
+  int fitting_plane_ransac_least_(const InnoGroundPoints &in_points,
                                  const double delta_z_per_10us,
                                  InnoGroundCoeff *coeff);
 
@@ -267,16 +353,23 @@ class InnoGalvoMirrorCheck {
   uint64_t frame_start_speed_ts_ms_;
   double frame_start_steering_angle_;
   double frame_start_steering_angle_ts_ms_;
-  double last_vehicle_speed_;
   uint64_t ref_idx_;
   double rotation_matrix_[kInnoGroundMatrixSize];
-  uint64_t check_times_;
+  // reset by the api thread, counted by the worker
+  std::atomic<uint64_t> check_times_;
+  uint64_t last_frame_idx_;
+  bool need_ground_points_;
+  InnoGroundPoints check_galvo_ground_points_;
+  CheckJob jobs_[kInnoGalvoCheckJobNumber];
+  ConsumerProducer *cp_check_;
+  uint64_t skipped_check_times_;
+  // used by the worker only
+  double last_vehicle_speed_;
   uint64_t check_speed_times_;
   double check_angles_[kInnoGalvoCheckMaxTimes];
   double check_speeds_[kInnoGalvoCheckMaxTimes];
-  uint64_t last_frame_idx_;
-  bool need_ground_points_;
-  InnoCheckPoints check_galvo_ground_points_;
+  InnoGroundPoints ransac_points_;
+  InnoGroundPoints filter_points_;
   union {
     char xyz_data_packet_buf_[kMaxXyzDataPacketBufSize];
     InnoDataPacket xyz_data_packet_;
@@ -15,6 +15,9 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#ifndef __MINGW64__
+#include <sys/uio.h>
+#endif
 
 #include <utility>
 #include <vector>
@@ -26,8 +29,103 @@
 
 // #include "raw_recorder.h"
 namespace innovusion {
+#ifdef __MINGW64__
+struct iovec {
+  void *iov_base;
+  size_t iov_len;
+};
+#endif
+
+/**
+ * write all the buffers, retry on EINTR/EAGAIN and partial writes
+ * @return bytes written, -1 on error
+ */
+static ssize_t writev_all(int fd, struct iovec *iov, int count) {
+  ssize_t total = 0;
+  while (count > 0) {
+#ifdef __MINGW64__
+    ssize_t n = ::write(fd, iov->iov_base, iov->iov_len);
+#else
+    ssize_t n = ::writev(fd, iov, count);
+#endif
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+        continue;
+      }
+      return -1;
+    }
+    total += n;
+    // skip what has been written
+    while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = reinterpret_cast<char *>(iov->iov_base) + n;
+      iov->iov_len -= n;
+    }
+  }
+  return total;
+}
+
+RawSegmentPool::RawSegmentPool(uint32_t segment_number)
+    : segment_number_(segment_number)
+    , free_list_(nullptr)
+    , free_number_(0) {
+  // one block, the pages are only backed once a datagram lands there
+  buffer_ = reinterpret_cast<char *>(
+      malloc(static_cast<size_t>(segment_number) * RawSegment::kCapacity));
+  inno_log_verify(buffer_, "malloc failed");
+  segments_ = new RawSegment[segment_number];
+  inno_log_verify(segments_, "new RawSegment failed");
+  pthread_mutex_init(&mutex_, nullptr);
+  for (uint32_t i = segment_number; i > 0; i--) {
+    RawSegment *segment = &segments_[i - 1];
+    segment->start = buffer_ + static_cast<size_t>(i - 1)
+                                * RawSegment::kCapacity;
+    segment->len = 0;
+    segment->next = free_list_;
+    free_list_ = segment;
+  }
+  free_number_ = segment_number;
+}
+
+RawSegmentPool::~RawSegmentPool() {
+  if (free_number_ != segment_number_) {
+    inno_log_warning("%u raw segments still in use",
+                     segment_number_ - free_number_);
+  }
+  pthread_mutex_destroy(&mutex_);
+  delete[] segments_;
+  segments_ = nullptr;
+  ::free(buffer_);
+  buffer_ = nullptr;
+}
+
+RawSegment *RawSegmentPool::alloc() {
+  pthread_mutex_lock(&mutex_);
+  RawSegment *segment = free_list_;
+  if (segment) {
+    free_list_ = segment->next;
+    free_number_--;
+  }
+  pthread_mutex_unlock(&mutex_);
+  return segment;
+}
+
+void RawSegmentPool::release(RawSegment *segment) {
+  pthread_mutex_lock(&mutex_);
+  segment->next = free_list_;
+  free_list_ = segment;
+  free_number_++;
+  pthread_mutex_unlock(&mutex_);
+}
+
 RawReceiver::RawReceiver(InnoLidarClient *l, int udp_port,
-                         std::string save_path) {
+                         std::string save_path)
+    : pool_(kSegmentNumber)
+    , no_segment_number_(0) {
   inno_log_verify(l, "lidar client is null!");
   this->lidar_client_ = l;
   this->udp_port = udp_port;
@@ -49,13 +147,16 @@ void *RawReceiver::receive_loop_() {
     return nullptr;
   }
 
-  char buf[65536];
+  // only used when all segments are in use, to drop the datagram
+  char drop_buf[RawSegment::kCapacity];
   while (!lidar_client_->it_raw_recorder_->has_shutdown()) {
-    // recvfrom udp_port
+    // recvfrom udp_port, straight into a segment
+    RawSegment *segment = pool_.alloc();
+    char *buf = segment ? segment->start : drop_buf;
     struct sockaddr_in serv_addr{};
     socklen_t len = sizeof(serv_addr);
     ssize_t n;
-    while (-1 == (n = recvfrom(fd, buf, sizeof(buf),
+    while (-1 == (n = recvfrom(fd, buf, RawSegment::kCapacity,
                                MSG_WAITALL,
                                (struct sockaddr *)&serv_addr,
                                &len))
@@ -66,16 +167,26 @@ void *RawReceiver::receive_loop_() {
 //     n, errno, udp_port);
 
     if (n < 0) {
+      if (segment) {
+        pool_.release(segment);
+      }
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
         continue;
       } else {
         // should we signal when other error occurred ?
         inno_log_error_errno("recv error %d", udp_port);
       }
+    } else if (!segment) {
+      // the savers are behind, drop it rather than allocate more
+      if ((no_segment_number_++ & 0x3ff) == 0) {
+        inno_log_warning("no free raw segment, %" PRI_SIZEU " dropped",
+                         no_segment_number_);
+      }
     } else {
       Raw4UdpHeader header{};
       inno_log_verify(n <= 65535, "n too big: %" PRI_SIZELD, n);
-      if (InnoDataPacketUtils::raw4_header_from_net(buf, n, &header)) {
+      if (n > Raw4UdpHeader::kHeaderSize &&
+          InnoDataPacketUtils::raw4_header_from_net(buf, n, &header)) {
         if (msgid_saver_map_.find(header.idx)
             == msgid_saver_map_.end()) {
           // creat saver for new msg
@@ -98,9 +209,11 @@ void *RawReceiver::receive_loop_() {
                              msgid_saver_map_.size());
           }
         }
-        msgid_saver_map_[header.idx]->add_data(buf, n);
+        segment->len = n;
+        segment->header = header;
+        msgid_saver_map_[header.idx]->add_data(segment);
       } else {
-        // do nothing
+        pool_.release(segment);
       }
     }
   }
@@ -127,6 +240,7 @@ RawSaver::RawSaver(InnoLidarClient *lidar_client,
                    RawReceiver *receiver, uint32_t msg_idx) {
   lidar_client_ = lidar_client;
   receiver_ = receiver;
+  pool_ = receiver->get_pool();
   tmp_fd_ = -1;
   save_path_ = std::string(receiver->save_path);
   msg_idx_ = msg_idx;
@@ -152,22 +266,22 @@ RawSaver::~RawSaver() {
   pthread_cond_destroy(&cond_cache_);
   pthread_cond_destroy(&cond_status_);
   pthread_condattr_destroy(&condattr_);
-  inno_log_verify(cache_.empty(),
+  inno_log_verify(cached_number_ == 0,
                   "[sn%s-%s-%u] cache is not empty when saver exit!",
                   sn_.c_str(), cause_.c_str(), msg_idx_);
 }
 
 /**
- * cache data into cache_
+ * cache data into slots_
  * call by receiver
  */
-void RawSaver::add_data(char *buf, uint32_t len) {
+void RawSaver::add_data(RawSegment *segment) {
   // status
-  inno_log_verify(buf, "added buf is null!");
-  inno_log_verify(len > Raw4UdpHeader::kHeaderSize, "bad data");
+  inno_log_verify(segment && segment->is_valid(), "bad data");
   pthread_mutex_lock(&mutex_status_);
   if (status_ != Status::WORKING) {
     pthread_mutex_unlock(&mutex_status_);
+    pool_->release(segment);
     return;
   }
   pthread_mutex_unlock(&mutex_status_);
@@ -175,47 +289,60 @@ void RawSaver::add_data(char *buf, uint32_t len) {
   pthread_cond_signal(&cond_status_);
 
   // data type
-  Raw4UdpHeader header{};
-  if (InnoDataPacketUtils::raw4_header_from_net(buf, len, &header)) {
-    switch (header.field_type) {
-      case InnoRaw4Packet::TYPE_SN:
-        // sn
-        sn_ = std::string(buf + Raw4UdpHeader::kHeaderSize,
-                          len - Raw4UdpHeader::kHeaderSize);
-        InnoUtils::remove_all_chars(&sn_, RawSaver::invalid_filename_chars);
-        inno_log_info("got sn: %s", sn_.c_str());
-        break;
-      case InnoRaw4Packet::TYPE_CAUSE:
-        // cause
-        cause_ = std::string(buf + Raw4UdpHeader::kHeaderSize,
-                             len - Raw4UdpHeader::kHeaderSize);
-        InnoUtils::remove_all_chars(&cause_, RawSaver::invalid_filename_chars);
-        inno_log_info("got cause: %s", cause_.c_str());
-        break;
-      // just copy raw data into cache
-      case InnoRaw4Packet::TYPE_RAWDATA:
-      {
-        // if received id == expected id then cache and notify
-        // < expected id then drop
-        // > expected id then cache
-        pthread_mutex_lock(&mutex_cache_);
-        if (header.field_sequence_id >= expect_id_) {
-          auto *data_buf = new RawDataBuf(buf, len);
-          inno_log_verify(data_buf, "Create RawDataBuf failed!");
-          cache_.emplace(header.field_sequence_id, data_buf);
-        }
-        if (header.field_sequence_id == expect_id_) {
-          pthread_cond_signal(&cond_cache_);
+  const Raw4UdpHeader &header = segment->header;
+  const char *payload = segment->start + Raw4UdpHeader::kHeaderSize;
+  const uint32_t payload_len = segment->len - Raw4UdpHeader::kHeaderSize;
+  switch (header.field_type) {
+    case InnoRaw4Packet::TYPE_SN:
+      // sn
+      sn_ = std::string(payload, payload_len);
+      InnoUtils::remove_all_chars(&sn_, RawSaver::invalid_filename_chars);
+      inno_log_info("got sn: %s", sn_.c_str());
+      break;
+    case InnoRaw4Packet::TYPE_CAUSE:
+      // cause
+      cause_ = std::string(payload, payload_len);
+      InnoUtils::remove_all_chars(&cause_, RawSaver::invalid_filename_chars);
+      inno_log_info("got cause: %s", cause_.c_str());
+      break;
+    // keep the segment until it is written
+    case InnoRaw4Packet::TYPE_RAWDATA:
+    {
+      // if received id == expected id then cache and notify
+      // < expected id then drop
+      // > expected id then cache, if within the slot window
+      // expected id is lost if a later one falls beyond the window or
+      // too many later ones wait for it, skip it and notify
+      uint32_t sid = header.field_sequence_id;
+      bool skipped = false;
+      pthread_mutex_lock(&mutex_cache_);
+      if (sid > expect_id_ && !cached_(expect_id_) &&
+          (sid - expect_id_ >= kSlotNumber ||
+           cached_number_ >= kMaxGapCachedNumber)) {
+        skipped = skip_gap_(sid) > 0;
+      }
+      if (sid >= expect_id_) {
+        RawSegment **slot = &slots_[sid % kSlotNumber];
+        if (sid - expect_id_ < kSlotNumber && *slot == nullptr) {
+          *slot = segment;
+          cached_number_++;
+          segment = nullptr;
+        } else {
+          dropped_number_++;
         }
-        pthread_mutex_unlock(&mutex_cache_);
-        break;
       }
-
-      default:
-        inno_log_panic("unknown packet type:%d", header.field_type);
+      if (sid == expect_id_ || skipped) {
+        pthread_cond_signal(&cond_cache_);
+      }
+      pthread_mutex_unlock(&mutex_cache_);
+      break;
     }
-  } else {
-    inno_log_error("parse data error, drop it.");
+
+    default:
+      inno_log_panic("unknown packet type:%d", header.field_type);
+  }
+  if (segment) {
+    pool_->release(segment);
   }
 }
 
@@ -231,6 +358,7 @@ void *RawSaver::flush_thread_func(void *ctx) {
 void RawSaver::flush_loop_() {
   // keep processing while working
   bool tmp_file_done = false;
+  RawSegment *segments[kMaxWriteSegments];
   pthread_mutex_lock(&mutex_status_);
   while (status_ < Status::STOPPED) {
     pthread_mutex_unlock(&mutex_status_);
@@ -238,7 +366,7 @@ void RawSaver::flush_loop_() {
     pthread_mutex_lock(&mutex_cache_);
     // if cache is empty or there isn't the expected sid, wait for new data
     // time out will also wake up
-    if (cache_.find(expect_id_) == cache_.end()) {
+    if (!cached_(expect_id_)) {
       // add_data() will signal when expected id received
       // return ETIMEDOUT when wait expected id timeout
       timespec ts{};
@@ -251,19 +379,30 @@ void RawSaver::flush_loop_() {
       pthread_cond_timedwait(&cond_cache_, &mutex_cache_, &ts);
     }
     // timeout and no new data received, continue waiting
-    if (cache_.empty()) {
+    if (cached_number_ == 0) {
       pthread_mutex_unlock(&mutex_cache_);
       pthread_mutex_lock(&mutex_status_);
       continue;
     }
-    // expected id received, flush it
-    if (cache_.find(expect_id_) != cache_.end()) {
-      RawDataBuf *data_buf = cache_.find(expect_id_)->second;
-      uint32_t eid = expect_id_;
-      expect_id_++;
+    // expected id received, flush it and the ones following it
+    if (cached_(expect_id_)) {
+      uint32_t number = 0;
+      RawSegment *segment;
+      while (number < kMaxWriteSegments &&
+             (segment = cached_(expect_id_)) != nullptr) {
+        slots_[expect_id_ % kSlotNumber] = nullptr;
+        segments[number++] = segment;
+        expect_id_++;
+        if (segment->header.is_field_end()) {
+          break;
+        }
+      }
+      cached_number_ -= number;
       pthread_mutex_unlock(&mutex_cache_);
-      tmp_file_done = save_to_tmp_file_(data_buf);
-      clear_cache_by_sid_(eid);
+      tmp_file_done = save_to_tmp_file_(segments, number);
+      for (uint32_t i = 0; i < number; i++) {
+        pool_->release(segments[i]);
+      }
       if (tmp_file_done) {
         finish_();
       }
@@ -272,10 +411,8 @@ void RawSaver::flush_loop_() {
       continue;
     } else {
       // expected id still not received in time, find smallest as expected id
-      size_t i = 0;
-      while (cache_.find(expect_id_) == cache_.end() && i++ < cache_.size()) {
-        expect_id_++;
-      }
+      // all cached sids are within kSlotNumber after expect_id_
+      skip_gap_(expect_id_ + kSlotNumber);
       pthread_mutex_unlock(&mutex_cache_);
       pthread_mutex_lock(&mutex_status_);
       continue;
@@ -287,37 +424,43 @@ void RawSaver::flush_loop_() {
     finish_();
   }
   clear_cache_();
-  inno_log_info("[sn%s-%s-%u] cache cleaned",
-                sn_.c_str(), cause_.c_str(), msg_idx_);
+  inno_log_info("[sn%s-%s-%u] cache cleaned, %" PRI_SIZEU " dropped, "
+                "%" PRI_SIZEU " lost",
+                sn_.c_str(), cause_.c_str(), msg_idx_, dropped_number_,
+                lost_number_);
   inno_log_info("[sn%s-%s-%u] flush thread exit",
                 sn_.c_str(), cause_.c_str(), msg_idx_);
 }
 
+uint32_t RawSaver::skip_gap_(uint32_t limit_sid) {
+  // save_to_tmp_file_() sees the sid jump and sets incomplete_
+  uint32_t start = expect_id_;
+  if (cached_number_ == 0) {
+    expect_id_ = limit_sid;
+  } else {
+    while (!cached_(expect_id_) && expect_id_ != limit_sid) {
+      expect_id_++;
+    }
+  }
+  lost_number_ += expect_id_ - start;
+  return expect_id_ - start;
+}
+
 void RawSaver::clear_cache_() {
   inno_log_verify(status_ >= Status::STOPPED,
                   "[sn%s-%s-%u] must be stopped before clear cache",
                   sn_.c_str(), cause_.c_str(), msg_idx_);
   pthread_mutex_lock(&mutex_cache_);
-  while (!cache_.empty()) {
-    if (cache_.begin()->second) {
-      delete cache_.begin()->second;
-      cache_.begin()->second = nullptr;
-      cache_.erase(cache_.begin());
+  for (uint32_t i = 0; i < kSlotNumber && cached_number_ > 0; i++) {
+    if (slots_[i]) {
+      pool_->release(slots_[i]);
+      slots_[i] = nullptr;
+      cached_number_--;
     }
   }
   pthread_mutex_unlock(&mutex_cache_);
 }
 
-void RawSaver::clear_cache_by_sid_(uint32_t sid) {
-  pthread_mutex_lock(&mutex_cache_);
-  if (cache_.find(sid) != cache_.end()) {
-    delete cache_.find(sid)->second;
-    cache_.find(sid)->second = nullptr;
-    cache_.erase(sid);
-  }
-  pthread_mutex_unlock(&mutex_cache_);
-}
-
 //  ./;'\"!@#$%^&*<>?:{}[]()|~` AND \n
 const char *RawSaver::invalid_filename_chars = R"(" ./;'\"!@#$%^&*<>?:{}[]()|~`
                                                   ")";
@@ -392,20 +535,22 @@ void RawSaver::total_size_control_() {
   }
 }
 
-bool RawSaver::save_to_tmp_file_(RawDataBuf *data_buf) {
-  Raw4UdpHeader header{};
-  inno_log_verify(data_buf && data_buf->is_valid(), "data_buf");
-  if (!InnoDataPacketUtils::raw4_header_from_net(data_buf->start,
-                                                data_buf->len, &header)) {
-    inno_log_error("bad data: %p????, start:%p, len:%u",
-                   data_buf, data_buf->start, data_buf->len);
-    return false;
-  }
-
-  if (static_cast<int>(header.field_sequence_id) != last_flush_sid_ + 1) {
-    incomplete_ = true;
+bool RawSaver::save_to_tmp_file_(RawSegment **segments, uint32_t number) {
+  struct iovec iov[kMaxWriteSegments];
+  bool field_end = false;
+  inno_log_verify(number <= kMaxWriteSegments, "number %u", number);
+  for (uint32_t i = 0; i < number; i++) {
+    const RawSegment *segment = segments[i];
+    inno_log_verify(segment && segment->is_valid(), "segment");
+    const Raw4UdpHeader &header = segment->header;
+    if (static_cast<int>(header.field_sequence_id) != last_flush_sid_ + 1) {
+      incomplete_ = true;
+    }
+    last_flush_sid_ = static_cast<int>(header.field_sequence_id);
+    field_end = field_end || header.is_field_end();
+    iov[i].iov_base = segment->start + Raw4UdpHeader::kHeaderSize;
+    iov[i].iov_len = segment->len - Raw4UdpHeader::kHeaderSize;
   }
-  last_flush_sid_ = static_cast<int>(header.field_sequence_id);
 
   if (tmp_fd_ < 0) {
     tmp_path_ = save_path_ + "/" + std::to_string(msg_idx_) + "-tmp.inno_raw."
@@ -415,15 +560,10 @@ bool RawSaver::save_to_tmp_file_(RawDataBuf *data_buf) {
     inno_log_verify(tmp_fd_ >= 0, "open %s failed.", tmp_path_.c_str());
   }
 
-  ssize_t written;
-  while ( -1 == (written = ::write(tmp_fd_,
-          data_buf->start + Raw4UdpHeader::kHeaderSize,
-          data_buf->len - Raw4UdpHeader::kHeaderSize)) &&
-          (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
-  }
+  ssize_t written = writev_all(tmp_fd_, iov, number);
 
   // finish recording when reach the end or error occurred
-  if (header.is_field_end() || written < 0) {
+  if (field_end || written < 0) {
     if (written < 0) {
       inno_log_error("[sn%s-%s-%u] write to file failed."
                      " stop recording. errno:%d",
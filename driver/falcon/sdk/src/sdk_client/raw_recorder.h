@@ -30,25 +30,14 @@ namespace innovusion {
 class InnoLidarClient;
 class RawReceiver;
 
-class RawDataBuf {
+/**
+ * One received raw4 datagram. recvfrom() writes straight into start,
+ * the saver writes the payload to file from there, nothing is copied.
+ */
+class RawSegment {
  public:
-  RawDataBuf(char *buf, uint32_t len) {
-    start = reinterpret_cast<char *>(malloc(len + 10));
-    if (!start) {
-      inno_log_error("malloc failed! retry");
-      start = reinterpret_cast<char *>(malloc(len + 10));
-      inno_log_verify(start, "malloc failed");
-    }
-    memcpy(start, buf, len);
-    this->len = len;
-  }
-  ~RawDataBuf() {
-    if (start != nullptr) {
-      ::free(start);
-      start = nullptr;
-      len = 0;
-    }
-  }
+  // max udp datagram
+  static const uint32_t kCapacity = 65536;
 
   bool is_valid() const {
     return start && len > Raw4UdpHeader::kHeaderSize;
@@ -56,6 +45,32 @@ class RawDataBuf {
 
   char *start;
   uint32_t len;
+  Raw4UdpHeader header;
+  RawSegment *next;  // free list
+};
+
+/**
+ * Segments preallocated once by the receiver and shared by its savers.
+ * alloc() returns NULL when all are waiting to be written, the caller
+ * drops the datagram instead of growing the heap.
+ */
+class RawSegmentPool {
+ public:
+  explicit RawSegmentPool(uint32_t segment_number);
+  ~RawSegmentPool();
+  RawSegment *alloc();
+  void release(RawSegment *segment);
+  uint32_t free_number() const {
+    return free_number_;
+  }
+
+ private:
+  uint32_t segment_number_;
+  char *buffer_;
+  RawSegment *segments_;
+  RawSegment *free_list_;
+  uint32_t free_number_;
+  pthread_mutex_t mutex_;
 };
 
 class RawSaver {
@@ -80,13 +95,21 @@ class RawSaver {
   static const uint64_t kDestroyTimeOutDefaultS = 60 * 2;
   static const char *invalid_filename_chars;
   static const uint64_t kMaxTotalRawFileSize = 100 * 1024 * 1024;
+  // sid window cached ahead of expect_id_, slot = sid % kSlotNumber
+  static const uint32_t kSlotNumber = 256;
+  // a missing expect_id_ is given up once this many later sids are cached
+  // or a sid beyond the window comes, rather than waiting for the timeout
+  // while the pool runs empty
+  static const uint32_t kMaxGapCachedNumber = kSlotNumber / 2;
+  // max segments written by one writev()
+  static const uint32_t kMaxWriteSegments = 64;
 
  public:
   explicit RawSaver(InnoLidarClient *lidar_client,
                     RawReceiver *receiver, uint32_t msg_idx);
   ~RawSaver();
-  // put data in cache
-  void add_data(char *buf, uint32_t len);
+  // put data in cache, the saver returns the segment to the pool
+  void add_data(RawSegment *segment);
   void shutdown();
   bool destroied() {
     // no lock here because status change from DESTROYED to others
@@ -108,13 +131,24 @@ class RawSaver {
   static void *timer_start_(void *);
   void timer_loop_();
   /**
-   * write data to file
-   * @param sid
+   * write consecutive segments to file with one writev()
+   * @param segments in sid order
+   * @param number
    * @return true: write tmp file complete--reach the end or writing file error
    */
-  bool save_to_tmp_file_(RawDataBuf *data_buf);
+  bool save_to_tmp_file_(RawSegment **segments, uint32_t number);
+  // with mutex_cache_ held
+  RawSegment *cached_(uint32_t sid) const {
+    RawSegment *s = slots_[sid % kSlotNumber];
+    return s && s->header.field_sequence_id == sid ? s : nullptr;
+  }
+  /**
+   * with mutex_cache_ held, give up the missing expect_id_: move it to
+   * the lowest cached sid, or to limit_sid if none is cached
+   * @return number of sids given up
+   */
+  uint32_t skip_gap_(uint32_t limit_sid);
   void clear_cache_();
-  void clear_cache_by_sid_(uint32_t sid);
   void finish_();
   void total_size_control_();
 
@@ -136,15 +170,21 @@ class RawSaver {
    * If add_data get the expected id, then signal flush thread.
    * If add_data get a smaller id, then drop it.
    * If add_data get a bigger id, then push it to cache without signal.
+   * If expect_id_ is missing and add_data get an id beyond the window or
+   * too many are cached, expect_id_ is skipped, then signal.
    */
 
   uint32_t expect_id_ = 0;
 
   /**
-   * cache raw data, the memory is allocated by receiver.
-   * free after data is writen to file.
+   * cache raw data, the segments are allocated by receiver.
+   * freed after data is writen to file.
    */
-  std::unordered_map<uint32_t, RawDataBuf*> cache_;
+  RawSegmentPool *pool_;
+  RawSegment *slots_[kSlotNumber]{};
+  uint32_t cached_number_ = 0;
+  uint64_t dropped_number_ = 0;
+  uint64_t lost_number_ = 0;
   pthread_mutex_t mutex_cache_{};
 
   /**
@@ -188,11 +228,17 @@ class RawSaver {
 class RawReceiver {
  public:
   static const uint32_t kMaxMapSize = 100;
+  // 16MB address space, only the pages datagrams land in get touched
+  static const uint32_t kSegmentNumber = 256;
+
  public:
   RawReceiver(InnoLidarClient *l, int udp_port,
               std::string raw_recoder_save_path_);
   ~RawReceiver() = default;
   static void *start(void *ctx);
+  RawSegmentPool *get_pool() {
+    return &pool_;
+  }
 
  private:
   void *receive_loop_();
@@ -204,6 +250,8 @@ class RawReceiver {
  private:
   InnoLidarClient *lidar_client_;
   std::unordered_map<uint32_t, RawSaver*> msgid_saver_map_;
+  RawSegmentPool pool_;
+  uint64_t no_segment_number_;
 };
 }  // namespace innovusion
 #endif  //  SDK_CLIENT_RAW_RECORDER_H_
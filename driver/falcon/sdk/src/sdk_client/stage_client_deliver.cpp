@@ -298,7 +298,8 @@ int StageClientDeliver::update_galvo_check_result_(
                      "speed=%.4f,speed_acc=%.4f,R2=%.4f,cos_angle=%.4f,"
                      "dev_angle=%.4f,mean_angle=%.4f,"
                      "angle_r2=%.4f,fault_status=%u,fault_times=%u,"
-                     "valid_times=%d,us=%" PRI_SIZEU,
+                     "valid_times=%d,us=%" PRI_SIZEU ",lag_us=%" PRI_SIZEU
+                     ",lag_frames=%" PRI_SIZEU ",skipped=%" PRI_SIZEU,
                      check_result.frame,
                      static_cast<uint8_t>(check_result.frame_check_code),
                      check_result.points_count,
@@ -326,7 +327,10 @@ int StageClientDeliver::update_galvo_check_result_(
                      static_cast<uint8_t>(check_result.fault_status),
                      check_result.fault_times,
                      check_result.valid_times,
-                     check_result.use_time_us);
+                     check_result.use_time_us,
+                     check_result.lag_us,
+                     check_result.lag_frames,
+                     check_result.skipped_times);
   /* start to check fault */
   if (check_result.fault_status
       == INNO_GALVO_FAULT_STATUS_SET_GALVO_MIRROR
@@ -386,7 +390,7 @@ int StageClientDeliver::update_galvo_check_result_(
                 "%lf\t%lf\t%lf\t%lf\t"  // speed - cos_angle
                 "%lf\t%lf\t%lf\t"       // angle - angle_r2
                 "%u\t%u\t%u\t"          // fault_status - valid_times
-                "%lu",
+                "%lu\t%lu\t%lu\t%lu",    // use_time_us - skipped_times
                         check_result.frame,
                         static_cast<uint8_t>(check_result.frame_check_code),
                         check_result.points_count,
@@ -410,7 +414,10 @@ int StageClientDeliver::update_galvo_check_result_(
                         static_cast<uint8_t>(check_result.fault_status),
                         check_result.fault_times,
                         check_result.valid_times,
-                        check_result.use_time_us);
+                        check_result.use_time_us,
+                        check_result.lag_us,
+                        check_result.lag_frames,
+                        check_result.skipped_times);
     if (ret < static_cast<int>(sizeof(callback_msg))) {
       lidar_->do_message_callback(INNO_MESSAGE_LEVEL_DEBUG,
                               INNO_MESSAGE_CODE_GALVO_MIRROR_CHECK_RESULT,
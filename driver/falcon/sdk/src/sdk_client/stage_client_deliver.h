@@ -31,11 +31,11 @@ class StageClientDeliverConfig: public Config {
     return "LidarClient_StageClientDeliver";
   }
 
-  int set_key_value_(const std::string &key, double value) override {
+  int set_key_value_(const ConfigKey &key, double value) override {
     return -1;
   }
 
-  int set_key_value_(const std::string &key, const std::string value) override {
+  int set_key_value_(const ConfigKey &key, const std::string value) override {
     // no string attribute
     return -1;
   }
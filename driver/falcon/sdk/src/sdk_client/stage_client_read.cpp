@@ -15,11 +15,12 @@
 #include "sdk_client/lidar_client.h"
 #include "sdk_client/lidar_client_communication.h"
 #include "sdk_common/inno_lidar_packet_utils.h"
+#include "utils/shm_ring.h"
 
 namespace innovusion {
 StageClientRead::StageClientRead(InnoLidarClient *l,
                                  LidarClientCommunication *lm,
-                                 bool use_tcp,
+                                 enum InnoLidarProtocol protocol,
                                  uint16_t udp_port,
                                  int max_retry)
     : mutex_()
@@ -28,8 +29,10 @@ StageClientRead::StageClientRead(InnoLidarClient *l,
   inno_log_verify(lm, "lm should nout be NULL");
   lidar_comm_ = lm;
   max_retry_ = max_retry;
-  if (use_tcp) {
+  if (protocol == INNO_LIDAR_PROTOCOL_PCS_TCP) {
     source_ = SOURCE_TCP;
+  } else if (protocol == INNO_LIDAR_PROTOCOL_PCS_SHM) {
+    source_ = SOURCE_SHM;
   } else {
     source_ = SOURCE_UDP;
   }
@@ -96,6 +99,7 @@ void StageClientRead::start_reading_(void) {
   inno_log_verify(state_ == InnoLidarBase::STATE_INIT,
                   "%s state=%d", get_name_(), state_);
   state_ = InnoLidarBase::STATE_READING;
+  config_.copy_from_src(&config_base_);
   cond_.notify_all();
 }
 
@@ -185,6 +189,9 @@ int StageClientRead::process_job_(void *in_job) {
   } else if (source_ == SOURCE_TCP) {
     inno_log_info("read from tcp");
     ret = read_tcp_();
+  } else if (source_ == SOURCE_SHM) {
+    inno_log_info("read from shm ring");
+    ret = read_shm_();
   } else {
     inno_log_panic("invalid source %d", source_);
     ret = 1;
@@ -298,17 +305,10 @@ int StageClientRead::read_udp_(int32_t port) {
       }
     } else {
       if (n >= ssize_t(sizeof(InnoCommonHeader))) {
-        union {
-          const InnoDataPacket *data_hd;
-          const InnoStatusPacket *status_hd;
-          InnoCommonHeader *hd;
-        };
-        hd = reinterpret_cast<InnoCommonHeader *>(buff);
-        if ((hd->version.magic_number == kInnoMagicNumberDataPacket &&
-             InnoDataPacketUtils::check_data_packet(*data_hd, n)) ||
-            (hd->version.magic_number == kInnoMagicNumberStatusPacket &&
-             InnoDataPacketUtils::check_status_packet(*status_hd, n))
-            ) {
+        InnoCommonHeader *hd = reinterpret_cast<InnoCommonHeader *>(buff);
+        bool verify_crc32 = !(config_.skip_crc32_on_local &&
+                              (ntohl(cliaddr.sin_addr.s_addr) >> 24) == 127);
+        if (check_packet_(hd, n, verify_crc32)) {
           add_deliver_packet_(hd);
           buff = NULL;
         } else {
@@ -330,6 +330,88 @@ int StageClientRead::read_udp_(int32_t port) {
   return 0;
 }
 
+bool StageClientRead::check_packet_(const InnoCommonHeader *hd, ssize_t n,
+                                    bool verify_crc32) {
+  union {
+    const InnoDataPacket *data_hd;
+    const InnoStatusPacket *status_hd;
+    const InnoCommonHeader *common_hd;
+  };
+  common_hd = hd;
+  return (hd->version.magic_number == kInnoMagicNumberDataPacket &&
+          InnoDataPacketUtils::check_data_packet(*data_hd, n,
+                                                 verify_crc32)) ||
+      (hd->version.magic_number == kInnoMagicNumberStatusPacket &&
+       InnoDataPacketUtils::check_status_packet(*status_hd, n,
+                                                verify_crc32));
+}
+
+int StageClientRead::read_shm_() {
+  lidar_->before_read_start();
+
+  ShmRing *ring = NULL;
+  for (int i = 0; i < kShmAttachRetry && !stopping_or_stopped_(); i++) {
+    ring = new ShmRing(lidar_->port_, false);
+    inno_log_verify(ring, "ring");
+    if (ring->is_valid()) {
+      break;
+    }
+    delete ring;
+    ring = NULL;
+    usleep(500 * 1000);
+  }
+  if (ring == NULL) {
+    if (stopping_or_stopped_()) {
+      return 0;
+    }
+    inno_log_error("cannot attach shm ring of port %hu, "
+                   "is pcs started with --shm-ring?", lidar_->port_);
+    send_fatal_message_();
+    return 1;
+  }
+
+  // the ring is only written by the local pcs
+  bool verify_crc32 = !config_.skip_crc32_on_local;
+  uint64_t lost_reported = 0;
+  void *buff = NULL;
+  while (!stopping_or_stopped_()) {
+    if (buff == NULL) {
+      buff = lidar_->alloc_buffer_(kMaxReadSize);
+      inno_log_verify(buff, "out of memory");
+    }
+    // one copy from the ring into the packet pool, no socket in between
+    ssize_t n = ring->read(buff, kMaxReadSize, 500);
+    if (ring->get_lost() != lost_reported) {
+      inno_log_warning("shm ring lost %" PRI_SIZEU " packets, total %"
+                       PRI_SIZEU, (size_t)(ring->get_lost() - lost_reported),
+                       (size_t)ring->get_lost());
+      lost_reported = ring->get_lost();
+    }
+    if (n == 0) {
+      continue;
+    } else if (n < 0) {
+      inno_log_warning("shm ring packet too large");
+      continue;
+    }
+    InnoCommonHeader *hd = reinterpret_cast<InnoCommonHeader *>(buff);
+    if (n >= ssize_t(sizeof(InnoCommonHeader)) &&
+        check_packet_(hd, n, verify_crc32)) {
+      add_deliver_packet_(hd);
+      buff = NULL;
+    } else {
+      inno_log_warning("bad packet magic=0x%x size=%" PRI_SIZED,
+                       hd->version.magic_number, n);
+    }
+  }
+
+  if (buff) {
+    lidar_->free_buffer_(buff);
+    buff = NULL;
+  }
+  delete ring;
+  return 0;
+}
+
 int StageClientRead::read_udps_() {
   lidar_->before_read_start();
 
@@ -482,6 +564,18 @@ void StageClientRead::add_deliver_packet_(InnoCommonHeader *header) {
   lidar_->add_deliver_job_(header);
 }
 
+bool StageClientRead::is_local_peer_(int fd) {
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  if (getpeername(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                  &len) != 0) {
+    return false;
+  }
+  return addr.sin_family == AF_INET &&
+      (ntohl(addr.sin_addr.s_addr) >> 24) == 127;
+}
+
 int StageClientRead::keep_reading_fd_(int file_fd, bool is_file) {
   InnoDataPacket *data_packet = NULL;
   size_t data_len_max = kMaxReadSize;
@@ -503,6 +597,13 @@ int StageClientRead::keep_reading_fd_(int file_fd, bool is_file) {
   first_data_us_ = 0;
   total_byte_received_ = 0;
 
+  bool verify_crc32 = !(config_.skip_crc32_on_local &&
+                        (is_file || is_local_peer_(file_fd)));
+  if (!verify_crc32) {
+    inno_log_info("%s skip crc32 verification on local %s",
+                  get_name_(), is_file ? "file" : "connection");
+  }
+
   int ret = 0;
   while (1) {
     if (stopping_or_stopped_()) {
@@ -543,7 +644,7 @@ int StageClientRead::keep_reading_fd_(int file_fd, bool is_file) {
       if (data_len) {
         data_cnt++;
         if (InnoDataPacketUtils::check_data_packet(*data_packet,
-                                                   r)) {
+                                                   r, verify_crc32)) {
           latest_data_us = data_packet->common.ts_start_us;
           add_deliver_packet_(&data_packet->common);
           data_packet = NULL;
@@ -553,7 +654,7 @@ int StageClientRead::keep_reading_fd_(int file_fd, bool is_file) {
       } else if (message_len) {
         message_cnt++;
         if (InnoDataPacketUtils::check_data_packet(*message_packet,
-                                                   r)) {
+                                                   r, verify_crc32)) {
           add_deliver_packet_(&message_packet->common);
           message_packet = NULL;
         } else {
@@ -30,19 +30,23 @@ class StageClientReadConfig: public Config {
  public:
   StageClientReadConfig() : Config() {
     test = 0;
+    skip_crc32_on_local = 0;
+    huge_page = 0;
   }
 
   const char* get_type() const override {
     return "LidarClient_StageClientRead";
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                              double value) override {
     SET_CFG(test);
+    SET_CFG(skip_crc32_on_local);
+    SET_CFG(huge_page);
     return -1;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      const std::string value) override {
     // no string attribute
     return -1;
@@ -50,6 +54,11 @@ class StageClientReadConfig: public Config {
 
   BEGIN_CFG_MEMBER()
   double test;
+  // skip crc32 verification for packets read from a file or
+  // from a loopback peer
+  double skip_crc32_on_local;
+  // HugePageMode of the packet pool, read by InnoLidarClient::start()
+  double huge_page;
   END_CFG_MEMBER()
 };
 
@@ -62,6 +71,7 @@ class StageClientRead {
     SOURCE_FILE,
     SOURCE_TCP,
     SOURCE_UDP,
+    SOURCE_SHM,
     SOURCE_MAX,
   };
 
@@ -71,7 +81,7 @@ class StageClientRead {
  public:
   StageClientRead(InnoLidarClient *l,
                   LidarClientCommunication *lm,
-                  bool use_tcp,
+                  enum InnoLidarProtocol protocol,
                   uint16_t udp_port,
                   int max_retry);
   StageClientRead(InnoLidarClient *l,
@@ -87,6 +97,10 @@ class StageClientRead {
   void final_cleanup(void);
   enum InnoLidarBase::State get_state();
   void print_stats(void) const;
+  int get_huge_page() {
+    config_.copy_from_src(&config_base_);
+    return static_cast<int>(config_.huge_page);
+  }
 
  private:
   void init_(InnoLidarClient *l);
@@ -100,15 +114,20 @@ class StageClientRead {
   int read_udp_(int32_t port);
   int read_udps_();
   int read_tcp_();
+  int read_shm_();
+  bool check_packet_(const InnoCommonHeader *hd, ssize_t n,
+                     bool verify_crc32);
   int read_file_();
   bool stopping_or_stopped_();
   void add_deliver_packet_(InnoCommonHeader *header);
   int keep_reading_fd_(int fd, bool is_file);
+  bool is_local_peer_(int fd);
   void read_file_rate_control_(InnoTimestampUs last_data_us,
                                int r);
 
  public:
   static const size_t kMaxReadSize = 65536;
+  static const int kShmAttachRetry = 20;
 
  private:
   InnoLidarClient *lidar_;
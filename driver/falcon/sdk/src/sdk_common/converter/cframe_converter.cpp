@@ -9,9 +9,11 @@
 #include "sdk_common/converter/cframe_converter.h"
 
 #include <getopt.h>
+#include <math.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <list>
 #include <map>
@@ -21,11 +23,52 @@
 
 namespace innovusion {
 
-CframeConverter::CframeConverter() {
-  current_cframe_id_ = -1;
-  current_cframe_ = &cframe0_;
+CframeConverter::CframeConverter(int huge_page, bool point_ts_ns) {
+  huge_page_mem_ = NULL;
+  if (huge_page != HUGE_PAGE_OFF) {
+    huge_page_mem_ = new HugePageMem("cframe_converter",
+                                     kCframeSize * kFrameNumber,
+                                     huge_page == HUGE_PAGE_LOCKED);
+    inno_log_verify(huge_page_mem_, "cannot alloc huge_page_mem");
+    if (!huge_page_mem_->get()) {
+      delete huge_page_mem_;
+      huge_page_mem_ = NULL;
+    }
+  }
+  char *buffer;
+  if (huge_page_mem_) {
+    buffer = reinterpret_cast<char *>(huge_page_mem_->get());
+  } else {
+    buffer = reinterpret_cast<char *>(calloc(kFrameNumber, kCframeSize));
+    inno_log_verify(buffer, "cannot alloc cframe buffers");
+  }
+  uint32_t *ts_buffer = NULL;
+  if (point_ts_ns) {
+    // pages are only touched by the points added
+    ts_buffer = reinterpret_cast<uint32_t *>(
+        calloc(kFrameNumber * kMaxNumberInCframe, sizeof(uint32_t)));
+    inno_log_verify(ts_buffer, "cannot alloc point ts buffers");
+  }
+  for (uint32_t i = 0; i < kFrameNumber; i++) {
+    Frame &frame = frames_[i];
+    memset(&frame, 0, sizeof(frame));
+    frame.cframe =
+        reinterpret_cast<inno_cframe_header *>(buffer + i * kCframeSize);
+    frame.point_ts_ns = ts_buffer ? ts_buffer + i * kMaxNumberInCframe :
+                                    NULL;
+    frame.id = -1;
+  }
+  current_ = &frames_[0];
+  pending_ = NULL;
+  pending_packets_ = 0;
+  returned_ = NULL;
+  has_last_flags_ = false;
+  current_cframe_ = current_->cframe;
+  current_point_ts_ns_ = current_->point_ts_ns;
+  packet_offset_ns_ = 0;
   radius_shift_ = 0;
   angle_shift_ = 0;
+  memset(&stats_, 0, sizeof(stats_));
   for (uint32_t i = 0; i < 10; i++) {
     if ((cpoint_distance_unit_per_meter_c << i) == kInnoDistanceUnitPerMeter) {
       radius_shift_ = i;
@@ -37,20 +80,103 @@ CframeConverter::CframeConverter() {
 }
 
 CframeConverter::~CframeConverter() {
+  if (huge_page_mem_) {
+    delete huge_page_mem_;
+    huge_page_mem_ = NULL;
+  } else {
+    free(frames_[0].cframe);
+  }
+  free(frames_[0].point_ts_ns);
+  for (uint32_t i = 0; i < kFrameNumber; i++) {
+    frames_[i].cframe = NULL;
+    frames_[i].point_ts_ns = NULL;
+  }
+  current_cframe_ = NULL;
+  current_point_ts_ns_ = NULL;
 }
 
 inno_cframe_header *CframeConverter::close_current_frame() {
-  if (current_cframe_id_ != -1 &&
-      current_cframe_ &&
-      current_cframe_->item_number > 0) {
-    inno_cframe_header *ret = current_cframe_;
-    current_cframe_id_ = -1;
-    return ret;
+  returned_ = NULL;
+  if (pending_) {
+    return release_pending_();
+  }
+  if (current_->id != -1 &&
+      !current_->closed &&
+      current_->cframe->item_number > 0) {
+    finish_frame_(current_);
+    current_->id = -1;
+    return current_->cframe;
   } else {
     return NULL;
   }
 }
 
+inno_cframe_header *CframeConverter::close_current_frame_on_timeout() {
+  returned_ = NULL;
+  if (pending_) {
+    return release_pending_();
+  }
+  if (current_->id != -1 &&
+      !current_->closed &&
+      current_->cframe->item_number > 0) {
+    finish_frame_(current_);
+    current_->closed = true;
+    stats_.timeout_closed_frames++;
+    return current_->cframe;
+  } else {
+    return NULL;
+  }
+}
+
+int64_t CframeConverter::get_current_frame_span_us() const {
+  if (current_->id == -1 || current_->closed) {
+    return -1;
+  }
+  return static_cast<int64_t>(current_->cframe->ts_us_end -
+                              current_->cframe->ts_us_start);
+}
+
+const CframeConverter::Frame *CframeConverter::find_frame_(
+    const inno_cframe_header *cframe) const {
+  for (uint32_t i = 0; i < kFrameNumber; i++) {
+    if (frames_[i].cframe == cframe) {
+      return &frames_[i];
+    }
+  }
+  return NULL;
+}
+
+uint32_t *CframeConverter::get_point_ts_ns(
+    const inno_cframe_header *cframe) const {
+  const Frame *frame = find_frame_(cframe);
+  return frame ? frame->point_ts_ns : NULL;
+}
+
+const CframeConverter::Completeness *CframeConverter::get_completeness(
+    const inno_cframe_header *cframe) const {
+  const Frame *frame = find_frame_(cframe);
+  return frame ? &frame->completeness : NULL;
+}
+
+CframeConverter::Frame *CframeConverter::free_frame_() {
+  for (uint32_t i = 0; i < kFrameNumber; i++) {
+    if (&frames_[i] != pending_ && &frames_[i] != returned_) {
+      return &frames_[i];
+    }
+  }
+  inno_log_verify(false, "no free cframe");
+  return NULL;
+}
+
+inno_cframe_header *CframeConverter::release_pending_() {
+  Frame *frame = pending_;
+  pending_ = NULL;
+  finish_frame_(frame);
+  frame->closed = true;
+  returned_ = frame;
+  return frame->cframe;
+}
+
 inno_cframe_header *CframeConverter::add_data_packet(const InnoDataPacket *pkt,
                                                      int interval) {
   inno_log_verify(pkt, "pkt");
@@ -58,51 +184,222 @@ inno_cframe_header *CframeConverter::add_data_packet(const InnoDataPacket *pkt,
       pkt->type != INNO_ITEM_TYPE_XYZ_POINTCLOUD) {
     return NULL;
   }
+  returned_ = NULL;
   inno_cframe_header *ret = NULL;
-  if (ssize_t(pkt->idx) != current_cframe_id_) {
-    if (current_cframe_id_ < 0) {
+  if (pending_ && ssize_t(pkt->idx) == pending_->id) {
+    // late packet of the previous frame, still open
+    if (track_packet_(pending_, pkt)) {
+      add_packet_(pending_, pkt);
+      if (!can_get_packets_(pending_)) {
+        ret = release_pending_();
+      }
+    }
+    return ret;
+  }
+  if (ssize_t(pkt->idx) != current_->id) {
+    if (current_->id >= 0 &&
+        ssize_t(pkt->idx) < current_->id &&
+        current_->id - ssize_t(pkt->idx) <= ssize_t(kReorderFrames)) {
+      // late packet of a frame already returned
+      stats_.dropped_packets++;
+      return NULL;
+    }
+    if (pending_) {
+      // a third frame, the pending one cannot wait any longer
+      ret = release_pending_();
+    }
+    if (current_->id < 0 || current_->closed) {
       // do nothing
     } else {
       // close the previous frame
-      current_cframe_->ts_us_end = pkt->common.ts_start_us;
-      if (interval == 0 || current_cframe_id_ % interval == 0) {
-        ret = current_cframe_;
+      current_->cframe->ts_us_end = pkt->common.ts_start_us;
+      if (interval == 0 || current_->id % interval == 0) {
+        if (ret == NULL && !can_get_packets_(current_)) {
+          finish_frame_(current_);
+          current_->closed = true;
+          returned_ = current_;
+          ret = current_->cframe;
+        } else {
+          // waits for its late packets, or for the next call
+          pending_ = current_;
+          pending_packets_ = 0;
+        }
       }
     }
-    current_cframe_id_ = pkt->idx;
-    start_new_current_cframe_(pkt);
+    current_ = free_frame_();
+    start_frame_(current_, pkt);
+  } else if (current_->closed) {
+    // late packet after the frame was closed on its last packet
+    stats_.dropped_packets++;
+    return NULL;
+  }
+  if (pending_ && ret == NULL &&
+      (++pending_packets_ >= kReorderPackets ||
+       !can_get_packets_(pending_))) {
+    ret = release_pending_();
   }
-  if (interval == 0 || current_cframe_id_ % interval == 0) {
-    update_current_cframe_v2_(pkt);
+  if (interval == 0 || current_->id % interval == 0) {
+    if (!track_packet_(current_, pkt)) {
+      return ret;
+    }
+    add_packet_(current_, pkt);
+    if (ret == NULL && pending_ == NULL &&
+        current_->seen_frame_end && current_->gap_number == 0) {
+      // the last packet is in and no gap can still be filled,
+      // no need to wait for the next frame
+      current_->cframe->ts_us_end = packet_end_ts_us_(pkt);
+      finish_frame_(current_);
+      current_->closed = true;
+      stats_.early_closed_frames++;
+      returned_ = current_;
+      ret = current_->cframe;
+    }
   }
   return ret;
 }
 
-void CframeConverter::start_new_current_cframe_(const InnoDataPacket *pkt) {
-  current_cframe_ = current_cframe_ == &cframe1_ ?
-                    &cframe0_ :
-                    &cframe1_;
-  memset(current_cframe_, 0, sizeof(*current_cframe_));
+uint64_t CframeConverter::packet_end_ts_us_(const InnoDataPacket *pkt) {
+  uint64_t ts_10us = 0;
+  if (pkt->item_number == 0) {
+    // nothing
+  } else if (pkt->type == INNO_ITEM_TYPE_SPHERE_POINTCLOUD) {
+    uint32_t unit_size;
+    uint32_t mr;
+    InnoDataPacketUtils::get_block_size_and_number_return(*pkt,
+                                                          &unit_size,
+                                                          &mr);
+    const InnoBlock *last = reinterpret_cast<const InnoBlock *>(
+        reinterpret_cast<const char *>(&pkt->inno_block1s[0]) +
+        unit_size * (pkt->item_number - 1));
+    ts_10us = last->header.ts_10us;
+  } else {
+    ts_10us = pkt->xyz_points[pkt->item_number - 1].ts_10us;
+  }
+  return pkt->common.ts_start_us + ts_10us * 10;
+}
 
-  current_cframe_->version = cframe_version_c;
-  current_cframe_->flags = 0;
-  current_cframe_->checksum = 0;
-  current_cframe_->idx = pkt->idx;
-  current_cframe_->sub_idx = 0;
-  current_cframe_->sub_seq = 0;
-  current_cframe_->ts_us_start = pkt->common.ts_start_us;
-  current_cframe_->ts_us_end = pkt->common.ts_start_us;  // need to update
+bool CframeConverter::track_packet_(Frame *frame, const InnoDataPacket *pkt) {
+  uint32_t key = packet_key_(pkt->sub_idx, pkt->sub_seq);
+  if (key < frame->expect_key) {
+    // late, added only if it fills a known gap
+    for (uint32_t i = 0; i < frame->gap_number; i++) {
+      KeyRange &gap = frame->gaps[i];
+      if (key < gap.begin || key >= gap.end) {
+        continue;
+      }
+      if (key == gap.begin) {
+        gap.begin++;
+      } else if (key + 1 == gap.end) {
+        gap.end = key;
+      } else {
+        if (frame->gap_number < kReorderWindow) {
+          frame->gaps[frame->gap_number].begin = key + 1;
+          frame->gaps[frame->gap_number].end = gap.end;
+          frame->gap_number++;
+        }
+        // otherwise the upper part is given up
+        gap.end = key;
+      }
+      if (gap.begin == gap.end) {
+        frame->gaps[i] = frame->gaps[frame->gap_number - 1];
+        frame->gap_number--;
+      }
+      if (frame->lost > 0) {
+        frame->lost--;
+        stats_.lost_packets--;
+      }
+      if (pkt->is_last_sub_frame && pkt->is_last_sequence) {
+        frame->seen_frame_end = true;
+      }
+      stats_.reordered_packets++;
+      return true;
+    }
+    // duplicate, or its gap is out of the window
+    stats_.dropped_packets++;
+    return false;
+  }
+
+  if (key > frame->expect_key) {
+    // at least one packet per skipped sub-frame, plus the skipped
+    // sequences of this one
+    uint32_t expect_sub_idx = frame->expect_key >> 16;
+    uint32_t lost = pkt->sub_idx == expect_sub_idx ?
+                    key - frame->expect_key :
+                    pkt->sub_idx - expect_sub_idx + pkt->sub_seq;
+    frame->lost += lost;
+    stats_.lost_packets += lost;
+    if (frame->gap_number == kReorderWindow) {
+      // the oldest gap will not be filled any more
+      memmove(&frame->gaps[0], &frame->gaps[1],
+              sizeof(frame->gaps[0]) * (frame->gap_number - 1));
+      frame->gap_number--;
+    }
+    frame->gaps[frame->gap_number].begin = frame->expect_key;
+    frame->gaps[frame->gap_number].end = key;
+    frame->gap_number++;
+  }
+  if (pkt->is_last_sequence) {
+    has_last_flags_ = true;
+    if (pkt->is_last_sub_frame) {
+      frame->seen_frame_end = true;
+    }
+    frame->expect_key = packet_key_(pkt->sub_idx + 1, 0);
+  } else {
+    frame->expect_key = key + 1;
+  }
+  return true;
+}
+
+void CframeConverter::finish_frame_(Frame *frame) {
+  Completeness &c = frame->completeness;
+  c.lost_packets = frame->lost;
+  c.no_frame_end = has_last_flags_ && !frame->seen_frame_end;
+  stats_.frames++;
+  if (c.lost_packets > 0 || c.no_frame_end) {
+    stats_.incomplete_frames++;
+    inno_log_debug("frame %" PRI_SIZELU " incomplete, %u packets lost%s",
+                   frame->cframe->idx, c.lost_packets,
+                   c.no_frame_end ? ", no frame end" : "");
+  }
+}
+
+void CframeConverter::start_frame_(Frame *frame, const InnoDataPacket *pkt) {
+  inno_cframe_header *cframe = frame->cframe;
+  memset(cframe, 0, sizeof(*cframe));
+
+  cframe->version = cframe_version_c;
+  cframe->flags = 0;
+  cframe->checksum = 0;
+  cframe->idx = pkt->idx;
+  cframe->sub_idx = 0;
+  cframe->sub_seq = 0;
+  cframe->ts_us_start = pkt->common.ts_start_us;
+  cframe->ts_us_end = pkt->common.ts_start_us;  // need to update
   if (pkt->type == INNO_ITEM_TYPE_SPHERE_POINTCLOUD) {
-    current_cframe_->type = INNO_CFRAME_CPOINT;
+    cframe->type = INNO_CFRAME_CPOINT;
   } else if (pkt->type == INNO_ITEM_TYPE_XYZ_POINTCLOUD) {
-    current_cframe_->type = INNO_CFRAME_POINT;
+    cframe->type = INNO_CFRAME_POINT;
   } else {
     inno_log_verify(false, "invalid type %d", pkt->type);
   }
-  current_cframe_->topic = 0;
-  current_cframe_->item_number = 0;  // need to update
-  current_cframe_->conf_level = 255;
-  current_cframe_->source_id = 0;
+  cframe->topic = 0;
+  cframe->item_number = 0;  // need to update
+  cframe->conf_level = 255;
+  cframe->source_id = 0;
+
+  frame->id = pkt->idx;
+  frame->closed = false;
+  frame->seen_frame_end = false;
+  frame->expect_key = 0;
+  frame->lost = 0;
+  frame->gap_number = 0;
+  memset(&frame->completeness, 0, sizeof(frame->completeness));
+}
+
+void CframeConverter::add_packet_(Frame *frame, const InnoDataPacket *pkt) {
+  current_cframe_ = frame->cframe;
+  current_point_ts_ns_ = frame->point_ts_ns;
+  update_current_cframe_v2_(pkt);
 }
 
 inline void CframeConverter::add_cpoint_to_current_cframe_(
@@ -134,6 +431,9 @@ inline void CframeConverter::add_cpoint_to_current_cframe_(
       cpoint.flags |= 0x4;
     }
     cpoint.ref = pt.refl;
+    if (current_point_ts_ns_) {
+      current_point_ts_ns_[pcount] = point_ts_ns_(block.header.ts_10us);
+    }
     current_cframe_->item_number += 1;
   }
   return;
@@ -161,6 +461,9 @@ inline void CframeConverter::add_xyz_point_to_current_cframe_(
     point.scan_id = pt.scan_id;
     point.scan_idx = pt.scan_idx;
     point.reserved = 0;
+    if (current_point_ts_ns_) {
+      current_point_ts_ns_[pcount] = point_ts_ns_(pt.ts_10us);
+    }
 
     current_cframe_->item_number += 1;
   }
@@ -174,10 +477,15 @@ void CframeConverter::update_current_cframe_v2_(
     return;
   }
 
-  current_cframe_->ts_us_end = pkt->common.ts_start_us;  // need to update
+  if (pkt->common.ts_start_us > current_cframe_->ts_us_end) {
+    // a late packet does not move it back
+    current_cframe_->ts_us_end = pkt->common.ts_start_us;
+  }
   if (pkt->confidence_level < current_cframe_->conf_level) {
     current_cframe_->conf_level = pkt->confidence_level;
   }
+  packet_offset_ns_ = llround((pkt->common.ts_start_us -
+                               current_cframe_->ts_us_start) * 1000);
   // use macro way is as fast as the faster one
   if (pkt->type == INNO_ITEM_TYPE_SPHERE_POINTCLOUD) {
     size_t count = 0;
@@ -13,24 +13,159 @@
 #include "sdk_common/converter/cframe_legacy.h"
 #include "sdk_common/inno_lidar_packet.h"
 #include "sdk_common/inno_lidar_packet_utils.h"
+#include "utils/huge_page_mem.h"
 
 namespace innovusion {
 
+/************
+ Frame completeness
+
+ Packets of a frame are numbered (sub_idx, sub_seq), the last packet of
+ a sub-frame has is_last_sequence and the last sub-frame has
+ is_last_sub_frame. The converter expects the next number and, once the
+ lidar is seen to send the last flags, closes a frame on its last packet
+ instead of waiting for the first packet of the next frame.
+
+ A gap is counted as lost packets and remembered as a key range, a late
+ packet that falls in one of the last kReorderWindow gaps is still
+ added to the frame. Other late packets (duplicates, or packets of a
+ frame already returned) are dropped. All of it is O(kReorderWindow) per
+ packet.
+
+ A frame that can still get packets when the next one starts (a gap,
+ or no last packet yet) stays open as the pending frame for
+ kReorderPackets packets of the next frame, until a third frame starts,
+ or until it is complete, whichever comes first. So a frame is
+ returned up to one call after its last chance; frames are always
+ returned in order.
+
+ The cframe header is left as the lidar sent the frame, the
+ completeness of a returned frame is kept next to it, see
+ get_completeness().
+*************/
 class CframeConverter {
  private:
   static const size_t kMaxNumberInCframe = 600 * 1000;
+  static const uint32_t kReorderWindow = 8;
+  static const uint32_t kReorderPackets = 8;
+  // the returned, the pending and the current frame
+  static const uint32_t kFrameNumber = 3;
+  // late packets of that many previous frames are dropped, an older idx
+  // means the lidar restarted
+  static const uint64_t kReorderFrames = 2;
+  // a frame of either point type, cache line aligned
+  static const size_t kCframeSize =
+      (sizeof(inno_cframe_header) +
+       (sizeof(inno_cpoint) > sizeof(inno_point) ?
+        sizeof(inno_cpoint) : sizeof(inno_point)) * kMaxNumberInCframe +
+       63) & ~static_cast<size_t>(63);
+
+ public:
+  struct Completeness {
+    // missing when the frame was returned
+    uint32_t lost_packets;
+    // returned without its last packet, only known once the lidar is
+    // seen to send the last flags
+    bool no_frame_end;
+  };
+
+  struct Stats {
+    uint64_t frames;
+    uint64_t incomplete_frames;
+    uint64_t early_closed_frames;
+    uint64_t timeout_closed_frames;
+    uint64_t lost_packets;
+    uint64_t reordered_packets;
+    uint64_t dropped_packets;
+  };
 
  public:
-  CframeConverter();
+  // huge_page is a HugePageMode for the frame buffers, with
+  // point_ts_ns the ns offset of every point is kept as well
+  explicit CframeConverter(int huge_page = HUGE_PAGE_OFF,
+                           bool point_ts_ns = false);
   ~CframeConverter();
 
  public:
   inno_cframe_header *add_data_packet(const InnoDataPacket *pkt,
                                       int interval);
+  /*
+   * @brief Return the pending frame if any, else close the frame being
+   *        assembled, call until NULL to get both
+   */
   inno_cframe_header *close_current_frame();
+  /*
+   * @brief Same as close_current_frame() because the packets stopped,
+   *        late packets of the closed frame are dropped
+   */
+  inno_cframe_header *close_current_frame_on_timeout();
+  /*
+   * @brief ts_us_end - ts_us_start of the frame being assembled,
+   *        -1 if there is none
+   */
+  int64_t get_current_frame_span_us() const;
+  /*
+   * @brief ns from ts_us_start of every point of a frame returned by
+   *        the converter, valid until the next call that adds a packet
+   *        or closes a frame. NULL if point_ts_ns is off or the frame
+   *        is not from this converter.
+   */
+  uint32_t *get_point_ts_ns(const inno_cframe_header *cframe) const;
+  /*
+   * @brief Completeness of a frame returned by the converter, same
+   *        validity as get_point_ts_ns(), NULL if it is not from this
+   *        converter
+   */
+  const Completeness *get_completeness(
+      const inno_cframe_header *cframe) const;
+
+  const Stats &get_stats() const {
+    return stats_;
+  }
+
+ private:
+  struct KeyRange {
+    uint32_t begin;
+    uint32_t end;  // exclusive
+  };
+  struct Frame {
+    inno_cframe_header *cframe;
+    // NULL if not kept
+    uint32_t *point_ts_ns;
+    Completeness completeness;
+    ssize_t id;
+    bool closed;
+    bool seen_frame_end;
+    uint32_t expect_key;
+    uint32_t lost;
+    KeyRange gaps[kReorderWindow];
+    uint32_t gap_number;
+  };
 
  private:
-  void start_new_current_cframe_(const InnoDataPacket *pkt);
+  static inline uint32_t packet_key_(uint16_t sub_idx, uint16_t sub_seq) {
+    return (static_cast<uint32_t>(sub_idx) << 16) | sub_seq;
+  }
+  static uint64_t packet_end_ts_us_(const InnoDataPacket *pkt);
+  // ns from ts_us_start of a point ts_10us into the packet being added
+  inline uint32_t point_ts_ns_(uint32_t ts_10us) const {
+    int64_t ns = packet_offset_ns_ + static_cast<int64_t>(ts_10us) * 10000;
+    return ns < 0 ? 0 : ns > 0xffffffffLL ? 0xffffffffu : ns;
+  }
+  // a gap may still be filled or the last packet may still come
+  inline bool can_get_packets_(const Frame *frame) const {
+    return frame->gap_number > 0 ||
+           (has_last_flags_ && !frame->seen_frame_end);
+  }
+  const Frame *find_frame_(const inno_cframe_header *cframe) const;
+  // neither pending nor returned by the call in progress
+  Frame *free_frame_();
+  inno_cframe_header *release_pending_();
+  // false if the packet is a duplicate or too late
+  bool track_packet_(Frame *frame, const InnoDataPacket *pkt);
+  void finish_frame_(Frame *frame);
+  void start_frame_(Frame *frame, const InnoDataPacket *pkt);
+  void add_packet_(Frame *frame, const InnoDataPacket *pkt);
   void update_current_cframe_(const InnoDataPacket *pkt);
   void update_current_cframe_v2_(const InnoDataPacket *pkt);
   void add_cpoint_to_current_cframe_(void *ctx,
@@ -49,22 +184,26 @@ class CframeConverter {
   uint32_t radius_shift_;
   uint32_t angle_shift_;
 
-  ssize_t current_cframe_id_;
+  // kCframeSize each, huge_page_mem_ holds all of them if it could be
+  // mapped
+  Frame frames_[kFrameNumber];
+  HugePageMem *huge_page_mem_;
+  // the frame being assembled
+  Frame *current_;
+  // the previous frame waiting for its late packets, NULL if none
+  Frame *pending_;
+  // packets of the next frames since pending_ was set
+  uint32_t pending_packets_;
+  // by the call in progress, NULL if none
+  Frame *returned_;
+  bool has_last_flags_;
+  Stats stats_;
+
+  // the packet being added goes to these
   inno_cframe_header *current_cframe_;
-  union {
-    inno_cframe_header cframe0_;
-    char c0a_[sizeof(inno_cframe_header) +
-             sizeof(inno_cpoint) * kMaxNumberInCframe];
-    char c0b_[sizeof(inno_cframe_header) +
-             sizeof(inno_point) * kMaxNumberInCframe];
-  };
-  union {
-    inno_cframe_header cframe1_;
-    char c1a_[sizeof(inno_cframe_header) +
-              sizeof(inno_cpoint) * kMaxNumberInCframe];
-    char c1b_[sizeof(inno_cframe_header) +
-              sizeof(inno_point) * kMaxNumberInCframe];
-  };
+  uint32_t *current_point_ts_ns_;
+  // ts_start_us of the packet being added - ts_us_start of the frame
+  int64_t packet_offset_ns_;
 };
 
 }  // namespace innovusion
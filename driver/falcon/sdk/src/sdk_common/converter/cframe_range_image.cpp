@@ -0,0 +1,76 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+#include "sdk_common/converter/cframe_range_image.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace innovusion {
+
+const float CframeRangeImage::kMeterPerRadiusUnit =
+    1.0f / cpoint_distance_unit_per_meter_c;
+
+CframeRangeImage::CframeRangeImage(double resolution_h, double resolution_v,
+                                   double fov_h, double fov_v)
+    : resolution_h_(resolution_h)
+    , resolution_v_(resolution_v)
+    , h_angle_min_(-fov_h / 2)
+    , v_angle_max_(fov_v / 2) {
+  width_ = std::max(1, static_cast<int>(ceil(fov_h / resolution_h_)));
+  height_ = std::max(1, static_cast<int>(ceil(fov_v / resolution_v_)));
+
+  double degree_per_unit = 180.0 / cpoint_angle_unit_per_PI_c;
+  col_lut_.resize(kHAngleOffset * 2);
+  for (int32_t i = 0; i < kHAngleOffset * 2; i++) {
+    double h = (i - kHAngleOffset) * degree_per_unit;
+    int32_t col = static_cast<int32_t>(floor((h - h_angle_min_) /
+                                             resolution_h_));
+    col_lut_[i] = col >= 0 && col < static_cast<int32_t>(width_) ? col : -1;
+  }
+  row_lut_.resize(kVAngleOffset * 2);
+  for (int32_t i = 0; i < kVAngleOffset * 2; i++) {
+    double v = (i - kVAngleOffset) * degree_per_unit;
+    int32_t row = static_cast<int32_t>(floor((v_angle_max_ - v) /
+                                             resolution_v_));
+    row_lut_[i] = row >= 0 && row < static_cast<int32_t>(height_) ? row : -1;
+  }
+
+  size_t cells = static_cast<size_t>(width_) * height_;
+  range_.resize(cells, 0);
+  intensity_.resize(cells, 0);
+  timestamp_us_.resize(cells, 0);
+  touched_.reserve(cells);
+}
+
+void CframeRangeImage::start() {
+  if (touched_.size() > range_.size() / 4) {
+    memset(&range_[0], 0, range_.size() * sizeof(range_[0]));
+    memset(&intensity_[0], 0, intensity_.size() * sizeof(intensity_[0]));
+    memset(&timestamp_us_[0], 0,
+           timestamp_us_.size() * sizeof(timestamp_us_[0]));
+  } else {
+    for (size_t i = 0; i < touched_.size(); i++) {
+      uint32_t cell = touched_[i];
+      range_[cell] = 0;
+      intensity_[cell] = 0;
+      timestamp_us_[cell] = 0;
+    }
+  }
+  touched_.clear();
+}
+
+void CframeRangeImage::add_cpoints(const inno_cpoint *points, size_t number) {
+  for (size_t i = 0; i < number; i++) {
+    add_cpoint(points[i]);
+  }
+}
+
+}  // namespace innovusion
@@ -0,0 +1,137 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+#ifndef CONVERTER_CFRAME_RANGE_IMAGE_H_
+#define CONVERTER_CFRAME_RANGE_IMAGE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "sdk_common/converter/cframe_legacy.h"
+
+/************
+ Dense range image of the cpoints of a frame, for consumers that want
+ an image instead of a point list.
+
+ Same binning as RangeImage in png_range_image.h (fixed angular
+ resolution, the nearest return of a cell wins) but the cell of a
+ cpoint comes from its h/v angle through two lookup tables built once,
+ no trigonometry or division per point. The planes are allocated in
+ the constructor, points can be added while the frame is assembled
+ (e.g. per packet) and start() clears only the cells the last frame
+ touched.
+
+   row 0 is the top (v_angle_max), column 0 is the left (h_angle_min)
+   range             float meter, 0 means no return
+   intensity         uint8, ref & 0xff
+   timestamp offset  uint32 microsecond since ts_us_start of the frame
+*************/
+
+namespace innovusion {
+
+class CframeRangeImage {
+ public:
+  /*
+   * @param resolution_h Degree per column
+   * @param resolution_v Degree per row
+   * @param fov_h Width of the image in degree, centered at 0
+   * @param fov_v Height of the image in degree, centered at 0
+   */
+  CframeRangeImage(double resolution_h, double resolution_v,
+                   double fov_h, double fov_v);
+  ~CframeRangeImage() {}
+
+  /*
+   * @brief Clear the cells of the previous frame
+   */
+  void start();
+
+  inline void add_cpoint(const inno_cpoint &p) {
+    int32_t col = col_lut_[p.h_angle + kHAngleOffset];
+    int32_t row = row_lut_[p.v_angle + kVAngleOffset];
+    if (col < 0 || row < 0 || p.radius == 0) {
+      return;
+    }
+    uint32_t cell = row * width_ + col;
+    float range = p.radius * kMeterPerRadiusUnit;
+    if (range_[cell] != 0) {
+      if (range >= range_[cell]) {
+        return;
+      }
+    } else {
+      touched_.push_back(cell);
+    }
+    range_[cell] = range;
+    intensity_[cell] = p.ref & 0xff;
+    timestamp_us_[cell] = p.ts_100us * 100;
+  }
+
+  /*
+   * @brief Add the cpoints of a frame (or part of it)
+   */
+  void add_cpoints(const inno_cpoint *points, size_t number);
+
+  inline uint32_t get_width() const {
+    return width_;
+  }
+  inline uint32_t get_height() const {
+    return height_;
+  }
+  /* number of cells that got a point in this frame */
+  inline size_t get_filled_cells() const {
+    return touched_.size();
+  }
+  inline double get_h_angle_min() const {
+    return h_angle_min_;
+  }
+  inline double get_v_angle_max() const {
+    return v_angle_max_;
+  }
+  inline double get_resolution_h() const {
+    return resolution_h_;
+  }
+  inline double get_resolution_v() const {
+    return resolution_v_;
+  }
+  inline const std::vector<float> &get_range() const {
+    return range_;
+  }
+  inline const std::vector<uint8_t> &get_intensity() const {
+    return intensity_;
+  }
+  inline const std::vector<uint32_t> &get_timestamp_us() const {
+    return timestamp_us_;
+  }
+
+ private:
+  // inno_cpoint.h_angle is 13 bits, v_angle is 12 bits, both signed
+  static const int32_t kHAngleOffset = 4096;
+  static const int32_t kVAngleOffset = 2048;
+  static const float kMeterPerRadiusUnit;
+
+  double resolution_h_;
+  double resolution_v_;
+  double h_angle_min_;
+  double v_angle_max_;
+  uint32_t width_;
+  uint32_t height_;
+
+  // angle in cpoint unit + offset -> column/row, -1 if outside
+  std::vector<int32_t> col_lut_;
+  std::vector<int32_t> row_lut_;
+
+  std::vector<float> range_;
+  std::vector<uint8_t> intensity_;
+  std::vector<uint32_t> timestamp_us_;
+  std::vector<uint32_t> touched_;
+};
+
+}  // namespace innovusion
+
+#endif  // CONVERTER_CFRAME_RANGE_IMAGE_H_
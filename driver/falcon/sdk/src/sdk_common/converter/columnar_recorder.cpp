@@ -0,0 +1,699 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+#include "sdk_common/converter/columnar_recorder.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef __MINGW64__
+#include <sys/mman.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "sdk_common/converter/point_cloud_writer.h"
+#include "sdk_common/inno_lidar_api.h"
+#include "sdk_common/inno_lidar_packet_utils.h"
+#include "utils/inno_lidar_log.h"
+
+namespace innovusion {
+
+static const InnoColColumn kSphereColumns[] = {
+  INNO_COL_H_ANGLE, INNO_COL_V_ANGLE, INNO_COL_RADIUS,
+  INNO_COL_REFL, INNO_COL_TS_10US, INNO_COL_SCAN_ID,
+  INNO_COL_SCAN_IDX, INNO_COL_FLAGS,
+};
+
+static const InnoColColumn kXyzColumns[] = {
+  INNO_COL_X, INNO_COL_Y, INNO_COL_Z, INNO_COL_RADIUS,
+  INNO_COL_REFL, INNO_COL_TS_10US, INNO_COL_SCAN_ID,
+  INNO_COL_SCAN_IDX, INNO_COL_FLAGS,
+};
+
+/******************
+ * InnoColCodec
+ ******************/
+size_t InnoColCodec::encode(const int32_t *values, size_t n,
+                            InnoColEncoding encoding,
+                            std::vector<char> *out) {
+  size_t old_size = out->size();
+  if (encoding == INNO_COL_ENCODING_NONE) {
+    const char *p = reinterpret_cast<const char *>(values);
+    out->insert(out->end(), p, p + n * sizeof(int32_t));
+    return out->size() - old_size;
+  }
+  inno_log_verify(encoding == INNO_COL_ENCODING_DELTA_VARINT ||
+                  encoding == INNO_COL_ENCODING_XOR_VARINT,
+                  "invalid encoding %d", encoding);
+  // worst case is 5 bytes per value
+  out->resize(old_size + n * 5);
+  uint8_t *p = reinterpret_cast<uint8_t *>(&(*out)[old_size]);
+  uint32_t prev = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t v = values[i];
+    uint32_t z;
+    if (encoding == INNO_COL_ENCODING_DELTA_VARINT) {
+      uint32_t d = v - prev;
+      z = (d << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(d) >> 31);
+    } else {
+      z = v ^ prev;
+    }
+    prev = v;
+    while (z >= 0x80) {
+      *p++ = (z & 0x7f) | 0x80;
+      z >>= 7;
+    }
+    *p++ = z;
+  }
+  size_t used = p - reinterpret_cast<uint8_t *>(&(*out)[old_size]);
+  out->resize(old_size + used);
+  return used;
+}
+
+ssize_t InnoColCodec::decode(const char *buffer, size_t size,
+                             InnoColEncoding encoding,
+                             size_t start, size_t count,
+                             int32_t *out) {
+  size_t end = start + count;
+  if (encoding == INNO_COL_ENCODING_NONE) {
+    size_t n = size / sizeof(int32_t);
+    if (start >= n) {
+      return 0;
+    }
+    if (end > n) {
+      end = n;
+    }
+    memcpy(out, buffer + start * sizeof(int32_t),
+           (end - start) * sizeof(int32_t));
+    return end - start;
+  }
+  if (encoding != INNO_COL_ENCODING_DELTA_VARINT &&
+      encoding != INNO_COL_ENCODING_XOR_VARINT) {
+    inno_log_error("invalid encoding %d", encoding);
+    return -1;
+  }
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(buffer);
+  const uint8_t *p_end = p + size;
+  uint32_t prev = 0;
+  size_t i = 0;
+  for (; i < end && p < p_end; i++) {
+    uint32_t z = 0;
+    uint32_t shift = 0;
+    while (true) {
+      if (p >= p_end || shift > 28) {
+        return -1;
+      }
+      uint8_t b = *p++;
+      z |= static_cast<uint32_t>(b & 0x7f) << shift;
+      if ((b & 0x80) == 0) {
+        break;
+      }
+      shift += 7;
+    }
+    if (encoding == INNO_COL_ENCODING_DELTA_VARINT) {
+      prev += (z >> 1) ^ (0 - (z & 1));
+    } else {
+      prev ^= z;
+    }
+    if (i >= start) {
+      out[i - start] = prev;
+    }
+  }
+  return i > start ? i - start : 0;
+}
+
+/******************
+ * ColumnarRecorder
+ ******************/
+ColumnarRecorder::ColumnarRecorder(const std::string &f,
+                                   ssize_t size_limit_in_m)
+    : RecorderBase() {
+  filename_ = f;
+  size_limit_ = size_limit_in_m * 1000 * 1000;
+  point_type_ = INNO_ITEM_TYPE_NONE;
+  frame_started_ = false;
+  frame_idx_ = 0;
+  frame_ts_start_us_ = 0;
+  frame_confidence_level_ = 0;
+  frame_points_ = 0;
+  current_ts_10us_offset_ = 0;
+  current_flags_ = 0;
+  if (filename_.rfind(".") == std::string::npos) {
+    filename_ += ".inno_pc_col";
+  }
+
+  fd_ = open(filename_.c_str(), O_WRONLY
+             | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    inno_log_error_errno("cannot open columnar recorder %s.",
+                         filename_.c_str());
+  }
+}
+
+ColumnarRecorder::~ColumnarRecorder() {
+  flush_buffer_();
+  close_file_();
+}
+
+int ColumnarRecorder::write_(const void *buffer, size_t len) {
+  if (!is_opened()) {
+    return -1;
+  }
+  ssize_t ret = write(fd_, buffer, len);
+  if (ret < ssize_t(len)) {
+    inno_log_error_errno("write %s failed %d",
+                         filename_.c_str(), static_cast<int>(ret));
+    close(fd_);
+    fd_ = -1;
+    return -1;
+  }
+  total_size_ += len;
+  return 0;
+}
+
+int ColumnarRecorder::write_file_header_(const InnoDataPacket *pkt) {
+  InnoColFileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kInnoColFileMagic;
+  header.version = kInnoColVersion;
+  header.point_type = pkt->type;
+  header.angle_unit_per_pi_rad = kInnoAngleUnitPerPiRad;
+  header.distance_unit_per_meter = kInnoDistanceUnitPerMeter;
+  header.frame_id_base = pkt->idx;
+  return write_(&header, sizeof(header));
+}
+
+int ColumnarRecorder::write_index_() {
+  InnoColFileTail tail;
+  tail.index_offset = total_size_;
+  tail.frame_number = index_.size();
+  tail.magic = kInnoColTailMagic;
+  if (index_.size()) {
+    if (write_(&index_[0], index_.size() * sizeof(index_[0])) != 0) {
+      return -1;
+    }
+  }
+  return write_(&tail, sizeof(tail));
+}
+
+void ColumnarRecorder::close_file_() {
+  if (fd_ >= 0) {
+    write_index_();
+    if (fd_ >= 0) {
+      inno_log_info("write %lu frames, %lu points, %ld bytes to %s",
+                    total_frame_, total_points_,
+                    total_size_, filename_.c_str());
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+}
+
+void ColumnarRecorder::start_frame_(const InnoDataPacket *pkt) {
+  frame_started_ = true;
+  frame_idx_ = pkt->idx;
+  frame_ts_start_us_ = pkt->common.ts_start_us;
+  frame_confidence_level_ = pkt->confidence_level;
+  frame_points_ = 0;
+  last_frame_id_ = pkt->idx;
+  for (uint32_t c = 0; c < INNO_COL_MAX; c++) {
+    columns_[c].clear();
+  }
+}
+
+/*
+ * LZF compress the encoded chunk at the end of block_buffer_ in place,
+ * it is kept as is if that does not make it smaller.
+ */
+InnoColCompression ColumnarRecorder::compress_chunk_(size_t offset,
+                                                     size_t *size) {
+  uint32_t encoded_size = *size;
+  if (encoded_size <= sizeof(encoded_size) + 1) {
+    return INNO_COL_COMPRESSION_NONE;
+  }
+  size_t max_compressed = encoded_size - sizeof(encoded_size) - 1;
+  lzf_buffer_.resize(max_compressed);
+  size_t compressed = PointCloudWriter::lzf_compress(&block_buffer_[offset],
+                                                     encoded_size,
+                                                     &lzf_buffer_[0],
+                                                     max_compressed);
+  if (compressed == 0) {
+    return INNO_COL_COMPRESSION_NONE;
+  }
+  memcpy(&block_buffer_[offset], &encoded_size, sizeof(encoded_size));
+  memcpy(&block_buffer_[offset + sizeof(encoded_size)], &lzf_buffer_[0],
+         compressed);
+  *size = sizeof(encoded_size) + compressed;
+  block_buffer_.resize(offset + *size);
+  return INNO_COL_COMPRESSION_LZF;
+}
+
+int ColumnarRecorder::flush_buffer_() {
+  if (!frame_started_) {
+    return RERCORDER_SUCCESS;
+  }
+  frame_started_ = false;
+  if (frame_points_ == 0 || !is_opened()) {
+    return RERCORDER_SUCCESS;
+  }
+
+  const InnoColColumn *columns;
+  size_t column_number;
+  if (point_type_ == INNO_ITEM_TYPE_XYZ_POINTCLOUD) {
+    columns = kXyzColumns;
+    column_number = sizeof(kXyzColumns) / sizeof(kXyzColumns[0]);
+  } else {
+    columns = kSphereColumns;
+    column_number = sizeof(kSphereColumns) / sizeof(kSphereColumns[0]);
+  }
+
+  size_t header_size = sizeof(InnoColFrameHeader) +
+                       column_number * sizeof(InnoColChunk);
+  block_buffer_.resize(header_size);
+  for (size_t i = 0; i < column_number; i++) {
+    InnoColColumn c = columns[i];
+    inno_log_verify(columns_[c].size() == frame_points_,
+                    "column %d size %lu != %u",
+                    c, columns_[c].size(), frame_points_);
+    InnoColEncoding encoding = INNO_COL_ENCODING_DELTA_VARINT;
+    if (point_type_ == INNO_ITEM_TYPE_XYZ_POINTCLOUD &&
+        (c == INNO_COL_X || c == INNO_COL_Y || c == INNO_COL_Z ||
+         c == INNO_COL_RADIUS)) {
+      encoding = INNO_COL_ENCODING_XOR_VARINT;
+    }
+    size_t offset = block_buffer_.size();
+    size_t size = InnoColCodec::encode(&columns_[c][0], frame_points_,
+                                       encoding, &block_buffer_);
+    InnoColCompression compression = compress_chunk_(offset, &size);
+    // block_buffer_ may be reallocated by encode
+    InnoColFrameHeader *h =
+        reinterpret_cast<InnoColFrameHeader *>(&block_buffer_[0]);
+    InnoColChunk *chunk = &h->chunks[i];
+    chunk->column = c;
+    chunk->encoding = encoding;
+    chunk->compression = compression;
+    chunk->reserved = 0;
+    chunk->offset = offset;
+    chunk->size = size;
+  }
+
+  InnoColFrameHeader *header =
+      reinterpret_cast<InnoColFrameHeader *>(&block_buffer_[0]);
+  header->magic = kInnoColFrameMagic;
+  header->size = block_buffer_.size();
+  header->idx = frame_idx_;
+  header->ts_start_us = frame_ts_start_us_;
+  header->point_number = frame_points_;
+  header->column_number = column_number;
+  header->confidence_level = frame_confidence_level_;
+  header->reserved = 0;
+
+  if (size_limit_ > 0) {
+    ssize_t index_size = (index_.size() + 1) * sizeof(InnoColFrameIndex) +
+                         sizeof(InnoColFileTail);
+    if (total_size_ + ssize_t(block_buffer_.size()) + index_size >
+        size_limit_) {
+      close_file_();
+      return RERCORDER_SIZE_LIMIT;
+    }
+  }
+
+  InnoColFrameIndex index;
+  index.idx = frame_idx_;
+  index.ts_start_us = frame_ts_start_us_;
+  index.offset = total_size_;
+  index.size = block_buffer_.size();
+  index.point_number = frame_points_;
+  if (write_(&block_buffer_[0], block_buffer_.size()) != 0) {
+    return RERCORDER_STREAM_ERROR;
+  }
+  index_.push_back(index);
+  total_frame_++;
+  total_points_ += frame_points_;
+  return RERCORDER_SUCCESS;
+}
+
+inline void ColumnarRecorder::add_cpoint_(void *ctx,
+                                          const InnoDataPacket &pkt,
+                                          const InnoBlock &block,
+                                          const InnoChannelPoint &pt,
+                                          const InnoBlockFullAngles &fa,
+                                          const uint16_t ch,
+                                          const uint16_t m) {
+  if (pt.radius == 0) {
+    return;
+  }
+  uint16_t flags = current_flags_ | ch;
+  flags |= (block.header.in_roi == 3) ? (1 << 2) : 0;
+  flags |= m ? (1 << 3) : 0;
+  flags |= block.header.facet << 4;
+  flags |= pt.type << 10;
+  flags |= pt.elongation << 12;
+  columns_[INNO_COL_H_ANGLE].push_back(fa.angles[ch].h_angle);
+  columns_[INNO_COL_V_ANGLE].push_back(fa.angles[ch].v_angle);
+  columns_[INNO_COL_RADIUS].push_back(pt.radius);
+  columns_[INNO_COL_REFL].push_back(pt.refl);
+  columns_[INNO_COL_TS_10US].push_back(current_ts_10us_offset_ +
+                                       block.header.ts_10us);
+  columns_[INNO_COL_SCAN_ID].push_back(block.header.scan_id);
+  columns_[INNO_COL_SCAN_IDX].push_back(block.header.scan_idx);
+  columns_[INNO_COL_FLAGS].push_back(flags);
+  frame_points_++;
+}
+
+inline void ColumnarRecorder::add_xyz_point_(void *ctx,
+                                             const InnoDataPacket &pkt,
+                                             const InnoXyzPoint &pt) {
+  if (pt.radius <= 0) {
+    return;
+  }
+  uint16_t flags = current_flags_ | pt.channel;
+  flags |= (pt.in_roi == 3) ? (1 << 2) : 0;
+  flags |= pt.is_2nd_return ? (1 << 3) : 0;
+  flags |= pt.facet << 4;
+  flags |= pt.type << 10;
+  flags |= pt.elongation << 12;
+  columns_[INNO_COL_X].push_back(InnoColCodec::from_float(pt.x));
+  columns_[INNO_COL_Y].push_back(InnoColCodec::from_float(pt.y));
+  columns_[INNO_COL_Z].push_back(InnoColCodec::from_float(pt.z));
+  columns_[INNO_COL_RADIUS].push_back(InnoColCodec::from_float(pt.radius));
+  columns_[INNO_COL_REFL].push_back(pt.refl);
+  columns_[INNO_COL_TS_10US].push_back(current_ts_10us_offset_ +
+                                       pt.ts_10us);
+  columns_[INNO_COL_SCAN_ID].push_back(pt.scan_id);
+  columns_[INNO_COL_SCAN_IDX].push_back(pt.scan_idx);
+  columns_[INNO_COL_FLAGS].push_back(flags);
+  frame_points_++;
+}
+
+int ColumnarRecorder::add_block(const InnoDataPacket *pkt) {
+  if (!is_opened()) {
+    return RERCORDER_FILE_IS_NOT_OPEN;
+  }
+  if (pkt->type != INNO_ITEM_TYPE_SPHERE_POINTCLOUD &&
+      pkt->type != INNO_ITEM_TYPE_XYZ_POINTCLOUD) {
+    return RERCORDER_TYPE_ERROR;
+  }
+  if (pkt->idx > 1000000000L) {
+    return RERCORDER_INDEX_ERROR;
+  }
+
+  if (add_block_called_ == 0) {
+    // first call, the point type of the whole file is decided here
+    point_type_ = pkt->type;
+    frame_id_base_ = pkt->idx;
+    if (write_file_header_(pkt) != 0) {
+      return RERCORDER_STREAM_ERROR;
+    }
+  } else if (pkt->type != point_type_) {
+    return RERCORDER_TYPE_ERROR;
+  }
+  add_block_called_++;
+
+  if (!frame_started_ || pkt->idx != frame_idx_) {
+    int ret = flush_buffer_();
+    if (ret != RERCORDER_SUCCESS) {
+      return ret;
+    }
+    start_frame_(pkt);
+  }
+  if (pkt->confidence_level < frame_confidence_level_) {
+    frame_confidence_level_ = pkt->confidence_level;
+  }
+
+  current_ts_10us_offset_ =
+      (pkt->common.ts_start_us - frame_ts_start_us_) / 10;
+  // direction and confidence level are per packet
+  current_flags_ = pkt->scanner_direction << 7;
+  current_flags_ |= pkt->confidence_level << 8;
+
+  if (pkt->type == INNO_ITEM_TYPE_SPHERE_POINTCLOUD) {
+    size_t pcount = 0;
+    ITERARATE_INNO_DATA_PACKET_CPOINTS(add_cpoint_, NULL, pkt, pcount);
+  } else {
+    ITERARATE_INNO_DATA_PACKET_XYZ_POINTS(add_xyz_point_, NULL, pkt);
+  }
+  return RERCORDER_SUCCESS;
+}
+
+/******************
+ * ColumnarReader
+ ******************/
+ColumnarReader::ColumnarReader(const std::string &filename)
+    : filename_(filename)
+    , fd_(-1)
+    , base_(NULL)
+    , size_(0)
+    , mapped_(false) {
+  fd_ = open(filename_.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    inno_log_error_errno("cannot open %s", filename_.c_str());
+    return;
+  }
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+    inno_log_error_errno("cannot stat %s", filename_.c_str());
+    return;
+  }
+  size_ = st.st_size;
+  if (size_ < sizeof(InnoColFileHeader)) {
+    inno_log_error("%s is too small %lu", filename_.c_str(), size_);
+    return;
+  }
+
+#ifndef __MINGW64__
+  void *p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+  if (p == MAP_FAILED) {
+    inno_log_error_errno("cannot mmap %s", filename_.c_str());
+    return;
+  }
+  base_ = reinterpret_cast<char *>(p);
+  mapped_ = true;
+#else
+  base_ = reinterpret_cast<char *>(malloc(size_));
+  inno_log_verify(base_, "cannot alloc %lu", size_);
+  size_t got = 0;
+  while (got < size_) {
+    ssize_t r = read(fd_, base_ + got, size_ - got);
+    if (r <= 0) {
+      inno_log_error_errno("read %s failed", filename_.c_str());
+      free(base_);
+      base_ = NULL;
+      return;
+    }
+    got += r;
+  }
+#endif
+
+  const InnoColFileHeader *header = get_file_header();
+  // version 1 only differs in having no compressed chunks
+  if (header->magic != kInnoColFileMagic ||
+      header->version == 0 || header->version > kInnoColVersion) {
+    inno_log_error("%s is not a columnar file, magic=0x%x version=%u",
+                   filename_.c_str(), header->magic, header->version);
+    release_();
+    return;
+  }
+  load_index_();
+}
+
+ColumnarReader::~ColumnarReader() {
+  release_();
+}
+
+void ColumnarReader::release_() {
+  if (base_) {
+#ifndef __MINGW64__
+    if (mapped_) {
+      munmap(base_, size_);
+    }
+#else
+    free(base_);
+#endif
+    base_ = NULL;
+  }
+  mapped_ = false;
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool ColumnarReader::load_index_() {
+  index_.clear();
+  if (size_ >= sizeof(InnoColFileHeader) + sizeof(InnoColFileTail)) {
+    const InnoColFileTail *tail = reinterpret_cast<const InnoColFileTail *>(
+        base_ + size_ - sizeof(InnoColFileTail));
+    if (tail->magic == kInnoColTailMagic &&
+        tail->index_offset +
+        tail->frame_number * sizeof(InnoColFrameIndex) +
+        sizeof(InnoColFileTail) == size_) {
+      const InnoColFrameIndex *index =
+          reinterpret_cast<const InnoColFrameIndex *>(
+              base_ + tail->index_offset);
+      index_.assign(index, index + tail->frame_number);
+      return true;
+    }
+  }
+
+  // no valid tail, walk through the frame blocks
+  inno_log_warning("%s has no index, rebuild it", filename_.c_str());
+  size_t offset = sizeof(InnoColFileHeader);
+  while (offset + sizeof(InnoColFrameHeader) <= size_) {
+    const InnoColFrameHeader *h =
+        reinterpret_cast<const InnoColFrameHeader *>(base_ + offset);
+    if (h->magic != kInnoColFrameMagic ||
+        h->size < sizeof(InnoColFrameHeader) ||
+        offset + h->size > size_) {
+      break;
+    }
+    InnoColFrameIndex index;
+    index.idx = h->idx;
+    index.ts_start_us = h->ts_start_us;
+    index.offset = offset;
+    index.size = h->size;
+    index.point_number = h->point_number;
+    index_.push_back(index);
+    offset += h->size;
+  }
+  return false;
+}
+
+const InnoColFrameHeader *
+ColumnarReader::get_frame_header_(size_t frame) const {
+  if (!is_opened() || frame >= index_.size()) {
+    return NULL;
+  }
+  const InnoColFrameIndex &index = index_[frame];
+  if (index.offset + index.size > size_ ||
+      index.size < sizeof(InnoColFrameHeader)) {
+    inno_log_error("bad index of frame %lu", frame);
+    return NULL;
+  }
+  const InnoColFrameHeader *header =
+      reinterpret_cast<const InnoColFrameHeader *>(base_ + index.offset);
+  if (header->magic != kInnoColFrameMagic ||
+      sizeof(InnoColFrameHeader) +
+      header->column_number * sizeof(InnoColChunk) > index.size) {
+    inno_log_error("bad header of frame %lu", frame);
+    return NULL;
+  }
+  return header;
+}
+
+const InnoColChunk *
+ColumnarReader::find_chunk_(const InnoColFrameHeader *header,
+                            InnoColColumn column) const {
+  for (uint32_t i = 0; i < header->column_number; i++) {
+    const InnoColChunk *chunk = &header->chunks[i];
+    if (chunk->column == column) {
+      if (chunk->offset + chunk->size > header->size) {
+        inno_log_error("bad chunk %d of frame %" PRI_SIZEU,
+                       column, header->idx);
+        return NULL;
+      }
+      return chunk;
+    }
+  }
+  return NULL;
+}
+
+ssize_t ColumnarReader::decode_chunk_(const InnoColFrameHeader *header,
+                                      const InnoColChunk *chunk,
+                                      size_t start, size_t count,
+                                      int32_t *out,
+                                      std::vector<char> *scratch) const {
+  const char *data = reinterpret_cast<const char *>(header) + chunk->offset;
+  size_t size = chunk->size;
+  if (chunk->compression == INNO_COL_COMPRESSION_LZF) {
+    uint32_t encoded_size;
+    if (size < sizeof(encoded_size)) {
+      return -1;
+    }
+    memcpy(&encoded_size, data, sizeof(encoded_size));
+    // the whole chunk is decompressed even for a part of the column
+    scratch->resize(encoded_size);
+    if (encoded_size == 0 ||
+        PointCloudWriter::lzf_decompress(data + sizeof(encoded_size),
+                                         size - sizeof(encoded_size),
+                                         &(*scratch)[0],
+                                         encoded_size) != encoded_size) {
+      inno_log_error("bad lzf chunk %u of frame %" PRI_SIZEU,
+                     chunk->column, header->idx);
+      return -1;
+    }
+    data = &(*scratch)[0];
+    size = encoded_size;
+  } else if (chunk->compression != INNO_COL_COMPRESSION_NONE) {
+    inno_log_error("invalid compression %u", chunk->compression);
+    return -1;
+  }
+  return InnoColCodec::decode(data, size, InnoColEncoding(chunk->encoding),
+                              start, count, out);
+}
+
+int ColumnarReader::read_frame(size_t frame, InnoColFrame *result) const {
+  const InnoColFrameHeader *header = get_frame_header_(frame);
+  if (!header) {
+    return -1;
+  }
+  result->index = index_[frame];
+  std::vector<char> scratch;
+  for (uint32_t c = 0; c < INNO_COL_MAX; c++) {
+    result->columns[c].clear();
+  }
+  for (uint32_t i = 0; i < header->column_number; i++) {
+    const InnoColChunk *chunk = &header->chunks[i];
+    if (chunk->column >= INNO_COL_MAX ||
+        chunk->offset + chunk->size > header->size) {
+      inno_log_error("bad chunk %u of frame %lu", chunk->column, frame);
+      return -1;
+    }
+    std::vector<int32_t> &col = result->columns[chunk->column];
+    col.resize(header->point_number);
+    if (header->point_number == 0) {
+      continue;
+    }
+    ssize_t r = decode_chunk_(header, chunk, 0, header->point_number,
+                              &col[0], &scratch);
+    if (r != ssize_t(header->point_number)) {
+      inno_log_error("decode column %u of frame %lu failed %ld",
+                     chunk->column, frame, r);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+ssize_t ColumnarReader::read_column(size_t frame, InnoColColumn column,
+                                    size_t start, size_t count,
+                                    int32_t *out) const {
+  const InnoColFrameHeader *header = get_frame_header_(frame);
+  if (!header) {
+    return -1;
+  }
+  const InnoColChunk *chunk = find_chunk_(header, column);
+  if (!chunk) {
+    return -1;
+  }
+  if (start >= header->point_number) {
+    return 0;
+  }
+  if (start + count > header->point_number) {
+    count = header->point_number - start;
+  }
+  std::vector<char> scratch;
+  return decode_chunk_(header, chunk, start, count, out, &scratch);
+}
+
+}  // namespace innovusion
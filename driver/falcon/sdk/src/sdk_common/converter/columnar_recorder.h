@@ -0,0 +1,277 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+#ifndef CONVERTER_COLUMNAR_RECORDER_H_
+#define CONVERTER_COLUMNAR_RECORDER_H_
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "sdk_common/converter/recorder_base.h"
+#include "sdk_common/inno_lidar_api.h"
+#include "sdk_common/inno_lidar_packet_utils.h"
+
+/************
+ inno_pc_col file layout:
+
+   InnoColFileHeader
+   frame block 0: InnoColFrameHeader, InnoColChunk[column_number],
+                  encoded column 0, encoded column 1, ...
+   frame block 1
+   ...
+   InnoColFrameIndex[frame_number]
+   InnoColFileTail
+
+ Every column of a frame is stored in its own chunk.  Integer columns are
+ delta + zigzag + varint encoded, float columns (xyz pointcloud) are
+ xor + varint encoded on their bit pattern.  The encoded column is then
+ LZF compressed (the same encoder as binary_compressed pcd) if that makes
+ it smaller, such a chunk is the uint32_t encoded size followed by the
+ LZF data.  Version 1 files have no compressed chunks.  A reader can mmap
+ the file, jump to one frame through the index and decode only the columns
+ it needs.  If the tail is missing (e.g. recording was killed) the reader
+ rebuilds the index by walking the frame blocks.
+*************/
+
+namespace innovusion {
+
+static const uint32_t kInnoColFileMagic = 0x4c4f4349;   // "ICOL"
+static const uint32_t kInnoColFrameMagic = 0x4d524649;  // "IFRM"
+static const uint32_t kInnoColTailMagic = 0x4c494154;   // "TAIL"
+static const uint16_t kInnoColVersion = 2;
+
+enum InnoColColumn {
+  INNO_COL_H_ANGLE = 0,   /* sphere: InnoAngleUnit                       */
+  INNO_COL_V_ANGLE = 1,   /* sphere: InnoAngleUnit                       */
+  INNO_COL_RADIUS = 2,    /* sphere: InnoDistanceUnit, xyz: float meter  */
+  INNO_COL_X = 3,         /* xyz: float meter                            */
+  INNO_COL_Y = 4,         /* xyz: float meter                            */
+  INNO_COL_Z = 5,         /* xyz: float meter                            */
+  INNO_COL_REFL = 6,
+  INNO_COL_TS_10US = 7,   /* relative to ts_start_us of the frame        */
+  INNO_COL_SCAN_ID = 8,
+  INNO_COL_SCAN_IDX = 9,
+  INNO_COL_FLAGS = 10,    /* same as InnoPcNpy flags_1 | flags_2 << 8    */
+  INNO_COL_MAX = 11,
+};
+
+enum InnoColEncoding {
+  INNO_COL_ENCODING_NONE = 0,
+  INNO_COL_ENCODING_DELTA_VARINT = 1,
+  INNO_COL_ENCODING_XOR_VARINT = 2,
+  INNO_COL_ENCODING_MAX = 3,
+};
+
+enum InnoColCompression {
+  INNO_COL_COMPRESSION_NONE = 0,
+  INNO_COL_COMPRESSION_LZF = 1,
+  INNO_COL_COMPRESSION_MAX = 2,
+};
+
+DEFINE_INNO_COMPACT_STRUCT(InnoColFileHeader) {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t point_type;    /* enum InnoItemType                            */
+  uint8_t reserved0;
+  uint32_t angle_unit_per_pi_rad;
+  uint32_t distance_unit_per_meter;
+  uint64_t frame_id_base;
+  uint32_t reserved[4];
+};
+DEFINE_INNO_COMPACT_STRUCT_END
+
+DEFINE_INNO_COMPACT_STRUCT(InnoColChunk) {
+  uint8_t column;        /* enum InnoColColumn                           */
+  uint8_t encoding;      /* enum InnoColEncoding                         */
+  uint8_t compression;   /* enum InnoColCompression                      */
+  uint8_t reserved;
+  uint32_t offset;       /* from the beginning of the frame block        */
+  uint32_t size;         /* stored size in bytes                         */
+};
+DEFINE_INNO_COMPACT_STRUCT_END
+
+DEFINE_INNO_COMPACT_STRUCT(InnoColFrameHeader) {
+  uint32_t magic;
+  uint32_t size;         /* size of the whole frame block                */
+  uint64_t idx;
+  InnoTimestampUs ts_start_us;
+  uint32_t point_number;
+  uint16_t column_number;
+  uint8_t confidence_level;
+  uint8_t reserved;
+  InnoColChunk chunks[0];
+};
+DEFINE_INNO_COMPACT_STRUCT_END
+
+DEFINE_INNO_COMPACT_STRUCT(InnoColFrameIndex) {
+  uint64_t idx;
+  InnoTimestampUs ts_start_us;
+  uint64_t offset;       /* file offset of the frame block               */
+  uint32_t size;
+  uint32_t point_number;
+};
+DEFINE_INNO_COMPACT_STRUCT_END
+
+DEFINE_INNO_COMPACT_STRUCT(InnoColFileTail) {
+  uint64_t index_offset;
+  uint32_t frame_number;
+  uint32_t magic;
+};
+DEFINE_INNO_COMPACT_STRUCT_END
+
+class InnoColCodec {
+ public:
+  /*
+   * @brief Encode n values and append the result to out
+   * @return number of bytes appended
+   */
+  static size_t encode(const int32_t *values, size_t n,
+                       InnoColEncoding encoding,
+                       std::vector<char> *out);
+
+  /*
+   * @brief Decode values [start, start + count) from an encoded chunk,
+   *        the values after start + count are not touched.
+   * @return number of values decoded, -1 if the chunk is corrupted
+   */
+  static ssize_t decode(const char *buffer, size_t size,
+                        InnoColEncoding encoding,
+                        size_t start, size_t count,
+                        int32_t *out);
+
+  static inline float to_float(int32_t v) {
+    union {
+      int32_t i;
+      float f;
+    } u;
+    u.i = v;
+    return u.f;
+  }
+
+  static inline int32_t from_float(float v) {
+    union {
+      int32_t i;
+      float f;
+    } u;
+    u.f = v;
+    return u.i;
+  }
+};
+
+class ColumnarRecorder : public RecorderBase {
+ public:
+  ColumnarRecorder(const std::string &filename,
+                   ssize_t size_limit_in_m);
+  virtual ~ColumnarRecorder();
+  virtual int add_block(const InnoDataPacket *pkt);
+
+ protected:
+  virtual void close_file_();
+  virtual int flush_buffer_();
+
+ private:
+  void add_cpoint_(void *ctx,
+                   const InnoDataPacket &pkt,
+                   const InnoBlock &block,
+                   const InnoChannelPoint &pt,
+                   const InnoBlockFullAngles &,
+                   const uint16_t ch,
+                   const uint16_t m);
+  void add_xyz_point_(void *ctx,
+                      const InnoDataPacket &pkt,
+                      const InnoXyzPoint &pt);
+  void start_frame_(const InnoDataPacket *pkt);
+  int write_file_header_(const InnoDataPacket *pkt);
+  int write_index_();
+  int write_(const void *buffer, size_t len);
+  InnoColCompression compress_chunk_(size_t offset, size_t *size);
+
+ private:
+  uint8_t point_type_;
+  bool frame_started_;
+  uint64_t frame_idx_;
+  InnoTimestampUs frame_ts_start_us_;
+  uint8_t frame_confidence_level_;
+  uint32_t frame_points_;
+  int32_t current_ts_10us_offset_;
+  uint16_t current_flags_;
+  std::vector<int32_t> columns_[INNO_COL_MAX];
+  std::vector<char> block_buffer_;
+  std::vector<char> lzf_buffer_;
+  std::vector<InnoColFrameIndex> index_;
+};
+
+class InnoColFrame {
+ public:
+  InnoColFrameIndex index;
+  std::vector<int32_t> columns[INNO_COL_MAX];
+};
+
+class ColumnarReader {
+ public:
+  explicit ColumnarReader(const std::string &filename);
+  ~ColumnarReader();
+
+ public:
+  bool is_opened() const {
+    return base_ != NULL;
+  }
+  const InnoColFileHeader *get_file_header() const {
+    return reinterpret_cast<const InnoColFileHeader *>(base_);
+  }
+  size_t get_frame_number() const {
+    return index_.size();
+  }
+  const InnoColFrameIndex *get_frame_index(size_t frame) const {
+    return frame < index_.size() ? &index_[frame] : NULL;
+  }
+
+  /*
+   * @brief Decode all columns of one frame
+   * @return 0 if success, -1 otherwise
+   */
+  int read_frame(size_t frame, InnoColFrame *result) const;
+
+  /*
+   * @brief Decode points [start, start + count) of one column
+   * @return number of values decoded, -1 if the column is not found
+   *         or is corrupted
+   */
+  ssize_t read_column(size_t frame, InnoColColumn column,
+                      size_t start, size_t count,
+                      int32_t *out) const;
+
+ private:
+  void release_();
+  bool load_index_();
+  const InnoColChunk *find_chunk_(const InnoColFrameHeader *header,
+                                  InnoColColumn column) const;
+  const InnoColFrameHeader *get_frame_header_(size_t frame) const;
+  ssize_t decode_chunk_(const InnoColFrameHeader *header,
+                        const InnoColChunk *chunk,
+                        size_t start, size_t count,
+                        int32_t *out, std::vector<char> *scratch) const;
+
+ private:
+  std::string filename_;
+  int fd_;
+  char *base_;
+  size_t size_;
+  bool mapped_;
+  std::vector<InnoColFrameIndex> index_;
+};
+
+}  // namespace innovusion
+
+#endif  // CONVERTER_COLUMNAR_RECORDER_H_
@@ -322,43 +322,76 @@ bool PNGWriter::encode(int x, int y, unsigned char r, unsigned char g,
 }
 
 //
+// data of the chunk is already at p + 8, write length, type and crc
 //
-//
-bool PNGWriter::save(const SaveFunc &func) const {
-  inno_log_info("image_data_ size : %" PRI_SIZELU,
-                image_data_.size());
-
-  //
-  PNGChunk::save_IHDR(func, width_, height_, colortype_, bitdepth_,
-                      interlace_method);
-
-  //
-  PNGChunk::save_IDAT(func, this->image_data_);
-
-  //
-  PNGChunk::save_IEND(func);
-
-  return true;
+static char *png_write_chunk(char *p, const char *type, unsigned length) {
+  unsigned char *u = reinterpret_cast<unsigned char *>(p);
+  u[0] = (unsigned char)((length >> 24) & 0xff);
+  u[1] = (unsigned char)((length >> 16) & 0xff);
+  u[2] = (unsigned char)((length >> 8) & 0xff);
+  u[3] = (unsigned char)((length)&0xff);
+  memcpy(u + 4, type, 4);
+
+  // crc on type + data
+  unsigned r = 0xffffffffu;
+  for (unsigned i = 4; i < length + 8; i++) {
+    r = png_crc32_table[(r ^ u[i]) & 0xffu] ^ (r >> 8u);
+  }
+  r ^= 0xffffffffu;
+
+  unsigned char *crc = u + 8 + length;
+  crc[0] = (unsigned char)((r >> 24) & 0xff);
+  crc[1] = (unsigned char)((r >> 16) & 0xff);
+  crc[2] = (unsigned char)((r >> 8) & 0xff);
+  crc[3] = (unsigned char)((r)&0xff);
+  return p + 12 + length;
 }
 
-
 //
 //
 //
 bool PNGWriter::saveto_buffer(std::vector<char>* buf) const {
-  inno_log_info("save begin -- buff size : %" PRI_SIZELU,
-                buf->size());
+  inno_log_info("image_data_ size : %" PRI_SIZELU,
+                image_data_.size());
+
+  // signature + IHDR + IDAT + IEND
+  size_t start = buf->size();
+  buf->resize(start + png_signature_size + (12 + 13) + 12 +
+              PNGCompress::compress_bound(image_data_.size()) + 12);
+  char *begin = &(*buf)[0];
+  char *p = begin + start;
 
   // write signature
-  buf->insert(buf->end(), png_signature, png_signature + png_signature_size);
+  memcpy(p, png_signature, png_signature_size);
+  p += png_signature_size;
 
-  SaveFunc func = [&buf](PNGChunk &chunk) {
-    chunk.saveto_buffer(buf);
-    return true;
-  };
+  //
+  unsigned char *ihdr = reinterpret_cast<unsigned char *>(p + 8);
+  unsigned dim[2] = {width_, height_};
+  for (int i = 0; i < 2; i++) {
+    ihdr[i * 4 + 0] = (unsigned char)((dim[i] >> 24) & 0xff);
+    ihdr[i * 4 + 1] = (unsigned char)((dim[i] >> 16) & 0xff);
+    ihdr[i * 4 + 2] = (unsigned char)((dim[i] >> 8) & 0xff);
+    ihdr[i * 4 + 3] = (unsigned char)((dim[i]) & 0xff);
+  }
+  ihdr[8] = (unsigned char)bitdepth_;    // bit depth
+  ihdr[9] = (unsigned char)colortype_;   // color type
+  ihdr[10] = 0;                          // compression method
+  ihdr[11] = 0;                          // filter method
+  ihdr[12] = interlace_method;           // interlace method
+  p = png_write_chunk(p, "IHDR", 13);
 
-  save(func);
+  //
+  size_t idat_size =
+      compress_.compress(reinterpret_cast<unsigned char *>(p + 8),
+                         image_data_.data(), image_data_.size());
+  inno_log_info("IDAT chunk.data : %" PRI_SIZELU, idat_size);
+  p = png_write_chunk(p, "IDAT", idat_size);
 
+  //
+  p = png_write_chunk(p, "IEND", 0);
+
+  buf->resize(p - begin);
   inno_log_info("save end -- buff size : %" PRI_SIZELU,
                 buf->size());
   return true;
@@ -376,17 +409,11 @@ bool PNGWriter::saveto_file(const std::string &filename) const {
     return false;
   }
 
-  // write signature
-  fwrite(png_signature, 1, png_signature_size, file);
-
-  SaveFunc func = [&file](PNGChunk &chunk) {
-    chunk.saveto_file(file);
-    return true;
-  };
-
-  save(func);
+  std::vector<char> buf;
+  saveto_buffer(&buf);
+  bool ret = fwrite(buf.data(), 1, buf.size(), file) == buf.size();
 
   fclose(file);
-  return true;
+  return ret;
 }
 }  // namespace innovusion
@@ -37,6 +37,8 @@
 #include <string>
 #include <functional>
 
+#include "sdk_common/converter/png_zlib.h"
+
 namespace innovusion {
 
   using PNGVector = std::vector<std::uint8_t>;
@@ -127,7 +129,8 @@ class PNGWriter {
     bool encode(int x, int y, unsigned char r, unsigned char g,
                 unsigned char b);
 
-    //
+    // IHDR, IDAT, IEND appended to buf, buf is resized once and the
+    // IDAT is compressed in place, a reused buf is not reallocated
     bool saveto_buffer(std::vector<char>* buf) const;
 
     //
@@ -136,11 +139,13 @@ class PNGWriter {
  private:
     //
     bool filter();
-    bool save(const SaveFunc &saveFunc) const;
 
  private:
     PNGVector image_data_;
 
+    // keeps its hash table between images
+    mutable PNGCompress compress_;
+
     unsigned width_;
     unsigned height_;
 
@@ -14,6 +14,7 @@
 #include "sdk_common/inno_lidar_api.h"
 #include "sdk_common/inno_lidar_packet_utils.h"
 #include "utils/inno_lidar_log.h"
+#include "utils/utils.h"
 
 namespace innovusion {
 
@@ -23,7 +24,9 @@ constexpr int INVALID_FRAME_IDX = -1;
 //
 //
 PngRecorder::PngRecorder(size_t job_duration, size_t max_pack_num,
-                         size_t max_block_num, bool ignore_first_frame) {
+                         size_t max_block_num, bool ignore_first_frame)
+    : state_(State::Invalid)
+    , encoder_(NULL) {
   inno_log_info("++++++++ PngRecorder ++++++++");
 
   job_duration_ = job_duration;
@@ -39,24 +42,23 @@ PngRecorder::PngRecorder(size_t job_duration, size_t max_pack_num,
 
   frame_captured_ = 0;
   current_point_in_frame_ = 0;
+  points_in_image_ = 0;
+
+  encode_ms_ = 0;
+  png_size_ = 0;
 
   //
-  size_t len_saved_ =
-      sizeof(InnoDataPacket) + sizeof(InnoBlock2) * max_block_num;
-  saved_packet_ =
-      reinterpret_cast<InnoDataPacket *>(calloc(len_saved_, 1));
-  inno_log_verify(saved_packet_,
-                  "cannot allocate saved_ %" PRI_SIZELU,
-                  len_saved_);
-  memset(saved_packet_, 0, len_saved_);
-
-  size_t header_len_saved = sizeof(InnoDataPacket) * max_pack_num;
-  saved_packet_headers_ =
-      reinterpret_cast<InnoDataPacket *>(calloc(header_len_saved, 1));
-  inno_log_verify(saved_packet_headers_,
-                  "cannot allocate saved_header %" PRI_SIZELU,
-                  header_len_saved);
-  memset(saved_packet_headers_, 0, header_len_saved);
+  float angularResolution_x = static_cast<float>(0.05f * (M_PI / 180.0f));
+  float angularResolution_y = static_cast<float>(0.05f * (M_PI / 180.0f));
+
+  float maxAngleWidth = static_cast<float>(120.0f * (M_PI / 180.0f));
+  float maxAngleHeight = static_cast<float>(60.0f * (M_PI / 180.0f));
+
+  range_image_ = new RangeImage(angularResolution_x, angularResolution_y,
+                                maxAngleWidth, maxAngleHeight);
+  inno_log_verify(range_image_, "cannot allocate range_image");
+  range_image_->start();
+
   if (!ignore_first_frame) {
     start_capture_();
   }
@@ -68,13 +70,13 @@ PngRecorder::PngRecorder(size_t job_duration, size_t max_pack_num,
 PngRecorder::~PngRecorder() {
   inno_log_info("-------- ~PngRecorder --------");
 
-  if (saved_packet_) {
-    free(saved_packet_);
+  if (encoder_) {
+    encoder_->join();
+    delete encoder_;
+    encoder_ = NULL;
   }
 
-  if (saved_packet_headers_) {
-    free(saved_packet_headers_);
-  }
+  delete range_image_;
 }
 
 void PngRecorder::start_capture_() {
@@ -127,6 +129,31 @@ void PngRecorder::switch_state_(const InnoDataPacket* pkt) {
   frame_idx_last_ = pkt->idx;
 }
 
+//
+//
+//
+static inline void insert_cpoint_(RangeImage *range_image,
+                                  const InnoDataPacket &,
+                                  const InnoBlock &,
+                                  const InnoChannelPoint &pt,
+                                  const InnoBlockFullAngles &full_angles,
+                                  uint32_t ch, uint32_t) {
+  if (pt.radius > 0) {
+    InnoXyzrD xyzr;
+    InnoDataPacketUtils::get_xyzr_meter(full_angles.angles[ch], pt.radius,
+                                        ch, &xyzr);
+    range_image->insert_point(xyzr.x, xyzr.y, xyzr.z, pt.refl);
+  }
+}
+
+static inline void insert_xyz_point_(RangeImage *range_image,
+                                     const InnoDataPacket &,
+                                     const InnoXyzPoint &pt) {
+  if (pt.radius > 0) {
+    range_image->insert_point(pt.x, pt.y, pt.z, pt.refl);
+  }
+}
+
 //
 //
 //
@@ -138,30 +165,28 @@ void PngRecorder::capture_packet_(const InnoDataPacket *pkt) {
     return;
   }
 
+  // whole packets only, the blocks are rasterized in place
   uint32_t block_left = max_block_num_ - block_so_far_;
-  uint32_t block_to_copy = pkt->item_number;
-  if (block_to_copy > block_left) {
-    block_to_copy = block_left;
+  if (pkt->item_number > block_left) {
     inno_log_warning("reach limit kMaxBlockNum %" PRI_SIZELU,
                      max_block_num_);
+    return;
   }
 
-  current_point_in_frame_ += InnoDataPacketUtils::get_points_count(*pkt);
-  for (uint32_t i = 0; i < block_to_copy; i++) {
-    if (pkt->multi_return_mode == INNO_MULTIPLE_RETURN_MODE_SINGLE) {
-      memcpy(saved_packet_->inno_block2s + block_so_far_, &pkt->inno_block1s[i],
-             sizeof(InnoBlock1));
-    } else {
-      memcpy(saved_packet_->inno_block2s + block_so_far_, &pkt->inno_block2s[i],
-             sizeof(InnoBlock2));
-    }
-    block_so_far_++;
-  }
-
-  if (block_to_copy > 0) {
-    memcpy(saved_packet_headers_ + packet_so_far_, pkt, sizeof(InnoDataPacket));
-    packet_so_far_++;
+  // rasterize now, the range image keeps the nearest point of a pixel
+  uint32_t points = 0;
+  if (pkt->type == INNO_ITEM_TYPE_SPHERE_POINTCLOUD) {
+    ITERARATE_INNO_DATA_PACKET_CPOINTS(insert_cpoint_, range_image_, pkt,
+                                       points);
+  } else if (pkt->type == INNO_ITEM_TYPE_XYZ_POINTCLOUD) {
+    ITERARATE_INNO_DATA_PACKET_XYZ_POINTS(insert_xyz_point_, range_image_,
+                                          pkt);
+    points = pkt->item_number;
   }
+  current_point_in_frame_ += points;
+  points_in_image_ += points;
+  block_so_far_ += pkt->item_number;
+  packet_so_far_++;
   return;
 }
 
@@ -179,75 +204,38 @@ bool PngRecorder::capture(const InnoDataPacket *pkt) {
   return this->state_ == State::Saving;
 }
 
-//
-//
-//
-void PngRecorder::save_point_to_image_(RangeImage* range_image) {
-  inno_log_verify(range_image != NULL, "range_image");
-
-  InnoBlock2 *block;
-  size_t current_packet = 0;
-
-  for (size_t i = 0; i < block_so_far_; i++) {
-    inno_log_verify(current_packet < packet_so_far_,
-                    "%" PRI_SIZELU " vs %u",
-                    current_packet, packet_so_far_);
-
-    block = &saved_packet_->inno_block2s[i];
-
-    InnoBlockFullAngles full_angles;
-    InnoDataPacketUtils::get_block_full_angles(&full_angles, block->header);
-
-    for (uint32_t ch = 0; ch < kInnoChannelNumber; ch++) {
-      for (uint32_t m = 0; m < 2; m++) {
-        InnoChannelPoint &pt = block->points[InnoBlock2::get_idx(ch, m)];
-        if (pt.radius > 0) {
-          InnoXyzrD xyzr;
-          InnoDataPacketUtils::get_xyzr_meter(full_angles.angles[ch], pt.radius,
-                                              ch, &xyzr);
-
-          range_image->insert_point(xyzr.x, xyzr.y, xyzr.z, pt.refl);
-        }
-      }
-    }
-  }
-}
-
 //
 //
 //
 void PngRecorder::save_png_(SaveFunc save_func) {
   inno_log_info("save_to_png, block_so_far_ : %u", block_so_far_);
 
-  //
-  float angularResolution_x = static_cast<float>(0.05f * (M_PI / 180.0f));
-  float angularResolution_y = static_cast<float>(0.05f * (M_PI / 180.0f));
-
-  float maxAngleWidth = static_cast<float>(120.0f * (M_PI / 180.0f));
-  float maxAngleHeight = static_cast<float>(60.0f * (M_PI / 180.0f));
-
-  RangeImage range_image(angularResolution_x, angularResolution_y,
-                         maxAngleWidth, maxAngleHeight);
-
-  range_image.start();
-  save_point_to_image_(&range_image);
-  range_image.stop();
+  uint64_t start_ns = InnoUtils::get_time_ns(CLOCK_MONOTONIC);
+  range_image_->stop();
 
   // save
   RangeColor colorScale(ColorType::BGYR);
-  PNGWriter pngWriter(range_image.width, range_image.height,
+  PNGWriter pngWriter(range_image_->width, range_image_->height,
                       PNGColorType::RGB, 8);
 
-  range_image.get_image(
+  range_image_->get_image(
       [&colorScale](float range, float ref, unsigned char* r,
                     unsigned char* g, unsigned char* b) {
         colorScale.getColor(range, ref, r, g, b);
       },
       [&pngWriter](int x, int y, unsigned char r, unsigned char g,
                     unsigned char b) { pngWriter.encode(x, y, r, g, b); });
+  uint64_t color_ns = InnoUtils::get_time_ns(CLOCK_MONOTONIC);
 
   save_func(pngWriter);
 
+  encode_ms_ = (InnoUtils::get_time_ns(CLOCK_MONOTONIC) - start_ns) / 1e6;
+  inno_log_info("png snapshot %dx%d, %" PRI_SIZELU " points, "
+                "color %.1f ms, encode %.1f ms, %" PRI_SIZELU " bytes",
+                range_image_->width, range_image_->height,
+                (size_t)points_in_image_, (color_ns - start_ns) / 1e6,
+                encode_ms_ - (color_ns - start_ns) / 1e6, png_size_);
+
   // switch state
   this->state_ = State::Finish;
 }
@@ -258,9 +246,11 @@ void PngRecorder::save_png_(SaveFunc save_func) {
 void PngRecorder::save(std::vector<char>* buf) {
   inno_log_verify(buf, "png buf");
 
-  save_png_([buf](const PNGWriter& pngWriter){
+  save_png_([this, buf](const PNGWriter& pngWriter){
     inno_log_info("saveto_buffer");
+    size_t size = buf->size();
     pngWriter.saveto_buffer(buf);
+    png_size_ = buf->size() - size;
   });
 }
 
@@ -278,10 +268,37 @@ void PngRecorder::save(const std::string& filename) {
     }
   }
 
-  save_png_([&filename_](const PNGWriter& pngWriter){
+  save_png_([this, &filename_](const PNGWriter& pngWriter){
     inno_log_info("saveto_file");
-    pngWriter.saveto_file(filename_);
+    png_buffer_.clear();
+    pngWriter.saveto_buffer(&png_buffer_);
+    png_size_ = png_buffer_.size();
+
+    FILE *file = fopen(filename_.c_str(), "wb");
+    if (!file) {
+      inno_log_error("failed to open %s for writing", filename_.c_str());
+      return;
+    }
+    if (fwrite(png_buffer_.data(), 1, png_buffer_.size(), file) !=
+        png_buffer_.size()) {
+      inno_log_error("failed to write %s", filename_.c_str());
+    }
+    fclose(file);
+  });
+}
+
+//
+//
+//
+void PngRecorder::save_async(const std::string& filename) {
+  inno_log_verify(encoder_ == NULL, "png encoder already started");
+
+  // capture() stops at once, the encoder owns the range image from now
+  this->state_ = State::Encoding;
+  encoder_ = new std::thread([this, filename]() {
+    save(filename);
   });
+  inno_log_verify(encoder_, "cannot create png encoder thread");
 }
 
 }  // namespace innovusion
@@ -8,12 +8,24 @@
 #ifndef CONVERTER_PNG_RECORDER_H_
 #define CONVERTER_PNG_RECORDER_H_
 
+#include <atomic>
 #include <functional>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "sdk_common/inno_lidar_api.h"
 
+/************
+ Capture job_duration frames into one range image png.
+
+ Points are rasterized into the range image as the packets arrive,
+ nothing is copied and there is no big pass over the frame at the end.
+ save() colors and encodes synchronously, save_async() does it on a
+ worker thread so the data callback is not blocked: capture() returns
+ false while encoding and is_finished() tells when the png is written.
+*************/
+
 namespace innovusion {
 class RangeImage;
 class PNGWriter;
@@ -24,6 +36,7 @@ enum class State {
   Invalid,
   Capturing,
   Saving,
+  Encoding,
   Finish
 };
 
@@ -37,26 +50,42 @@ enum class State {
   void save(std::vector<char>* buf);
   void save(const std::string& filename);
 
+  /*
+   * @brief Encode and write the png on a worker thread
+   */
+  void save_async(const std::string& filename);
+  bool is_finished() const {
+    return state_ == State::Finish;
+  }
+
+  // of the last snapshot
+  double get_encode_ms() const {
+    return encode_ms_;
+  }
+  size_t get_png_size() const {
+    return png_size_;
+  }
+
  private:
   void start_capture_();
   void switch_state_(const InnoDataPacket *pkt);
   void capture_packet_(const InnoDataPacket *pkt);
 
-  void save_point_to_image_(RangeImage* range_image);
-
   using SaveFunc = std::function<void(const PNGWriter&)>;
   void save_png_(SaveFunc save_func);
 
  private:
-  State state_ = State::Invalid;
+  std::atomic<State> state_;
 
   size_t job_duration_;
 
   size_t max_pack_num_;
   size_t max_block_num_;
 
-  InnoDataPacket *saved_packet_;
-  InnoDataPacket *saved_packet_headers_;
+  RangeImage *range_image_;
+  std::thread *encoder_;
+  // reused by the file save
+  std::vector<char> png_buffer_;
 
   uint32_t block_so_far_;
   uint32_t packet_so_far_;
@@ -65,6 +94,10 @@ enum class State {
   uint64_t frame_captured_;
 
   uint32_t current_point_in_frame_;
+  uint64_t points_in_image_;
+
+  double encode_ms_;
+  size_t png_size_;
 };
 
 }  // namespace innovusion
@@ -28,73 +28,163 @@
 */
 
 #include "sdk_common/converter/png_zlib.h"
-// #include <stdlib.h> /* allocations */
 
 namespace innovusion {
+
+static const uint32_t kHashBits = 15;
+static const uint32_t kWindowSize = 32768;
+static const uint32_t kMinMatch = 4;
+static const uint32_t kMaxMatch = 258;
+
+/* RFC 1951 3.2.5, length codes 257..285 and distance codes 0..29 */
+static const unsigned kLengthBase[29] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned kLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+    2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned kDistBase[30] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned kDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/* huffman codes are sent msb first, the bit stream is lsb first */
+static unsigned reverse_bits(unsigned code, unsigned bits) {
+  unsigned r = 0;
+  for (unsigned i = 0; i < bits; i++) {
+    r = (r << 1) | ((code >> i) & 1u);
+  }
+  return r;
+}
+
 /*
-  non compressed deflate block data: 
-    1 bit BFINAL,
-    2 bits BTYPE,
-    (5 bits): it jumps to start of next byte, 
-    2 bytes LEN, 
-    2 bytes NLEN, 
-    LEN bytes literal DATA
+  Fixed huffman codes (BTYPE 01), ready to be written:
+    literal/length symbol -> reversed code
+    match length 3..258   -> reversed code | extra bits, in one put
+    distance - 1          -> distance symbol, zlib d_code style
 */
-static unsigned deflateNoCompression(std::vector<unsigned char>* out,
-                                     const std::vector<unsigned char> &in) {
-  size_t datasize = in.size();
-
-  size_t block_size = 65535u;
-  size_t block_count = (in.size() + block_size - 1) / block_size;
-
-  unsigned datapos = 0;
-  for (size_t i = 0; i != block_count; ++i) {
-    unsigned BFINAL = (i == block_count - 1);
-    unsigned BTYPE = 0;
-
-    unsigned LEN = block_size;
-    if (datasize - datapos < block_size) LEN = (unsigned)datasize - datapos;
-    unsigned NLEN = block_size - LEN;
-
-    unsigned char firstbyte =
-        (unsigned char)(BFINAL + ((BTYPE & 1u) << 1u) + ((BTYPE & 2u) << 1u));
-    out->push_back(firstbyte);
-    out->push_back((unsigned char)(LEN & 255));
-    out->push_back((unsigned char)(LEN >> 8u));
-    out->push_back((unsigned char)(NLEN & 255));
-    out->push_back((unsigned char)(NLEN >> 8u));
-
-    out->insert(out->end(), in.data() + datapos, in.data() + datapos + LEN);
-    datapos += LEN;
+struct FixedHuffman {
+  FixedHuffman() {
+    for (unsigned sym = 0; sym < 288; sym++) {
+      unsigned code;
+      unsigned bits;
+      if (sym < 144) {
+        code = 0x30 + sym;
+        bits = 8;
+      } else if (sym < 256) {
+        code = 0x190 + sym - 144;
+        bits = 9;
+      } else if (sym < 280) {
+        code = sym - 256;
+        bits = 7;
+      } else {
+        code = 0xc0 + sym - 280;
+        bits = 8;
+      }
+      lit_code[sym] = reverse_bits(code, bits);
+      lit_bits[sym] = bits;
+    }
+    for (unsigned len = kMinMatch - 1; len <= kMaxMatch; len++) {
+      unsigned i = 28;
+      while (len < kLengthBase[i]) i--;
+      unsigned sym = 257 + i;
+      len_code[len] = lit_code[sym] |
+                      ((len - kLengthBase[i]) << lit_bits[sym]);
+      len_bits[len] = lit_bits[sym] + kLengthExtra[i];
+    }
+    // distances above 256 have extra bits >= 7 and bases - 1 that are
+    // multiples of 128, the low 7 bits don't change the symbol
+    for (unsigned d = 0; d < 256; d++) {
+      dist_sym[d] = dist_symbol(d + 1);
+      dist_sym[256 + d] = d < 2 ? 0 : dist_symbol((d << 7) + 1);
+    }
+  }
+
+  static unsigned dist_symbol(unsigned dist) {
+    unsigned i = 29;
+    while (dist < kDistBase[i]) i--;
+    return i;
+  }
+
+  uint32_t lit_code[288];
+  uint8_t lit_bits[288];
+  uint32_t len_code[kMaxMatch + 1];
+  uint8_t len_bits[kMaxMatch + 1];
+  uint8_t dist_sym[512];
+};
+
+static const FixedHuffman &fixed_huffman() {
+  static const FixedHuffman table;
+  return table;
+}
+
+class BitWriter {
+ public:
+  explicit BitWriter(unsigned char *out)
+      : out_(out)
+      , bits_(0)
+      , count_(0) {
+  }
+
+  // count <= 32
+  inline void put(uint32_t value, uint32_t count) {
+    bits_ |= static_cast<uint64_t>(value) << count_;
+    count_ += count;
+    if (count_ >= 32) {
+      out_[0] = static_cast<unsigned char>(bits_);
+      out_[1] = static_cast<unsigned char>(bits_ >> 8);
+      out_[2] = static_cast<unsigned char>(bits_ >> 16);
+      out_[3] = static_cast<unsigned char>(bits_ >> 24);
+      out_ += 4;
+      bits_ >>= 32;
+      count_ -= 32;
+    }
+  }
+
+  unsigned char *flush() {
+    while (count_ > 0) {
+      *out_++ = static_cast<unsigned char>(bits_);
+      bits_ >>= 8;
+      count_ = count_ > 8 ? count_ - 8 : 0;
+    }
+    return out_;
   }
 
-  return 0;
+ private:
+  unsigned char *out_;
+  uint64_t bits_;
+  uint32_t count_;
+};
+
+static inline uint32_t load32(const unsigned char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t hash32(uint32_t v) {
+  return (v * 2654435761u) >> (32 - kHashBits);
 }
 
 /*Return the adler32 of the bytes data[0..len-1]*/
-static unsigned update_adler32(unsigned adler,
-                               const std::vector<unsigned char> &in) {
+static unsigned update_adler32(unsigned adler, const unsigned char *in,
+                               size_t size) {
   unsigned s1 = adler & 0xffffu;
   unsigned s2 = (adler >> 16u) & 0xffffu;
 
-  unsigned i = 0;
-  for (unsigned char c : in) {
-    s1 += c;
-    s2 += s1;
-
-    i++;
-
+  while (size > 0) {
     /*at least 5552 sums can be done before the sums overflow, saving a lot of
      * module divisions*/
-    if (i >= 5552u) {
-      s1 %= 65521u;
-      s2 %= 65521u;
-
-      i = 0;
+    size_t n = size < 5552u ? size : 5552u;
+    size -= n;
+    for (size_t i = 0; i < n; i++) {
+      s1 += in[i];
+      s2 += s1;
     }
-  }
-
-  if (i > 0) {
+    in += n;
     s1 %= 65521u;
     s2 %= 65521u;
   }
@@ -102,60 +192,101 @@ static unsigned update_adler32(unsigned adler,
   return (s2 << 16u) | s1;
 }
 
+/*
+  one final fixed huffman block:
+    1 bit BFINAL, 2 bits BTYPE 01,
+    literals and <length, distance> pairs,
+    end of block symbol 256
+*/
+static unsigned char *deflate_fixed(unsigned char *out,
+                                    const unsigned char *in, size_t size,
+                                    uint32_t *hash_head) {
+  const FixedHuffman &huff = fixed_huffman();
+  BitWriter writer(out);
+  writer.put(1 | (1 << 1), 3);
 
-/*  zlib data: 
-      1 byte CMF (CM+CINFO), 
-      1 byte FLG, 
-      deflate data, 
+  size_t ip = 0;
+  while (ip + kMinMatch <= size) {
+    uint32_t v = load32(in + ip);
+    uint32_t *head = &hash_head[hash32(v)];
+    size_t candidate = *head;
+    *head = ip + 1;
+    if (candidate > 0 && ip + 1 - candidate <= kWindowSize &&
+        load32(in + candidate - 1) == v) {
+      const unsigned char *ref = in + candidate - 1;
+      size_t max_len = size - ip < kMaxMatch ? size - ip : kMaxMatch;
+      size_t len = kMinMatch;
+      while (len < max_len && ref[len] == in[ip + len]) {
+        len++;
+      }
+      unsigned dist = in + ip - ref;
+      writer.put(huff.len_code[len], huff.len_bits[len]);
+      unsigned sym = dist <= 256 ? huff.dist_sym[dist - 1]
+                                 : huff.dist_sym[256 + ((dist - 1) >> 7)];
+      writer.put(reverse_bits(sym, 5) | ((dist - kDistBase[sym]) << 5),
+                 5 + kDistExtra[sym]);
+      ip += len;
+    } else {
+      writer.put(huff.lit_code[in[ip]], huff.lit_bits[in[ip]]);
+      ip++;
+    }
+  }
+  for (; ip < size; ip++) {
+    writer.put(huff.lit_code[in[ip]], huff.lit_bits[in[ip]]);
+  }
+  writer.put(huff.lit_code[256], huff.lit_bits[256]);
+  return writer.flush();
+}
+
+PNGCompress::PNGCompress()
+    : hash_head_(1u << kHashBits, 0) {
+}
+
+size_t PNGCompress::compress_bound(size_t size) {
+  // 9 bits per literal at worst, plus 2 bytes header, 4 bytes adler32
+  // and the block header/end of block bits
+  return size + size / 8 + 16;
+}
+
+/*  zlib data:
+      1 byte CMF (CM+CINFO),
+      1 byte FLG,
+      deflate data,
       4 byte ADLER32
       checksum of the Decompressed data
   */
-void PNGCompress::save_file_header(std::vector<unsigned char> *out) const {
+size_t PNGCompress::compress(unsigned char *out, const unsigned char *in,
+                             size_t size) {
   // 0b01111000: CM 8, CINFO 7. With CINFO 7
   // any window size up to 32768 can be used.
   unsigned CMF = 120;
-  unsigned FLEVEL = 0;
+  unsigned FLEVEL = 1;  // fast
   unsigned FDICT = 0;
   unsigned CMFFLG = 256 * CMF + FDICT * 32 + FLEVEL * 64;
   unsigned FCHECK = 31 - CMFFLG % 31;
   CMFFLG += FCHECK;
 
-  out->push_back((unsigned char)(CMFFLG >> 8));
-  out->push_back((unsigned char)(CMFFLG & 255));
-}
+  unsigned char *p = out;
+  *p++ = (unsigned char)(CMFFLG >> 8);
+  *p++ = (unsigned char)(CMFFLG & 255);
 
-void PNGCompress::save_file_end(std::vector<unsigned char> *out,
-                                const std::vector<unsigned char> &in) const {
-  unsigned ADLER32 = update_adler32(1u, in);
+  memset(&hash_head_[0], 0, hash_head_.size() * sizeof(hash_head_[0]));
+  p = deflate_fixed(p, in, size, &hash_head_[0]);
 
-  // buffer must have at least 4 allocated bytes available
-  out->push_back((unsigned char)((ADLER32 >> 24) & 0xff));
-  out->push_back((unsigned char)((ADLER32 >> 16) & 0xff));
-  out->push_back((unsigned char)((ADLER32 >> 8) & 0xff));
-  out->push_back((unsigned char)((ADLER32)&0xff));
+  unsigned ADLER32 = update_adler32(1u, in, size);
+  *p++ = (unsigned char)((ADLER32 >> 24) & 0xff);
+  *p++ = (unsigned char)((ADLER32 >> 16) & 0xff);
+  *p++ = (unsigned char)((ADLER32 >> 8) & 0xff);
+  *p++ = (unsigned char)((ADLER32)&0xff);
+  return p - out;
 }
 
 bool PNGCompress::compress(std::vector<unsigned char> *out,
-                           const std::vector<unsigned char> &in) const {
-  save_file_header(out);
-
-  //
-  //  int insize = in.size();
-
-  //
-  /*on PNGs, deflate blocks of 65-262k seem to give most dense encoding*/
-  //  size_t blocksize = insize / 8u + 8;
-  //
-  //  if (blocksize < 65536) blocksize = 65536;
-  //
-  //  if (blocksize > 262144) blocksize = 262144;
-
-  //
-  unsigned error = 0;
-  error = deflateNoCompression(out, in);
-
-  //
-  save_file_end(out, in);
-  return error == 0;
+                           const std::vector<unsigned char> &in) {
+  size_t offset = out->size();
+  out->resize(offset + compress_bound(in.size()));
+  size_t written = compress(&(*out)[offset], in.data(), in.size());
+  out->resize(offset + written);
+  return true;
 }
 }  // namespace innovusion
@@ -30,30 +30,40 @@
 #ifndef PCS_PNG_ZLIB_H_
 #define PCS_PNG_ZLIB_H_
 
+#include <stdint.h>
 #include <string.h> /*for size_t*/
 #include <vector>
 
-/*Compress a buffer with deflate. See RFC 1951. Out buffer must be freed after
- * use.*/
+/*Compress a buffer with deflate. See RFC 1951.*/
 namespace innovusion {
 class PNGCompress {
  public:
+  PNGCompress();
+
   /*
     Compresses data with Zlib.
-    Reallocates the out buffer and appends the data.
-    Zlib adds a small header and trailer around the deflate data.
-    The data is output in the format of the zlib specification.
-    Either, *out must be NULL and *outsize must be 0, or, *out must be a valid
-    buffer and *outsize its size in bytes. out must be freed by user after
-    usage.
+    The zlib stream (small header, deflate data, adler32 trailer) is
+    appended to out, which is resized once to the worst case and then
+    shrunk, so a reused out buffer is not reallocated.
+    Deflate is a single fixed-huffman block with a one-probe hash
+    matcher (zlib level 1 class): a few ms for a range image, an order
+    of magnitude smaller than the stored blocks it replaces.
   */
   bool compress(std::vector<unsigned char> *out,
-                const std::vector<unsigned char> &in) const;
+                const std::vector<unsigned char> &in);
+
+  /*
+    Same as above on raw buffers, out must have at least
+    compress_bound(size) bytes. Return the number of bytes written.
+  */
+  size_t compress(unsigned char *out, const unsigned char *in, size_t size);
+
+  static size_t compress_bound(size_t size);
 
  private:
-  void save_file_header(std::vector<unsigned char> *out) const;
-  void save_file_end(std::vector<unsigned char> *out,
-                     const std::vector<unsigned char> &in) const;
+  // head of the hash chain, position + 1 of the last 4 bytes with this
+  // hash, 0 means empty. Kept between calls to avoid the allocation.
+  std::vector<uint32_t> hash_head_;
 };
 }  // namespace innovusion
 
@@ -0,0 +1,743 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+#include "sdk_common/converter/point_cloud_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "utils/inno_lidar_log.h"
+#include "utils/utils.h"
+
+namespace innovusion {
+
+static const double kUsInSecond = 1000000.0;
+static const double k10UsInSecond = 100000.0;
+
+static const char *kPcdHeader =
+    "# .PCD v0.7 - Point Cloud Data file format\n"
+    "VERSION 0.7\n"
+    "FIELDS "
+    "x y z %s channel roi facet is_2nd_return multi_return confid_level "
+    "flag elongation timestamp "
+    "scanline scan_idx frame_id\n"
+    "SIZE 4 4 4 2 1 1 1 1 1 1 1 1 8 2 2 4\n"
+    "TYPE F F F U U U U U U U U U F U U U\n"
+    "COUNT 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 1\n"
+    "WIDTH %" PRI_SIZEU "\n"
+    "HEIGHT 1\n"
+    "VIEWPOINT 0 0 0 1 0 0 0\n"
+    "POINTS %" PRI_SIZEU "\n"
+    "DATA %s\n";
+
+static const char *kPlyHeader =
+    "ply\n"
+    "format binary_little_endian 1.0\n"
+    "comment innovusion lidar frame %" PRI_SIZEU "\n"
+    "element vertex %" PRI_SIZEU "\n"
+    "property float x\n"
+    "property float y\n"
+    "property float z\n"
+    "property ushort %s\n"
+    "property uchar channel\n"
+    "property uchar roi\n"
+    "property uchar facet\n"
+    "property uchar is_2nd_return\n"
+    "property uchar multi_return\n"
+    "property uchar confid_level\n"
+    "property uchar flag\n"
+    "property uchar elongation\n"
+    "property double timestamp\n"
+    "property ushort scanline\n"
+    "property ushort scan_idx\n"
+    "property uint frame_id\n"
+    "end_header\n";
+
+// offset and size of every PointCloudRecord field, in FIELDS order
+static const struct {
+  uint16_t offset;
+  uint16_t size;
+} kRecordFields[] = {
+  {offsetof(PointCloudRecord, x), 4},
+  {offsetof(PointCloudRecord, y), 4},
+  {offsetof(PointCloudRecord, z), 4},
+  {offsetof(PointCloudRecord, intensity), 2},
+  {offsetof(PointCloudRecord, channel), 1},
+  {offsetof(PointCloudRecord, roi), 1},
+  {offsetof(PointCloudRecord, facet), 1},
+  {offsetof(PointCloudRecord, is_2nd_return), 1},
+  {offsetof(PointCloudRecord, multi_return), 1},
+  {offsetof(PointCloudRecord, confid_level), 1},
+  {offsetof(PointCloudRecord, flags), 1},
+  {offsetof(PointCloudRecord, elongation), 1},
+  {offsetof(PointCloudRecord, timestamp), 8},
+  {offsetof(PointCloudRecord, scanline), 2},
+  {offsetof(PointCloudRecord, scan_idx), 2},
+  {offsetof(PointCloudRecord, frame_id), 4},
+};
+
+DEFINE_INNO_COMPACT_STRUCT(LasHeader) {
+  char signature[4];
+  uint16_t file_source_id;
+  uint16_t global_encoding;
+  uint32_t guid1;
+  uint16_t guid2;
+  uint16_t guid3;
+  uint8_t guid4[8];
+  uint8_t version_major;
+  uint8_t version_minor;
+  char system_id[32];
+  char software[32];
+  uint16_t creation_day;
+  uint16_t creation_year;
+  uint16_t header_size;
+  uint32_t point_offset;
+  uint32_t vlr_number;
+  uint8_t point_format;
+  uint16_t point_size;
+  uint32_t point_number;
+  uint32_t point_number_by_return[5];
+  double scale[3];
+  double offset[3];
+  double max_x;
+  double min_x;
+  double max_y;
+  double min_y;
+  double max_z;
+  double min_z;
+};
+DEFINE_INNO_COMPACT_STRUCT_END
+
+DEFINE_INNO_COMPACT_STRUCT(LasPoint1) {
+  int32_t x;
+  int32_t y;
+  int32_t z;
+  uint16_t intensity;
+  uint8_t returns;       /* return number 0-2, number of returns 3-5 */
+  uint8_t classification;
+  int8_t scan_angle;
+  uint8_t user_data;
+  uint16_t point_source_id;
+  double gps_time;
+};
+DEFINE_INNO_COMPACT_STRUCT_END
+
+static const double kLasScale = 0.001;
+// global_encoding bit 0: gps_time is adjusted standard GPS time
+static const uint16_t kLasGpsTimeAdjusted = 1;
+// unix time of the GPS epoch, 1980-01-06
+static const double kGpsEpochUnixSec = 315964800.0;
+// adjusted standard GPS time is GPS time - 1e9
+static const double kLasGpsTimeOffset = 1e9;
+
+/*
+ * GPS time is ahead of UTC by the leap seconds since the GPS epoch,
+ * the unix times they took effect at
+ */
+static double gps_leap_seconds(double unix_sec) {
+  static const double kLeaps[] = {
+    362793600, 394329600, 425865600, 489024000, 567993600, 631152000,
+    662688000, 709948800, 741484800, 773020800, 820454400, 867715200,
+    915148800, 1136073600, 1230768000, 1341100800, 1435708800, 1483228800,
+  };
+  int n = 0;
+  while (n < static_cast<int>(sizeof(kLeaps) / sizeof(kLeaps[0])) &&
+         unix_sec >= kLeaps[n]) {
+    n++;
+  }
+  return n;
+}
+
+/***********************
+ * PointCloudFrame
+ ***********************/
+PointCloudFrame::PointCloudFrame()
+    : reflectance_(true) {
+}
+
+void PointCloudFrame::clear() {
+  points_.clear();
+  segments_.clear();
+}
+
+void PointCloudFrame::swap(PointCloudFrame *other) {
+  points_.swap(other->points_);
+  segments_.swap(other->segments_);
+  convert_buffer_.swap(other->convert_buffer_);
+  std::swap(reflectance_, other->reflectance_);
+}
+
+void PointCloudFrame::add_segment(InnoTimestampUs ts_start_us,
+                                  uint64_t frame_idx,
+                                  uint8_t confidence_level) {
+  PointCloudSegment s;
+  s.end = points_.size();
+  s.confidence_level = confidence_level;
+  s.frame_idx = frame_idx;
+  s.ts_start_us = ts_start_us;
+  segments_.push_back(s);
+}
+
+bool PointCloudFrame::add_packet(const InnoDataPacket &pkt) {
+  const InnoDataPacket *xyz = &pkt;
+  if (pkt.type == INNO_ITEM_TYPE_SPHERE_POINTCLOUD) {
+    size_t size = InnoDataPacketUtils::get_data_packet_size(
+        INNO_ITEM_TYPE_XYZ_POINTCLOUD,
+        InnoDataPacketUtils::get_max_points_count(pkt),
+        INNO_MULTIPLE_RETURN_MODE_NONE);
+    if (convert_buffer_.size() < size) {
+      convert_buffer_.resize(size);
+    }
+    InnoDataPacket *dest =
+        reinterpret_cast<InnoDataPacket *>(&convert_buffer_[0]);
+    if (!InnoDataPacketUtils::convert_to_xyz_pointcloud(pkt, dest,
+                                                        size, false)) {
+      return false;
+    }
+    xyz = dest;
+  } else if (pkt.type != INNO_ITEM_TYPE_XYZ_POINTCLOUD) {
+    return false;
+  }
+  reflectance_ = pkt.use_reflectance;
+  add_segment(xyz->common.ts_start_us, xyz->idx, xyz->confidence_level);
+  points_.insert(points_.end(), xyz->xyz_points,
+                 xyz->xyz_points + xyz->item_number);
+  segments_.back().end = points_.size();
+  return true;
+}
+
+/***********************
+ * PointCloudWriter
+ ***********************/
+const char *PointCloudWriter::get_extension(PointCloudFileFormat format) {
+  switch (format) {
+    case POINT_CLOUD_FILE_PCD_BINARY:
+    case POINT_CLOUD_FILE_PCD_BINARY_COMPRESSED:
+      return "pcd";
+    case POINT_CLOUD_FILE_PLY:
+      return "ply";
+    case POINT_CLOUD_FILE_LAS:
+      return "las";
+    default:
+      return "";
+  }
+}
+
+PointCloudFileFormat PointCloudWriter::get_format(const char *name) {
+  if (strcmp(name, "pcd") == 0 || strcmp(name, "pcd_binary") == 0) {
+    return POINT_CLOUD_FILE_PCD_BINARY;
+  } else if (strcmp(name, "pcd_compressed") == 0 ||
+             strcmp(name, "pcd_binary_compressed") == 0) {
+    return POINT_CLOUD_FILE_PCD_BINARY_COMPRESSED;
+  } else if (strcmp(name, "ply") == 0) {
+    return POINT_CLOUD_FILE_PLY;
+  } else if (strcmp(name, "las") == 0) {
+    return POINT_CLOUD_FILE_LAS;
+  } else {
+    return POINT_CLOUD_FILE_MAX;
+  }
+}
+
+size_t PointCloudWriter::encode(const PointCloudFrame &frame,
+                                PointCloudFileFormat format,
+                                std::vector<char> *out,
+                                std::vector<char> *scratch) {
+  switch (format) {
+    case POINT_CLOUD_FILE_PCD_BINARY:
+      return encode_pcd_(frame, false, out, scratch);
+    case POINT_CLOUD_FILE_PCD_BINARY_COMPRESSED:
+      return encode_pcd_(frame, true, out, scratch);
+    case POINT_CLOUD_FILE_PLY:
+      return encode_ply_(frame, out);
+    case POINT_CLOUD_FILE_LAS:
+      return encode_las_(frame, out);
+    default:
+      inno_log_panic("invalid format %d", format);
+      return 0;
+  }
+}
+
+void PointCloudWriter::fill_records_(const PointCloudFrame &frame,
+                                     PointCloudRecord *records) {
+  const std::vector<InnoXyzPoint> &points = frame.get_points();
+  const std::vector<PointCloudSegment> &segments = frame.get_segments();
+  size_t i = 0;
+  for (size_t s = 0; s < segments.size(); s++) {
+    const PointCloudSegment &seg = segments[s];
+    double ts_sec = seg.ts_start_us / kUsInSecond;
+    for (; i < seg.end; i++) {
+      const InnoXyzPoint &pt = points[i];
+      PointCloudRecord *r = records + i;
+      r->x = pt.x;
+      r->y = pt.y;
+      r->z = pt.z;
+      r->intensity = pt.refl;
+      r->channel = pt.channel;
+      r->roi = pt.in_roi;
+      r->facet = pt.facet;
+      r->is_2nd_return = pt.is_2nd_return;
+      r->multi_return = pt.is_2nd_return;
+      r->confid_level = seg.confidence_level;
+      r->flags = pt.type;
+      r->elongation = pt.elongation;
+      r->timestamp = ts_sec + pt.ts_10us / k10UsInSecond;
+      r->scanline = pt.scan_id;
+      r->scan_idx = pt.scan_idx;
+      r->frame_id = seg.frame_idx;
+    }
+  }
+}
+
+template <typename T>
+static inline void copy_column_(const char *records, size_t n,
+                                size_t offset, char *column) {
+  const char *src = records + offset;
+  T *dst = reinterpret_cast<T *>(column);
+  for (size_t i = 0; i < n; i++, src += sizeof(PointCloudRecord)) {
+    memcpy(dst + i, src, sizeof(T));
+  }
+}
+
+size_t PointCloudWriter::encode_pcd_(const PointCloudFrame &frame,
+                                     bool compressed,
+                                     std::vector<char> *out,
+                                     std::vector<char> *scratch) {
+  size_t n = frame.get_point_number();
+  size_t data_size = n * sizeof(PointCloudRecord);
+  char header[1024];
+  int header_size = snprintf(header, sizeof(header), kPcdHeader,
+                             frame.is_reflectance() ? "reflectance"
+                                                    : "intensity",
+                             n, n,
+                             compressed ? "binary_compressed" : "binary");
+  inno_log_verify(header_size > 0 && header_size < ssize_t(sizeof(header)),
+                  "header too small %d", header_size);
+
+  if (!compressed) {
+    out->resize(header_size + data_size);
+    memcpy(&(*out)[0], header, header_size);
+    if (n) {
+      fill_records_(frame, reinterpret_cast<PointCloudRecord *>(
+          &(*out)[header_size]));
+    }
+    return out->size();
+  }
+
+  // records then columns in scratch, lzf from the columns into out
+  scratch->resize(data_size * 2 + 1);
+  char *records = &(*scratch)[0];
+  char *columns = records + data_size;
+  if (n) {
+    fill_records_(frame, reinterpret_cast<PointCloudRecord *>(records));
+  }
+  char *column = columns;
+  for (size_t f = 0; f < sizeof(kRecordFields) / sizeof(kRecordFields[0]);
+       f++) {
+    switch (kRecordFields[f].size) {
+      case 1:
+        copy_column_<uint8_t>(records, n, kRecordFields[f].offset, column);
+        break;
+      case 2:
+        copy_column_<uint16_t>(records, n, kRecordFields[f].offset, column);
+        break;
+      case 4:
+        copy_column_<uint32_t>(records, n, kRecordFields[f].offset, column);
+        break;
+      case 8:
+        copy_column_<uint64_t>(records, n, kRecordFields[f].offset, column);
+        break;
+      default:
+        inno_log_panic("invalid size %u", kRecordFields[f].size);
+    }
+    column += n * kRecordFields[f].size;
+  }
+
+  // lzf output is at most 1/32 larger than its input
+  size_t max_compressed = data_size + data_size / 32 + 64;
+  out->resize(header_size + sizeof(uint32_t) * 2 + max_compressed);
+  char *p = &(*out)[0];
+  memcpy(p, header, header_size);
+  p += header_size;
+  uint32_t compressed_size =
+      lzf_compress(columns, data_size, p + sizeof(uint32_t) * 2,
+                   max_compressed);
+  inno_log_verify(data_size == 0 || compressed_size > 0,
+                  "lzf failed %" PRI_SIZEU, data_size);
+  uint32_t uncompressed_size = data_size;
+  memcpy(p, &compressed_size, sizeof(compressed_size));
+  memcpy(p + sizeof(uint32_t), &uncompressed_size, sizeof(uncompressed_size));
+  out->resize(header_size + sizeof(uint32_t) * 2 + compressed_size);
+  return out->size();
+}
+
+size_t PointCloudWriter::encode_ply_(const PointCloudFrame &frame,
+                                     std::vector<char> *out) {
+  size_t n = frame.get_point_number();
+  const std::vector<PointCloudSegment> &segments = frame.get_segments();
+  uint64_t frame_idx = segments.empty() ? 0 : segments[0].frame_idx;
+  char header[1024];
+  int header_size = snprintf(header, sizeof(header), kPlyHeader,
+                             frame_idx, n,
+                             frame.is_reflectance() ? "reflectance"
+                                                    : "intensity");
+  inno_log_verify(header_size > 0 && header_size < ssize_t(sizeof(header)),
+                  "header too small %d", header_size);
+  out->resize(header_size + n * sizeof(PointCloudRecord));
+  memcpy(&(*out)[0], header, header_size);
+  if (n) {
+    fill_records_(frame, reinterpret_cast<PointCloudRecord *>(
+        &(*out)[header_size]));
+  }
+  return out->size();
+}
+
+size_t PointCloudWriter::encode_las_(const PointCloudFrame &frame,
+                                     std::vector<char> *out) {
+  const std::vector<InnoXyzPoint> &points = frame.get_points();
+  const std::vector<PointCloudSegment> &segments = frame.get_segments();
+  size_t n = points.size();
+  out->resize(sizeof(LasHeader) + n * sizeof(LasPoint1));
+  LasHeader *h = reinterpret_cast<LasHeader *>(&(*out)[0]);
+  LasPoint1 *p = reinterpret_cast<LasPoint1 *>(&(*out)[sizeof(LasHeader)]);
+
+  memset(h, 0, sizeof(*h));
+  memcpy(h->signature, "LASF", 4);
+  h->version_major = 1;
+  h->version_minor = 2;
+  h->global_encoding = kLasGpsTimeAdjusted;
+  strncpy(h->system_id, "innovusion lidar", sizeof(h->system_id));
+  strncpy(h->software, "innovusion sdk", sizeof(h->software));
+  if (!segments.empty()) {
+    time_t t = segments[0].ts_start_us / kUsInSecond;
+    struct tm tm_info;
+    if (gmtime_r(&t, &tm_info)) {
+      h->creation_day = tm_info.tm_yday + 1;
+      h->creation_year = tm_info.tm_year + 1900;
+    }
+  }
+  h->header_size = sizeof(LasHeader);
+  h->point_offset = sizeof(LasHeader);
+  h->point_format = 1;
+  h->point_size = sizeof(LasPoint1);
+  h->point_number = n;
+  h->scale[0] = h->scale[1] = h->scale[2] = kLasScale;
+
+  float min_x = 0, max_x = 0, min_y = 0, max_y = 0, min_z = 0, max_z = 0;
+  if (n) {
+    min_x = max_x = points[0].x;
+    min_y = max_y = points[0].y;
+    min_z = max_z = points[0].z;
+  }
+  uint32_t second_returns = 0;
+  size_t i = 0;
+  for (size_t s = 0; s < segments.size(); s++) {
+    const PointCloudSegment &seg = segments[s];
+    // unix to adjusted standard GPS time, the leap seconds of a frame
+    // are taken at the start of its segment
+    double ts_sec = seg.ts_start_us / kUsInSecond;
+    double gps_sec = ts_sec - kGpsEpochUnixSec + gps_leap_seconds(ts_sec) -
+                     kLasGpsTimeOffset;
+    for (; i < seg.end; i++, p++) {
+      const InnoXyzPoint &pt = points[i];
+      min_x = std::min(min_x, pt.x);
+      max_x = std::max(max_x, pt.x);
+      min_y = std::min(min_y, pt.y);
+      max_y = std::max(max_y, pt.y);
+      min_z = std::min(min_z, pt.z);
+      max_z = std::max(max_z, pt.z);
+      p->x = lrint(pt.x / kLasScale);
+      p->y = lrint(pt.y / kLasScale);
+      p->z = lrint(pt.z / kLasScale);
+      p->intensity = pt.refl;
+      // a 2nd return is return 2 of 2
+      p->returns = pt.is_2nd_return ? (2 | 2 << 3) : (1 | 1 << 3);
+      second_returns += pt.is_2nd_return;
+      // 1: unclassified, 2: ground, 7: noise (fog)
+      p->classification = pt.type == 1 ? 2 : (pt.type == 2 ? 7 : 1);
+      p->scan_angle = 0;
+      p->user_data = pt.channel | pt.facet << 2 | pt.in_roi << 5;
+      p->point_source_id = pt.scan_id;
+      p->gps_time = gps_sec + pt.ts_10us / k10UsInSecond;
+    }
+  }
+  h->point_number_by_return[0] = n - second_returns;
+  h->point_number_by_return[1] = second_returns;
+  h->min_x = min_x;
+  h->max_x = max_x;
+  h->min_y = min_y;
+  h->max_y = max_y;
+  h->min_z = min_z;
+  h->max_z = max_z;
+  return out->size();
+}
+
+static const uint32_t kLzfHashLog = 14;
+static const size_t kLzfMaxLiteral = 32;
+static const size_t kLzfMaxOffset = 8192;
+static const size_t kLzfMaxRef = 264;
+
+static inline bool lzf_literals_(const uint8_t *in, size_t len,
+                                 uint8_t *out, size_t out_size,
+                                 size_t *op) {
+  while (len > 0) {
+    size_t l = std::min(len, kLzfMaxLiteral);
+    if (*op + 1 + l > out_size) {
+      return false;
+    }
+    out[(*op)++] = l - 1;
+    memcpy(out + *op, in, l);
+    *op += l;
+    in += l;
+    len -= l;
+  }
+  return true;
+}
+
+size_t PointCloudWriter::lzf_compress(const char *in_c, size_t in_size,
+                                      char *out_c, size_t out_size) {
+  static __thread uint32_t htab[1 << kLzfHashLog];
+  const uint8_t *in = reinterpret_cast<const uint8_t *>(in_c);
+  uint8_t *out = reinterpret_cast<uint8_t *>(out_c);
+  // 0 means empty, otherwise position + 1
+  memset(htab, 0, sizeof(htab));
+
+  size_t ip = 0;
+  size_t op = 0;
+  size_t literal_start = 0;
+  while (ip + 2 < in_size) {
+    uint32_t v = in[ip] << 16 | in[ip + 1] << 8 | in[ip + 2];
+    uint32_t h = ((v * 2654435761U) >> (32 - kLzfHashLog));
+    size_t ref = htab[h];
+    htab[h] = ip + 1;
+    if (ref > 0 && ip - ref < kLzfMaxOffset &&
+        in[ref - 1] == in[ip] &&
+        in[ref] == in[ip + 1] &&
+        in[ref + 1] == in[ip + 2]) {
+      ref--;
+      size_t off = ip - ref - 1;
+      size_t max_len = std::min(kLzfMaxRef, in_size - ip);
+      size_t len = 3;
+      while (len < max_len && in[ref + len] == in[ip + len]) {
+        len++;
+      }
+      if (!lzf_literals_(in + literal_start, ip - literal_start,
+                         out, out_size, &op) ||
+          op + 3 > out_size) {
+        return 0;
+      }
+      size_t l = len - 2;
+      if (l < 7) {
+        out[op++] = (l << 5) | (off >> 8);
+      } else {
+        out[op++] = (7 << 5) | (off >> 8);
+        out[op++] = l - 7;
+      }
+      out[op++] = off & 0xff;
+      ip += len;
+      literal_start = ip;
+    } else {
+      ip++;
+    }
+  }
+  if (!lzf_literals_(in + literal_start, in_size - literal_start,
+                     out, out_size, &op)) {
+    return 0;
+  }
+  return op;
+}
+
+size_t PointCloudWriter::lzf_decompress(const char *in_c, size_t in_size,
+                                        char *out_c, size_t out_size) {
+  const uint8_t *in = reinterpret_cast<const uint8_t *>(in_c);
+  uint8_t *out = reinterpret_cast<uint8_t *>(out_c);
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < in_size) {
+    uint32_t ctrl = in[ip++];
+    if (ctrl < 32) {
+      size_t len = ctrl + 1;
+      if (op + len > out_size || ip + len > in_size) {
+        return 0;
+      }
+      memcpy(out + op, in + ip, len);
+      op += len;
+      ip += len;
+    } else {
+      size_t len = ctrl >> 5;
+      if (len == 7) {
+        if (ip >= in_size) {
+          return 0;
+        }
+        len += in[ip++];
+      }
+      len += 2;
+      if (ip >= in_size) {
+        return 0;
+      }
+      size_t off = ((ctrl & 0x1f) << 8) + in[ip++] + 1;
+      if (off > op || op + len > out_size) {
+        return 0;
+      }
+      // may overlap, copy byte by byte
+      for (size_t i = 0; i < len; i++, op++) {
+        out[op] = out[op - off];
+      }
+    }
+  }
+  return op;
+}
+
+/***********************
+ * PointCloudWriterPool
+ ***********************/
+PointCloudWriterPool::PointCloudWriterPool(uint32_t thread_number,
+                                           uint32_t max_pending_frames)
+    : max_pending_frames_(max_pending_frames)
+    , busy_(0)
+    , shutdown_(false)
+    , written_frames_(0)
+    , written_bytes_(0)
+    , failed_frames_(0) {
+  if (thread_number == 0) {
+    thread_number = 1;
+  }
+  if (max_pending_frames_ == 0) {
+    max_pending_frames_ = 1;
+  }
+  // frames being encoded, queued, and the one add_frame swaps out
+  size_t frame_number = thread_number + max_pending_frames_ + 1;
+  for (size_t i = 0; i < frame_number; i++) {
+    PointCloudFrame *f = new PointCloudFrame();
+    inno_log_verify(f, "PointCloudFrame");
+    all_frames_.push_back(f);
+    free_frames_.push_back(f);
+  }
+  for (uint32_t i = 0; i < thread_number; i++) {
+    std::thread *t = new std::thread(&PointCloudWriterPool::worker_loop_,
+                                     this);
+    inno_log_verify(t, "thread");
+    threads_.push_back(t);
+  }
+}
+
+PointCloudWriterPool::~PointCloudWriterPool() {
+  {
+    std::unique_lock<std::mutex> lk(mutex_);
+    shutdown_ = true;
+  }
+  job_cond_.notify_all();
+  for (size_t i = 0; i < threads_.size(); i++) {
+    threads_[i]->join();
+    delete threads_[i];
+  }
+  threads_.clear();
+  for (size_t i = 0; i < all_frames_.size(); i++) {
+    delete all_frames_[i];
+  }
+  all_frames_.clear();
+  free_frames_.clear();
+}
+
+void PointCloudWriterPool::add_frame(const std::string &filename,
+                                     PointCloudFileFormat format,
+                                     PointCloudFrame *frame) {
+  inno_log_verify(format < POINT_CLOUD_FILE_MAX, "invalid format %d", format);
+  std::unique_lock<std::mutex> lk(mutex_);
+  done_cond_.wait(lk, [this] {
+    return jobs_.size() < max_pending_frames_ && !free_frames_.empty();
+  });
+  PointCloudFrame *f = free_frames_.back();
+  free_frames_.pop_back();
+  f->swap(frame);
+  frame->clear();
+  Job job;
+  job.filename = filename;
+  job.format = format;
+  job.frame = f;
+  jobs_.push_back(job);
+  job_cond_.notify_one();
+}
+
+void PointCloudWriterPool::wait_idle() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  done_cond_.wait(lk, [this] {
+    return jobs_.empty() && busy_ == 0;
+  });
+}
+
+void PointCloudWriterPool::worker_loop_() {
+  std::vector<char> out;
+  std::vector<char> scratch;
+  out.reserve(kInitialBufferSize);
+  while (1) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lk(mutex_);
+      // drain the queue before exiting
+      job_cond_.wait(lk, [this] {
+        return shutdown_ || !jobs_.empty();
+      });
+      if (jobs_.empty()) {
+        return;
+      }
+      job = jobs_.front();
+      jobs_.pop_front();
+      busy_++;
+    }
+    PointCloudWriter::encode(*job.frame, job.format, &out, &scratch);
+    if (write_file_(job.filename, out) == 0) {
+      written_frames_++;
+      written_bytes_ += out.size();
+    } else {
+      failed_frames_++;
+    }
+    {
+      std::unique_lock<std::mutex> lk(mutex_);
+      job.frame->clear();
+      free_frames_.push_back(job.frame);
+      busy_--;
+    }
+    done_cond_.notify_all();
+  }
+}
+
+int PointCloudWriterPool::write_file_(const std::string &filename,
+                                      const std::vector<char> &buf) {
+  int fd = InnoUtils::open_file(filename.c_str(),
+                                O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    inno_log_error_errno("cannot open %s", filename.c_str());
+    return -1;
+  }
+  size_t written = 0;
+  while (written < buf.size()) {
+    ssize_t r = write(fd, &buf[written], buf.size() - written);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      inno_log_error_errno("cannot write %s", filename.c_str());
+      close(fd);
+      return -1;
+    }
+    written += r;
+  }
+  close(fd);
+  return 0;
+}
+
+}  // namespace innovusion
@@ -0,0 +1,240 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+#ifndef CONVERTER_POINT_CLOUD_WRITER_H_
+#define CONVERTER_POINT_CLOUD_WRITER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "sdk_common/inno_lidar_api.h"
+#include "sdk_common/inno_lidar_packet_utils.h"
+
+/************
+ Binary point cloud file writers, no text formatting on the point path.
+
+   pcd_binary             PCD v0.7, DATA binary, one PointCloudRecord
+                          per point (same fields as get_pcd's binary pcd)
+   pcd_binary_compressed  PCD v0.7, DATA binary_compressed, the fields
+                          are stored column by column and LZF compressed
+   ply                    PLY 1.0 binary_little_endian, same fields
+   las                    LAS 1.2 point data format 1, xyz in mm,
+                          gps time is adjusted standard GPS time
+                          (GPS seconds - 1e9, global encoding bit 0)
+
+ PointCloudWriter::encode() builds a whole file in one buffer, the
+ buffer is reused across frames so that a steady stream of frames
+ does not allocate. PointCloudWriterPool encodes and writes frames
+ on a few threads, one write() per file.
+*************/
+
+namespace innovusion {
+
+enum PointCloudFileFormat {
+  POINT_CLOUD_FILE_PCD_BINARY = 0,
+  POINT_CLOUD_FILE_PCD_BINARY_COMPRESSED = 1,
+  POINT_CLOUD_FILE_PLY = 2,
+  POINT_CLOUD_FILE_LAS = 3,
+  POINT_CLOUD_FILE_MAX = 4,
+};
+
+DEFINE_INNO_COMPACT_STRUCT(PointCloudRecord) {
+  float x;
+  float y;
+  float z;
+  uint16_t intensity;
+  uint8_t channel;
+  uint8_t roi;
+  uint8_t facet;
+  uint8_t is_2nd_return;
+  uint8_t multi_return;
+  uint8_t confid_level;
+  uint8_t flags;
+  uint8_t elongation;
+  double timestamp;
+  uint16_t scanline;
+  uint16_t scan_idx;
+  uint32_t frame_id;
+};
+DEFINE_INNO_COMPACT_STRUCT_END
+
+/*
+ * points of one file, the points of every data packet share the
+ * packet's timestamp, frame idx and confidence level in a segment
+ */
+struct PointCloudSegment {
+  uint32_t end;          /* index after the last point of the segment  */
+  uint8_t confidence_level;
+  uint64_t frame_idx;
+  InnoTimestampUs ts_start_us;
+};
+
+class PointCloudFrame {
+ public:
+  PointCloudFrame();
+  ~PointCloudFrame() {}
+
+  void clear();
+  void swap(PointCloudFrame *other);
+
+  /*
+   * @brief Append all points of a data packet, sphere packets are
+   *        converted to xyz first
+   * @return false if the packet has no point cloud
+   */
+  bool add_packet(const InnoDataPacket &pkt);
+
+  /*
+   * @brief Start a segment, the points added after it get its
+   *        timestamp, frame idx and confidence level
+   */
+  void add_segment(InnoTimestampUs ts_start_us, uint64_t frame_idx,
+                   uint8_t confidence_level);
+  inline void add_point(const InnoXyzPoint &pt) {
+    points_.push_back(pt);
+    segments_.back().end = points_.size();
+  }
+
+  inline const std::vector<InnoXyzPoint> &get_points() const {
+    return points_;
+  }
+  inline const std::vector<PointCloudSegment> &get_segments() const {
+    return segments_;
+  }
+  inline size_t get_point_number() const {
+    return points_.size();
+  }
+  inline void set_reflectance(bool reflectance) {
+    reflectance_ = reflectance;
+  }
+  inline bool is_reflectance() const {
+    return reflectance_;
+  }
+
+ private:
+  std::vector<InnoXyzPoint> points_;
+  std::vector<PointCloudSegment> segments_;
+  std::vector<char> convert_buffer_;
+  bool reflectance_;
+};
+
+class PointCloudWriter {
+ public:
+  /*
+   * @brief Encode a whole file
+   * @param out Resized to the size of the file, its capacity is kept
+   * @param scratch Column buffer of binary_compressed pcd
+   * @return size of the file
+   */
+  static size_t encode(const PointCloudFrame &frame,
+                       PointCloudFileFormat format,
+                       std::vector<char> *out,
+                       std::vector<char> *scratch);
+
+  /*
+   * @brief LZF compress (liblzf format, as used by PCL)
+   * @return compressed size, 0 if out_size is too small
+   */
+  static size_t lzf_compress(const char *in, size_t in_size,
+                             char *out, size_t out_size);
+
+  /*
+   * @brief LZF decompress
+   * @return decompressed size, 0 if in is corrupted or out_size is too small
+   */
+  static size_t lzf_decompress(const char *in, size_t in_size,
+                               char *out, size_t out_size);
+
+  static const char *get_extension(PointCloudFileFormat format);
+  static PointCloudFileFormat get_format(const char *name);
+
+ private:
+  static size_t encode_pcd_(const PointCloudFrame &frame, bool compressed,
+                            std::vector<char> *out,
+                            std::vector<char> *scratch);
+  static size_t encode_ply_(const PointCloudFrame &frame,
+                            std::vector<char> *out);
+  static size_t encode_las_(const PointCloudFrame &frame,
+                            std::vector<char> *out);
+  static void fill_records_(const PointCloudFrame &frame,
+                            PointCloudRecord *records);
+};
+
+class PointCloudWriterPool {
+ public:
+  static const size_t kInitialBufferSize = 16 * 1024 * 1024;
+
+ public:
+  /*
+   * @param thread_number Number of encode/write threads
+   * @param max_pending_frames add_frame() blocks when that many frames
+   *        are waiting
+   */
+  PointCloudWriterPool(uint32_t thread_number, uint32_t max_pending_frames);
+  ~PointCloudWriterPool();
+
+  /*
+   * @brief Queue a frame, the content of frame is taken and frame gets
+   *        an empty one whose buffers can be reused by the caller
+   */
+  void add_frame(const std::string &filename, PointCloudFileFormat format,
+                 PointCloudFrame *frame);
+
+  /*
+   * @brief Wait until all queued frames are written
+   */
+  void wait_idle();
+
+  inline uint64_t get_written_frames() const {
+    return written_frames_;
+  }
+  inline uint64_t get_written_bytes() const {
+    return written_bytes_;
+  }
+  inline uint64_t get_failed_frames() const {
+    return failed_frames_;
+  }
+
+ private:
+  struct Job {
+    std::string filename;
+    PointCloudFileFormat format;
+    PointCloudFrame *frame;
+  };
+
+  void worker_loop_();
+  int write_file_(const std::string &filename, const std::vector<char> &buf);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable job_cond_;
+  std::condition_variable done_cond_;
+  std::deque<Job> jobs_;
+  std::vector<PointCloudFrame *> free_frames_;
+  std::vector<PointCloudFrame *> all_frames_;
+  std::vector<std::thread *> threads_;
+  uint32_t max_pending_frames_;
+  uint32_t busy_;
+  bool shutdown_;
+
+  std::atomic<uint64_t> written_frames_;
+  std::atomic<uint64_t> written_bytes_;
+  std::atomic<uint64_t> failed_frames_;
+};
+
+}  // namespace innovusion
+
+#endif  // CONVERTER_POINT_CLOUD_WRITER_H_
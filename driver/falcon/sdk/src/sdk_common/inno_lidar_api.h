@@ -97,7 +97,8 @@ enum InnoLidarProtocol {
   INNO_LIDAR_PROTOCOL_PCS_UDP = 4,
   INNO_LIDAR_PROTOCOL_RAW_FILE = 5,
   INNO_LIDAR_PROTOCOL_PCS_FILE = 6,
-  INNO_LIDAR_PROTOCOL_MAX = 7,
+  INNO_LIDAR_PROTOCOL_PCS_SHM = 7,  /* local pcs started with --shm-ring */
+  INNO_LIDAR_PROTOCOL_MAX = 8,
 };
 
 enum InnoLidarState {
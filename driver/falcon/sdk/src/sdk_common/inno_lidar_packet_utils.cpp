@@ -8,6 +8,10 @@
 
 #include "sdk_common/inno_lidar_packet_utils.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <algorithm>
 #include <cmath>
 
@@ -312,11 +316,129 @@ InnoDataPacket *InnoDataPacketUtils::convert_to_xyz_pointcloud_malloced(
   }
 }
 
-bool InnoDataPacketUtils::convert_to_xyz_pointcloud(
+// Convert all channels and returns of one block, the output order is the
+// same as ITERARATE_INNO_DATA_PACKET_CPOINTS (channel major) and every
+// floating point operation is the same as get_xyzr_meter, so the result
+// is bit-identical to get_xyz_point.
+uint32_t InnoDataPacketUtils::convert_block_to_xyz_points_(
+    const InnoBlock &block,
+    uint32_t mr,
+    uint16_t time_adjust_10us,
+    InnoXyzPoint *out) {
+  InnoBlockFullAngles full_angles;
+  get_block_full_angles(&full_angles, block.header);
+
+  // per channel trig values, the sign is folded into sin so that
+  // radius * sin_v == -(radius * sin(-v)) exactly
+  double sin_v[kInnoChannelNumber] __attribute__((aligned(16)));
+  double cos_v[kInnoChannelNumber] __attribute__((aligned(16)));
+  double sin_h[kInnoChannelNumber] __attribute__((aligned(16)));
+  double cos_h[kInnoChannelNumber] __attribute__((aligned(16)));
+  double adj_x[kInnoChannelNumber] __attribute__((aligned(16)));
+  double adj_z[kInnoChannelNumber] __attribute__((aligned(16)));
+  for (uint32_t ch = 0; ch < kInnoChannelNumber; ch++) {
+    const InnoBlockAngles &a = full_angles.angles[ch];
+    int v = a.v_angle;
+    int h = a.h_angle;
+    int av = v >= 0 ? v : -v;
+    int ah = h >= 0 ? h : -h;
+    double sv = innovusion::MathTables::lookup_sin_table_in_unit(av);
+    double sh = innovusion::MathTables::lookup_sin_table_in_unit(ah);
+    sin_v[ch] = v >= 0 ? sv : -sv;
+    cos_v[ch] = innovusion::MathTables::lookup_cos_table_in_unit(av);
+    sin_h[ch] = h >= 0 ? sh : -sh;
+    cos_h[ch] = innovusion::MathTables::lookup_cos_table_in_unit(ah);
+    lookup_xz_adjustment_(a, ch, &adj_x[ch], &adj_z[ch]);
+  }
+
+  // [m][ch]
+  uint32_t radius[kInnoMaxMultiReturn][kInnoChannelNumber]
+      __attribute__((aligned(16)));
+  float x[kInnoMaxMultiReturn][kInnoChannelNumber];
+  float y[kInnoMaxMultiReturn][kInnoChannelNumber];
+  float z[kInnoMaxMultiReturn][kInnoChannelNumber];
+  float r[kInnoMaxMultiReturn][kInnoChannelNumber];
+
+  for (uint32_t m = 0; m < mr; m++) {
+    // the 4 channel points of one return are continuous, decode the 17-bit
+    // radius of all of them at once
+    const InnoChannelPoint *cps =
+        &block.points[InnoBlock2::get_idx(0, m)];
+#if defined(__SSE2__)
+    __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cps));
+    __m128i rad = _mm_and_si128(raw, _mm_set1_epi32((1 << 17) - 1));
+    _mm_store_si128(reinterpret_cast<__m128i *>(radius[m]), rad);
+    const __m128d unit = _mm_set1_pd(kMeterPerInnoDistanceUnit);
+    for (uint32_t ch = 0; ch < kInnoChannelNumber; ch += 2) {
+      __m128d rd = _mm_mul_pd(_mm_cvtepi32_pd(rad), unit);
+      rad = _mm_srli_si128(rad, 8);
+      __m128d t = _mm_mul_pd(rd, _mm_load_pd(&cos_v[ch]));
+      __m128d xd = _mm_add_pd(_mm_mul_pd(rd, _mm_load_pd(&sin_v[ch])),
+                              _mm_load_pd(&adj_x[ch]));
+      __m128d yd = _mm_mul_pd(t, _mm_load_pd(&sin_h[ch]));
+      __m128d zd = _mm_add_pd(_mm_mul_pd(t, _mm_load_pd(&cos_h[ch])),
+                              _mm_load_pd(&adj_z[ch]));
+      // cvtpd_ps rounds to nearest, same as the scalar double to float
+      _mm_storel_pi(reinterpret_cast<__m64 *>(&x[m][ch]), _mm_cvtpd_ps(xd));
+      _mm_storel_pi(reinterpret_cast<__m64 *>(&y[m][ch]), _mm_cvtpd_ps(yd));
+      _mm_storel_pi(reinterpret_cast<__m64 *>(&z[m][ch]), _mm_cvtpd_ps(zd));
+      _mm_storel_pi(reinterpret_cast<__m64 *>(&r[m][ch]), _mm_cvtpd_ps(rd));
+    }
+#else
+    for (uint32_t ch = 0; ch < kInnoChannelNumber; ch++) {
+      radius[m][ch] = cps[ch].radius;
+    }
+    for (uint32_t ch = 0; ch < kInnoChannelNumber; ch++) {
+      double rd = radius[m][ch] * kMeterPerInnoDistanceUnit;
+      double t = rd * cos_v[ch];
+      double xd = rd * sin_v[ch];
+      xd += adj_x[ch];
+      double zd = t * cos_h[ch];
+      zd += adj_z[ch];
+      x[m][ch] = xd;
+      y[m][ch] = t * sin_h[ch];
+      z[m][ch] = zd;
+      r[m][ch] = rd;
+    }
+#endif
+  }
+
+  const InnoBlockHeader &bh = block.header;
+  uint16_t ts_10us = bh.ts_10us + time_adjust_10us;
+  uint32_t n = 0;
+  for (uint32_t ch = 0; ch < kInnoChannelNumber; ch++) {
+    for (uint32_t m = 0; m < mr; m++) {
+      if (radius[m][ch] == 0) {
+        continue;
+      }
+      const InnoChannelPoint &cp = block.points[InnoBlock2::get_idx(ch, m)];
+      InnoXyzPoint *pt = &out[n++];
+      pt->x = x[m][ch];
+      pt->y = y[m][ch];
+      pt->z = z[m][ch];
+      pt->radius = r[m][ch];
+      pt->ts_10us = ts_10us;
+      pt->scan_idx = bh.scan_idx;
+      pt->scan_id = bh.scan_id;
+      pt->in_roi = bh.in_roi;
+      pt->facet = bh.facet;
+      pt->reserved_flags = bh.reserved_flags;
+      pt->refl = cp.refl;
+      pt->type = cp.type;
+      pt->elongation = cp.elongation;
+      pt->channel = ch;
+      pt->is_2nd_return = cp.is_2nd_return;
+    }
+  }
+  return n;
+}
+
+bool InnoDataPacketUtils::convert_to_xyz_pointcloud_(
     const InnoDataPacket &src,
     InnoDataPacket *dest,
     size_t dest_size,
-    bool append) {
+    bool append,
+    bool per_point) {
   if (src.type != INNO_ITEM_TYPE_SPHERE_POINTCLOUD) {
     inno_log_warning("invalid type %u", src.type);
     return false;
@@ -329,7 +451,7 @@ bool InnoDataPacketUtils::convert_to_xyz_pointcloud(
 
   uint32_t item_count = 0;
   uint32_t dummy_count = 0;
-  item_count = get_points_count(src);
+  uint32_t max_count = get_max_points_count(src);
 
   if (append) {
     if (!check_data_packet(*dest, dest_size)) {
@@ -353,7 +475,7 @@ bool InnoDataPacketUtils::convert_to_xyz_pointcloud(
     dest->item_size = sizeof(InnoXyzPoint);
     dest->item_number = 0;
   } else {
-    required_size = src.common.size;
+    required_size = dest->common.size;
     if (src.common.ts_start_us < dest->common.ts_start_us) {
       inno_log_warning("cannot merge earlier packet %f %f",
                        src.common.ts_start_us,
@@ -364,7 +486,10 @@ bool InnoDataPacketUtils::convert_to_xyz_pointcloud(
                         dest->common.ts_start_us) / 10;
   }
 
-  {
+  if (per_point ||
+      required_size + max_count * sizeof(InnoXyzPoint) > dest_size) {
+    // count the real points only when the dest may be too small
+    item_count += get_points_count(src);
 #define CONVERT_FN(ctx, p, blk, pt, full_angles, ch, m)    \
     do {                                                   \
       if (pt.radius > 0) {                                 \
@@ -387,6 +512,20 @@ bool InnoDataPacketUtils::convert_to_xyz_pointcloud(
 
     ITERARATE_INNO_DATA_PACKET_CPOINTS(CONVERT_FN, NULL,
                                        &src, dummy_count);
+  } else {
+    uint32_t unit_size;
+    uint32_t mr;
+    get_block_size_and_number_return(src, &unit_size, &mr);
+    const char *block = reinterpret_cast<const char *>(&src.inno_block1s[0]);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < src.item_number; i++, block += unit_size) {
+      n += convert_block_to_xyz_points_(
+          *reinterpret_cast<const InnoBlock *>(block), mr,
+          time_adjust_10us, &dest->xyz_points[dest->item_number + n]);
+    }
+    dest->item_number += n;
+    item_count += n;
+    required_size += n * sizeof(InnoXyzPoint);
   }
   inno_log_verify(dest->item_number == item_count,
                   "item number %u vs %u",
@@ -405,6 +544,12 @@ bool InnoDataPacketUtils::convert_to_xyz_pointcloud(
 
 bool InnoDataPacketUtils::check_data_packet(const InnoDataPacket &pkt,
                                             size_t size) {
+  return check_data_packet(pkt, size, true);
+}
+
+bool InnoDataPacketUtils::check_data_packet(const InnoDataPacket &pkt,
+                                            size_t size,
+                                            bool verify_crc32) {
   if (pkt.common.version.magic_number != kInnoMagicNumberDataPacket) {
     inno_log_warning("bad magic %x", pkt.common.version.magic_number);
     return false;
@@ -449,7 +594,8 @@ bool InnoDataPacketUtils::check_data_packet(const InnoDataPacket &pkt,
       inno_log_warning("bad size %" PRI_SIZELU " %u", s, pkt.common.size);
       return false;
     }
-    if (!InnoPacketReader::verify_packet_crc32(&pkt.common)) {
+    if (verify_crc32 &&
+        !InnoPacketReader::verify_packet_crc32(&pkt.common)) {
       inno_log_warning("crc32 mismatch for data packet");
       return false;
     }
@@ -473,7 +619,8 @@ bool InnoDataPacketUtils::check_data_packet(const InnoDataPacket &pkt,
                        pkt.item_size + sizeof(InnoDataPacket));
       return false;
     }
-    if (!InnoPacketReader::verify_packet_crc32(&pkt.common)) {
+    if (verify_crc32 &&
+        !InnoPacketReader::verify_packet_crc32(&pkt.common)) {
       inno_log_warning("crc32 mismatch for message packet");
       return false;
     }
@@ -486,6 +633,12 @@ bool InnoDataPacketUtils::check_data_packet(const InnoDataPacket &pkt,
 
 bool InnoDataPacketUtils::check_status_packet(const InnoStatusPacket &pkt,
                                               size_t size) {
+  return check_status_packet(pkt, size, true);
+}
+
+bool InnoDataPacketUtils::check_status_packet(const InnoStatusPacket &pkt,
+                                              size_t size,
+                                              bool verify_crc32) {
   if (pkt.common.version.magic_number != kInnoMagicNumberStatusPacket) {
     inno_log_warning("bad magic %x", pkt.common.version.magic_number);
     return false;
@@ -501,7 +654,8 @@ bool InnoDataPacketUtils::check_status_packet(const InnoStatusPacket &pkt,
     return false;
   }
 
-  if (!InnoPacketReader::verify_packet_crc32(&pkt.common)) {
+  if (verify_crc32 &&
+      !InnoPacketReader::verify_packet_crc32(&pkt.common)) {
     inno_log_warning("crc32 mismatch for status packet");
     return false;
   }
@@ -175,6 +175,15 @@ extern "C" {
    private:
     static void lookup_xz_adjustment_(const InnoBlockAngles &angles,
                                       uint32_t ch, double *x, double *z);
+    static uint32_t convert_block_to_xyz_points_(const InnoBlock &block,
+                                                 uint32_t mr,
+                                                 uint16_t time_adjust_10us,
+                                                 InnoXyzPoint *out);
+    static bool convert_to_xyz_pointcloud_(const InnoDataPacket &src,
+                                           InnoDataPacket *dest,
+                                           size_t dest_size,
+                                           bool append,
+                                           bool per_point);
 
    public:
     static int init_f(void);
@@ -378,7 +387,21 @@ extern "C" {
     static bool convert_to_xyz_pointcloud(const InnoDataPacket &src,
                                           InnoDataPacket *dest,
                                           size_t dest_size,
-                                          bool append);
+                                          bool append) {
+      return convert_to_xyz_pointcloud_(src, dest, dest_size, append, false);
+    }
+
+    /*
+     * @brief Same as convert_to_xyz_pointcloud but converts one
+     *        InnoChannelPoint at a time. It is the reference of the
+     *        block-at-a-time path and produces bit-identical output.
+     */
+    static bool convert_to_xyz_pointcloud_per_point(const InnoDataPacket &src,
+                                                    InnoDataPacket *dest,
+                                                    size_t dest_size,
+                                                    bool append) {
+      return convert_to_xyz_pointcloud_(src, dest, dest_size, append, true);
+    }
 
     /*
      * @brief Sanity check the integrity of a InnoDataPacketGet.
@@ -389,6 +412,13 @@ extern "C" {
      */
     static bool check_data_packet(const InnoDataPacket &pkt,
                                   size_t size);
+    /*
+     * @brief Same as above, verify_crc32 false skips the checksum, only
+     *        for packets from a trusted local transport
+     */
+    static bool check_data_packet(const InnoDataPacket &pkt,
+                                  size_t size,
+                                  bool verify_crc32);
 
     /*
      * @brief Sanity check the integrity of a InnoDataPacketGet.
@@ -399,6 +429,13 @@ extern "C" {
      */
     static bool check_status_packet(const InnoStatusPacket &pkt,
                                     size_t size);
+    /*
+     * @brief Same as above, verify_crc32 false skips the checksum, only
+     *        for packets from a trusted local transport
+     */
+    static bool check_status_packet(const InnoStatusPacket &pkt,
+                                    size_t size,
+                                    bool verify_crc32);
 
     /*
      * @brief InnoStatusPacket formatted output.
@@ -104,11 +104,19 @@ void ResourceStats::show() {
   }
   int print_off = 0;
   for (int i = 0; i < PACKET_TYPE_MAX; i++) {
+    char ref_buf[96];
+    ref_buf[0] = 0;
+    if (i == PACKET_TYPE_POINT) {
+      snprintf(ref_buf, sizeof(ref_buf),
+               ", ref_intensity_sum = %" PRI_SIZEU
+               ", ref_count_total = %" PRI_SIZEU,
+               total_ref_intensity_, total_ref_count_);
+    }
     int pr = snprintf(buf + print_off, sizeof(buf) - print_off,
                       " <%s> %s=%" PRI_SIZEU "/%" PRI_SIZEU
                       ", %s=%" PRI_SIZEU "K/%" PRI_SIZEU "K, "
                       "%s=%.2fM/s"
-                      "%s%s%s%s;",
+                      "%s;",
                       packet_type_names[i],
                       i == PACKET_TYPE_POINT ? "frames": "packets",
                       total_packet_[i] - lastp_packet_[i],
@@ -118,12 +126,7 @@ void ResourceStats::show() {
                       (total_byte_[i]) >> 10,
                       i == PACKET_TYPE_POINT ? "point-rate": "bandwidth",
                       (total_byte_[i] - lastp_byte_[i]) / 1000000.0 / diff_s,
-                      i == PACKET_TYPE_POINT ? ", ref_intensity_sum = " : "",
-                      i == PACKET_TYPE_POINT ?
-                           std::to_string(total_ref_intensity_).c_str() : "",
-                      i == PACKET_TYPE_POINT ? ", ref_count_total = " : "",
-                      i == PACKET_TYPE_POINT ?
-                           std::to_string(total_ref_count_).c_str() : "");
+                      ref_buf);
     if (print_off + pr >= ssize_t(sizeof(buf))) {
       inno_log_error("stats buffer to small %d", print_off + pr);
       return;
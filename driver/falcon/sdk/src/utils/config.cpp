@@ -8,10 +8,13 @@
 
 #include "utils/config.h"
 
+#include <ctype.h>
 #include <limits.h>
+#include <stdlib.h>
 
 #include <algorithm>
 #include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
 
 #include "utils/log.h"
@@ -19,8 +22,9 @@
 
 namespace innovusion {
 
-Config::Config() {
-  version_ = 0;
+Config::Config()
+    : version_(0)
+    , write_seq_(0) {
 }
 
 Config::~Config() {
@@ -30,69 +34,92 @@ bool Config::is_same_type(const std::string &n) {
   return (strcmp(get_type(), n.c_str()) == 0);
 }
 
-int Config::set_key_value(const std::string &cfg_key_in,
-                          const std::string &cfg_value_in) {
-  std::string key(cfg_key_in);
-  std::string value(cfg_value_in);
-  InnoUtils::trim_space(&key);
-  InnoUtils::trim_space(&value);
+static inline void trim_space(const char **start, size_t *size) {
+  const char *s = *start;
+  const char *e = s + *size;
+  while (s < e && isspace(static_cast<unsigned char>(*s))) s++;
+  while (e > s && isspace(static_cast<unsigned char>(e[-1]))) e--;
+  *start = s;
+  *size = e - s;
+}
+
+int Config::set_key_value(const char *cfg_key_in, size_t key_size,
+                          const char *cfg_value_in, size_t value_size) {
+  const char *key_start = cfg_key_in;
+  const char *value = cfg_value_in;
+  trim_space(&key_start, &key_size);
+  trim_space(&value, &value_size);
+  ConfigKey key(key_start, key_size);
   // value is enclosed in double quotation marks, regard as a string
   int r;
-  if (value.at(0) == '"' && value.at(value.size()-1) == '"') {
-    r = set_key_value_(key, *InnoUtils::trim(&value, "\""));
+  if (value_size > 0 && value[0] == '"' && value[value_size - 1] == '"') {
+    std::string s(value, value_size);
+    r = set_key_value_(key, *InnoUtils::trim(&s, "\""));
   } else {
-    double v;
-    if (sscanf(value.c_str(), "%lf", &v) != 1) {
-      inno_log_error("%s invalid config value %s (key=%s)",
+    // the value is followed by white space or the end of the string
+    char *end = NULL;
+    double v = value_size > 0 ? strtod(value, &end) : 0;
+    if (end == NULL || end == value) {
+      inno_log_error("%s invalid config value %.*s (key=%.*s)",
                      get_type(),
-                     cfg_value_in.c_str(),
-                     cfg_key_in.c_str());
+                     static_cast<int>(value_size), value,
+                     static_cast<int>(key_size), key_start);
       return -1;
     }
     r = set_key_value_(key, v);
   }
   if (r == 0) {
     inc_version_();
-    inno_log_info("config %s(%" PRI_SIZEU ") set %s to %s",
+    inno_log_info("config %s(%" PRI_SIZEU ") set %.*s to %.*s",
                   get_type(),
-                  version_,
-                  key.c_str(),
-                  value.c_str());
+                  version_.load(std::memory_order_relaxed),
+                  static_cast<int>(key_size), key_start,
+                  static_cast<int>(value_size), value);
   } else {
-    inno_log_error("config %s invalid key %s (value=%s)",
+    inno_log_error("config %s invalid key %.*s (value=%.*s)",
                    get_type(),
-                   cfg_key_in.c_str(),
-                   cfg_value_in.c_str());
+                   static_cast<int>(key_size), key_start,
+                   static_cast<int>(value_size), value);
   }
   return r;
 }
 
 bool Config::copy_from_src(Config *src) {
+  uint64_t src_version = src->version_.load(std::memory_order_acquire);
+  if (src_version == version_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+
   /* have to be from the same class */
   inno_log_verify(strcmp(src->get_type(), get_type()) == 0,
                   "invalid copy %s to %s",
                   src->get_type(),
                   get_type());
-  bool copied = false;
-  {
-    std::unique_lock<std::mutex> lk(src->mutex_);
-    {
-      std::unique_lock<std::mutex> lk2(mutex_);
-          if (src->get_version_locked_() != get_version_locked_()) {
-            memcpy(get_start_(),
-                   src->get_start_(),
-                   src->get_size_());
-            set_version_locked_(src->get_version_locked_());
-            copied = true;
-          }
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    uint32_t seq = src->write_seq_.load(std::memory_order_acquire);
+    if (seq & 1) {
+      // a writer is in SET_CFG, it only holds for one assignment
+      std::this_thread::yield();
+      continue;
+    }
+    src_version = src->version_.load(std::memory_order_acquire);
+    memcpy(get_start_(),
+           src->get_start_(),
+           src->get_size_());
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (src->write_seq_.load(std::memory_order_relaxed) == seq) {
+      break;
     }
   }
-  return copied;
+  // if src_version is older than the copied members we only copy again
+  set_version_locked_(src_version);
+  return true;
 }
 
 void Config::inc_version_() {
   std::unique_lock<std::mutex> lk(mutex_);
-  version_++;
+  version_.fetch_add(1, std::memory_order_release);
   return;
 }
 
@@ -181,18 +208,22 @@ void ConfigManager::remove_config(Config *c) {
 int ConfigManager::set_config_key_value(const std::string &cfg_name_in,
                                         const std::string &cfg_value_in,
                                         bool from_app) {
-  std::string whole_name(cfg_name_in);
-  InnoUtils::trim_space(&whole_name);
+  const char *whole_name = cfg_name_in.data();
+  size_t whole_size = cfg_name_in.size();
+  trim_space(&whole_name, &whole_size);
 
-  size_t epos = whole_name.find("/");
+  const char *slash = reinterpret_cast<const char *>(
+      memchr(whole_name, '/', whole_size));
+  size_t epos = slash ? slash - whole_name : std::string::npos;
   if (epos == std::string::npos || epos == 0||
-      epos >= whole_name.size() - 1) {
+      epos >= whole_size - 1) {
     inno_log_warning("bad config %s=%s",
                      cfg_name_in.c_str(), cfg_value_in.c_str());
     return -1;
   }
-  std::string section = whole_name.substr(0, epos);
-  std::string key = whole_name.substr(epos + 1);
+  std::string section(whole_name, epos);
+  const char *key_start = whole_name + epos + 1;
+  size_t key_size = whole_size - epos - 1;
   int r = 0;
 
   {
@@ -205,15 +236,15 @@ int ConfigManager::set_config_key_value(const std::string &cfg_name_in,
         std::unordered_map<std::string, std::string> a;
         history_[section] = a;
       }
-      history_[section][key] = cfg_value_in;
+      history_[section][std::string(key_start, key_size)] = cfg_value_in;
     }
 
     std::unordered_map<std::string, std::vector<Config *>>::iterator it =
         configs_.find(section);
     if (it == configs_.end()) {
-      inno_log_info("%s config value %s (key=%s), will be applied later",
+      inno_log_info("%s config value %.*s (key=%s), will be applied later",
                     section.c_str(),
-                    key.c_str(),
+                    static_cast<int>(key_size), key_start,
                     cfg_value_in.c_str());
       // WYY to: seperate config from load
       return -2;
@@ -221,8 +252,9 @@ int ConfigManager::set_config_key_value(const std::string &cfg_name_in,
 
     std::vector<Config *> &vec = it->second;
     for (size_t i = 0; i < vec.size(); i++) {
-      int k = vec[i]->set_key_value(key,
-                                    cfg_value_in);
+      int k = vec[i]->set_key_value(key_start, key_size,
+                                    cfg_value_in.data(),
+                                    cfg_value_in.size());
       if (k != 0) {
         r = k;
       }
@@ -10,9 +10,13 @@
 #define UTILS_CONFIG_H_
 
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
 
+#include <atomic>
 #include <mutex>  // NOLINT
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -20,15 +24,88 @@
 
 namespace innovusion {
 
+/*
+ * key passed to Config::set_key_value_(): an unallocated copy of the
+ * name and its FNV-1a hash. SET_CFG and CFG_KEY_IS compare the hash with
+ * a constant computed at compile time before they compare the name.
+ */
+class ConfigKey {
+ public:
+  static const uint32_t kMaxSize = 63;
+  static const uint32_t kHashBasis = 2166136261u;
+  static const uint32_t kHashPrime = 16777619u;
+
+ public:
+  ConfigKey(const char *key)  // NOLINT(runtime/explicit)
+      : ConfigKey(key, strlen(key)) {
+  }
+  ConfigKey(const std::string &key)  // NOLINT(runtime/explicit)
+      : ConfigKey(key.data(), key.size()) {
+  }
+  ConfigKey(const char *key, size_t size)
+      : size_(size)
+      , hash_(hash_of(key, size)) {
+    size_t n = size < kMaxSize ? size : kMaxSize;
+    memcpy(key_, key, n);
+    key_[n] = 0;
+  }
+  const char *c_str() const {
+    return key_;
+  }
+  size_t size() const {
+    return size_;
+  }
+  uint32_t hash() const {
+    return hash_;
+  }
+  bool is(uint32_t hash, const char *name, size_t size) const {
+    return hash == hash_ && size == size_ && size <= kMaxSize &&
+           memcmp(name, key_, size) == 0;
+  }
+
+  static constexpr uint32_t hash_of(const char *s) {
+    return hash_from_(s, kHashBasis);
+  }
+  static inline uint32_t hash_of(const char *s, size_t size) {
+    uint32_t h = kHashBasis;
+    for (size_t i = 0; i < size; i++) {
+      h = (h ^ static_cast<uint8_t>(s[i])) * kHashPrime;
+    }
+    return h;
+  }
+
+ private:
+  static constexpr uint32_t hash_from_(const char *s, uint32_t h) {
+    return *s ? hash_from_(s + 1, (h ^ static_cast<uint8_t>(*s)) * kHashPrime)
+              : h;
+  }
+
+ private:
+  size_t size_;
+  uint32_t hash_;
+  char key_[kMaxSize + 1];
+};
+
 class Config {
  public:
   Config();
   virtual ~Config();
   bool is_same_type(const std::string &n);
   int set_key_value(const std::string &cfg_key_in,
-                    const std::string &cfg_value_in);
+                    const std::string &cfg_value_in) {
+    return set_key_value(cfg_key_in.data(), cfg_key_in.size(),
+                         cfg_value_in.data(), cfg_value_in.size());
+  }
+  /* the key is not null-terminated, the value ends at a space or null */
+  int set_key_value(const char *cfg_key_in, size_t key_size,
+                    const char *cfg_value_in, size_t value_size);
   virtual const char* get_type() const = 0;
-  /* only copy when version are different */
+  /*
+   * only copy when version are different. Called by the stages on every
+   * job: an unchanged version is detected with one atomic load and no
+   * lock, a changed one is copied as a seqlock read of src, so a writer
+   * in set_key_value() never blocks on a reader.
+   */
   bool copy_from_src(Config *src);
 
  protected:
@@ -38,7 +115,7 @@ class Config {
    * @param value
    * @return
    */
-  virtual int set_key_value_(const std::string &key,
+  virtual int set_key_value_(const ConfigKey &key,
                              double value) = 0;
   /**
    * set a string value config
@@ -46,7 +123,7 @@ class Config {
    * @param value
    * @return
    */
-  virtual int set_key_value_(const std::string &key,
+  virtual int set_key_value_(const ConfigKey &key,
                              const std::string value) {
     // do nothing in base config
     return -1;
@@ -56,22 +133,35 @@ class Config {
 
   inline uint64_t get_version_locked_() {
     // inno_log_assert(mutex_.owns_lock(), "not locked");
-    return version_;
+    return version_.load(std::memory_order_relaxed);
   }
 
   inline uint64_t set_version_locked_(uint64_t r) {
     // inno_log_assert(mutex_.owns_lock(), "not locked");
-    version_ = r;
+    version_.store(r, std::memory_order_release);
     return r;
   }
 
+  /* writers hold mutex_, write_seq_ is odd while a member is written */
+  inline void begin_write_locked_() {
+    write_seq_.store(write_seq_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  inline void end_write_locked_() {
+    write_seq_.store(write_seq_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+  }
+
   void inc_version_();
 
  protected:
   std::mutex mutex_;
 
  private:
-  uint64_t version_;
+  std::atomic<uint64_t> version_;
+  std::atomic<uint32_t> write_seq_;
 };
 
 #define BEGIN_CFG_MEMBER()                      \
@@ -89,11 +179,19 @@ class Config {
  private:                                       \
   int32_t end_;
 
+/* key is one of the names in a set_key_value_() override */
+#define CFG_KEY_IS(name)                                              \
+  (key.is(std::integral_constant<uint32_t,                            \
+          ::innovusion::ConfigKey::hash_of(name)>::value,             \
+          name, sizeof(name) - 1))
+
 #define SET_CFG(name)                           \
   do {                                          \
-     if (strcmp(key.c_str(), #name) == 0) {     \
+     if (CFG_KEY_IS(#name)) {                   \
        std::unique_lock<std::mutex> lk(mutex_); \
-       (name) = value;                            \
+       begin_write_locked_();                   \
+       (name) = value;                          \
+       end_write_locked_();                     \
        return 0;                                \
      }                                          \
   } while (0)
@@ -134,7 +232,7 @@ class ExampleConfig: public Config {
     return "Example";  // <== different Config class must return different name
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                              double value) override {
     SET_CFG(test1);  // <== ADD_MEMBER_STEP2
     SET_CFG(test2);
@@ -142,7 +240,7 @@ class ExampleConfig: public Config {
     return -1;
   }
 
-  int set_key_value_(const std::string &key,
+  int set_key_value_(const ConfigKey &key,
                      const std::string value) override {
     // no string attribute
     return -1;
@@ -0,0 +1,867 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+#include "utils/deferred_log.h"
+
+#if !(defined(_QNX_) || defined (__MINGW64__) || defined(__APPLE__))
+#include <link.h>
+#include <syscall.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+
+namespace innovusion {
+
+/************
+ A record in the ring, 8-byte aligned, followed by one 8-byte slot per
+ printf argument (int/double/pointer, a '*' width or precision takes one
+ too) in the order of fmt. A string argument is a uint32 length and the
+ bytes with their '\0', padded to 8.
+*************/
+struct DeferredLogRecord {
+  uint32_t size;
+  uint16_t level;  // kPadLevel: skip to the start of the ring
+  uint16_t reserved;
+  int32_t line;
+  uint32_t tid;
+  int64_t tv_sec;
+  int64_t tv_nsec;
+  uint64_t seq;
+  const char *file;
+  const char *fmt;
+};
+
+static const uint16_t kPadLevel = 0xffff;
+
+/*
+ * single producer (the owner thread) single consumer (the drain thread)
+ * byte ring, head_ and tail_ only grow
+ */
+class DeferredLogRing {
+ public:
+  explicit DeferredLogRing(size_t size)
+      : buffer_(reinterpret_cast<char *>(malloc(size)))
+      , mask_(size - 1)
+      , head_(0)
+      , writing_(false)
+      , released_(false)
+      , recorded_(0)
+      , dropped_(0)
+      , wake_(false)
+      , tail_(0) {
+    inno_log_verify_no_print(buffer_);
+  }
+  ~DeferredLogRing() {
+    free(buffer_);
+  }
+
+  /* contiguous room for size bytes, NULL if full */
+  inline char *reserve(size_t size, uint64_t *pos) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t room = mask_ + 1 - (head - tail_.load(std::memory_order_acquire));
+    size_t offset = head & mask_;
+    size_t to_end = mask_ + 1 - offset;
+    if (to_end < size) {
+      if (room < to_end + size) {
+        return NULL;
+      }
+      // not committed until the record after it is
+      DeferredLogRecord *pad =
+          reinterpret_cast<DeferredLogRecord *>(buffer_ + offset);
+      pad->size = to_end;
+      pad->level = kPadLevel;
+      head += to_end;
+      offset = 0;
+    } else if (room < size) {
+      return NULL;
+    }
+    *pos = head;
+    return buffer_ + offset;
+  }
+
+  inline void commit(uint64_t pos, size_t size) {
+    head_.store(pos + size, std::memory_order_release);
+  }
+
+  /* true if the drain thread has to be woken up */
+  inline bool need_wake() {
+    if (wake_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    wake_.store(true, std::memory_order_relaxed);
+    return true;
+  }
+
+  inline size_t used() const {
+    return head_.load(std::memory_order_relaxed) -
+        tail_.load(std::memory_order_relaxed);
+  }
+
+ public:
+  char *buffer_;
+  size_t mask_;
+  // written by the owner thread
+  std::atomic<uint64_t> head_;
+  std::atomic<bool> writing_;
+  std::atomic<bool> released_;
+  std::atomic<uint64_t> recorded_;
+  std::atomic<uint64_t> dropped_;
+  // the drain thread was woken up for this ring and has not drained it
+  std::atomic<bool> wake_;
+  char pad_[64];
+  // written by the drain thread
+  std::atomic<uint64_t> tail_;
+};
+
+enum DeferredArgType {
+  kArgNone = 0,  // %%
+  kArgInt,
+  kArgLong,
+  kArgLongLong,
+  kArgSize,
+  kArgIntMax,
+  kArgPtrDiff,
+  kArgDouble,
+  kArgString,
+  kArgPointer,
+  kArgBad,
+};
+
+struct DeferredFormatSpec {
+  const char *begin;
+  size_t len;
+  int stars;
+  DeferredArgType type;
+};
+
+static const size_t kMaxSpecLength = 32;
+
+/*
+ * parse the conversion at p (a '%'), same rules on both sides of the
+ * ring so the slots need no type tag
+ */
+static const char *parse_spec(const char *p, DeferredFormatSpec *spec) {
+  spec->begin = p;
+  spec->stars = 0;
+  spec->type = kArgBad;
+  p++;
+  if (*p == '%') {
+    spec->type = kArgNone;
+    spec->len = 2;
+    return p + 1;
+  }
+  while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' ||
+         *p == '0' || *p == '\'') {
+    p++;
+  }
+  if (*p == '*') {
+    spec->stars++;
+    p++;
+  } else {
+    while (*p >= '0' && *p <= '9') {
+      p++;
+    }
+  }
+  if (*p == '$') {
+    // positional arguments
+    return p;
+  }
+  if (*p == '.') {
+    p++;
+    if (*p == '*') {
+      spec->stars++;
+      p++;
+    } else {
+      while (*p >= '0' && *p <= '9') {
+        p++;
+      }
+    }
+  }
+
+  enum { kNone, kChar, kShort, kLong, kLongLong, kLongDouble,
+         kSize, kIntMax, kPtrDiff } length = kNone;
+  switch (*p) {
+    case 'h':
+      p++;
+      length = kShort;
+      if (*p == 'h') {
+        p++;
+        length = kChar;
+      }
+      break;
+    case 'l':
+      p++;
+      length = kLong;
+      if (*p == 'l') {
+        p++;
+        length = kLongLong;
+      }
+      break;
+    case 'q':
+      p++;
+      length = kLongLong;
+      break;
+    case 'L':
+      p++;
+      length = kLongDouble;
+      break;
+    case 'z':
+      p++;
+      length = kSize;
+      break;
+    case 'j':
+      p++;
+      length = kIntMax;
+      break;
+    case 't':
+      p++;
+      length = kPtrDiff;
+      break;
+    default:
+      break;
+  }
+
+  switch (*p) {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+      switch (length) {
+        case kNone: case kChar: case kShort:
+          spec->type = kArgInt;
+          break;
+        case kLong:
+          spec->type = kArgLong;
+          break;
+        case kLongLong:
+          spec->type = kArgLongLong;
+          break;
+        case kSize:
+          spec->type = kArgSize;
+          break;
+        case kIntMax:
+          spec->type = kArgIntMax;
+          break;
+        case kPtrDiff:
+          spec->type = kArgPtrDiff;
+          break;
+        default:
+          break;
+      }
+      break;
+    case 'c':
+      if (length == kNone) {
+        spec->type = kArgInt;
+      }
+      break;
+    case 's':
+      if (length == kNone) {
+        spec->type = kArgString;
+      }
+      break;
+    case 'p':
+      if (length == kNone) {
+        spec->type = kArgPointer;
+      }
+      break;
+    case 'f': case 'F': case 'e': case 'E':
+    case 'g': case 'G': case 'a': case 'A':
+      if (length == kNone || length == kLong) {
+        spec->type = kArgDouble;
+      }
+      break;
+    default:
+      // %n, %m, %S, end of string...
+      return p;
+  }
+  p++;
+  spec->len = p - spec->begin;
+  if (spec->len >= kMaxSpecLength) {
+    spec->type = kArgBad;
+  }
+  return p;
+}
+
+template <typename T>
+static inline T get_slot(const char *p) {
+  T v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+template <typename T>
+static inline void put_slot(char *p, T v) {
+  memset(p, 0, 8);
+  memcpy(p, &v, sizeof(v));
+}
+
+template <typename T>
+static inline int format_arg(char *out, size_t size, const char *spec,
+                             int stars, const int *star, T v) {
+  if (stars == 0) {
+    return snprintf(out, size, spec, v);
+  } else if (stars == 1) {
+    return snprintf(out, size, spec, star[0], v);
+  } else {
+    return snprintf(out, size, spec, star[0], star[1], v);
+  }
+}
+
+static __thread DeferredLog *tls_owner = NULL;
+static __thread DeferredLogRing *tls_ring = NULL;
+static __thread bool tls_is_drain_thread = false;
+
+DeferredLog::DeferredLog(DeferredLogSink sink, void *sink_ctx)
+    : sink_(sink)
+    , sink_ctx_(sink_ctx)
+    , running_(true)
+    , ring_number_(0)
+    , thread_(NULL)
+    , fallback_(0)
+    , inline_drain_(0)
+    , seq_(0)
+    , head1_len_(0)
+    , head1_sec_(-1) {
+  pthread_key_create(&ring_key_, release_ring_);
+  memset(rings_, 0, sizeof(rings_));
+  thread_ = new std::thread(&DeferredLog::drain_loop_, this);
+}
+
+DeferredLog::~DeferredLog() {
+  shutdown();
+  delete thread_;
+  thread_ = NULL;
+  // no release_ring_() after this
+  pthread_key_delete(ring_key_);
+  uint32_t n = ring_number_.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < n; i++) {
+    delete rings_[i];
+    rings_[i] = NULL;
+  }
+}
+
+uint32_t DeferredLog::get_tid() {
+  static __thread uint32_t tid = 0;
+#if !(defined(_QNX_) ||defined(__MINGW64__) || defined(__APPLE__))
+  if (tid == 0) {
+    tid = syscall(SYS_gettid);
+  }
+#endif
+  return tid;
+}
+
+#if !(defined(_QNX_) || defined (__MINGW64__) || defined(__APPLE__))
+struct DeferredSegmentQuery {
+  uintptr_t address;
+  bool read_only;
+};
+
+static int find_read_only_segment(struct dl_phdr_info *info, size_t,
+                                  void *data) {
+  DeferredSegmentQuery *q = reinterpret_cast<DeferredSegmentQuery *>(data);
+  for (int i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr) &ph = info->dlpi_phdr[i];
+    if (ph.p_type != PT_LOAD) {
+      continue;
+    }
+    uintptr_t start = info->dlpi_addr + ph.p_vaddr;
+    if (q->address >= start && q->address < start + ph.p_memsz) {
+      q->read_only = (ph.p_flags & PF_W) == 0;
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif
+
+/*
+ * a string literal lives in a read-only segment of a loaded module;
+ * heap, stack, anonymous mappings and writable .data/.bss don't, and
+ * their content may change before it is formatted.
+ * The answer is cached per thread by address.
+ */
+bool DeferredLog::is_static_string_(const char *s) {
+#if defined(_QNX_) || defined (__MINGW64__) || defined(__APPLE__)
+  return false;
+#else
+  static const uint32_t kCacheBits = 8;
+  static __thread uintptr_t cache[1 << kCacheBits];  // address | is_static
+  uintptr_t a = reinterpret_cast<uintptr_t>(s);
+  uint32_t slot = (a * 0x9E3779B97F4A7C15ULL) >> (64 - kCacheBits);
+  uintptr_t c = cache[slot];
+  if ((c >> 1) == a) {
+    return c & 1;
+  }
+  DeferredSegmentQuery q;
+  q.address = a;
+  q.read_only = false;
+  dl_iterate_phdr(find_read_only_segment, &q);
+  bool is_static = q.read_only;
+  cache[slot] = (a << 1) | (is_static ? 1 : 0);
+  return is_static;
+#endif
+}
+
+DeferredLogRing *DeferredLog::get_ring_() {
+  if (tls_owner == this) {
+    return tls_ring;
+  }
+  DeferredLogRing *ring = NULL;
+  {
+    std::unique_lock<std::mutex> lk(rings_mutex_);
+    uint32_t n = ring_number_.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < n; i++) {
+      if (rings_[i]->released_.load(std::memory_order_acquire) &&
+          rings_[i]->used() == 0) {
+        ring = rings_[i];
+        ring->released_.store(false, std::memory_order_relaxed);
+        break;
+      }
+    }
+    if (ring == NULL && n < kMaxRings) {
+      ring = new DeferredLogRing(kRingSize);
+      rings_[n] = ring;
+      ring_number_.store(n + 1, std::memory_order_release);
+    }
+  }
+  if (ring) {
+    pthread_setspecific(ring_key_, ring);
+  }
+  tls_owner = this;
+  tls_ring = ring;
+  return ring;
+}
+
+void DeferredLog::release_ring_(void *ring) {
+  reinterpret_cast<DeferredLogRing *>(ring)->
+      released_.store(true, std::memory_order_release);
+}
+
+bool DeferredLog::log_v(enum InnoLogLevel level,
+                        bool discardable,
+                        const char *file, int line,
+                        const char *fmt,
+                        va_list valist) {
+  if (tls_is_drain_thread ||
+      !is_static_string_(fmt) || !is_static_string_(file)) {
+    fallback_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  DeferredLogRing *ring = get_ring_();
+  if (ring == NULL) {
+    fallback_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // built on the stack first, so only its own size is reserved in the
+  // ring instead of kMaxRecordSize
+  uint64_t local[kMaxRecordSize / 8];
+  char *start = reinterpret_cast<char *>(local);
+  DeferredLogRecord *record = reinterpret_cast<DeferredLogRecord *>(start);
+  struct timespec spec;
+  clock_gettime(CLOCK_REALTIME, &spec);
+  record->level = level;
+  record->reserved = 0;
+  record->line = line;
+  record->tid = get_tid();
+  record->tv_sec = spec.tv_sec;
+  record->tv_nsec = spec.tv_nsec;
+  record->file = file;
+  record->fmt = fmt;
+
+  char *p = start + sizeof(DeferredLogRecord);
+  char *end = start + kMaxRecordSize;
+  bool ok = true;
+  va_list ap;
+  va_copy(ap, valist);
+  for (const char *f = fmt; *f && ok;) {
+    if (*f != '%') {
+      f++;
+      continue;
+    }
+    DeferredFormatSpec fs;
+    f = parse_spec(f, &fs);
+    if (fs.type == kArgBad ||
+        p + (fs.stars + 1) * 8 > end) {
+      ok = false;
+      break;
+    }
+    for (int i = 0; i < fs.stars; i++) {
+      put_slot<int>(p, va_arg(ap, int));
+      p += 8;
+    }
+    switch (fs.type) {
+      case kArgNone:
+        break;
+      case kArgInt:
+        put_slot<int>(p, va_arg(ap, int));
+        p += 8;
+        break;
+      case kArgLong:
+        put_slot<long>(p, va_arg(ap, long));  // NOLINT
+        p += 8;
+        break;
+      case kArgLongLong:
+        put_slot<long long>(p, va_arg(ap, long long));  // NOLINT
+        p += 8;
+        break;
+      case kArgSize:
+        put_slot<size_t>(p, va_arg(ap, size_t));
+        p += 8;
+        break;
+      case kArgIntMax:
+        put_slot<intmax_t>(p, va_arg(ap, intmax_t));
+        p += 8;
+        break;
+      case kArgPtrDiff:
+        put_slot<ptrdiff_t>(p, va_arg(ap, ptrdiff_t));
+        p += 8;
+        break;
+      case kArgDouble:
+        put_slot<double>(p, va_arg(ap, double));
+        p += 8;
+        break;
+      case kArgPointer:
+        put_slot<void *>(p, va_arg(ap, void *));
+        p += 8;
+        break;
+      case kArgString: {
+        const char *s = va_arg(ap, const char *);
+        if (s == NULL) {
+          s = "(null)";
+        }
+        size_t len = strlen(s);
+        size_t need = 8 + ((len + 1 + 7) & ~7);
+        if (len >= kMaxRecordSize || p + need > end) {
+          ok = false;
+          break;
+        }
+        put_slot<uint32_t>(p, len);
+        memcpy(p + 8, s, len + 1);
+        p += need;
+        break;
+      }
+      default:
+        ok = false;
+        break;
+    }
+  }
+  va_end(ap);
+
+  if (!ok) {
+    fallback_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  record->size = p - start;
+
+  // pairs with shutdown(): either we see !running_ or it waits for us
+  ring->writing_.store(true, std::memory_order_seq_cst);
+  if (!running_.load(std::memory_order_seq_cst)) {
+    ring->writing_.store(false, std::memory_order_release);
+    return false;
+  }
+  uint64_t pos;
+  char *dest = ring->reserve(record->size, &pos);
+  if (dest == NULL) {
+    ring->writing_.store(false, std::memory_order_release);
+    if (discardable && level > INNO_LOG_LEVEL_ERROR) {
+      if (ring->need_wake()) {
+        wait_cond_.notify_one();
+      }
+      ring->dropped_.store(ring->dropped_.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+      return true;
+    }
+    // make room here, formatting this one now would put it ahead of
+    // the records in the rings
+    inline_drain_.fetch_add(1, std::memory_order_relaxed);
+    drain_();
+    ring->writing_.store(true, std::memory_order_seq_cst);
+    if (!running_.load(std::memory_order_seq_cst)) {
+      ring->writing_.store(false, std::memory_order_release);
+      return false;
+    }
+    dest = ring->reserve(record->size, &pos);
+    if (dest == NULL) {
+      ring->writing_.store(false, std::memory_order_release);
+      fallback_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  // taken with writing_ set, see drain_()
+  record->seq = seq_.fetch_add(1, std::memory_order_seq_cst);
+  memcpy(dest, start, record->size);
+  ring->commit(pos, record->size);
+  ring->recorded_.store(ring->recorded_.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+  ring->writing_.store(false, std::memory_order_release);
+  if ((level <= INNO_LOG_LEVEL_WARNING || ring->used() > kRingSize / 2) &&
+      ring->need_wake()) {
+    wait_cond_.notify_one();
+  }
+  return true;
+}
+
+void DeferredLog::format_(const char *data) {
+  const DeferredLogRecord *record =
+      reinterpret_cast<const DeferredLogRecord *>(data);
+
+  // head1, the date only changes once a second
+  if (record->tv_sec != head1_sec_) {
+    time_t sec = record->tv_sec;
+    struct tm result_time;
+    struct tm *tm_info = NULL;
+#ifndef __MINGW64__
+    tm_info = localtime_r(&sec, &result_time);
+#else
+    tm_info = localtime_s(&result_time, &sec) == 0 ? &result_time : NULL;
+#endif
+    head1_len_ = 0;
+    if (tm_info) {
+      head1_len_ = strftime(head1_, sizeof(head1_) - 5,
+                            "%Y-%m-%d %H:%M:%S", tm_info);
+    }
+    head1_sec_ = record->tv_sec;
+  }
+  int milli = record->tv_nsec / (1000 * 1000);
+  head1_[head1_len_] = '.';
+  head1_[head1_len_ + 1] = '0' + milli / 100;
+  head1_[head1_len_ + 2] = '0' + milli / 10 % 10;
+  head1_[head1_len_ + 3] = '0' + milli % 10;
+  head1_[head1_len_ + 4] = 0;
+
+  static const int kMaxHeaderSize = 100;
+  char head2[kMaxHeaderSize];
+  int head2_len = snprintf(head2, kMaxHeaderSize, "%s %d %s:%d",
+                           inno_log_header_g[record->level], record->tid,
+                           record->file, record->line);
+  if (head2_len > (kMaxHeaderSize - 1)) {
+    head2_len = kMaxHeaderSize - 1;
+  }
+
+  // body
+  const char *slot = data + sizeof(DeferredLogRecord);
+  size_t n = 0;
+  char spec_str[kMaxSpecLength];
+  for (const char *f = record->fmt; *f;) {
+    if (*f != '%') {
+      const char *next = strchr(f, '%');
+      size_t len = next ? next - f : strlen(f);
+      size_t copy = std::min(len, kMaxBodySize - 1 - n);
+      memcpy(body_ + n, f, copy);
+      n += copy;
+      f += len;
+      continue;
+    }
+    DeferredFormatSpec fs;
+    f = parse_spec(f, &fs);
+    if (fs.type == kArgNone) {
+      if (n < kMaxBodySize - 1) {
+        body_[n++] = '%';
+      }
+      continue;
+    }
+    memcpy(spec_str, fs.begin, fs.len);
+    spec_str[fs.len] = 0;
+    int star[2] = {0, 0};
+    for (int i = 0; i < fs.stars; i++) {
+      star[i] = get_slot<int>(slot);
+      slot += 8;
+    }
+    char *out = body_ + n;
+    size_t size = kMaxBodySize - n;
+    int r = 0;
+    switch (fs.type) {
+      case kArgInt:
+        r = format_arg(out, size, spec_str, fs.stars, star,
+                       get_slot<int>(slot));
+        break;
+      case kArgLong:
+        r = format_arg(out, size, spec_str, fs.stars, star,
+                       get_slot<long>(slot));  // NOLINT
+        break;
+      case kArgLongLong:
+        r = format_arg(out, size, spec_str, fs.stars, star,
+                       get_slot<long long>(slot));  // NOLINT
+        break;
+      case kArgSize:
+        r = format_arg(out, size, spec_str, fs.stars, star,
+                       get_slot<size_t>(slot));
+        break;
+      case kArgIntMax:
+        r = format_arg(out, size, spec_str, fs.stars, star,
+                       get_slot<intmax_t>(slot));
+        break;
+      case kArgPtrDiff:
+        r = format_arg(out, size, spec_str, fs.stars, star,
+                       get_slot<ptrdiff_t>(slot));
+        break;
+      case kArgDouble:
+        r = format_arg(out, size, spec_str, fs.stars, star,
+                       get_slot<double>(slot));
+        break;
+      case kArgPointer:
+        r = format_arg(out, size, spec_str, fs.stars, star,
+                       get_slot<void *>(slot));
+        break;
+      case kArgString: {
+        uint32_t len = get_slot<uint32_t>(slot);
+        r = format_arg(out, size, spec_str, fs.stars, star,
+                       slot + 8);
+        slot += ((len + 1 + 7) & ~7);
+        break;
+      }
+      default:
+        break;
+    }
+    slot += 8;
+    if (r > 0) {
+      n = std::min(n + r, kMaxBodySize - 1);
+    }
+  }
+  if (n > 0 && body_[n - 1] == '\n') {
+    // remove unnecessary \n
+    n--;
+  }
+  body_[n] = 0;
+
+  logContextInfo info;
+  info.level = static_cast<enum InnoLogLevel>(record->level);
+  info.head1_p = head1_;
+  info.head1_len = head1_len_ + 4;
+  info.head2_p = head2;
+  info.head2_len = head2_len;
+  info.level_len = strlen(inno_log_header_g[record->level]);
+  info.body_p = body_;
+  info.body_len = n;
+  sink_(sink_ctx_, info);
+}
+
+size_t DeferredLog::drain_() {
+  std::unique_lock<std::mutex> lk(drain_mutex_);
+  // logs from the sinks go to the direct path
+  bool is_drain_thread = tls_is_drain_thread;
+  tls_is_drain_thread = true;
+  size_t records = 0;
+  // A writer takes its seq with writing_ set, so once no ring is being
+  // written every seq below limit is committed. The records of one ring
+  // are in seq order, the rings are merged up to limit.
+  uint64_t limit = seq_.load(std::memory_order_seq_cst);
+  uint32_t n = ring_number_.load(std::memory_order_acquire);
+  uint32_t active = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    DeferredLogRing *ring = rings_[i];
+    ring->wake_.store(false, std::memory_order_relaxed);
+    while (ring->writing_.load(std::memory_order_seq_cst)) {
+      std::this_thread::yield();
+    }
+    if (ring->tail_.load(std::memory_order_relaxed) <
+        ring->head_.load(std::memory_order_acquire)) {
+      drain_rings_[active++] = ring;
+    }
+  }
+  while (active > 0) {
+    uint32_t best = kMaxRings;
+    uint64_t best_seq = limit;
+    for (uint32_t i = 0; i < active;) {
+      DeferredLogRing *ring = drain_rings_[i];
+      uint64_t tail = ring->tail_.load(std::memory_order_relaxed);
+      uint64_t head = ring->head_.load(std::memory_order_acquire);
+      const DeferredLogRecord *record = NULL;
+      while (tail < head) {
+        record = reinterpret_cast<const DeferredLogRecord *>(
+            ring->buffer_ + (tail & ring->mask_));
+        if (record->level != kPadLevel) {
+          break;
+        }
+        tail += record->size;
+        ring->tail_.store(tail, std::memory_order_release);
+        record = NULL;
+      }
+      if (record == NULL || record->seq >= limit) {
+        // done with this ring
+        drain_rings_[i] = drain_rings_[--active];
+        continue;
+      }
+      if (record->seq < best_seq) {
+        best_seq = record->seq;
+        best = i;
+      }
+      i++;
+    }
+    if (best == kMaxRings) {
+      break;
+    }
+    DeferredLogRing *ring = drain_rings_[best];
+    uint64_t tail = ring->tail_.load(std::memory_order_relaxed);
+    const char *data = ring->buffer_ + (tail & ring->mask_);
+    format_(data);
+    records++;
+    // give the room back as we go, the producer may be waiting on it
+    ring->tail_.store(
+        tail + reinterpret_cast<const DeferredLogRecord *>(data)->size,
+        std::memory_order_release);
+  }
+  tls_is_drain_thread = is_drain_thread;
+  return records;
+}
+
+void DeferredLog::drain_loop_() {
+  tls_is_drain_thread = true;
+  while (running_.load(std::memory_order_acquire)) {
+    drain_();
+    std::unique_lock<std::mutex> lk(wait_mutex_);
+    wait_cond_.wait_for(lk, std::chrono::milliseconds(kDrainIntervalMs));
+  }
+}
+
+void DeferredLog::flush() {
+  if (tls_is_drain_thread) {
+    // drain_mutex_ is held by this thread
+    return;
+  }
+  drain_();
+}
+
+void DeferredLog::shutdown() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  uint32_t n = ring_number_.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < n; i++) {
+    while (rings_[i]->writing_.load(std::memory_order_seq_cst)) {
+      std::this_thread::yield();
+    }
+  }
+  wait_cond_.notify_one();
+  if (thread_) {
+    thread_->join();
+  }
+  drain_();
+}
+
+void DeferredLog::print_stats() {
+  uint64_t recorded = 0;
+  uint64_t dropped = 0;
+  uint32_t n = ring_number_.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < n; i++) {
+    recorded += rings_[i]->recorded_.load(std::memory_order_relaxed);
+    dropped += rings_[i]->dropped_.load(std::memory_order_relaxed);
+  }
+  inno_log_info("deferred log: rings=%u recorded=%" PRI_SIZEU
+                " dropped=%" PRI_SIZEU " direct=%" PRI_SIZEU
+                " inline_drain=%" PRI_SIZEU,
+                n, recorded, dropped,
+                fallback_.load(std::memory_order_relaxed),
+                inline_drain_.load(std::memory_order_relaxed));
+}
+
+}  // namespace innovusion
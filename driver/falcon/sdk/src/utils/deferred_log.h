@@ -0,0 +1,123 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+#ifndef UTILS_DEFERRED_LOG_H_
+#define UTILS_DEFERRED_LOG_H_
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+
+#include "utils/log.h"
+
+namespace innovusion {
+
+class DeferredLogRing;
+
+typedef void (*DeferredLogSink)(void *ctx, const logContextInfo &info);
+
+/**
+ * @class DeferredLog :
+ * Low overhead backend of InnoLog. The logging thread only records the
+ * time, the level, the file/fmt pointers and the raw printf arguments
+ * (strings are copied) into a lock-free ring owned by that thread; the
+ * headers and the message are formatted later on the DeferredLog thread,
+ * which hands a logContextInfo to the sink (terminal/file/callback).
+ *
+ * file and fmt are kept as pointers, so a log call is only deferred when
+ * both are in a read-only segment of a loaded module (string literals,
+ * see is_static_string_()). Anything the ring cannot carry (%n, %m, %ls,
+ * %Lf, positional arguments, long strings) returns false and the caller
+ * formats it right away, after flush().
+ *
+ * Every record takes a sequence number and the rings are merged by it,
+ * so the output keeps the order of the log calls across threads. A
+ * full ring is drained by the logging thread itself for a not
+ * discardable log instead of formatting that log ahead of the others.
+ */
+class DeferredLog {
+ public:
+  DeferredLog(DeferredLogSink sink, void *sink_ctx);
+  ~DeferredLog();
+
+  /**
+   * @brief record a log call
+   * @return true if recorded or dropped, false if the caller has to
+   *         format it
+   */
+  bool log_v(enum InnoLogLevel level,
+             bool discardable,
+             const char *file, int line,
+             const char *fmt,
+             va_list valist);
+  /**
+   * @brief format everything recorded so far, in the calling thread,
+   *        no-op in a sink
+   */
+  void flush();
+  /**
+   * @brief stop recording, flush and join the thread
+   */
+  void shutdown();
+  void print_stats();
+
+  /* cached per thread, shared with the direct path of InnoLog */
+  static uint32_t get_tid();
+
+ private:
+  static const size_t kRingSize = 64 * 1024;
+  static const size_t kMaxRecordSize = 4096;
+  static const uint32_t kMaxRings = 256;
+  static const uint32_t kDrainIntervalMs = 10;
+  static const size_t kMaxBodySize = 10000;
+
+  DeferredLogRing *get_ring_();
+  static void release_ring_(void *ring);
+  static bool is_static_string_(const char *s);
+  void drain_loop_();
+  size_t drain_();
+  void format_(const char *record);
+
+ private:
+  DeferredLogSink sink_;
+  void *sink_ctx_;
+  std::atomic<bool> running_;
+  pthread_key_t ring_key_;
+
+  // rings are only added, a thread that exits leaves its ring for reuse
+  std::mutex rings_mutex_;
+  DeferredLogRing *rings_[kMaxRings];
+  std::atomic<uint32_t> ring_number_;
+
+  // drain_mutex_ is held while formatting, flush() takes it too
+  std::mutex drain_mutex_;
+  std::mutex wait_mutex_;
+  std::condition_variable wait_cond_;
+  std::thread *thread_;
+
+  std::atomic<uint64_t> fallback_;
+  std::atomic<uint64_t> inline_drain_;
+  // taken by a record once it has room in its ring
+  std::atomic<uint64_t> seq_;
+
+  // used with drain_mutex_ held
+  DeferredLogRing *drain_rings_[kMaxRings];
+  char head1_[64];
+  int head1_len_;
+  int64_t head1_sec_;
+  char body_[kMaxBodySize];
+};
+
+}  // namespace innovusion
+
+#endif  // UTILS_DEFERRED_LOG_H_
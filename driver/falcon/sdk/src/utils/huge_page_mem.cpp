@@ -0,0 +1,95 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+#include "utils/huge_page_mem.h"
+
+#include <stdint.h>
+#include <unistd.h>
+#ifndef __MINGW64__
+#include <sys/mman.h>
+#endif
+
+#include "utils/inno_lidar_log.h"
+
+namespace innovusion {
+//======================================
+// HugePageMem
+//======================================
+HugePageMem::HugePageMem(const char *name, size_t size, bool lock)
+    : buffer_(NULL)
+    , map_size_(0)
+    , backing_("none")
+    , locked_(false) {
+#if defined(__linux__) && !defined(_QNX_)
+  size_t map_size = (size + kHugePageSize - 1) & ~(kHugePageSize - 1);
+  void *p = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE,
+                 -1, 0);
+  if (p != MAP_FAILED) {
+    backing_ = "hugetlb";
+  } else {
+    // no reserved huge pages, map one huge page more to align the start
+    // so that every huge page of it can be a transparent one
+    char *m = reinterpret_cast<char *>(
+        mmap(NULL, map_size + kHugePageSize, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (m == MAP_FAILED) {
+      inno_log_warning_errno("%s cannot map %" PRI_SIZEU " bytes",
+                             name, uint64_t(map_size));
+      return;
+    }
+    char *aligned = reinterpret_cast<char *>(
+        (uintptr_t(m) + kHugePageSize - 1) & ~(kHugePageSize - 1));
+    if (aligned > m) {
+      munmap(m, aligned - m);
+    }
+    munmap(aligned + map_size, m + kHugePageSize - aligned);
+    p = aligned;
+    if (madvise(p, map_size, MADV_HUGEPAGE) == 0) {
+      backing_ = "thp";
+    }
+    // fault the pages in now
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    for (size_t off = 0; off < map_size; off += page_size) {
+      reinterpret_cast<volatile char *>(p)[off] = 0;
+    }
+  }
+  if (lock) {
+    if (mlock(p, map_size) == 0) {
+      locked_ = true;
+    } else {
+      inno_log_warning_errno("%s cannot lock %" PRI_SIZEU " bytes, "
+                             "check RLIMIT_MEMLOCK",
+                             name, uint64_t(map_size));
+    }
+  }
+  buffer_ = p;
+  map_size_ = map_size;
+  inno_log_info("%s %" PRI_SIZEU " bytes at %p backed by %s%s",
+                name, uint64_t(map_size_), buffer_, backing_,
+                locked_ ? ", locked" : "");
+#else
+  (void)size;
+  (void)lock;
+  inno_log_info("%s no huge pages on this platform", name);
+#endif
+}
+
+HugePageMem::~HugePageMem() {
+#if defined(__linux__) && !defined(_QNX_)
+  if (buffer_) {
+    if (locked_) {
+      munlock(buffer_, map_size_);
+    }
+    munmap(buffer_, map_size_);
+  }
+#endif
+  buffer_ = NULL;
+}
+
+}  // namespace innovusion
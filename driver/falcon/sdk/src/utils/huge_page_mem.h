@@ -0,0 +1,60 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+#ifndef UTILS_HUGE_PAGE_MEM_H_
+#define UTILS_HUGE_PAGE_MEM_H_
+
+#include <stddef.h>
+
+namespace innovusion {
+//=====================================================================
+// HugePageMem
+// One anonymous mapping backed by reserved huge pages (MAP_HUGETLB) or,
+// when none are reserved, by transparent huge pages. The pages are
+// faulted in by the constructor, so the first frames after start do not
+// pay for them, and can be locked with mlock(). It has its own file
+// because the adapter builds it together with the cframe converter.
+//=====================================================================
+enum HugePageMode {
+  HUGE_PAGE_OFF = 0,
+  HUGE_PAGE_ON = 1,
+  HUGE_PAGE_LOCKED = 2,
+};
+
+class HugePageMem {
+ public:
+  static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+ public:
+  HugePageMem(const char *name, size_t size, bool lock);
+  ~HugePageMem();
+  // NULL if nothing could be mapped, use calloc() then
+  void *get() const {
+    return buffer_;
+  }
+  size_t get_size() const {
+    return map_size_;
+  }
+  // hugetlb, thp or none
+  const char *get_backing() const {
+    return backing_;
+  }
+  bool is_locked() const {
+    return locked_;
+  }
+
+ private:
+  void *buffer_;
+  size_t map_size_;
+  const char *backing_;
+  bool locked_;
+};
+
+}  // namespace innovusion
+
+#endif  // UTILS_HUGE_PAGE_MEM_H_
@@ -28,6 +28,7 @@
 
 #include "utils/log.h"
 #include "utils/async_log.h"
+#include "utils/deferred_log.h"
 
 enum InnoLogLevel inno_log_level_g = INNO_LOG_LEVEL_INFO;
 // Nice log level. the fatal and critical do the sync
@@ -168,6 +169,7 @@ InnoLog::InnoLog() {
 
   asynclog_manager_p_ = NULL;
   asynclog_exist_ = false;
+  deferred_log_ = NULL;
 }
 
 InnoLog::~InnoLog() {
@@ -190,6 +192,9 @@ InnoLog::~InnoLog() {
   log_callback_ctx_ = NULL;
 
   pthread_rwlock_destroy(&asynclog_lock_);
+  if (deferred_log_) {
+    delete deferred_log_.exchange(NULL);
+  }
   if (asynclog_manager_p_) {
     delete asynclog_manager_p_;
     asynclog_manager_p_ = NULL;
@@ -216,12 +221,22 @@ void InnoLog::start_async_log_thread_() {
   pthread_rwlock_unlock(&asynclog_lock_);
 
   inno_log_verify_no_print(asynclog_manager_p_);
+
+#ifndef ASYCLOG_UNITEST_ENABLE
+  // the unit test hooks the jobs of asynclog_manager_p_
+  deferred_log_ = new DeferredLog(InnoLog::process_deferred,
+                                  &get_instance());
+#endif
 }
 
 /**
  * @brief :shutdown the async log thread
  */
 void InnoLog::shutdown_async_log_thread_() {
+  if (deferred_log_) {
+    // the rest of its logs are formatted here
+    deferred_log_.load()->shutdown();
+  }
   if (asynclog_manager_p_) {
     pthread_rwlock_wrlock(&asynclog_lock_);
     asynclog_exist_ = false;
@@ -337,6 +352,18 @@ int InnoLog::log_v(enum InnoLogLevel level,
                    const char *file, int line,
                    const char *fmt,
                    va_list valist) {
+  DeferredLog *deferred = deferred_log_.load(std::memory_order_acquire);
+  if (deferred) {
+    // fatal and critical stay synchronous
+    if (level > INNO_LOG_LEVEL_CRITICAL &&
+        deferred->log_v(level, discardable, file, line, fmt, valist)) {
+      return 0;
+    }
+    // the recorded logs go first, also before a fatal log and the abort
+    // after it
+    deferred->flush();
+  }
+
   // define max len
   static const int Kmax_head1_len = 64;
   char tbuffer[32];
@@ -371,10 +398,7 @@ int InnoLog::log_v(enum InnoLogLevel level,
   head1_buff[head1_len] = 0;
 
   // get head2
-  uint32_t tid = 0;
-#if !(defined(_QNX_) ||defined(__MINGW64__) || defined(__APPLE__))
-  tid = syscall(SYS_gettid);
-#endif
+  uint32_t tid = DeferredLog::get_tid();
   static const int kMaxHeaderSize = 100;
   char header2_buff[kMaxHeaderSize];
   int head2_len = snprintf(header2_buff,
@@ -522,6 +546,20 @@ int InnoLog::process(void *in_job, void *ctx,
   return s->process_job_(reinterpret_cast<logContextInfo *>(in_job), prefer);
 }
 
+/**
+ * @brief :  format sink of the deferred log
+ * @param  ctx     :  single inno log instance
+ * @param  info    :  the formatted log
+ */
+void InnoLog::process_deferred(void *ctx, const logContextInfo &info) {
+  InnoLog *s = reinterpret_cast<InnoLog *>(ctx);
+#ifndef ASYCLOG_UNITEST_ENABLE
+  s->log2terminal_(info);
+#endif
+  s->log2file_(info);
+  s->log2Callback_(info);
+}
+
 /**
  * @brief :  process_job_
  * @param  job    : log packet
@@ -557,6 +595,9 @@ void InnoLog::asynclog_info() {
   if (asynclog_manager_p_) {
     asynclog_manager_p_->print_stats();
   }
+  if (deferred_log_) {
+    deferred_log_.load()->print_stats();
+  }
 }
 
 /**
@@ -613,6 +654,10 @@ void InnoLog::set_logs(int out_fd, int error_fd,
  * @brief : set_logs_callback
  */
 void InnoLog::set_logs_callback(InnoLogCallback log_callback, void *ctx) {
+  if (deferred_log_) {
+    // logged before the change go to the old callback
+    deferred_log_.load()->flush();
+  }
   if (asynclog_manager_p_) {
     // make sure there is no un-processed job and pause Q
     asynclog_manager_p_->flush_and_pause();
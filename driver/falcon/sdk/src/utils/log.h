@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <unistd.h>
+#include <atomic>
 #include <string>
 #include "utils/inno_lidar_log.h"
 #include "utils/consumer_producer.h"
@@ -39,6 +40,7 @@ namespace innovusion {
 // define the format of log
 // cross include and earlier declare
 class AsyncLogManager;
+class DeferredLog;
 typedef struct {
   enum InnoLogLevel level;
   char *head1_p;
@@ -164,6 +166,8 @@ class InnoLog {
 
   // add the static process function to the consumer of async log
   static int process(void *job, void *ctx, bool prefer);
+  // sink of the deferred log thread
+  static void process_deferred(void *ctx, const logContextInfo &info);
   // print the status
   void asynclog_info();
   // add the for debug
@@ -204,6 +208,8 @@ class InnoLog {
   pthread_rwlock_t asynclog_lock_;
   bool asynclog_exist_ = false;
   int process_job_(logContextInfo *job, bool prefer);
+  // formats on its own thread, created with the async log
+  std::atomic<DeferredLog *> deferred_log_;
 #ifdef ASYCLOG_UNITEST_ENABLE
   // add this for debug
   process_job process_job_hook_ = NULL;
@@ -154,8 +154,10 @@ MemPool::MemPool(const char *name,
                  unsigned int unit_sz,
                  unsigned int unit_nm,
                  uint64_t alignment,
-                 bool is_sys_malloc):
-                   is_sys_malloc_(is_sys_malloc) {
+                 bool is_sys_malloc,
+                 int huge_page):
+                   is_sys_malloc_(is_sys_malloc),
+                   huge_page_mem_(NULL) {
   inno_log_verify(unit_sz > 0, "%s unit_size = %u",
                   name, unit_sz);
   inno_log_verify(unit_nm > 0, "%s unit_number = %u",
@@ -170,7 +172,20 @@ MemPool::MemPool(const char *name,
   unit_count_ = unit_nm;
   alignment_ = alignment;
 
-  if (is_sys_malloc_ == true) {
+  if (huge_page != HUGE_PAGE_OFF) {
+    // huge page aligned, no extra unit is needed
+    huge_page_mem_ = new HugePageMem(name, uint64_t(unit_size_) * unit_count_,
+                                     huge_page == HUGE_PAGE_LOCKED);
+    inno_log_verify(huge_page_mem_, "%s cannot alloc huge_page_mem", name);
+    if (!huge_page_mem_->get()) {
+      delete huge_page_mem_;
+      huge_page_mem_ = NULL;
+    }
+  }
+  if (huge_page_mem_) {
+    alloc_delegate_ = NULL;
+    pool_ = huge_page_mem_->get();
+  } else if (is_sys_malloc_ == true) {
     /* allocate one extra for alignment adjustment */
     alloc_delegate_ = NULL;
     pool_ = calloc(unit_count_ + 1, unit_size_);
@@ -201,7 +216,10 @@ MemPool::~MemPool() {
   delete manager_;
   manager_ = NULL;
   // free
-  if (is_sys_malloc_ == true) {
+  if (huge_page_mem_) {
+    delete huge_page_mem_;
+    huge_page_mem_ = NULL;
+  } else if (is_sys_malloc_ == true) {
     ::free(pool_);
   } else {
     alloc_delegate_->free(pool_);
@@ -20,6 +20,7 @@
 #include <string>
 
 #include "utils/log.h"
+#include "utils/huge_page_mem.h"
 #include "utils/mem_allocator.h"
 
 namespace innovusion {
@@ -58,11 +59,13 @@ class MemPoolManager {
 
 class MemPool {
  public:
-  // support sys malloc
+  // support sys malloc, huge_page is a HugePageMode, the pool falls back
+  // to the allocator if no huge page backed memory can be mapped
   MemPool(const char *name,
           unsigned int unit_sz,
           unsigned int unit_nm,
-          uint64_t alignment, bool is_sys_malloc = false);
+          uint64_t alignment, bool is_sys_malloc = false,
+          int huge_page = HUGE_PAGE_OFF);
 
   ~MemPool();
   void *alloc();
@@ -89,6 +92,7 @@ class MemPool {
   MemAllocDelegate *alloc_delegate_;
   // support the sys malloc
   bool is_sys_malloc_ = false;
+  HugePageMem *huge_page_mem_;
 };
 
 template <class T>
@@ -16,6 +16,7 @@
 
 #include <sys/types.h>
 
+#include "utils/inno_lidar_log.h"
 #include "utils/log.h"
 
 namespace innovusion {
@@ -43,6 +44,27 @@ class SharedMemory {
 #endif
   }
 
+  // attach by key, create the segment only if create is true
+  SharedMemory(int key, size_t size, bool create) {
+    shm_id_ = -1;
+    shm_addr_ = NULL;
+#ifndef __MINGW64__
+    shm_id_ = shmget(key, size, create ? 0666|IPC_CREAT : 0666);
+    if (shm_id_ == -1) {
+      if (create) {
+        inno_log_error_errno("shmget 0x%x %" PRI_SIZEU, key, size);
+      }
+    } else {
+      void *addr = shmat(shm_id_, NULL, 0);
+      if (addr == reinterpret_cast<void *>(-1)) {
+        inno_log_error_errno("shmat 0x%x", key);
+      } else {
+        shm_addr_ = addr;
+      }
+    }
+#endif
+  }
+
   ~SharedMemory() {
 #ifndef __MINGW64__
     if (shm_addr_) {
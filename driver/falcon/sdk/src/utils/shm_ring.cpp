@@ -0,0 +1,175 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+#include "utils/shm_ring.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "utils/log.h"
+#include "utils/utils.h"
+
+namespace innovusion {
+
+ShmRing::ShmRing(uint16_t port, bool writer)
+    : shm_(NULL)
+    , header_(NULL)
+    , slots_(NULL)
+    , writer_(writer)
+    , next_(0)
+    , generation_(0)
+    , lost_(0) {
+  shm_ = new SharedMemory(get_key(port), get_shm_size(), writer);
+  inno_log_verify(shm_, "shm");
+  if (!shm_->is_valid()) {
+    return;
+  }
+  ShmRingHeader *h = reinterpret_cast<ShmRingHeader *>(
+      const_cast<void *>(shm_->get_memory()));
+  if (writer) {
+    // keep head so that the readers see a continuous sequence
+    __atomic_store_n(&h->magic, 0, __ATOMIC_RELAXED);
+    h->version = kVersion;
+    h->slot_size = kSlotSize;
+    h->slot_number = kSlotNumber;
+    h->generation = InnoUtils::get_time_ns(CLOCK_REALTIME);
+    __atomic_store_n(&h->magic, kMagic, __ATOMIC_RELEASE);
+    inno_log_info("shm ring port=%hu key=0x%x created, head=%" PRI_SIZEU,
+                  port, get_key(port), (size_t)h->head);
+  } else {
+    if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != kMagic ||
+        h->version != kVersion ||
+        h->slot_size != kSlotSize ||
+        h->slot_number != kSlotNumber) {
+      inno_log_warning("shm ring port=%hu is not ready", port);
+      return;
+    }
+    generation_ = h->generation;
+    next_ = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+  }
+  header_ = h;
+  slots_ = reinterpret_cast<char *>(h) + sizeof(ShmRingHeader);
+}
+
+ShmRing::~ShmRing() {
+  if (shm_) {
+    delete shm_;
+    shm_ = NULL;
+  }
+  header_ = NULL;
+  slots_ = NULL;
+}
+
+int ShmRing::publish(const void *buf, size_t size) {
+  inno_log_verify(writer_ && header_, "not a writer");
+  if (size > kSlotSize) {
+    return -1;
+  }
+  std::unique_lock<std::mutex> lk(mutex_);
+  uint64_t n = header_->head;
+  ShmRingSlot *slot = get_slot_(n);
+  // seqlock style: readers copying this slot see seq change
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  slot->size = size;
+  memcpy(slot->data, buf, size);
+  __atomic_store_n(&slot->seq, n + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&header_->head, n + 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&header_->waiters, __ATOMIC_SEQ_CST)) {
+    wake_();
+  }
+  return 0;
+}
+
+ssize_t ShmRing::read(void *buf, size_t buf_size, uint32_t timeout_ms) {
+  inno_log_verify(!writer_ && header_, "not a reader");
+  while (1) {
+    if (header_->generation != generation_) {
+      // writer restarted
+      inno_log_info("shm ring writer restarted");
+      generation_ = header_->generation;
+      next_ = __atomic_load_n(&header_->head, __ATOMIC_ACQUIRE);
+    }
+    uint64_t head = __atomic_load_n(&header_->head, __ATOMIC_ACQUIRE);
+    if (head == next_) {
+      if (!wait_(next_, timeout_ms)) {
+        return 0;
+      }
+      // only wait once, the caller checks its stop condition
+      timeout_ms = 0;
+      continue;
+    }
+    if (head - next_ > kSlotNumber) {
+      lost_ += head - next_ - kSlotNumber;
+      next_ = head - kSlotNumber;
+    }
+    ShmRingSlot *slot = get_slot_(next_);
+    uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq != next_ + 1) {
+      // overwritten by the writer already
+      lost_++;
+      next_++;
+      continue;
+    }
+    size_t size = slot->size;
+    bool too_small = size > buf_size || size > kSlotSize;
+    if (!too_small) {
+      memcpy(buf, slot->data, size);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+      lost_++;
+      next_++;
+      continue;
+    }
+    next_++;
+    return too_small ? -1 : size;
+  }
+}
+
+bool ShmRing::wait_(uint64_t next, uint32_t timeout_ms) {
+  if (timeout_ms == 0) {
+    return false;
+  }
+#ifdef __linux__
+  uint32_t f = __atomic_load_n(&header_->futex, __ATOMIC_SEQ_CST);
+  __atomic_add_fetch(&header_->waiters, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&header_->head, __ATOMIC_SEQ_CST) == next) {
+    struct timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    // not FUTEX_PRIVATE, the word is shared between processes
+    syscall(SYS_futex, &header_->futex, FUTEX_WAIT, f, &ts, NULL, 0);
+  }
+  __atomic_sub_fetch(&header_->waiters, 1, __ATOMIC_SEQ_CST);
+#else
+  uint64_t waited_us = 0;
+  while (__atomic_load_n(&header_->head, __ATOMIC_ACQUIRE) == next &&
+         waited_us < timeout_ms * 1000ULL) {
+    usleep(200);
+    waited_us += 200;
+  }
+#endif
+  return __atomic_load_n(&header_->head, __ATOMIC_ACQUIRE) != next;
+}
+
+void ShmRing::wake_() {
+#ifdef __linux__
+  __atomic_add_fetch(&header_->futex, 1, __ATOMIC_SEQ_CST);
+  syscall(SYS_futex, &header_->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+}  // namespace innovusion
@@ -0,0 +1,127 @@
+/**
+ *  Copyright (C) 2021 - Innovusion Inc.
+ *
+ *  All Rights Reserved.
+ *
+ *  $Id$
+ */
+
+#ifndef UTILS_SHM_RING_H_
+#define UTILS_SHM_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <mutex>  // NOLINT
+
+#include "utils/shared_memory.h"
+
+/************
+ Single writer, multiple readers broadcast ring in SysV shared memory.
+
+ The writer never waits for the readers. Every message gets a sequence
+ number, a reader that falls behind by more than kSlotNumber messages,
+ or whose slot is overwritten while it is copying, skips the lost
+ messages and counts them in get_lost().
+
+ Readers sleep on a futex in the shared header when the ring is empty,
+ the writer only makes the wake syscall when there is a waiter.
+*************/
+
+namespace innovusion {
+
+struct ShmRingHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t slot_size;
+  uint32_t slot_number;
+  uint64_t generation;       /* changes every time a writer attaches  */
+  alignas(64) uint64_t head;  /* number of messages published          */
+  alignas(64) uint32_t futex;
+  uint32_t waiters;
+};
+
+struct ShmRingSlot {
+  // n + 1 when message n is complete, 0 while it is being written
+  uint64_t seq;
+  uint32_t size;
+  uint32_t reserved;
+  char data[0];
+};
+
+class ShmRing {
+ public:
+  static const uint32_t kMagic = 0x474e5249;  // "IRNG"
+  static const uint16_t kVersion = 1;
+  static const uint32_t kSlotSize = 65536;
+  static const uint32_t kSlotNumber = 256;
+  static const int kKeyBase = 0x494e0000;
+
+  static inline int get_key(uint16_t port) {
+    return kKeyBase + port;
+  }
+  static inline size_t get_shm_size() {
+    return sizeof(ShmRingHeader) +
+        static_cast<size_t>(kSlotNumber) * get_slot_stride_();
+  }
+
+ public:
+  /*
+   * @brief Attach to the ring of port. The writer creates the
+   *        segment, a reader fails (is_valid() is false) if no writer
+   *        has created it yet.
+   */
+  ShmRing(uint16_t port, bool writer);
+  ~ShmRing();
+
+  bool is_valid() const {
+    return header_ != NULL;
+  }
+
+  /*
+   * @brief Publish one message, thread safe
+   * @return 0 if success, -1 if size is larger than kSlotSize
+   */
+  int publish(const void *buf, size_t size);
+
+  /*
+   * @brief Copy the next message into buf
+   * @param timeout_ms Max time to wait if the ring is empty
+   * @return size of the message, 0 if timeout,
+   *         -1 if buf_size is too small (the message is skipped)
+   */
+  ssize_t read(void *buf, size_t buf_size, uint32_t timeout_ms);
+
+  uint64_t get_lost() const {
+    return lost_;
+  }
+
+ private:
+  static inline size_t get_slot_stride_() {
+    return sizeof(ShmRingSlot) + kSlotSize;
+  }
+  inline ShmRingSlot *get_slot_(uint64_t n) const {
+    return reinterpret_cast<ShmRingSlot *>(
+        slots_ + (n % kSlotNumber) * get_slot_stride_());
+  }
+  bool wait_(uint64_t next, uint32_t timeout_ms);
+  void wake_();
+
+ private:
+  SharedMemory *shm_;
+  ShmRingHeader *header_;
+  char *slots_;
+  bool writer_;
+  std::mutex mutex_;
+
+  // reader only
+  uint64_t next_;
+  uint64_t generation_;
+  uint64_t lost_;
+};
+
+}  // namespace innovusion
+
+#endif  // UTILS_SHM_RING_H_
@@ -27,6 +27,13 @@
 #endif
 #endif
 
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
 #ifdef _QNX_
 #define SCHED_IDLE 5
 #endif
@@ -118,6 +125,13 @@ __inline static uint32_t __attribute__((__gnu_inline__,
 _mm_crc32_u32(uint32_t __C, uint32_t __V) {
   return __builtin_ia32_crc32si(__C, __V);
 }
+
+__inline static uint64_t __attribute__((__gnu_inline__,
+                                        __always_inline__,
+                                        __artificial__))
+_mm_crc32_u64(uint64_t __C, uint64_t __V) {
+  return __builtin_ia32_crc32di(__C, __V);
+}
 #endif
 
 #ifdef _QNX_
@@ -190,150 +204,319 @@ uint32_t InnoUtils::crc32_do(uint32_t crc, const void *const buf,
 
   return crc;
 }
+
+bool InnoUtils::crc32_impl_supported(Crc32Impl impl) {
+  return impl == CRC32_IMPL_AUTO || impl == CRC32_IMPL_TABLE;
+}
+
+const char *InnoUtils::crc32_impl_name(Crc32Impl impl) {
+  return impl == CRC32_IMPL_TABLE ? "table" : "auto";
+}
+
+uint32_t InnoUtils::crc32_do_impl(Crc32Impl impl, uint32_t crc,
+                                  const void *buf, size_t len) {
+  return crc32_do(crc, buf, len);
+}
 #else
-uint32_t InnoUtils::crc32_do(uint32_t crc, const void *const buf,
-                             const size_t buf_len) {
-  const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
-#if !(defined(__APPLE__))
-  register uint32_t l = crc;
+/*
+ * CRC32C (Castagnoli), same as the SSE4.2 crc32 and the ARMv8 crc32c
+ * instructions. The implementation is picked once at run time:
+ *   x86_64 + pclmul: 3 interleaved crc32q streams folded with pclmul
+ *   x86 sse4.2:      crc32q (crc32l on i386)
+ *   aarch64 crc:     crc32cx
+ *   otherwise:       slicing-by-8 table
+ */
+#if (defined(__i386__) || defined(__x86_64__)) && !defined(__APPLE__)
+#define INNO_CRC32_X86
+#if defined(__x86_64__)
+#define INNO_CRC32_X86_FOLD
+#endif
+#define INNO_CRC32_TARGET(x) __attribute__((target(x)))
 #else
-  uint32_t l = crc;
+#define INNO_CRC32_TARGET(x)
 #endif
 
-#if (defined(__i386__) || defined(__x86_64__)) && (!defined(__MINGW64__dd)) \
-  && (!defined(__APPLE__))
-  for (size_t i = 0; i < (buf_len / sizeof(uint32_t)); ++i) {
-    l = _mm_crc32_u32(l, *(const uint32_t *)p);
-    p += sizeof(uint32_t);
+typedef uint32_t (*InnoCrc32Func)(uint32_t crc, const uint8_t *p,
+                                  size_t len);
+
+static const uint32_t kCrc32cPoly = 0x82f63b78;
+static uint32_t crc32c_table_[8][256];
+
+static void crc32c_init_table_() {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) {
+      c = c & 1 ? (c >> 1) ^ kCrc32cPoly : c >> 1;
+    }
+    crc32c_table_[0][i] = c;
   }
-if (buf_len & sizeof(uint16_t)) {
-    l = _mm_crc32_u16(l, *(const uint16_t *)p);
-    p += sizeof(uint16_t);
+  for (uint32_t i = 0; i < 256; i++) {
+    for (int t = 1; t < 8; t++) {
+      uint32_t c = crc32c_table_[t - 1][i];
+      crc32c_table_[t][i] = (c >> 8) ^ crc32c_table_[0][c & 0xff];
+    }
   }
-  if (buf_len & sizeof(uint8_t)) {
-    l = _mm_crc32_u8(l, *(const uint8_t *)p);
+}
+
+static uint32_t crc32c_table_do_(uint32_t crc, const uint8_t *p,
+                                 size_t len) {
+  while (len && (reinterpret_cast<uintptr_t>(p) & 7)) {
+    crc = crc32c_table_[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    len--;
+  }
+  // all supported targets are little endian
+  while (len >= 8) {
+    uint64_t v = *reinterpret_cast<const uint64_t *>(p) ^ crc;
+    crc = crc32c_table_[7][v & 0xff] ^
+          crc32c_table_[6][(v >> 8) & 0xff] ^
+          crc32c_table_[5][(v >> 16) & 0xff] ^
+          crc32c_table_[4][(v >> 24) & 0xff] ^
+          crc32c_table_[3][(v >> 32) & 0xff] ^
+          crc32c_table_[2][(v >> 40) & 0xff] ^
+          crc32c_table_[1][(v >> 48) & 0xff] ^
+          crc32c_table_[0][v >> 56];
+    p += 8;
+    len -= 8;
+  }
+  while (len--) {
+    crc = crc32c_table_[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
   }
-#else
+  return crc;
+}
 
-#if defined(__aarch64__)
-  // from https://www.programmersought.com/article/13506713080/
-#define CRC32X(crc, value) __asm__("crc32x %w[c], %w[c], %x[v]":[c]"+r"(crc):[v]"r"(value))  // NOLINT
-#define CRC32W(crc, value) __asm__("crc32w %w[c], %w[c], %w[v]":[c]"+r"(crc):[v]"r"(value))  // NOLINT
-#define CRC32H(crc, value) __asm__("crc32h %w[c], %w[c], %w[v]":[c]"+r"(crc):[v]"r"(value))  // NOLINT
-#define CRC32B(crc, value) __asm__("crc32b %w[c], %w[c], %w[v]":[c]"+r"(crc):[v]"r"(value))  // NOLINT
+#if defined(INNO_CRC32_X86)
+INNO_CRC32_TARGET("sse4.2")
+static uint32_t crc32c_hw_do_(uint32_t crc, const uint8_t *p,
+                              size_t len) {
+  while (len && (reinterpret_cast<uintptr_t>(p) & 7)) {
+    crc = _mm_crc32_u8(crc, *p++);
+    len--;
+  }
+#if defined(__x86_64__)
+  uint64_t l = crc;
+  while (len >= 8) {
+    l = _mm_crc32_u64(l, *reinterpret_cast<const uint64_t *>(p));
+    p += 8;
+    len -= 8;
+  }
+  crc = l;
+#endif
+  while (len >= 4) {
+    crc = _mm_crc32_u32(crc, *reinterpret_cast<const uint32_t *>(p));
+    p += 4;
+    len -= 4;
+  }
+  while (len--) {
+    crc = _mm_crc32_u8(crc, *p++);
+  }
+  return crc;
+}
+#elif defined(__aarch64__)
+// from https://www.programmersought.com/article/13506713080/
 #define CRC32CX(crc, value) __asm__("crc32cx %w[c], %w[c], %x[v]":[c]"+r"(crc):[v]"r"(value))  // NOLINT
 #define CRC32CW(crc, value) __asm__("crc32cw %w[c], %w[c], %w[v]":[c]"+r"(crc):[v]"r"(value))  // NOLINT
 #define CRC32CH(crc, value) __asm__("crc32ch %w[c], %w[c], %w[v]":[c]"+r"(crc):[v]"r"(value))  // NOLINT
 #define CRC32CB(crc, value) __asm__("crc32cb %w[c], %w[c], %w[v]":[c]"+r"(crc):[v]"r"(value))  // NOLINT
-  // Use local variables, use register optimization
-#if !(defined(__APPLE__))
-  register size_t len = buf_len;
-#else
-  size_t len = buf_len;
+static uint32_t crc32c_hw_do_(uint32_t crc, const uint8_t *p,
+                              size_t len) {
+  uint32_t l = crc;
+  while (len && (reinterpret_cast<uintptr_t>(p) & 7)) {
+    CRC32CB(l, *p++);
+    len--;
+  }
+  // 64 bytes per loop, the crc unit is pipelined
+  while (len >= 64) {
+    const uint64_t *q = reinterpret_cast<const uint64_t *>(p);
+    CRC32CX(l, q[0]); CRC32CX(l, q[1]); CRC32CX(l, q[2]); CRC32CX(l, q[3]);
+    CRC32CX(l, q[4]); CRC32CX(l, q[5]); CRC32CX(l, q[6]); CRC32CX(l, q[7]);
+    p += 64;
+    len -= 64;
+  }
+  while (len >= 8) {
+    CRC32CX(l, *reinterpret_cast<const uint64_t *>(p));
+    p += 8;
+    len -= 8;
+  }
+  if (len >= 4) {
+    CRC32CW(l, *reinterpret_cast<const uint32_t *>(p));
+    p += 4;
+    len -= 4;
+  }
+  if (len >= 2) {
+    CRC32CH(l, *reinterpret_cast<const uint16_t *>(p));
+    p += 2;
+    len -= 2;
+  }
+  if (len >= 1) {
+    CRC32CB(l, *p);
+  }
+  return l;
+}
 #endif
-#define STEP1 do {                                              \
-    CRC32CB(l, *p++);                                           \
-    len--;                                                      \
-} while (0)
-
-#define STEP2 do {                                              \
-    CRC32CH(l, *(uint16_t *)p);                                 \
-    p += 2;                                                     \
-    len -= 2;                                                   \
-} while (0)
-
-#define STEP4 do {                                              \
-    CRC32CW(l, *(uint32_t *)p);                                 \
-    p += 4;                                                     \
-    len -= 4;                                                   \
-} while (0)
-
-#define STEP8 do {                                              \
-    CRC32CX(l, *(uint64_t *)p);                                 \
-    p += 8;                                                     \
-    len -= 8;                                                   \
-} while (0)
-
-  // 512 way loop inline expansion
-  while (len >= 512) {
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-  }
-  // Use if to judge directly, the effect will be higher
-  if (len >= 256) {
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-  }
-
-  if (len >= 128) {
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-  }
-
-  if (len >= 64) {
-    STEP8; STEP8; STEP8; STEP8;
-    STEP8; STEP8; STEP8; STEP8;
-  }
-
-  if (len >= 32) {
-    STEP8; STEP8; STEP8; STEP8;
-  }
-
-  if (len >= 16) {
-    STEP8; STEP8;
-  }
-
-  if (len >= 8) {
-    STEP8;
+
+#if defined(INNO_CRC32_X86_FOLD)
+// a * b mod P, in the reflected bit order of the crc register
+static uint32_t crc32c_multmodp_(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31;
+  uint32_t p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) {
+        break;
+      }
+    }
+    m >>= 1;
+    b = b & 1 ? (b >> 1) ^ kCrc32cPoly : b >> 1;
   }
+  return p;
+}
 
-  if (len >= 4) {
-    STEP4;
+// x^n mod P
+static uint32_t crc32c_xnmodp_(uint64_t n) {
+  uint32_t p = 1u << 31;    // x^0
+  uint32_t x2k = 1u << 30;  // x^1
+  while (n) {
+    if (n & 1) {
+      p = crc32c_multmodp_(x2k, p);
+    }
+    x2k = crc32c_multmodp_(x2k, x2k);
+    n >>= 1;
   }
+  return p;
+}
 
-  if (len >= 2) {
-    STEP2;
+/*
+ * The buffer is cut into 3 streams of n bytes which are computed in
+ * parallel (crc32q has 3 cycles latency but 1 cycle throughput), then
+ * crc = a * x^(16n) ^ b * x^(8n) ^ c.  The multiplications are done with
+ * pclmul and reduced with one more crc32q, which adds x^33 to the
+ * product, so the constants are x^(8n * k - 33) mod P.
+ */
+static const size_t kCrc32FoldStreamSize[] = {1024, 256, 64};
+static const size_t kCrc32FoldTiers =
+    sizeof(kCrc32FoldStreamSize) / sizeof(kCrc32FoldStreamSize[0]);
+static uint64_t crc32c_fold_k_[kCrc32FoldTiers][2];
+
+static void crc32c_init_fold_() {
+  for (size_t i = 0; i < kCrc32FoldTiers; i++) {
+    uint64_t bits = kCrc32FoldStreamSize[i] * 8;
+    crc32c_fold_k_[i][0] = crc32c_xnmodp_(bits - 33);
+    crc32c_fold_k_[i][1] = crc32c_xnmodp_(bits * 2 - 33);
   }
+}
 
-  if (len >= 1) {
-    STEP1;
+INNO_CRC32_TARGET("sse4.2,pclmul")
+static uint32_t crc32c_fold_do_(uint32_t crc, const uint8_t *p,
+                                size_t len) {
+  while (len && (reinterpret_cast<uintptr_t>(p) & 7)) {
+    crc = _mm_crc32_u8(crc, *p++);
+    len--;
+  }
+  for (size_t t = 0; t < kCrc32FoldTiers; t++) {
+    size_t n = kCrc32FoldStreamSize[t];
+    __m128i k = _mm_set_epi64x(crc32c_fold_k_[t][1], crc32c_fold_k_[t][0]);
+    while (len >= 3 * n) {
+      const uint64_t *q0 = reinterpret_cast<const uint64_t *>(p);
+      const uint64_t *q1 = reinterpret_cast<const uint64_t *>(p + n);
+      const uint64_t *q2 = reinterpret_cast<const uint64_t *>(p + 2 * n);
+      uint64_t a = crc;
+      uint64_t b = 0;
+      uint64_t c = 0;
+      for (size_t i = 0; i < n / 8; i++) {
+        a = _mm_crc32_u64(a, q0[i]);
+        b = _mm_crc32_u64(b, q1[i]);
+        c = _mm_crc32_u64(c, q2[i]);
+      }
+      __m128i v = _mm_set_epi64x(a, b);
+      __m128i m = _mm_xor_si128(_mm_clmulepi64_si128(v, k, 0x00),
+                                _mm_clmulepi64_si128(v, k, 0x11));
+      crc = _mm_crc32_u64(0, _mm_cvtsi128_si64(m)) ^ c;
+      p += 3 * n;
+      len -= 3 * n;
+    }
   }
-#undef STEP8
-#undef STEP4
-#undef STEP2
-#undef STEP1
+  return crc32c_hw_do_(crc, p, len);
+}
+#endif
 
+static InnoCrc32Func crc32_get_func_(InnoUtils::Crc32Impl impl) {
+  switch (impl) {
+    case InnoUtils::CRC32_IMPL_TABLE:
+      return crc32c_table_do_;
+#if defined(INNO_CRC32_X86)
+    case InnoUtils::CRC32_IMPL_HW:
+      return __builtin_cpu_supports("sse4.2") ? crc32c_hw_do_ : NULL;
+#if defined(INNO_CRC32_X86_FOLD)
+    case InnoUtils::CRC32_IMPL_HW_FOLD:
+      return __builtin_cpu_supports("sse4.2") &&
+          __builtin_cpu_supports("pclmul") ? crc32c_fold_do_ : NULL;
+#endif
+#elif defined(__aarch64__)
+    case InnoUtils::CRC32_IMPL_HW:
+#if defined(__linux__)
+      return getauxval(AT_HWCAP) & HWCAP_CRC32 ? crc32c_hw_do_ : NULL;
 #else
-//  for (size_t i = 0; i < buf_len; ++i) {
-//    l = (l << 5) + l + p[i];
-//  }
-#error "unsupported ARCH"
+      return crc32c_hw_do_;
+#endif
+#endif
+    default:
+      return NULL;
+  }
+}
 
-#endif  // ARM
+// resolved once, the first call also builds the tables
+static InnoCrc32Func crc32_auto_func_() {
+  static const InnoCrc32Func func = [] {
+#if defined(INNO_CRC32_X86)
+    __builtin_cpu_init();
 #endif
-  return l;
+    crc32c_init_table_();
+#if defined(INNO_CRC32_X86_FOLD)
+    crc32c_init_fold_();
+#endif
+    static const InnoUtils::Crc32Impl prefer[] = {
+      InnoUtils::CRC32_IMPL_HW_FOLD,
+      InnoUtils::CRC32_IMPL_HW,
+      InnoUtils::CRC32_IMPL_TABLE,
+    };
+    for (size_t i = 0; i < sizeof(prefer) / sizeof(prefer[0]); i++) {
+      InnoCrc32Func f = crc32_get_func_(prefer[i]);
+      if (f) {
+        inno_log_info("crc32 uses %s",
+                      InnoUtils::crc32_impl_name(prefer[i]));
+        return f;
+      }
+    }
+    return crc32c_table_do_;
+  }();
+  return func;
+}
+
+uint32_t InnoUtils::crc32_do(uint32_t crc, const void *const buf,
+                             const size_t buf_len) {
+  return crc32_auto_func_()(crc, reinterpret_cast<const uint8_t *>(buf),
+                            buf_len);
+}
+
+bool InnoUtils::crc32_impl_supported(Crc32Impl impl) {
+  crc32_auto_func_();
+  return impl == CRC32_IMPL_AUTO || crc32_get_func_(impl) != NULL;
+}
+
+const char *InnoUtils::crc32_impl_name(Crc32Impl impl) {
+  static const char *names[] = {"auto", "table", "hw", "hw_fold"};
+  return impl < CRC32_IMPL_MAX ? names[impl] : "invalid";
+}
+
+uint32_t InnoUtils::crc32_do_impl(Crc32Impl impl, uint32_t crc,
+                                  const void *buf, size_t len) {
+  InnoCrc32Func f = crc32_auto_func_();
+  if (impl != CRC32_IMPL_AUTO) {
+    f = crc32_get_func_(impl);
+    inno_log_verify(f, "crc32 %s is not supported", crc32_impl_name(impl));
+  }
+  return f(crc, reinterpret_cast<const uint8_t *>(buf), len);
 }
 #endif
 
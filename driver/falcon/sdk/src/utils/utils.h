@@ -173,6 +173,20 @@ class InnoUtils {
   static uint32_t crc32_do(uint32_t crc, const void* buf,
                            const size_t len);
 
+  // crc32_do picks the fastest implementation the cpu supports,
+  // the others are exposed for benchmark and test
+  enum Crc32Impl {
+    CRC32_IMPL_AUTO = 0,
+    CRC32_IMPL_TABLE,
+    CRC32_IMPL_HW,
+    CRC32_IMPL_HW_FOLD,
+    CRC32_IMPL_MAX,
+  };
+  static bool crc32_impl_supported(Crc32Impl impl);
+  static const char *crc32_impl_name(Crc32Impl impl);
+  static uint32_t crc32_do_impl(Crc32Impl impl, uint32_t crc,
+                                const void *buf, size_t len);
+
   static uint32_t calculate_http_crc32(const char* buffer,
                                        uint32_t length,
                                        bool append = false);
@@ -18,6 +18,7 @@
 #include <memory>
 #include <mutex>   // NOLINT
 #include <string>
+#include <vector>
 
 #include "utils/utils.h"
 #include "utils/inno_lidar_log.h"
@@ -26,7 +27,10 @@ namespace innovusion {
 
 ServerWs::ServerWs(uint16_t port)
     : server_(new WsServer(this))
-    , server_thread_(NULL) {
+    , server_thread_(NULL)
+    , send_queue_limit_(kDefaultSendQueueLimit)
+    , send_drop_policy_(WsConnection::SEND_DROP_OLDEST)
+    , frame_id_(0) {
   setup_server_(port);
   total_bytes_ = 0;
   total_called_ = 0;
@@ -223,29 +227,32 @@ int ServerWs::write_ws_socket_preamble_s(std::shared_ptr<WsConnection> conn) {
   return ret;
 }
 
+void ServerWs::get_stream_connections_(
+    bool is_sp, std::vector<std::shared_ptr<WsConnection>> *conns) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  for (auto conn : stream_connections_) {
+    if (conn->is_sp_conn() == is_sp) {
+      conns->push_back(conn);
+    }
+  }
+}
+
 int ServerWs::write_socket_var_struct(
     const void *var_struct,
-    size_t total_size) {
-  int total = 0;
-  {
-    std::unique_lock<std::mutex> lk(mutex_);
-    for (auto conn : stream_connections_) {
-      if (conn->is_sp_conn()) {
-        int ret = write_buffer_to_ws_socket_full_s(
-            conn,
-            (const char*)var_struct,
-            total_size);
-        if (ret >= 0) {
-          total += ret;
-          conn->flush_buffer();
-        }
-      }
-    }
+    size_t total_size,
+    uint64_t frame_id) {
+  std::vector<std::shared_ptr<WsConnection>> conns;
+  get_stream_connections_(true, &conns);
+  if (conns.empty()) {
+    return 0;
   }
-  if (total > 0) {
-    // have to do it without lock
-    bw_stats_(total);
+  // one copy for all connections, each one only queues a reference
+  std::shared_ptr<WsSendStream> stream = std::make_shared<WsSendStream>();
+  stream->write(reinterpret_cast<const char *>(var_struct), total_size);
+  for (auto conn : conns) {
+    conn->send_shared(stream, frame_id);
   }
+  bw_stats_(total_size * conns.size());
   return 0;
 }
 
@@ -253,30 +260,73 @@ int ServerWs::write_ws_socket_var_struct(
     uint32_t context,
     const void *var_struct,
     size_t struct_size,
-    size_t additional_size) {
-  int total = 0;
-  {
-    std::unique_lock<std::mutex> lk(mutex_);
-    for (auto conn : stream_connections_) {
-      if (!conn->is_sp_conn()) {
-        int ret = write_ws_socket_var_struct_s(conn,
-                                               context,
-                                               var_struct,
-                                               struct_size,
-                                               additional_size);
-        if (ret >= 0) {
-          total += ret;
-        }
-      }
-    }
+    size_t additional_size,
+    uint64_t frame_id) {
+  if (var_struct == NULL) {
+    return 0;
   }
-  if (total > 0) {
-    // have to do it without lock
-    bw_stats_(total);
+  std::vector<std::shared_ptr<WsConnection>> conns;
+  get_stream_connections_(false, &conns);
+  if (conns.empty()) {
+    return 0;
   }
+  if (frame_id == 0) {
+    // every message is a frame
+    frame_id = ++frame_id_;
+  }
+  // same layout as write_ws_socket_var_struct_s()
+  std::shared_ptr<WsSendStream> stream = std::make_shared<WsSendStream>();
+  int h = htonl(context);
+  const char *items[3] = {
+    reinterpret_cast<const char *>(&h),
+    reinterpret_cast<const char *>(var_struct),
+    reinterpret_cast<const char *>(var_struct) + struct_size,
+  };
+  size_t sizes[3] = {sizeof(h), struct_size, additional_size};
+  for (int i = 0; i < 3; i++) {
+    uint32_t len = htonl(sizes[i]);
+    stream->write(reinterpret_cast<const char *>(&len), sizeof(len));
+    stream->write(items[i], sizes[i]);
+  }
+  for (auto conn : conns) {
+    conn->send_shared(stream, frame_id);
+  }
+  bw_stats_(stream->size() * conns.size());
   return 0;
 }
 
+void ServerWs::set_default_send_queue(int64_t limit, int policy) {
+  std::unique_lock<std::mutex> lk(mutex_);
+  send_queue_limit_ = limit;
+  send_drop_policy_ = policy;
+}
+
+std::string ServerWs::get_send_stats() {
+  static const char *kPolicyName[] = {"none", "oldest", "frame"};
+  std::string ret;
+  std::unique_lock<std::mutex> lk(mutex_);
+  for (auto conn : stream_connections_) {
+    WsConnection::SendStats st = conn->get_send_stats();
+    int policy = conn->get_send_drop_policy();
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "%s %s:%hu limit=%" PRI_SIZED " drop=%s sent=%" PRI_SIZELU
+             " dropped=%" PRI_SIZELU " queued=%" PRI_SIZELU
+             " queued_bytes=%" PRI_SIZELU " lag_us=%" PRI_SIZELU
+             " max_lag_us=%" PRI_SIZELU "\n",
+             conn->is_sp_conn() ? "stream" : "ws",
+             conn->remote_endpoint_address().c_str(),
+             conn->remote_endpoint_port(),
+             static_cast<ssize_t>(conn->get_send_queue_limit()),
+             policy >= 0 && policy <= WsConnection::SEND_DROP_FRAME ?
+             kPolicyName[policy] : "?",
+             st.sent, st.dropped, st.queued, st.queued_bytes,
+             st.lag_us, st.max_lag_us);
+    ret += buf;
+  }
+  return ret;
+}
+
 bool ServerWs::has_ws_socket() {
   std::unique_lock<std::mutex> lk(mutex_);
   for (auto conn : stream_connections_) {
@@ -301,6 +351,9 @@ void ServerWs::add_endpoint(const char *path,
 
 void ServerWs::add_stream_connection(std::shared_ptr<WsConnection> conn) {
   std::unique_lock<std::mutex> lk(mutex_);
+  if (conn->get_send_queue_limit() < 0) {
+    conn->set_send_queue(send_queue_limit_, send_drop_policy_);
+  }
   stream_connections_.push_back(conn);
 }
 
@@ -17,11 +17,13 @@
 #include <memory>
 #include <mutex>   // NOLINT
 #include <string>
+#include <vector>
 
 #include "ws_utils/server_ws/server_ws.hpp"
 
 using WsServer = SimpleWeb::SocketServer<SimpleWeb::WS>;
 using WsConnection = WsServer::Connection;
+using WsSendStream = WsServer::SendStream;
 
 namespace innovusion {
 
@@ -29,6 +31,10 @@ typedef void (*PcServerCallback)(void *ctx,
                                  void *conn);
 
 class ServerWs {
+ public:
+  // max messages queued per stream connection, the slow ones drop
+  static const int64_t kDefaultSendQueueLimit = 256;
+
  public:
   explicit ServerWs(uint16_t port);
   ~ServerWs();
@@ -68,17 +74,32 @@ class ServerWs {
   void on_conn_open_(std::shared_ptr<WsConnection> conn,
                      const std::string &path);
   void bw_stats_(int total);
+  void get_stream_connections_(
+      bool is_sp, std::vector<std::shared_ptr<WsConnection>> *conns);
 
  public:
+  // the message is copied once and shared by all connections,
+  // frame_id groups the messages of one frame for SEND_DROP_FRAME
   int write_socket_var_struct(
       const void *var_struct,
-      size_t total_size);
+      size_t total_size,
+      uint64_t frame_id = 0);
 
   int write_ws_socket_var_struct(
       uint32_t context,
       const void *var_struct,
       size_t struct_size,
-      size_t additional_size);
+      size_t additional_size,
+      uint64_t frame_id = 0);
+
+  /*
+   * @brief Send queue of the stream connections that do not set
+   *        their own with WsConnection::set_send_queue()
+   */
+  void set_default_send_queue(int64_t limit, int policy);
+
+  // one line per stream connection: queue, lag and drops
+  std::string get_send_stats();
 
   bool has_ws_socket();
 
@@ -98,6 +119,9 @@ class ServerWs {
   std::map<std::string, PcServerCallback> callback_;
   std::map<std::string, void *> callback_ctx_;
   std::mutex mutex_;
+  int64_t send_queue_limit_;
+  int send_drop_policy_;
+  uint64_t frame_id_;
 
   uint64_t total_called_;
   uint64_t total_bytes_;
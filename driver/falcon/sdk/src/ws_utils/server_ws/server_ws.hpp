@@ -27,6 +27,7 @@
 
 #include <array>
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <iostream>
 #include <limits>
 #include <list>
@@ -223,7 +224,16 @@ class SocketServerBase {
         , timeout_idle_(timeout_idle)
         , strand_(GET_IO_SERVICE(socket_))
         , closed_(false)
-        , is_sp_(false) {
+        , is_sp_(false)
+        , send_queue_limit_(-1)
+        , send_drop_policy_(SEND_DROP_OLDEST)
+        , send_drop_frame_id_(0)
+        , send_sent_(0)
+        , send_dropped_(0)
+        , send_queued_(0)
+        , send_queued_bytes_(0)
+        , send_lag_us_(0)
+        , send_max_lag_us_(0) {
       write_buffer_stream_ = std::make_shared<SendStream>();
       bad_ = false;
       timer_set_flag_ = false;
@@ -386,18 +396,95 @@ class SocketServerBase {
      public:
       SendData(std::shared_ptr<SendStream> header_stream,
                std::shared_ptr<SendStream> message_stream,
-               std::function<void(const error_code)> &&callback) noexcept
+               std::function<void(const error_code)> &&callback,
+               bool droppable = false,
+               uint64_t frame_id = 0) noexcept
           : header_stream(std::move(header_stream))
           , message_stream(std::move(message_stream))
-          , callback(std::move(callback)) {
+          , callback(std::move(callback))
+          , droppable(droppable)
+          , frame_id(frame_id)
+          , enqueue_time(std::chrono::steady_clock::now()) {
       }
       std::shared_ptr<SendStream> header_stream;
+      // may be shared by all connections, it is never consumed
       std::shared_ptr<SendStream> message_stream;
       std::function<void(const error_code)> callback;
+      bool droppable;
+      uint64_t frame_id;  // 0 means not part of a frame
+      std::chrono::steady_clock::time_point enqueue_time;
     };  // SendData
 
     std::list<SendData> send_queue_;
 
+    // only called in strand_
+    void remove_queued_(typename std::list<SendData>::iterator it) {
+      send_queued_--;
+      send_queued_bytes_ -= it->message_stream->size();
+      send_dropped_++;
+      send_queue_.erase(it);
+    }
+
+    // only called in strand_, the head of send_queue_ is being written
+    // and is never dropped
+    void enqueue_bounded_(SendData &&data) {
+      if (data.frame_id && data.frame_id == send_drop_frame_id_) {
+        // the rest of a frame that is partly dropped already
+        send_dropped_++;
+        return;
+      }
+      int64_t limit = send_queue_limit_.load(std::memory_order_relaxed);
+      int policy = send_drop_policy_.load(std::memory_order_relaxed);
+      if (limit > 0 && send_queue_.size() > static_cast<size_t>(limit)) {
+        auto victim = send_queue_.begin();
+        for (++victim; victim != send_queue_.end(); ++victim) {
+          if (victim->droppable) {
+            break;
+          }
+        }
+        if (victim != send_queue_.end()) {
+          uint64_t frame_id = victim->frame_id;
+          if (policy == SEND_DROP_FRAME && frame_id) {
+            // drop every queued piece of the oldest frame
+            send_drop_frame_id_ = frame_id;
+            auto it = send_queue_.begin();
+            for (++it; it != send_queue_.end();) {
+              auto cur = it++;
+              if (cur->droppable && cur->frame_id == frame_id) {
+                remove_queued_(cur);
+              }
+            }
+            if (data.frame_id == frame_id) {
+              send_dropped_++;
+              return;
+            }
+          } else if (policy != SEND_DROP_NONE) {
+            remove_queued_(victim);
+          }
+        }
+      }
+      send_queued_++;
+      send_queued_bytes_ += data.message_stream->size();
+      send_queue_.emplace_back(std::move(data));
+      if (send_queue_.size() == 1) {
+        send_from_queue_();
+      }
+    }
+
+    // only called in strand_, the head has been written
+    void on_sent_(const SendData &data) {
+      uint64_t lag_us =
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - data.enqueue_time).count();
+      send_lag_us_ = lag_us;
+      if (lag_us > send_max_lag_us_) {
+        send_max_lag_us_ = lag_us;
+      }
+      send_sent_++;
+      send_queued_--;
+      send_queued_bytes_ -= data.message_stream->size();
+    }
+
     void send_from_queue_() {
       auto self = this->shared_from_this();
       strand_.post(
@@ -434,12 +521,15 @@ class SocketServerBase {
                                     send_queued->callback(ec);
                                   }
                                   if (!ec) {
+                                    self->on_sent_(*send_queued);
                                     self->send_queue_.erase(send_queued);
                                     if (self->send_queue_.size() > 0) {
                                       self->send_from_queue_();
                                     }
                                   } else {
                                     self->send_queue_.clear();
+                                    self->send_queued_ = 0;
+                                    self->send_queued_bytes_ = 0;
                                   }
                                   self->cancel_send_timeout_();
                                 }));
@@ -449,6 +539,8 @@ class SocketServerBase {
                           send_queued->callback(ec);
                         }
                         self->send_queue_.clear();
+                        self->send_queued_ = 0;
+                        self->send_queued_bytes_ = 0;
                       }
                     }));
           });
@@ -457,6 +549,18 @@ class SocketServerBase {
     std::atomic<bool> closed_;
     bool is_sp_;  // true means not real websocket
 
+    // bounded send queue, see set_send_queue(), set by the processor
+    // thread and read in strand_
+    std::atomic<int64_t> send_queue_limit_;
+    std::atomic<int> send_drop_policy_;
+    uint64_t send_drop_frame_id_;
+    std::atomic<uint64_t> send_sent_;
+    std::atomic<uint64_t> send_dropped_;
+    std::atomic<uint64_t> send_queued_;
+    std::atomic<uint64_t> send_queued_bytes_;
+    std::atomic<uint64_t> send_lag_us_;
+    std::atomic<uint64_t> send_max_lag_us_;
+
     void read_remote_endpoint_() noexcept {
       try {
         remote_endpoint = socket_->lowest_layer().remote_endpoint();
@@ -484,15 +588,91 @@ class SocketServerBase {
       return is_bad_() ? -1 : 0;
     }
 
+    enum SendDropPolicy {
+      SEND_DROP_NONE = 0,   // never drop, the queue is unbounded
+      SEND_DROP_OLDEST,     // drop the oldest queued message
+      SEND_DROP_FRAME,      // drop all messages of the oldest queued frame
+    };
+
+    struct SendStats {
+      uint64_t sent;
+      uint64_t dropped;
+      uint64_t queued;
+      uint64_t queued_bytes;
+      uint64_t lag_us;      // enqueue to written, last message
+      uint64_t max_lag_us;
+    };
+
+    /// limit is the max number of messages queued by send_shared()
+    /// in addition to the one being written, -1 means not set yet
+    void set_send_queue(int64_t limit, int policy) {
+      send_drop_policy_.store(policy, std::memory_order_relaxed);
+      send_queue_limit_.store(limit, std::memory_order_relaxed);
+    }
+
+    int64_t get_send_queue_limit() const {
+      return send_queue_limit_.load(std::memory_order_relaxed);
+    }
+
+    int get_send_drop_policy() const {
+      return send_drop_policy_.load(std::memory_order_relaxed);
+    }
+
+    SendStats get_send_stats() const {
+      SendStats st;
+      st.sent = send_sent_;
+      st.dropped = send_dropped_;
+      st.queued = send_queued_;
+      st.queued_bytes = send_queued_bytes_;
+      st.lag_us = send_lag_us_;
+      st.max_lag_us = send_max_lag_us_;
+      return st;
+    }
+
+    /// Queue a message that can be shared by many connections, the
+    /// message may be dropped by the drop policy if this connection is
+    /// too slow. frame_id groups the messages of one frame, 0 if none.
+    void send_shared(const std::shared_ptr<SendStream> &send_stream,
+                     uint64_t frame_id,
+                     unsigned char fin_rsv_opcode = 130) {
+      cancel_timeout_();
+      set_timeout_();
+
+      auto header_stream = make_header_(send_stream->size(), fin_rsv_opcode);
+      auto self = this->shared_from_this();
+      strand_.post(
+          [self, header_stream, send_stream, frame_id]
+          () {
+            self->enqueue_bounded_(SendData(header_stream, send_stream,
+                                            nullptr, true, frame_id));
+          });
+    }  // send_shared
+
     void send(const std::shared_ptr<SendStream> &send_stream,
               const std::function<void(const error_code &)> &callback = nullptr,
               unsigned char fin_rsv_opcode = 129) {
       cancel_timeout_();
       set_timeout_();
 
-      auto header_stream = std::make_shared<SendStream>();
+      auto header_stream = make_header_(send_stream->size(), fin_rsv_opcode);
 
-      std::size_t length = send_stream->size();
+      auto self = this->shared_from_this();
+      strand_.post(
+          [self, header_stream, send_stream, callback]
+          () {
+            self->send_queued_++;
+            self->send_queued_bytes_ += send_stream->size();
+            self->send_queue_.emplace_back(header_stream, send_stream, callback);
+            if (self->send_queue_.size() == 1) {
+              self->send_from_queue_();
+            }
+          });
+    }  // send
+
+   private:
+    std::shared_ptr<SendStream> make_header_(std::size_t length,
+                                             unsigned char fin_rsv_opcode) {
+      auto header_stream = std::make_shared<SendStream>();
 
       if (is_sp_) {
         // no header_stream for sp connection
@@ -518,18 +698,10 @@ class SocketServerBase {
           header_stream->put(static_cast<char>(length));
         }
       }
+      return header_stream;
+    }
 
-      auto self = this->shared_from_this();
-      strand_.post(
-          [self, header_stream, send_stream, callback]
-          () {
-            self->send_queue_.emplace_back(header_stream, send_stream, callback);
-            if (self->send_queue_.size() == 1) {
-              self->send_from_queue_();
-            }
-          });
-    }  // send
-
+   public:
     void send_close(int status,
                     const std::string &reason = "",
                     const std::function<void(const error_code &)> &callback = nullptr) {
@@ -8,6 +8,8 @@
 
 #include "src/ws_utils/server_ws_processor.h"
 
+#include <string.h>
+
 #include <map>
 #include <memory>
 
@@ -122,6 +124,51 @@ std::vector<int> &ServerWsProcessor::get_topics_subscribed_s(void *conn) {
   return get_ws_connection(conn)->topics_subscribed;
 }
 
+/*
+ * "<MAX_QUEUED_MESSAGES>[,oldest|frame|none]"
+ */
+static int parse_send_queue(const std::string &value,
+                            int64_t *limit, int *policy) {
+  long long l = 0;  // NOLINT
+  char policy_str[16] = "oldest";
+  int got = sscanf(value.c_str(), "%lld,%15s", &l, policy_str);
+  if (got < 1 || l < 0) {
+    return -1;
+  }
+  if (strcmp(policy_str, "oldest") == 0) {
+    *policy = WsConnection::SEND_DROP_OLDEST;
+  } else if (strcmp(policy_str, "frame") == 0) {
+    *policy = WsConnection::SEND_DROP_FRAME;
+  } else if (strcmp(policy_str, "none") == 0) {
+    *policy = WsConnection::SEND_DROP_NONE;
+  } else {
+    return -1;
+  }
+  *limit = l;
+  return 0;
+}
+
+int ServerWsProcessor::set_send_queue_s(void *conn,
+                                        const std::string &value) {
+  int64_t limit;
+  int policy;
+  if (parse_send_queue(value, &limit, &policy) != 0) {
+    return -1;
+  }
+  get_ws_connection(conn)->set_send_queue(limit, policy);
+  return 0;
+}
+
+int ServerWsProcessor::set_default_send_queue(const std::string &value) {
+  int64_t limit;
+  int policy;
+  if (parse_send_queue(value, &limit, &policy) != 0) {
+    return -1;
+  }
+  pc_server_->set_default_send_queue(limit, policy);
+  return 0;
+}
+
 std::string ServerWsProcessor::get_source_ip_string_s(void *conn) {
   return get_ws_connection(conn)->get_source_ip_string();
 }
@@ -208,6 +255,10 @@ bool ServerWsProcessor::has_ws_socket() {
   return pc_server_->has_ws_socket();
 }
 
+std::string ServerWsProcessor::get_send_stats() {
+  return pc_server_->get_send_stats();
+}
+
 void ServerWsProcessor::add_endpoint(const char *path,
                                      bool is_ws,
                                      WsServerProcessorCallback callback,
@@ -48,6 +48,18 @@ class ServerWsProcessor {
   static int write_buffer_to_ws_socket_with_length_s(
       void *conn, const char *buf, ssize_t input_len);
   static int write_ws_socket_preamble_s(void *conn);
+  /*
+   * @brief Set the send queue of a stream connection from
+   *        "<MAX_QUEUED_MESSAGES>[,oldest|frame|none]"
+   * @return 0 if success, -1 if value is invalid
+   */
+  static int set_send_queue_s(void *conn, const std::string &value);
+  /*
+   * @brief Same as set_send_queue_s() for the stream connections that
+   *        do not set their own
+   * @return 0 if success, -1 if value is invalid
+   */
+  int set_default_send_queue(const std::string &value);
 
   static void split_query_string_s_(const std::string &nv,
                                     std::string *name,
@@ -55,6 +67,7 @@ class ServerWsProcessor {
 
  public:
   bool has_ws_socket();
+  std::string get_send_stats();
 
  public:
   void add_endpoint(const char *path,
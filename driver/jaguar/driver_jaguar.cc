@@ -1,6 +1,9 @@
 #include "driver_jaguar.h"
 
+#include <sys/mman.h>
+
 #include <regex>
+#include <sstream>
 
 #include "sdk/src/inno_lidar_api.h"
 #include "sdk/src/inno_lidar_api_experimental.h"
@@ -55,10 +58,14 @@ bool DriverJaguar::init_() {
     inno_lidar_set_callbacks_2(handle_,
                                (inno_lidar_cframe_callback_t)data_callback_s_,
                                INNO_CFRAME_CPOINT, this);
+    if (cframe_pool_size > 0 && !setup_cframe_pool_()) {
+      AWARN << "cframe pool is not used, the sdk allocates the frames";
+    }
     inno_lidar_set_parameters(handle_, lidar_model.c_str(), "",
                               yaml_filename.c_str());
     inno_lidar_set_reflectance_mode(handle_,
                                     (enum reflectance_mode)reflectance);
+    set_sdk_thread_placements_();
     return true;
   }
   return false;
@@ -82,6 +89,17 @@ bool DriverJaguar::pause() {
 bool DriverJaguar::stop() {
   if (handle_ > 0) {
     inno_lidar_stop(handle_);
+    if (pool_registered_) {
+      std::unique_lock<std::mutex> lk(pool_mtx_);
+      // the frames that are still being converted go back first
+      if (!pool_cv_.wait_for(lk, std::chrono::seconds(1),
+                             [this]() { return pool_in_use_ == 0; })) {
+        AWARN << pool_in_use_ << " cframes are not returned to the pool";
+      }
+      inno_lidar_unset_external_cframe_mem_pool(handle_, pool_);
+      pool_registered_ = false;
+      AWARN << get_cframe_pool_stats_();
+    }
     inno_lidar_close(handle_);
   }
   is_running_ = 0;
@@ -89,6 +107,172 @@ bool DriverJaguar::stop() {
   return true;
 };
 
+void DriverJaguar::set_sdk_thread_placements_() {
+  // the jaguar sdk only places all of its threads together
+  for (const ThreadPlacement &placement : thread_placements) {
+    if (placement.thread == "status_poll" || placement.thread == "convert") {
+      continue;
+    }
+    if (placement.thread != "sdk") {
+      AWARN << "thread " << placement.thread
+            << " cannot be placed, use \"sdk\" for jaguar";
+      continue;
+    }
+    cpu_set_t cpuset;
+    if (!parse_cpu_list(placement.cpus, &cpuset)) {
+      AWARN << "thread sdk: bad cpus '" << placement.cpus << "'";
+      continue;
+    }
+    int ret =
+        inno_lidar_thread_setaffinity_np(handle_, sizeof(cpuset), &cpuset, 0);
+    if (ret != 0) AWARN << "thread_setaffinity " << ret;
+  }
+}
+
+int DriverJaguar::get_lidar(const std::string &cmd, std::string *result) {
+  if (cmd == "cframe_pool_stats") {
+    *result += get_cframe_pool_stats_();
+  } else if (cmd == "thread_placement") {
+    *result += thread_placement_report();
+  }
+  return 0;
+}
+
+void DriverJaguar::release_cframe(void *cframe) {
+  if (cframe == NULL) return;
+  if (!in_cframe_pool_(cframe)) {
+    // allocated by the sdk, the callee frees it
+    free(cframe);
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lk(pool_mtx_);
+    if (pool_registered_) {
+      inno_lidar_return_to_external_cframe_memory_pool(handle_, cframe);
+    }
+    pool_in_use_--;
+    pool_returned_++;
+  }
+  pool_cv_.notify_all();
+}
+
+void DriverJaguar::hold_cframe_(void *cframe) {
+  inno_cframe_header *frame = reinterpret_cast<inno_cframe_header *>(cframe);
+  bool in_pool = in_cframe_pool_(cframe);
+  bool exhausted = false;
+  pool_held_++;
+  if (pool_last_idx_ != 0 && frame->idx > pool_last_idx_ + 1) {
+    pool_frame_gaps_ += frame->idx - pool_last_idx_ - 1;
+    // the sdk dropped these frames if every unit was held meanwhile
+    exhausted = pool_full_;
+  }
+  pool_last_idx_ = frame->idx;
+  if (!in_pool) {
+    pool_outside_++;
+    // the sdk fell back to its own allocation
+    exhausted = exhausted || pool_registered_;
+  } else {
+    uint32_t in_use = ++pool_in_use_;
+    uint32_t max_in_use = pool_max_in_use_;
+    while (in_use > max_in_use &&
+           !pool_max_in_use_.compare_exchange_weak(max_in_use, in_use)) {
+    }
+  }
+  // a full pool alone is not exhaustion, the next frame may find a unit
+  pool_full_ = pool_in_use_ >= pool_units_;
+  if (exhausted) {
+    pool_exhausted_++;
+    static uint64_t warned = 0;
+    if (warned++ % 100 == 0) {
+      AWARN << "cframe pool exhausted, " << get_cframe_pool_stats_();
+    }
+  }
+}
+
+void DriverJaguar::unhold_cframe_(void *cframe) {
+  pool_held_--;
+  if (in_cframe_pool_(cframe)) {
+    pool_in_use_--;
+  } else {
+    pool_outside_--;
+  }
+}
+
+bool DriverJaguar::setup_cframe_pool_() {
+  int min_size = inno_lidar_get_min_buffer_size_per_cframe(handle_);
+  if (min_size <= 0) {
+    AWARN << "get_min_buffer_size_per_cframe failed " << min_size;
+    return false;
+  }
+  // cache line aligned units
+  size_t unit_size = (static_cast<size_t>(min_size) + 63) & ~(size_t)63;
+  if (pool_in_use_ != 0) {
+    // not returned in stop(), the units cannot be handed out again yet
+    AWARN << pool_in_use_ << " cframes of the last run are still in use";
+    return false;
+  }
+  if (pool_ != nullptr &&
+      (unit_size != pool_unit_size_ || cframe_pool_size != pool_units_)) {
+    free_cframe_pool_();
+  }
+  if (pool_ == nullptr) {
+    static const size_t kHugePageSize = 2 * 1024 * 1024;
+    size_t map_size = unit_size * cframe_pool_size;
+    map_size = (map_size + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    void *p = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE,
+                   -1, 0);
+    pool_huge_page_ = p != MAP_FAILED;
+    if (p == MAP_FAILED) {
+      // no reserved huge pages, ask for transparent huge pages
+      p = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED) {
+        AERROR << "cannot map " << map_size << " bytes for the cframe pool";
+        return false;
+      }
+      madvise(p, map_size, MADV_HUGEPAGE);
+      // fault the pages in now, not in the first frames
+      memset(p, 0, map_size);
+    }
+    pool_ = p;
+    pool_map_size_ = map_size;
+    pool_unit_size_ = unit_size;
+    pool_units_ = cframe_pool_size;
+  }
+  if (inno_lidar_set_external_cframe_mem_pool(handle_, pool_, pool_unit_size_,
+                                              pool_units_) != 0) {
+    AWARN << "set_external_cframe_mem_pool failed";
+    return false;
+  }
+  pool_registered_ = true;
+  AWARN << "cframe pool " << pool_units_ << " x " << pool_unit_size_
+        << " bytes, huge page: " << (pool_huge_page_ ? "reserved" : "thp");
+  return true;
+}
+
+void DriverJaguar::free_cframe_pool_() {
+  if (pool_ == nullptr) return;
+  if (pool_in_use_ != 0) {
+    // someone still reads them, leak rather than unmap
+    AWARN << "leak cframe pool, " << pool_in_use_ << " cframes in use";
+  } else {
+    munmap(pool_, pool_map_size_);
+  }
+  pool_ = nullptr;
+  pool_map_size_ = 0;
+}
+
+std::string DriverJaguar::get_cframe_pool_stats_() {
+  std::ostringstream os;
+  os << "cframe pool: units=" << pool_units_ << " in_use=" << pool_in_use_
+     << " max_in_use=" << pool_max_in_use_ << " held=" << pool_held_
+     << " returned=" << pool_returned_ << " exhausted=" << pool_exhausted_
+     << " lost_frames=" << pool_frame_gaps_
+     << " outside_pool=" << pool_outside_;
+  return os.str();
+}
+
 int DriverJaguar::set_config_name_value(const std::string &key,
                                         const std::string &value) {
   return inno_lidar_set_config_name_value(handle_, key.c_str(), value.c_str());
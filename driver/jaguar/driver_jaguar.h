@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <string>
+
 #include "modules/drivers/lidar/innovusion/driver/driver_factory.h"
 
 namespace apollo {
@@ -14,11 +17,21 @@ class __attribute__((visibility("default"))) DriverJaguar
       : DriverFactory(data_callback, callback_context, status_callback){};
   ~DriverJaguar() {
     stop();  // make sure that handle_ has been closed
+    free_cframe_pool_();
   };
 
   // callback group
   int data_callback_(int handle_, void *ctx, void *cframe) {
     if (cframe != NULL) {
+      if (cframe_pool_size > 0) {
+        // counted before the callee can give it back by release_cframe()
+        hold_cframe_(cframe);
+        if (cframe_callback_(handle_, cframe_callback_ctx_, cframe) == 1) {
+          return 1;  // kept by the callee
+        }
+        unhold_cframe_(cframe);
+        return 0;
+      }
       cframe_callback_(handle_, cframe_callback_ctx_, cframe);
     }
     return 0;
@@ -35,15 +48,49 @@ class __attribute__((visibility("default"))) DriverJaguar
   bool pause() override;
   bool stop() override;
 
+  void release_cframe(void *cframe) override;
+
   // optional
-  int get_lidar(const std::string &cmd, std::string *result) override {
-    return 0;
-  };
+  int get_lidar(const std::string &cmd, std::string *result) override;
   int set_lidar(const std::string &key, const std::string &value) override {
     return 0;
   };
   int set_config_name_value(const std::string &key,
                             const std::string &value) override;
+
+ private:
+  // the "sdk" thread_placements entry
+  void set_sdk_thread_placements_();
+  bool setup_cframe_pool_();
+  void free_cframe_pool_();
+  void hold_cframe_(void *cframe);
+  void unhold_cframe_(void *cframe);
+  bool in_cframe_pool_(void *cframe) const {
+    return pool_ != nullptr && cframe >= pool_ &&
+           cframe < static_cast<char *>(pool_) + pool_unit_size_ * pool_units_;
+  }
+  std::string get_cframe_pool_stats_();
+
+ private:
+  // external cframe memory pool
+  void *pool_{nullptr};
+  size_t pool_map_size_{0};
+  size_t pool_unit_size_{0};
+  uint32_t pool_units_{0};
+  bool pool_huge_page_{false};
+  std::atomic<bool> pool_registered_{false};
+  std::mutex pool_mtx_;
+  std::condition_variable pool_cv_;
+  // counters
+  std::atomic<uint32_t> pool_in_use_{0};
+  std::atomic<uint32_t> pool_max_in_use_{0};
+  std::atomic<uint64_t> pool_held_{0};
+  std::atomic<uint64_t> pool_returned_{0};
+  std::atomic<uint64_t> pool_exhausted_{0};
+  std::atomic<uint64_t> pool_outside_{0};
+  std::atomic<uint64_t> pool_frame_gaps_{0};
+  uint64_t pool_last_idx_{0};
+  bool pool_full_{false};
 };
 
 }  // namespace innovusion
@@ -0,0 +1,310 @@
+#include "motion_deskew.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+#include "cyber/cyber.h"
+
+namespace apollo {
+namespace drivers {
+namespace innovusion {
+
+// quaternions are w x y z
+static void quat_mul(const double a[4], const double b[4], double out[4]) {
+  double w = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+  double x = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+  double y = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+  double z = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+  out[0] = w;
+  out[1] = x;
+  out[2] = y;
+  out[3] = z;
+}
+
+static void quat_normalize(double q[4]) {
+  double n = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+  if (n == 0) {
+    q[0] = 1;
+    q[1] = q[2] = q[3] = 0;
+    return;
+  }
+  for (int i = 0; i < 4; i++) q[i] /= n;
+}
+
+// rotation by the angle vector v (axis * angle)
+static void quat_exp(const double v[3], double out[4]) {
+  double angle = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  double s = angle > 1e-12 ? std::sin(angle / 2) / angle : 0.5;
+  out[0] = std::cos(angle / 2);
+  out[1] = v[0] * s;
+  out[2] = v[1] * s;
+  out[3] = v[2] * s;
+}
+
+static void quat_slerp(const double a[4], const double b[4], double f,
+                       double out[4]) {
+  double dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+  double sign = dot < 0 ? -1 : 1;
+  dot *= sign;
+  double wa = 1 - f;
+  double wb = f;
+  if (dot < 0.9995) {
+    double theta = std::acos(dot);
+    wa = std::sin((1 - f) * theta) / std::sin(theta);
+    wb = std::sin(f * theta) / std::sin(theta);
+  }
+  for (int i = 0; i < 4; i++) out[i] = wa * a[i] + wb * sign * b[i];
+  quat_normalize(out);
+}
+
+RigidTransform RigidTransform::identity() {
+  RigidTransform ret = {{1, 0, 0, 0, 1, 0, 0, 0, 1}, {0, 0, 0}};
+  return ret;
+}
+
+RigidTransform RigidTransform::from_pose(const double position[3],
+                                         const double rotation[4]) {
+  double q[4] = {rotation[0], rotation[1], rotation[2], rotation[3]};
+  quat_normalize(q);
+  double w = q[0], x = q[1], y = q[2], z = q[3];
+  RigidTransform ret = {
+      {1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y),
+       2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x),
+       2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y)},
+      {position[0], position[1], position[2]}};
+  return ret;
+}
+
+RigidTransform RigidTransform::operator*(const RigidTransform &o) const {
+  RigidTransform ret;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      ret.r[i * 3 + j] = r[i * 3] * o.r[j] + r[i * 3 + 1] * o.r[3 + j] +
+                         r[i * 3 + 2] * o.r[6 + j];
+    }
+    ret.t[i] = r[i * 3] * o.t[0] + r[i * 3 + 1] * o.t[1] +
+               r[i * 3 + 2] * o.t[2] + t[i];
+  }
+  return ret;
+}
+
+RigidTransform RigidTransform::inverse() const {
+  RigidTransform ret;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) ret.r[i * 3 + j] = r[j * 3 + i];
+  }
+  for (int i = 0; i < 3; i++) {
+    ret.t[i] = -(ret.r[i * 3] * t[0] + ret.r[i * 3 + 1] * t[1] +
+                 ret.r[i * 3 + 2] * t[2]);
+  }
+  return ret;
+}
+
+MotionDeskew::MotionDeskew(const DeskewConfig &conf)
+    : max_extrapolation_ns_(conf.max_extrapolation_ms() * 1000000ull),
+      stats_interval_(conf.stats_interval()) {
+  double position[3] = {conf.x(), conf.y(), conf.z()};
+  double rotation[4] = {conf.qw(), conf.qx(), conf.qy(), conf.qz()};
+  lidar_to_vehicle_ = RigidTransform::from_pose(position, rotation);
+}
+
+void MotionDeskew::add_pose(const MotionPose &pose) {
+  std::unique_lock<std::mutex> lk(mtx_);
+  if (!poses_.empty() && pose.ts_ns <= poses_.back().ts_ns) return;
+  poses_.push_back(pose);
+  if (poses_.size() > kMaxPoses) poses_.pop_front();
+}
+
+bool MotionDeskew::pose_at_(uint64_t ts_ns, RigidTransform *pose) const {
+  if (poses_.empty() || ts_ns < poses_.front().ts_ns) return false;
+  const MotionPose &last = poses_.back();
+  if (ts_ns >= last.ts_ns) {
+    uint64_t dt_ns = ts_ns - last.ts_ns;
+    if (dt_ns == 0) {
+      *pose = RigidTransform::from_pose(last.position, last.rotation);
+      return true;
+    }
+    if (!last.has_velocity || dt_ns > max_extrapolation_ns_) return false;
+    double dt = dt_ns * 1e-9;
+    double position[3];
+    double angle[3];
+    for (int i = 0; i < 3; i++) {
+      position[i] = last.position[i] + last.linear_velocity[i] * dt;
+      angle[i] = last.angular_velocity[i] * dt;
+    }
+    // the angular velocity is in the vehicle frame
+    double delta[4];
+    double rotation[4];
+    quat_exp(angle, delta);
+    quat_mul(last.rotation, delta, rotation);
+    *pose = RigidTransform::from_pose(position, rotation);
+    return true;
+  }
+  auto b = std::upper_bound(
+      poses_.begin(), poses_.end(), ts_ns,
+      [](uint64_t ts, const MotionPose &p) { return ts < p.ts_ns; });
+  auto a = b - 1;
+  double f = static_cast<double>(ts_ns - a->ts_ns) / (b->ts_ns - a->ts_ns);
+  double position[3];
+  double rotation[4];
+  for (int i = 0; i < 3; i++) {
+    position[i] = a->position[i] + (b->position[i] - a->position[i]) * f;
+  }
+  quat_slerp(a->rotation, b->rotation, f, rotation);
+  *pose = RigidTransform::from_pose(position, rotation);
+  return true;
+}
+
+static void to_float(const RigidTransform &m, float out[12]) {
+  for (int i = 0; i < 3; i++) {
+    out[i * 4] = m.r[i * 3];
+    out[i * 4 + 1] = m.r[i * 3 + 1];
+    out[i * 4 + 2] = m.r[i * 3 + 2];
+    out[i * 4 + 3] = m.t[i];
+  }
+}
+
+void MotionDeskew::transform_run(const float a[12], const float b[12],
+                                 float t0, float inv_dt, const float *t,
+                                 float *x, float *y, float *z, uint32_t begin,
+                                 uint32_t end) {
+  // a * p + f * (b - a) * p
+  float d[12];
+  for (int k = 0; k < 12; k++) d[k] = b[k] - a[k];
+  uint32_t i = begin;
+#if defined(__SSE2__)
+  __m128 va[12];
+  __m128 vd[12];
+  for (int k = 0; k < 12; k++) {
+    va[k] = _mm_set1_ps(a[k]);
+    vd[k] = _mm_set1_ps(d[k]);
+  }
+  const __m128 vt0 = _mm_set1_ps(t0);
+  const __m128 vinv = _mm_set1_ps(inv_dt);
+  for (; i + 4 <= end; i += 4) {
+    __m128 px = _mm_loadu_ps(x + i);
+    __m128 py = _mm_loadu_ps(y + i);
+    __m128 pz = _mm_loadu_ps(z + i);
+    __m128 f = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(t + i), vt0), vinv);
+    __m128 out[3];
+    for (int r = 0; r < 3; r++) {
+      __m128 pa = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(va[r * 4], px), _mm_mul_ps(va[r * 4 + 1], py)),
+          _mm_add_ps(_mm_mul_ps(va[r * 4 + 2], pz), va[r * 4 + 3]));
+      __m128 pd = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(vd[r * 4], px), _mm_mul_ps(vd[r * 4 + 1], py)),
+          _mm_add_ps(_mm_mul_ps(vd[r * 4 + 2], pz), vd[r * 4 + 3]));
+      out[r] = _mm_add_ps(pa, _mm_mul_ps(f, pd));
+    }
+    _mm_storeu_ps(x + i, out[0]);
+    _mm_storeu_ps(y + i, out[1]);
+    _mm_storeu_ps(z + i, out[2]);
+  }
+#endif
+  for (; i < end; i++) {
+    float px = x[i];
+    float py = y[i];
+    float pz = z[i];
+    float f = (t[i] - t0) * inv_dt;
+    float out[3];
+    for (int r = 0; r < 3; r++) {
+      float pa = a[r * 4] * px + a[r * 4 + 1] * py +
+                 (a[r * 4 + 2] * pz + a[r * 4 + 3]);
+      float pd = d[r * 4] * px + d[r * 4 + 1] * py +
+                 (d[r * 4 + 2] * pz + d[r * 4 + 3]);
+      out[r] = pa + f * pd;
+    }
+    x[i] = out[0];
+    y[i] = out[1];
+    z[i] = out[2];
+  }
+}
+
+bool MotionDeskew::process(uint64_t start_ns, uint64_t end_ns,
+                           const uint64_t *ts_ns, float *x, float *y,
+                           float *z, uint32_t n) {
+  auto start = std::chrono::steady_clock::now();
+  if (end_ns <= start_ns) end_ns = start_ns + 1;
+  // the lidar at the slot ends
+  RigidTransform slots[kSlots + 1];
+  {
+    std::unique_lock<std::mutex> lk(mtx_);
+    stats_.frames++;
+    for (uint32_t k = 0; k <= kSlots; k++) {
+      uint64_t ts = start_ns + (end_ns - start_ns) * k / kSlots;
+      RigidTransform vehicle;
+      if (!pose_at_(ts, &vehicle)) {
+        stats_.skipped_frames++;
+        return false;
+      }
+      slots[k] = vehicle * lidar_to_vehicle_;
+    }
+  }
+  RigidTransform to_end = slots[kSlots].inverse();
+  float m[kSlots + 1][12];
+  for (uint32_t k = 0; k <= kSlots; k++) to_float(to_end * slots[k], m[k]);
+
+  // a late or reordered point outside the frame is moved as if taken at
+  // its start or end
+  if (t_.size() < n) t_.resize(n);
+  float *t = t_.data();
+  float span_us = (end_ns - start_ns) * 1e-3f;
+  for (uint32_t i = 0; i < n; i++) {
+    float us = static_cast<int64_t>(ts_ns[i] - start_ns) * 1e-3f;
+    t[i] = std::min(std::max(us, 0.0f), span_us);
+  }
+  // runs of points in the same slot, one run per slot in time order
+  float slot_us = span_us / kSlots;
+  float inv_slot_us = 1 / slot_us;
+  auto slot_of = [&](float us) {
+    return std::min(static_cast<uint32_t>(us * inv_slot_us), kSlots - 1);
+  };
+  uint32_t i = 0;
+  while (i < n) {
+    uint32_t k = slot_of(t[i]);
+    uint32_t begin = i;
+    while (++i < n && slot_of(t[i]) == k) {
+    }
+    transform_run(m[k], m[k + 1], slot_us * k, inv_slot_us, t, x, y, z,
+                  begin, i);
+  }
+
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  uint64_t frames;
+  {
+    std::unique_lock<std::mutex> lk(mtx_);
+    stats_.points += n;
+    stats_.total_ns += ns;
+    stats_.max_ns = std::max(stats_.max_ns, ns);
+    frames = stats_.frames;
+  }
+  if (stats_interval_ > 0 && frames % stats_interval_ == 0) {
+    AINFO << get_stats();
+  }
+  return true;
+}
+
+std::string MotionDeskew::get_stats() const {
+  std::unique_lock<std::mutex> lk(mtx_);
+  uint64_t frames = stats_.frames - stats_.skipped_frames;
+  uint64_t divider = frames ? frames : 1;
+  std::ostringstream os;
+  os << "deskew: frames=" << stats_.frames
+     << " skipped=" << stats_.skipped_frames
+     << " avg_us=" << stats_.total_ns / divider / 1000
+     << " max_us=" << stats_.max_ns / 1000
+     << " ns/point=" << (stats_.points ? stats_.total_ns / stats_.points : 0);
+  return os.str();
+}
+
+}  // namespace innovusion
+}  // namespace drivers
+}  // namespace apollo
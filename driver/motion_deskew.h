@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "modules/drivers/lidar/innovusion/proto/innovusion_config.pb.h"
+
+namespace apollo {
+namespace drivers {
+namespace innovusion {
+
+// pose of the vehicle (the localization frame) in the world
+struct MotionPose {
+  uint64_t ts_ns{0};
+  double position[3]{0, 0, 0};
+  double rotation[4]{1, 0, 0, 0};  // quaternion w x y z, vehicle to world
+  // the last pose is extrapolated by them
+  bool has_velocity{false};
+  double linear_velocity[3]{0, 0, 0};   // world, m/s
+  double angular_velocity[3]{0, 0, 0};  // vehicle, rad/s
+};
+
+// p' = r * p + t
+struct RigidTransform {
+  double r[9];
+  double t[3];
+
+  static RigidTransform identity();
+  static RigidTransform from_pose(const double position[3],
+                                  const double rotation[4]);
+  RigidTransform operator*(const RigidTransform &o) const;
+  RigidTransform inverse() const;
+};
+
+// Moves the points of a frame to where they are seen from the lidar pose at
+// the end of the frame. The vehicle poses are interpolated (or the last one
+// extrapolated by its velocities) at kSlots + 1 times across the frame,
+// a point is moved by the linear blend of the transforms at the ends of
+// its slot. The points in time order (as the converter adds them) make
+// long runs of a slot, a point out of order only splits a run and a point
+// outside the frame is taken at its start or end. The points are SoA float
+// arrays, the kernel is SSE2 if available.
+class MotionDeskew {
+ public:
+  static const uint32_t kSlots = 32;
+  static const size_t kMaxPoses = 1024;
+
+  struct Stats {
+    uint64_t frames{0};
+    uint64_t skipped_frames{0};  // no pose for the frame
+    uint64_t points{0};
+    uint64_t total_ns{0};
+    uint64_t max_ns{0};
+  };
+
+ public:
+  explicit MotionDeskew(const DeskewConfig &conf);
+
+  // thread safe, a pose not newer than the last one is dropped
+  void add_pose(const MotionPose &pose);
+  // the n points taken at ts_ns[i], false if the poses do not cover
+  // start_ns..end_ns, the points are untouched then
+  bool process(uint64_t start_ns, uint64_t end_ns, const uint64_t *ts_ns,
+               float *x, float *y, float *z, uint32_t n);
+  std::string get_stats() const;
+
+  // points [begin, end) at t[i], blend of a (at t0) and b (at t0 + 1/inv_dt)
+  // a and b are 3x4 row major
+  static void transform_run(const float a[12], const float b[12], float t0,
+                            float inv_dt, const float *t, float *x, float *y,
+                            float *z, uint32_t begin, uint32_t end);
+
+ private:
+  // vehicle pose at ts_ns, called with mtx_ held
+  bool pose_at_(uint64_t ts_ns, RigidTransform *pose) const;
+
+ private:
+  RigidTransform lidar_to_vehicle_;
+  uint64_t max_extrapolation_ns_;
+  uint32_t stats_interval_;
+
+  mutable std::mutex mtx_;
+  std::deque<MotionPose> poses_;
+  Stats stats_;
+  // us from start_ns of every point, reused across frames
+  std::vector<float> t_;
+};
+
+}  // namespace innovusion
+}  // namespace drivers
+}  // namespace apollo
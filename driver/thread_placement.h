@@ -0,0 +1,110 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <cstdlib>
+#include <string>
+
+namespace apollo {
+namespace drivers {
+namespace innovusion {
+
+// where a thread runs, see ThreadPlacementConfig in innovusion_config.proto
+struct ThreadPlacement {
+  std::string thread;
+  std::string cpus;  // "0-3,8", empty: keep
+  bool has_priority{false};
+  int32_t priority{0};  // >0: SCHED_FIFO, <0: SCHED_IDLE, 0: SCHED_OTHER
+};
+
+// "0-3,8" to a cpuset, false if the list is malformed or out of range
+inline bool parse_cpu_list(const std::string &list, cpu_set_t *cpuset) {
+  CPU_ZERO(cpuset);
+  const char *p = list.c_str();
+  while (*p) {
+    char *end;
+    long first = strtol(p, &end, 10);  // NOLINT
+    if (end == p || first < 0 || first >= CPU_SETSIZE) return false;
+    long last = first;  // NOLINT
+    p = end;
+    if (*p == '-') {
+      last = strtol(p + 1, &end, 10);
+      if (end == p + 1 || last < first || last >= CPU_SETSIZE) return false;
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; cpu++) CPU_SET(cpu, cpuset);  // NOLINT
+    if (*p == ',') {
+      p++;
+    } else if (*p) {
+      return false;
+    }
+  }
+  return CPU_COUNT(cpuset) > 0;
+}
+
+inline std::string cpu_list_string(const cpu_set_t &cpuset) {
+  std::string s;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &cpuset)) continue;
+    int last = cpu;
+    while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpuset)) last++;
+    if (!s.empty()) s += ",";
+    s += std::to_string(cpu);
+    if (last > cpu) s += "-" + std::to_string(last);
+    cpu = last;
+  }
+  return s;
+}
+
+// the cpus and scheduling the calling thread really got
+inline std::string self_thread_placement() {
+  cpu_set_t cpuset;
+  std::string cpus = "?";
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0)
+    cpus = cpu_list_string(cpuset);
+  struct sched_param param;
+  int policy;
+  if (pthread_getschedparam(pthread_self(), &policy, &param) != 0) {
+    policy = -1;
+    param.sched_priority = 0;
+  }
+  const char *name = policy == SCHED_FIFO    ? "fifo"
+                     : policy == SCHED_RR    ? "rr"
+                     : policy == SCHED_IDLE  ? "idle"
+                     : policy == SCHED_OTHER ? "other"
+                                             : "?";
+  return "cpus=" + cpus + " policy=" + name + "/" +
+         std::to_string(param.sched_priority);
+}
+
+// place the calling thread, errors are returned in *error
+inline std::string apply_thread_placement(const ThreadPlacement &placement,
+                                          std::string *error) {
+  pthread_t self = pthread_self();
+  if (!placement.cpus.empty()) {
+    cpu_set_t cpuset;
+    if (!parse_cpu_list(placement.cpus, &cpuset)) {
+      *error += "bad cpus '" + placement.cpus + "' ";
+    } else if (pthread_setaffinity_np(self, sizeof(cpuset), &cpuset) != 0) {
+      *error += "setaffinity failed ";
+    }
+  }
+  if (placement.has_priority) {
+    struct sched_param param = {};
+    int policy = SCHED_OTHER;
+    if (placement.priority > 0) {
+      policy = SCHED_FIFO;
+      param.sched_priority = placement.priority;
+    } else if (placement.priority < 0) {
+      policy = SCHED_IDLE;
+    }
+    if (pthread_setschedparam(self, policy, &param) != 0)
+      *error += "setschedparam failed ";
+  }
+  return self_thread_placement();
+}
+
+}  // namespace innovusion
+}  // namespace drivers
+}  // namespace apollo